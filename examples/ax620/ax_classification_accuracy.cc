@@ -33,6 +33,7 @@
 
 #include "base/topk.hpp"
 #include "base/common.hpp"
+#include "base/dataset.hpp"
 
 #include "middleware/io.hpp"
 
@@ -74,7 +75,7 @@ namespace ax
         }
     }
 
-    bool run_classification(const std::string& model, const std::string& image_dir, const std::string& val_file)
+    bool run_classification(const std::string& model, const std::string& image_dir, const std::string& val_file, int workers)
     {
         // 1. create a runtime handle and load the model
         AX_JOINT_HANDLE joint_handle;
@@ -232,46 +233,46 @@ namespace ax
         uint32_t duration_neu_core_us = 0, duration_neu_total_us = 0;
         uint32_t duration_axe_core_us = 0, duration_axe_total_us = 0;
 
-        std::ifstream val_file_1000(val_file);
-        if (!val_file_1000.is_open())
+        std::vector<dataset::Entry> val_entries;
+        if (!dataset::read_manifest(val_file, image_dir, val_entries))
         {
             fprintf(stderr, "[ERR] val_file_1000 open fail \n");
             clear_and_exit();
         }
 
+        // 1.1 / 1.2 decode, resize, center crop & swapRB(default is OFF) on worker threads, ahead of the npu
+        auto load = [&](dataset::Sample& sample) {
+            if (!image_io::read(sample.entry.path, 0, 0, sample.image))
+            {
+                return false;
+            }
+            sample.input.resize(image_size);
+            common::get_input_data_centercrop(sample.image.mat, sample.input, input_sizes[0], input_sizes[1], false);
+            sample.image.mat.release();
+            return true;
+        };
+        dataset::reader reader(val_entries, load, workers);
+
         std::vector<float> time_costs;
-        std::string val_file_1000_line_temp;
-        std::vector<uint8_t> image(image_size);
         int top_1 = 0, top_5 = 0, total = 0;
-        cv::Mat mat_input;
-        cv::Mat img_new(input_sizes[0], input_sizes[1], CV_8UC3, image.data());
         std::vector<cls::score> result(1001);
         int cur_index = 0;
 
         // 5. loop the val dataset
-        while (getline(val_file_1000, val_file_1000_line_temp))
+        dataset::Sample sample;
+        while (reader.next(sample))
         {
             // 1.0 decode file path
-            std::stringstream val_1000_line_ss(val_file_1000_line_temp);
-            std::string file_name, gt_index;
-            getline(val_1000_line_ss, file_name, ' ');
-            getline(val_1000_line_ss, gt_index, ' ');
-            std::string image_file_path = image_dir + '/' + file_name;
-
-            // 1.1 prepare image precess
-            mat_input = cv::imread(image_file_path);
-            if (mat_input.empty())
+            std::string file_name = sample.entry.name;
+            std::string gt_index = sample.entry.label.substr(0, sample.entry.label.find(' '));
+
+            if (!sample.ok)
             {
                 fprintf(stderr, "Read image failed.\n");
                 clear_and_exit();
             }
 
-            // 1.2 prepare resize, center crop & swapRB(default is OFF)
-            common::get_input_data_centercrop(mat_input, image, input_sizes[0], input_sizes[1], false);
-
-            mat_input.release();
-
-            mw::copy_to_device(image.data(), image.size(), pBuf);
+            mw::copy_to_device(sample.input.data(), sample.input.size(), pBuf);
             joint_io_arr.pIoSetting = &joint_io_setting;
 
             // 1.3 run joint, inference the model
@@ -360,6 +361,7 @@ namespace ax
 
         // 6. show time costs
         fprintf(stdout, "--------------------------------------\n");
+        fprintf(stdout, "image loading stalled the npu loop for %.2f ms\n", reader.stall_ms());
         fprintf(stdout,
                 "Create handle took %.2f ms (neu %.2f ms, axe %.2f ms, overhead %.2f ms)\n",
                 duration_hdl_init_us / 1000.,
@@ -389,6 +391,7 @@ int main(int argc, char* argv[])
     cmd.add<std::string>("model", 'm', "joint file(a.k.a. joint model)", true, "");
     cmd.add<std::string>("images", 'i', "image file dir", true, "");
     cmd.add<std::string>("val", 'v', "val file", true, "");
+    cmd.add<int>("workers", 0, "decode and preprocess threads", false, 2);
 
     cmd.parse_check(argc, argv);
 
@@ -396,6 +399,7 @@ int main(int argc, char* argv[])
     auto model_file = cmd.get<std::string>("model");
     auto image_file = cmd.get<std::string>("images");
     auto val_file = cmd.get<std::string>("val");
+    auto workers = cmd.get<int>("workers");
 
     auto model_file_flag = utilities::file_exist(model_file);
     auto val_file_flag = utilities::file_exist(val_file);
@@ -438,7 +442,7 @@ int main(int argc, char* argv[])
 
     // 5. run the processing
     auto flag
-        = ax::run_classification(model_file, image_file, val_file);
+        = ax::run_classification(model_file, image_file, val_file, workers);
     if (!flag)
     {
         fprintf(stderr, "Run classification failed.\n");
@@ -66,25 +66,6 @@ namespace ax
     namespace mw = middleware;
     namespace utl = utilities;
 
-    static int softmax(const float* src, float* dst, int length)
-    {
-        const float max_value = *std::max_element(src, src + length);
-        float denominator{0};
-
-        for (int i = 0; i < length; ++i)
-        {
-            dst[i] = std::exp /*fast_exp*/ (src[i] - max_value);
-            denominator += dst[i];
-        }
-
-        for (int i = 0; i < length; ++i)
-        {
-            dst[i] /= denominator;
-        }
-
-        return 0;
-    }
-
     // @brief:  generate and filter proposals
     // @param:  cls_pred[in] (1, num_grid, cls_num)
     // @param:  stride[in]
@@ -127,19 +108,8 @@ namespace ax
                     float pred_ltrb[4];
                     for (int k = 0; k < 4; k++)
                     {
-                        float dis = 0.f;
-                        // predicted distance distribution after softmax
-                        float dis_after_sm[8] = {0.};
-                        softmax(scores + num_class + k * reg_max_1, dis_after_sm, 8);
-
-                        // integral on predicted discrete distribution
-                        for (int l = 0; l < reg_max_1; l++)
-                        {
-                            dis += l * dis_after_sm[l];
-                            //printf("%2.6f ", dis_after_sm[l]);
-                        }
-                        //printf("\n");
-
+                        // integral on predicted discrete distribution after softmax
+                        float dis = math::dfl(scores + num_class + k * reg_max_1, reg_max_1);
                         pred_ltrb[k] = dis * stride;
                     }
 
@@ -365,7 +335,7 @@ namespace ax
             proposals.insert(proposals.end(), objects.begin(), objects.end());
         }
 
-        det::qsort_descent_inplace(proposals);
+        det::sort_top_k(proposals);
         std::vector<int> picked;
         det::nms_sorted_bboxes(proposals, picked, NMS_THRESHOLD);
 
@@ -256,7 +256,10 @@ namespace ax
         auto& scores_info = joint_io_arr.pOutputs[1];
         auto scores_ptr = (float*)scores_info.pVirAddr;
         float prob_threshold_unsigmoid = -1.0f * (float)std::log((1.0f / PROB_THRESHOLD) - 1.0f);
-        det::generate_proposals_palm(proposals, PROB_THRESHOLD, DEFAULT_IMG_W, DEFAULT_IMG_H, scores_ptr, bboxes_ptr, 2, strides, anchor_size, anchor_offset, map_size, prob_threshold_unsigmoid);
+        auto plan = decode::get_plan(decode::make_key("palm", DEFAULT_IMG_W, DEFAULT_IMG_H), [](decode::DecodePlan& p) {
+            decode::build_palm_plan(p, 2, strides, anchor_size, anchor_offset, map_size);
+        });
+        det::generate_proposals_palm(proposals, PROB_THRESHOLD, DEFAULT_IMG_W, DEFAULT_IMG_H, scores_ptr, bboxes_ptr, *plan, prob_threshold_unsigmoid);
 
         det::get_out_bbox_palm(proposals, objects, NMS_THRESHOLD, input_h, input_w, mat.rows, mat.cols);
 
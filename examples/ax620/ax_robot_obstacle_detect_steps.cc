@@ -261,8 +261,10 @@ namespace ax
         auto ptr_score = joint_io_arr.pOutputs[0].pVirAddr;
         auto ptr_box = joint_io_arr.pOutputs[1].pVirAddr;
 
-        det::generate_proposals_mobilenet_ssd((const float*)ptr_score, (const float*)ptr_box, 6, map_size, anchor_size, 5, 0.2, strides,
-                                              0.1, 0.2, &anchors_info[0][0], proposals);
+        auto plan = decode::get_plan(decode::make_key("mobilenet_ssd", input_w, input_h), [](decode::DecodePlan& p) {
+            decode::build_ssd_plan(p, 6, map_size, anchor_size, strides, &anchors_info[0][0]);
+        });
+        det::generate_proposals_mobilenet_ssd((const float*)ptr_score, (const float*)ptr_box, *plan, 5, 0.2, 0.1, 0.2, proposals);
 
         det::get_out_bbox_no_letterbox(proposals, objects, NMS_THRESHOLD, input_h, input_w, mat.rows, mat.cols);
 
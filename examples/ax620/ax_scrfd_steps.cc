@@ -272,7 +272,7 @@ namespace ax
             proposals.insert(proposals.end(), objects_temp.begin(), objects_temp.end());
         }
 
-        det::get_out_bbox(proposals, objects, NMS_THRESHOLD, DEFAULT_IMG_H, DEFAULT_IMG_W, mat.rows, mat.cols);
+        det::get_out_bbox(proposals, objects, NMS_THRESHOLD, DEFAULT_IMG_H, DEFAULT_IMG_W, mat.rows, mat.cols, -1, true);
 
         // 6. show time costs
         fprintf(stdout, "--------------------------------------\n");
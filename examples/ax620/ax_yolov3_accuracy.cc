@@ -34,6 +34,7 @@
 #include "base/topk.hpp"
 #include "base/yolo.hpp"
 #include "base/transform.hpp"
+#include "base/dataset.hpp"
 
 #include "middleware/io.hpp"
 
@@ -57,7 +58,7 @@ namespace ax
     namespace utl = utilities;
     namespace det = detection;
 
-    bool run_yolov3(const std::string& model, const std::string& image_dir, const std::string& val_file, const std::string& output_file, int input_size)
+    bool run_yolov3(const std::string& model, const std::string& image_dir, const std::string& val_file, const std::string& output_file, int input_size, int workers)
     {
         // 1. create a runtime handle and load the model
         AX_JOINT_HANDLE joint_handle;
@@ -211,17 +212,30 @@ namespace ax
         uint32_t duration_neu_core_us = 0, duration_neu_total_us = 0;
         uint32_t duration_axe_core_us = 0, duration_axe_total_us = 0;
 
-        std::ifstream val_file_1000(val_file);
-        if (!val_file_1000.is_open())
+        std::vector<dataset::Entry> val_entries;
+        if (!dataset::read_manifest(val_file, image_dir, val_entries))
         {
             fprintf(stderr, "[ERR] val_file_1000 open fail \n");
             clear_and_exit();
         }
 
+        // 1.1 decode, swap to rgb and resize on worker threads, ahead of the npu
+        auto load = [&](dataset::Sample& sample) {
+            if (!image_io::read(sample.entry.path, 0, 0, sample.image))
+            {
+                return false;
+            }
+            cv::Mat& mat = sample.image.mat;
+            cv::cvtColor(mat, mat, cv::COLOR_BGR2RGB);
+            sample.input.resize(input_size * input_size * 3);
+            cv::Mat img_new(input_size, input_size, CV_8UC3, sample.input.data());
+            cv::resize(mat, img_new, cv::Size(input_size, input_size));
+            return true;
+        };
+        dataset::reader reader(val_entries, load, workers);
+
         std::vector<float> time_costs;
         std::vector<float> time_postprocess;
-        std::string val_file_1000_line_temp;
-        std::vector<uint8_t> image(input_size * input_size * 3);
 
         yolo::YoloDetectionOutput yolo{};
         std::vector<yolo::TMat> yolo_inputs, yolo_outputs;
@@ -235,28 +249,22 @@ namespace ax
         fprintf(file_handle, "[");
         bool is_first = true;
 
-        while (getline(val_file_1000, val_file_1000_line_temp))
+        dataset::Sample sample;
+        while (reader.next(sample))
         {
             // 1.0 decode file path
-            std::stringstream val_1000_line_ss(val_file_1000_line_temp);
-            std::string file_name, file_name_index;
-            getline(val_1000_line_ss, file_name, ' ');
-            getline(val_1000_line_ss, file_name_index, ' ');
-            std::string image_file_path = image_dir + file_name;
-
-            // 1.1 prepare image precess
-            cv::Mat mat = cv::imread(image_file_path);
-            if (mat.empty())
+            std::string file_name = sample.entry.name;
+            std::string file_name_index = sample.entry.label.substr(0, sample.entry.label.find(' '));
+
+            if (!sample.ok)
             {
                 fprintf(stderr, "Read image failed.\n");
                 clear_and_exit();
             }
-            cv::cvtColor(mat, mat, cv::COLOR_BGR2RGB);
-            cv::Mat img_new(input_size, input_size, CV_8UC3, image.data());
-            cv::resize(mat, img_new, cv::Size(input_size, input_size));
+            const cv::Mat& mat = sample.image.mat;
 
             //ret = mw::prepare_io(image.data(), image.size(), joint_io_arr, io_info);
-            ret = mw::copy_to_device(image.data(), image.size(), pBuf);
+            ret = mw::copy_to_device(sample.input.data(), sample.input.size(), pBuf);
             if (AX_ERR_NPU_JOINT_SUCCESS != ret)
             {
                 fprintf(stderr, "Fill copy_to_device failed.\n");
@@ -364,6 +372,7 @@ namespace ax
 
         // 6. show time costs
         fprintf(stdout, "--------------------------------------\n");
+        fprintf(stdout, "image loading stalled the npu loop for %.2f ms\n", reader.stall_ms());
         fprintf(stdout,
                 "Create handle took %.2f ms (neu %.2f ms, axe %.2f ms, overhead %.2f ms)\n",
                 duration_hdl_init_us / 1000.,
@@ -394,6 +403,7 @@ int main(int argc, char* argv[])
     cmd.add<std::string>("images", 'i', "image file", true, "");
     cmd.add<std::string>("val", 'v', "val file", true, "");
     cmd.add<std::string>("out", 'o', "output file path", false, "./out.json");
+    cmd.add<int>("workers", 0, "decode and preprocess threads", false, 2);
 
     cmd.parse_check(argc, argv);
 
@@ -402,6 +412,7 @@ int main(int argc, char* argv[])
     auto image_file = cmd.get<std::string>("images");
     auto val_file = cmd.get<std::string>("val");
     auto output_file = cmd.get<std::string>("out");
+    auto workers = cmd.get<int>("workers");
 
     auto model_file_flag = utilities::file_exist(model_file);
     auto val_file_flag = utilities::file_exist(val_file);
@@ -444,7 +455,7 @@ int main(int argc, char* argv[])
 
     // 5. run the processing
 
-    auto flag = ax::run_yolov3(model_file, image_file, val_file, output_file.c_str(), 416);
+    auto flag = ax::run_yolov3(model_file, image_file, val_file, output_file.c_str(), 416, workers);
     if (!flag)
     {
         fprintf(stderr, "Run classification failed.\n");
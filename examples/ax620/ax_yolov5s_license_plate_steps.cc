@@ -264,7 +264,7 @@ namespace ax
             det::generate_proposals_yolov5_license_plate(stride, ptr, PROB_THRESHOLD, proposals, input_w, input_h, ANCHORS, prob_threshold_unsigmoid);
         }
 
-        det::get_out_bbox(proposals, objects, NMS_THRESHOLD, input_h, input_w, mat.rows, mat.cols);
+        det::get_out_bbox(proposals, objects, NMS_THRESHOLD, input_h, input_w, mat.rows, mat.cols, -1, true);
 
         // 6. show time costs
         fprintf(stdout, "--------------------------------------\n");
@@ -80,7 +80,7 @@ namespace ax
             proposals.insert(proposals.end(), objects_temp.begin(), objects_temp.end());
         }
 
-        detection::get_out_bbox(proposals, objects, NMS_THRESHOLD, DEFAULT_IMG_H, DEFAULT_IMG_W, mat.rows, mat.cols);
+        detection::get_out_bbox(proposals, objects, NMS_THRESHOLD, DEFAULT_IMG_H, DEFAULT_IMG_W, mat.rows, mat.cols, -1, true);
         fprintf(stdout, "post process cost time:%.2f ms \n", timer_postprocess.cost());
         fprintf(stdout, "--------------------------------------\n");
         auto total_time = std::accumulate(time_costs.begin(), time_costs.end(), 0.f);
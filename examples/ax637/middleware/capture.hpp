@@ -0,0 +1,533 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2025, AXERA Semiconductor Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ax_engine_api.h>
+
+#include "base/tensor.hpp"
+
+// captures grow past 2 GB, 32 bit builds need -D_FILE_OFFSET_BITS=64 as set by the top level CMakeLists.txt
+static_assert(sizeof(off_t) >= 8, "capture.hpp needs a 64 bit off_t, build with -D_FILE_OFFSET_BITS=64");
+
+/*
+ * tensor capture: the inputs and outputs of every frame after AX_ENGINE_RunSync, with the io
+ * info and the output quantization, in one file that can be mmap'ed and read in place.
+ *
+ *   header | tensor table | frame 0 | frame 1 | ... | index
+ *
+ * every block and every tensor starts on a CAPTURE_ALIGN boundary. a frame is a FrameHeader
+ * followed by its tensors in table order (inputs first), each batch * nSize / max_batch bytes.
+ * the index (one offset per frame) is written by close(), a file without it (writer killed)
+ * is still readable, the reader then walks the frames. little endian, as on the board.
+ */
+namespace middleware
+{
+    const uint32_t CAPTURE_ALIGN = 128;
+    const uint32_t CAPTURE_VERSION = 1;
+    const uint32_t CAPTURE_MAX_DIMS = 8;
+    const char CAPTURE_MAGIC[8] = {'A', 'X', 'C', 'A', 'P', 'T', 'U', 'R'};
+    const uint32_t CAPTURE_FRAME_MAGIC = 0x4d415246; // "FRAM"
+
+    typedef struct CaptureHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t alignment;
+        uint32_t num_inputs; // 0 when only outputs are captured
+        uint32_t num_outputs;
+        uint32_t max_batch;
+        uint32_t reserved0;
+        uint64_t table_offset;
+        uint64_t index_offset; // 0 until close()
+        uint64_t num_frames;
+        uint64_t reserved[10];
+    } CaptureHeader;
+
+    typedef struct CaptureTensor
+    {
+        char name[96];
+        uint32_t is_output;
+        uint32_t data_type;   // AX_ENGINE_DATA_TYPE_T
+        uint32_t color_space; // AX_ENGINE_COLOR_SPACE_T
+        uint32_t layout;      // AX_ENGINE_TENSOR_LAYOUT_T
+        uint32_t size;        // nSize, all max_batch images
+        uint32_t num_dims;
+        int32_t shape[CAPTURE_MAX_DIMS];
+        float scale; // output quantization, 1 / 0 for float outputs
+        int32_t zero_point;
+        uint64_t reserved[4];
+    } CaptureTensor;
+
+    typedef struct CaptureFrame
+    {
+        uint32_t magic;
+        uint32_t batch;
+        uint64_t index;
+        uint64_t timestamp_us;
+        uint64_t size; // header and tensors, aligned
+        uint64_t reserved[4];
+    } CaptureFrame;
+
+    static inline uint64_t capture_align(uint64_t offset)
+    {
+        return (offset + CAPTURE_ALIGN - 1) / CAPTURE_ALIGN * CAPTURE_ALIGN;
+    }
+
+    /* false for the data types tensor::View cannot read, those are not captured */
+    static inline bool capture_dtype(uint32_t data_type, tensor::DataType& dtype)
+    {
+        switch (data_type)
+        {
+        case AX_ENGINE_DT_FLOAT32:
+            dtype = tensor::DT_FLOAT32;
+            return true;
+        case AX_ENGINE_DT_SINT8:
+            dtype = tensor::DT_SINT8;
+            return true;
+        case AX_ENGINE_DT_UINT8:
+            dtype = tensor::DT_UINT8;
+            return true;
+        case AX_ENGINE_DT_UINT16:
+            dtype = tensor::DT_UINT16;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    class capture_writer
+    {
+    public:
+        capture_writer() = default;
+        capture_writer(const capture_writer&) = delete;
+        capture_writer& operator=(const capture_writer&) = delete;
+
+        ~capture_writer()
+        {
+            close();
+        }
+
+        /* with_inputs false keeps only the outputs, enough to replay post processing */
+        int open(const std::string& path, const AX_ENGINE_IO_INFO_T* info, bool with_inputs = true)
+        {
+            close();
+            tensor::DataType dtype;
+            for (uint32_t i = 0; i < info->nInputSize + info->nOutputSize; i++)
+            {
+                const AX_ENGINE_IOMETA_T& meta = i < info->nInputSize ? info->pInputs[i] : info->pOutputs[i - info->nInputSize];
+                if ((i >= info->nInputSize || with_inputs) && !capture_dtype(meta.eDataType, dtype))
+                {
+                    fprintf(stderr, "capture of tensor %s with data type %d is not supported\n", meta.pName ? meta.pName : "", (int)meta.eDataType);
+                    return -1;
+                }
+            }
+            file = fopen(path.c_str(), "wb+");
+            if (!file)
+            {
+                fprintf(stderr, "[ERR] cannot open file %s \n", path.c_str());
+                return -1;
+            }
+            setvbuf(file, nullptr, _IOFBF, 1 << 20);
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+            header.version = CAPTURE_VERSION;
+            header.alignment = CAPTURE_ALIGN;
+            header.num_inputs = with_inputs ? info->nInputSize : 0;
+            header.num_outputs = info->nOutputSize;
+            header.max_batch = info->nMaxBatchSize > 0 ? info->nMaxBatchSize : 1;
+            header.table_offset = capture_align(sizeof(CaptureHeader));
+
+            tensors.clear();
+            for (uint32_t i = 0; i < header.num_inputs; i++)
+            {
+                tensors.push_back(describe(info->pInputs[i], false));
+            }
+            for (uint32_t i = 0; i < header.num_outputs; i++)
+            {
+                tensors.push_back(describe(info->pOutputs[i], true));
+            }
+            offsets.clear();
+            offset = capture_align(header.table_offset + tensors.size() * sizeof(CaptureTensor));
+            return write_head();
+        }
+
+        /* quantization of output index, set before close(), the io info does not carry it */
+        void set_quant(int index, float scale, int32_t zero_point)
+        {
+            CaptureTensor& t = tensors[header.num_inputs + index];
+            t.scale = scale;
+            t.zero_point = zero_point;
+        }
+
+        /* call right after AX_ENGINE_RunSync, io->nBatchSize images of every tensor are kept */
+        int append(const AX_ENGINE_IO_T* io, uint64_t timestamp_us = 0)
+        {
+            if (!file)
+                return -1;
+            uint32_t batch = io->nBatchSize > 0 ? io->nBatchSize : header.max_batch;
+            CaptureFrame frame;
+            memset(&frame, 0, sizeof(frame));
+            frame.magic = CAPTURE_FRAME_MAGIC;
+            frame.batch = batch;
+            frame.index = offsets.size();
+            frame.timestamp_us = timestamp_us;
+            frame.size = capture_align(sizeof(CaptureFrame));
+            for (const auto& t : tensors)
+            {
+                frame.size += capture_align((uint64_t)t.size / header.max_batch * batch);
+            }
+
+            bool ok = fseeko(file, (off_t)offset, SEEK_SET) == 0 && write_padded(&frame, sizeof(frame));
+            for (size_t i = 0; ok && i < tensors.size(); i++)
+            {
+                const AX_ENGINE_IO_BUFFER_T& buffer = i < header.num_inputs ? io->pInputs[i] : io->pOutputs[i - header.num_inputs];
+                ok = write_padded(buffer.pVirAddr, (size_t)tensors[i].size / header.max_batch * batch);
+            }
+            if (!ok)
+            {
+                fprintf(stderr, "capture write of frame %zu failed\n", offsets.size());
+                return -1;
+            }
+            offsets.push_back(offset);
+            offset += frame.size;
+            return 0;
+        }
+
+        size_t frames() const
+        {
+            return offsets.size();
+        }
+
+        /* writes the index and the final header */
+        int close()
+        {
+            if (!file)
+                return 0;
+            header.index_offset = offset;
+            header.num_frames = offsets.size();
+            bool ok = fseeko(file, (off_t)offset, SEEK_SET) == 0 && (offsets.empty() || fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size());
+            ok = ok && write_head() == 0;
+            ok = fclose(file) == 0 && ok;
+            file = nullptr;
+            return ok ? 0 : -1;
+        }
+
+    private:
+        static CaptureTensor describe(const AX_ENGINE_IOMETA_T& meta, bool is_output)
+        {
+            CaptureTensor t;
+            memset(&t, 0, sizeof(t));
+            strncpy(t.name, meta.pName ? meta.pName : "", sizeof(t.name) - 1);
+            t.is_output = is_output ? 1 : 0;
+            t.data_type = meta.eDataType;
+            t.color_space = meta.pExtraMeta ? meta.pExtraMeta->eColorSpace : AX_ENGINE_CS_FEATUREMAP;
+            t.layout = meta.eLayout;
+            t.size = meta.nSize;
+            t.num_dims = meta.nShapeSize < CAPTURE_MAX_DIMS ? meta.nShapeSize : CAPTURE_MAX_DIMS;
+            for (uint32_t d = 0; d < t.num_dims; d++)
+            {
+                t.shape[d] = meta.pShape[d];
+            }
+            t.scale = 1.f;
+            return t;
+        }
+
+        bool write_padded(const void* data, size_t size)
+        {
+            static const char zeros[CAPTURE_ALIGN] = {0};
+            size_t pad = capture_align(size) - size;
+            return fwrite(data, 1, size, file) == size && fwrite(zeros, 1, pad, file) == pad;
+        }
+
+        int write_head()
+        {
+            bool ok = fseeko(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+            ok = ok && fseeko(file, (off_t)header.table_offset, SEEK_SET) == 0;
+            ok = ok && (tensors.empty() || fwrite(tensors.data(), sizeof(CaptureTensor), tensors.size(), file) == tensors.size());
+            return ok ? 0 : -1;
+        }
+
+        FILE* file = nullptr;
+        CaptureHeader header;
+        std::vector<CaptureTensor> tensors;
+        std::vector<uint64_t> offsets;
+        uint64_t offset = 0;
+    };
+
+    /*
+     * read only mapping of a capture. tensors are handed out as pointers into the mapping,
+     * bind() points an AX_ENGINE_IO_T at a frame so an unchanged post_process can run on it.
+     */
+    class capture_reader
+    {
+    public:
+        typedef struct Frame
+        {
+            AX_ENGINE_IO_T io;
+            std::vector<AX_ENGINE_IO_BUFFER_T> inputs;
+            std::vector<AX_ENGINE_IO_BUFFER_T> outputs;
+        } Frame;
+
+        capture_reader() = default;
+        capture_reader(const capture_reader&) = delete;
+        capture_reader& operator=(const capture_reader&) = delete;
+
+        ~capture_reader()
+        {
+            close();
+        }
+
+        bool open(const std::string& path)
+        {
+            close();
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                fprintf(stderr, "[ERR] cannot open file %s \n", path.c_str());
+                return false;
+            }
+            struct stat st;
+            // a capture larger than the address space cannot be mapped on a 32 bit board
+            if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(CaptureHeader) && (uint64_t)st.st_size <= (uint64_t)SIZE_MAX)
+            {
+                size = (size_t)st.st_size;
+                void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+                base = mapped == MAP_FAILED ? nullptr : (const uint8_t*)mapped;
+            }
+            ::close(fd);
+            if (!base || !parse())
+            {
+                fprintf(stderr, "%s is not a tensor capture\n", path.c_str());
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close()
+        {
+            if (base)
+                munmap((void*)base, size);
+            base = nullptr;
+            size = 0;
+            offsets.clear();
+        }
+
+        size_t frames() const
+        {
+            return offsets.size();
+        }
+
+        /* io info rebuilt from the tensor table, the input list is empty for an outputs only capture */
+        AX_ENGINE_IO_INFO_T* io_info()
+        {
+            return &info;
+        }
+
+        const CaptureTensor& input_desc(int index) const
+        {
+            return table()[index];
+        }
+
+        const CaptureTensor& output_desc(int index) const
+        {
+            return table()[header().num_inputs + index];
+        }
+
+        int find_output(const std::string& name) const
+        {
+            for (uint32_t i = 0; i < header().num_outputs; i++)
+            {
+                if (name == output_desc(i).name)
+                    return (int)i;
+            }
+            return -1;
+        }
+
+        const CaptureFrame& frame(size_t index) const
+        {
+            return *(const CaptureFrame*)(base + offsets[index]);
+        }
+
+        const void* input(size_t index, int tensor) const
+        {
+            return data(index, tensor);
+        }
+
+        const void* output(size_t index, int tensor) const
+        {
+            return data(index, header().num_inputs + tensor);
+        }
+
+        /* bytes of one image of the batch of output index */
+        size_t output_stride(int tensor) const
+        {
+            return output_desc(tensor).size / header().max_batch;
+        }
+
+        tensor::View output_view(size_t index, int tensor) const
+        {
+            const CaptureTensor& t = output_desc(tensor);
+            tensor::DataType dtype;
+            if (!capture_dtype(t.data_type, dtype))
+                return tensor::View{nullptr, tensor::DT_FLOAT32, {1.f, 0}};
+            return tensor::View{output(index, tensor), dtype, {t.scale, t.zero_point}};
+        }
+
+        /* points frame.io at the tensors of frame index, zero copy, valid while the reader is open */
+        void bind(size_t index, Frame& frame)
+        {
+            const CaptureHeader& h = header();
+            frame.inputs.resize(h.num_inputs);
+            frame.outputs.resize(h.num_outputs);
+            for (uint32_t i = 0; i < h.num_inputs + h.num_outputs; i++)
+            {
+                AX_ENGINE_IO_BUFFER_T& buffer = i < h.num_inputs ? frame.inputs[i] : frame.outputs[i - h.num_inputs];
+                memset(&buffer, 0, sizeof(buffer));
+                buffer.pVirAddr = (void*)data(index, i);
+                buffer.phyAddr = (AX_U64)(uintptr_t)buffer.pVirAddr;
+                buffer.nSize = table()[i].size;
+            }
+            memset(&frame.io, 0, sizeof(frame.io));
+            frame.io.pInputs = frame.inputs.data();
+            frame.io.nInputSize = h.num_inputs;
+            frame.io.pOutputs = frame.outputs.data();
+            frame.io.nOutputSize = h.num_outputs;
+            frame.io.nBatchSize = this->frame(index).batch;
+        }
+
+    private:
+        const CaptureHeader& header() const
+        {
+            return *(const CaptureHeader*)base;
+        }
+
+        const CaptureTensor* table() const
+        {
+            return (const CaptureTensor*)(base + header().table_offset);
+        }
+
+        const void* data(size_t index, uint32_t tensor) const
+        {
+            const CaptureHeader& h = header();
+            uint64_t offset = offsets[index] + capture_align(sizeof(CaptureFrame));
+            uint32_t batch = frame(index).batch;
+            for (uint32_t i = 0; i < tensor; i++)
+            {
+                offset += capture_align((uint64_t)table()[i].size / h.max_batch * batch);
+            }
+            return base + offset;
+        }
+
+        /* the frame at offset and every tensor of it lie inside the mapping */
+        bool frame_fits(uint64_t offset) const
+        {
+            const CaptureHeader& h = header();
+            if (offset % CAPTURE_ALIGN != 0 || offset > size || size - offset < sizeof(CaptureFrame))
+                return false;
+            const CaptureFrame& f = *(const CaptureFrame*)(base + offset);
+            if (f.magic != CAPTURE_FRAME_MAGIC || f.batch == 0 || f.batch > h.max_batch || f.size > size - offset)
+                return false;
+            uint64_t used = capture_align(sizeof(CaptureFrame));
+            for (uint32_t i = 0; i < h.num_inputs + h.num_outputs; i++)
+            {
+                used += capture_align((uint64_t)table()[i].size / h.max_batch * f.batch);
+            }
+            return used <= f.size;
+        }
+
+        bool parse()
+        {
+            const CaptureHeader& h = header();
+            uint64_t count = (uint64_t)h.num_inputs + h.num_outputs;
+            if (memcmp(h.magic, CAPTURE_MAGIC, sizeof(h.magic)) != 0 || h.version != CAPTURE_VERSION || h.max_batch == 0
+                || h.table_offset > size || count > (size - h.table_offset) / sizeof(CaptureTensor))
+                return false;
+
+            if (h.index_offset != 0 && h.index_offset <= size && h.num_frames <= (size - h.index_offset) / sizeof(uint64_t))
+            {
+                // the index comes from the file, every offset is checked before frame() trusts it
+                const uint64_t* index = (const uint64_t*)(base + h.index_offset);
+                offsets.assign(index, index + h.num_frames);
+                for (uint64_t offset : offsets)
+                {
+                    if (!frame_fits(offset))
+                    {
+                        offsets.clear();
+                        return false;
+                    }
+                }
+            }
+            else
+            {
+                // not closed, walk the frames up to the first incomplete one
+                uint64_t offset = capture_align(h.table_offset + count * sizeof(CaptureTensor));
+                while (frame_fits(offset))
+                {
+                    offsets.push_back(offset);
+                    offset += frame(offsets.size() - 1).size;
+                }
+            }
+
+            metas.resize(count);
+            extras.resize(count);
+            shapes.resize(count);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                const CaptureTensor& t = table()[i];
+                shapes[i].assign(t.shape, t.shape + std::min(t.num_dims, CAPTURE_MAX_DIMS));
+                memset(&metas[i], 0, sizeof(metas[i]));
+                memset(&extras[i], 0, sizeof(extras[i]));
+                extras[i].eColorSpace = (AX_ENGINE_COLOR_SPACE_T)t.color_space;
+                metas[i].pName = (AX_CHAR*)t.name;
+                metas[i].pShape = shapes[i].data();
+                metas[i].nShapeSize = (AX_U8)shapes[i].size();
+                metas[i].eLayout = (AX_ENGINE_TENSOR_LAYOUT_T)t.layout;
+                metas[i].eDataType = (AX_ENGINE_DATA_TYPE_T)t.data_type;
+                metas[i].pExtraMeta = &extras[i];
+                metas[i].nSize = t.size;
+            }
+            memset(&info, 0, sizeof(info));
+            info.pInputs = metas.data();
+            info.nInputSize = h.num_inputs;
+            info.pOutputs = metas.data() + h.num_inputs;
+            info.nOutputSize = h.num_outputs;
+            info.nMaxBatchSize = h.max_batch;
+            return true;
+        }
+
+        const uint8_t* base = nullptr;
+        size_t size = 0;
+        std::vector<uint64_t> offsets;
+        std::vector<AX_ENGINE_IOMETA_T> metas;
+        std::vector<AX_ENGINE_IOMETA_EX_T> extras;
+        std::vector<std::vector<AX_S32> > shapes;
+        AX_ENGINE_IO_INFO_T info;
+    };
+} // namespace middleware
@@ -0,0 +1,290 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2025, AXERA Semiconductor Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ax_sys_api.h>
+
+/*
+ * cmm pool behind prepare_io / free_io. blocks are rounded up to a size class and, once
+ * idle blocks are allowed (set_idle_limit or reserve), go back to a free list instead of
+ * to the cmm, so the next model of about the same size reuses them without a cmm call.
+ * with the default limit of 0 every free goes straight to AX_SYS_MemFree as before, the
+ * pool only keeps the statistics. a process that keeps idle blocks calls release() before
+ * AX_SYS_Deinit.
+ */
+namespace middleware
+{
+    const size_t CMM_POOL_ALIGN = 128;
+    const size_t CMM_POOL_SMALL = 4096;
+
+    /* 128 byte steps up to 4 KB, then 4 classes per power of two, at most 25% waste */
+    static inline size_t cmm_size_class(size_t size)
+    {
+        size = (size + CMM_POOL_ALIGN - 1) / CMM_POOL_ALIGN * CMM_POOL_ALIGN;
+        if (size <= CMM_POOL_SMALL)
+            return size > 0 ? size : CMM_POOL_ALIGN;
+        size_t power = CMM_POOL_SMALL;
+        while (power * 2 <= size)
+        {
+            power *= 2;
+        }
+        size_t step = power / 4;
+        return (size + step - 1) / step * step;
+    }
+
+    typedef struct CmmSessionStats
+    {
+        size_t in_use = 0; // bytes handed out, size classes
+        size_t peak = 0;   // high water mark of in_use
+        size_t requests = 0;
+    } CmmSessionStats;
+
+    typedef struct CmmPoolStats
+    {
+        size_t requests = 0;
+        size_t reused = 0;     // served from a free list
+        size_t cmm_allocs = 0; // AX_SYS_MemAlloc(Cached) calls
+        size_t cmm_frees = 0;
+        size_t failed = 0;
+        size_t cmm_bytes = 0; // held from the cmm, in use and idle
+        size_t cmm_peak = 0;
+        size_t idle_bytes = 0;
+        std::map<std::string, CmmSessionStats> sessions;
+    } CmmPoolStats;
+
+    class cmm_pool
+    {
+    public:
+        cmm_pool() = default;
+        cmm_pool(const cmm_pool&) = delete;
+        cmm_pool& operator=(const cmm_pool&) = delete;
+
+        /* same contract as AX_SYS_MemAlloc(Cached), CMM_POOL_ALIGN aligned */
+        int alloc(AX_U64* phy, AX_VOID** vir, size_t size, bool cached, const char* session)
+        {
+            std::string name = session ? session : "";
+            size_t size_class = cmm_size_class(size);
+            Block block;
+            bool reused = false;
+            bool keep = false;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                statistics.requests++;
+                keep = idle_limit > 0;
+                auto it = idle.find(std::make_pair(cached, size_class));
+                if (it != idle.end() && !it->second.empty())
+                {
+                    block = it->second.back();
+                    it->second.pop_back();
+                    statistics.idle_bytes -= block.size;
+                    statistics.reused++;
+                    reused = true;
+                }
+            }
+
+            if (!reused)
+            {
+                // without idle blocks nothing is reused, the exact size is enough
+                block.size = keep ? size_class : std::max((size + CMM_POOL_ALIGN - 1) / CMM_POOL_ALIGN * CMM_POOL_ALIGN, CMM_POOL_ALIGN);
+                block.cached = cached;
+                int ret = cmm_alloc(block, name.c_str());
+                if (ret != 0)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    statistics.failed++;
+                    return ret;
+                }
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            block.session = name;
+            live[block.vir] = block;
+            CmmSessionStats& s = statistics.sessions[name];
+            s.requests++;
+            s.in_use += block.size;
+            s.peak = std::max(s.peak, s.in_use);
+            *phy = block.phy;
+            *vir = block.vir;
+            return 0;
+        }
+
+        /* blocks not from this pool go to AX_SYS_MemFree */
+        void free(AX_U64 phy, AX_VOID* vir)
+        {
+            Block block;
+            bool foreign = false;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                auto it = live.find(vir);
+                if (it == live.end())
+                {
+                    foreign = true;
+                }
+                else
+                {
+                    block = it->second;
+                    live.erase(it);
+                    statistics.sessions[block.session].in_use -= block.size;
+                    if (block.size == cmm_size_class(block.size) && statistics.idle_bytes + block.size <= idle_limit)
+                    {
+                        idle[std::make_pair(block.cached, block.size)].push_back(block);
+                        statistics.idle_bytes += block.size;
+                        return;
+                    }
+                }
+            }
+            // the cmm calls stay outside the lock
+            if (foreign)
+                AX_SYS_MemFree(phy, vir);
+            else
+                cmm_free(block);
+        }
+
+        /* idle bytes kept for reuse, 0 frees every block as it is released */
+        void set_idle_limit(size_t bytes)
+        {
+            std::vector<Block> excess;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                idle_limit = bytes;
+                for (auto& list : idle)
+                {
+                    while (statistics.idle_bytes > idle_limit && !list.second.empty())
+                    {
+                        excess.push_back(list.second.back());
+                        statistics.idle_bytes -= list.second.back().size;
+                        list.second.pop_back();
+                    }
+                }
+            }
+            for (auto& block : excess)
+            {
+                cmm_free(block);
+            }
+        }
+
+        /* at least count idle blocks of the class of size, the idle limit grows to hold them */
+        int reserve(size_t size, bool cached, int count, const char* session)
+        {
+            size_t size_class = cmm_size_class(size);
+            int missing = 0;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                missing = count - (int)idle[std::make_pair(cached, size_class)].size();
+                if (missing > 0)
+                    idle_limit = std::max(idle_limit, statistics.idle_bytes + missing * size_class);
+            }
+            for (int i = 0; i < missing; i++)
+            {
+                Block block;
+                block.size = size_class;
+                block.cached = cached;
+                int ret = cmm_alloc(block, session ? session : "");
+                if (ret != 0)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    statistics.failed++;
+                    return ret;
+                }
+                std::lock_guard<std::mutex> guard(lock);
+                idle[std::make_pair(cached, size_class)].push_back(block);
+                statistics.idle_bytes += block.size;
+            }
+            return 0;
+        }
+
+        /* frees the idle blocks and stops keeping new ones, call before AX_SYS_Deinit */
+        void release()
+        {
+            set_idle_limit(0);
+            std::lock_guard<std::mutex> guard(lock);
+            if (!live.empty())
+                fprintf(stderr, "cmm pool: %zu blocks still in use\n", live.size());
+        }
+
+        CmmPoolStats stats()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return statistics;
+        }
+
+    private:
+        typedef struct Block
+        {
+            AX_U64 phy = 0;
+            AX_VOID* vir = nullptr;
+            size_t size = 0;
+            bool cached = false;
+            std::string session;
+        } Block;
+
+        int cmm_alloc(Block& block, const char* session)
+        {
+            int ret = block.cached ? AX_SYS_MemAllocCached(&block.phy, &block.vir, (AX_U32)block.size, CMM_POOL_ALIGN, (const AX_S8*)session)
+                                   : AX_SYS_MemAlloc(&block.phy, &block.vir, (AX_U32)block.size, CMM_POOL_ALIGN, (const AX_S8*)session);
+            if (ret != 0)
+                return ret;
+            std::lock_guard<std::mutex> guard(lock);
+            statistics.cmm_allocs++;
+            statistics.cmm_bytes += block.size;
+            statistics.cmm_peak = std::max(statistics.cmm_peak, statistics.cmm_bytes);
+            return 0;
+        }
+
+        void cmm_free(const Block& block)
+        {
+            AX_SYS_MemFree(block.phy, block.vir);
+            std::lock_guard<std::mutex> guard(lock);
+            statistics.cmm_frees++;
+            statistics.cmm_bytes -= block.size;
+        }
+
+        std::mutex lock;
+        size_t idle_limit = 0;
+        std::map<std::pair<bool, size_t>, std::vector<Block> > idle;
+        std::map<AX_VOID*, Block> live;
+        CmmPoolStats statistics;
+    };
+
+    /* the pool prepare_io and free_io allocate from, one per process */
+    inline cmm_pool& default_cmm_pool()
+    {
+        static cmm_pool pool;
+        return pool;
+    }
+
+    static inline void print_cmm_pool_stats(const CmmPoolStats& stats)
+    {
+        fprintf(stdout, "cmm pool: %zu requests, %zu reused, %zu cmm allocs, %zu cmm frees, %zu failed\n",
+                stats.requests, stats.reused, stats.cmm_allocs, stats.cmm_frees, stats.failed);
+        fprintf(stdout, "cmm pool: held %.2f MB, peak %.2f MB, idle %.2f MB\n",
+                stats.cmm_bytes / 1048576.f, stats.cmm_peak / 1048576.f, stats.idle_bytes / 1048576.f);
+        for (const auto& session : stats.sessions)
+        {
+            fprintf(stdout, "  %-24s in use %.2f MB, peak %.2f MB, %zu requests\n", session.first.c_str(),
+                    session.second.in_use / 1048576.f, session.second.peak / 1048576.f, session.second.requests);
+        }
+    }
+} // namespace middleware
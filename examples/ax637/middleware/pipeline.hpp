@@ -0,0 +1,377 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2025, AXERA Semiconductor Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "middleware/io.hpp"
+
+/*
+ * three stage executor over a model handle: preprocess of frame k+1, npu of frame k and
+ * postprocess of frame k-1 run on their own threads. every frame owns one of N io sets
+ * from prepare_io, the set index travels pre -> npu -> post -> pre through spsc queues,
+ * so the number of frames in flight is bounded by N and no buffer is copied.
+ */
+namespace middleware
+{
+    /* bounded single producer / single consumer ring, push and pop never block */
+    template<typename T>
+    class spsc_queue
+    {
+    public:
+        explicit spsc_queue(size_t capacity)
+        {
+            size_t size = 2;
+            while (size < capacity + 1)
+                size <<= 1;
+            slots.resize(size);
+            mask = size - 1;
+        }
+
+        spsc_queue(const spsc_queue&) = delete;
+        spsc_queue& operator=(const spsc_queue&) = delete;
+
+        bool push(const T& value)
+        {
+            size_t tail = tail_index.load(std::memory_order_relaxed);
+            size_t next = (tail + 1) & mask;
+            if (next == head_index.load(std::memory_order_acquire))
+                return false;
+            slots[tail] = value;
+            tail_index.store(next, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(T& value)
+        {
+            size_t head = head_index.load(std::memory_order_relaxed);
+            if (head == tail_index.load(std::memory_order_acquire))
+                return false;
+            value = slots[head];
+            head_index.store((head + 1) & mask, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        std::vector<T> slots;
+        size_t mask;
+        // producer and consumer indices on separate cache lines
+        alignas(64) std::atomic<size_t> head_index{0};
+        alignas(64) std::atomic<size_t> tail_index{0};
+    };
+
+    /* nearest rank percentile, p in [0, 1], of an ascending sorted list */
+    static inline float percentile(const std::vector<double>& sorted, float p)
+    {
+        if (sorted.empty())
+            return 0.f;
+        size_t rank = (size_t)(p * (sorted.size() - 1) + 0.5f);
+        return (float)sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    enum PipelineStage
+    {
+        STAGE_PRE = 0,
+        STAGE_NPU = 1,
+        STAGE_POST = 2,
+        STAGE_NUM = 3,
+    };
+
+    typedef struct PipelineStats
+    {
+        size_t frames;
+        size_t failed;            // frames dropped by an npu error
+        float wall_ms;            // first preprocess start to last postprocess end
+        float fps;                // frames / wall_ms
+        float steady_fps;         // fps once the first N frames (pipeline fill) are out
+        float busy_ms[STAGE_NUM]; // time each stage spent in its callback
+        float occupancy[STAGE_NUM];
+        float latency_p50; // preprocess start to postprocess end of one frame, ms
+        float latency_p90;
+        float latency_p99;
+        float latency_max;
+    } PipelineStats;
+
+    static inline void print_pipeline_stats(const PipelineStats& stats)
+    {
+        fprintf(stdout, "pipeline frames %zu, failed %zu, wall %.2f ms, fps %.2f, steady fps %.2f\n",
+                stats.frames, stats.failed, stats.wall_ms, stats.fps, stats.steady_fps);
+        fprintf(stdout, "stage busy pre %.2f ms (%.1f%%), npu %.2f ms (%.1f%%), post %.2f ms (%.1f%%)\n",
+                stats.busy_ms[STAGE_PRE], stats.occupancy[STAGE_PRE] * 100.f,
+                stats.busy_ms[STAGE_NPU], stats.occupancy[STAGE_NPU] * 100.f,
+                stats.busy_ms[STAGE_POST], stats.occupancy[STAGE_POST] * 100.f);
+        fprintf(stdout, "latency p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+                stats.latency_p50, stats.latency_p90, stats.latency_p99, stats.latency_max);
+    }
+
+    /*
+     * Job is the per frame state carried with an io set (source image, letterbox transform...).
+     * preprocess fills the inputs of the set and returns false at the end of the stream,
+     * postprocess reads its outputs. run defaults to AX_ENGINE_RunSync on the handle.
+     */
+    template<typename Job>
+    class pipeline
+    {
+    public:
+        typedef std::function<bool(Job&, AX_ENGINE_IO_T*)> pre_fn;
+        typedef std::function<int(Job&, AX_ENGINE_IO_T*)> run_fn;
+        typedef std::function<void(Job&, AX_ENGINE_IO_T*)> post_fn;
+
+        pipeline() = default;
+        pipeline(const pipeline&) = delete;
+        pipeline& operator=(const pipeline&) = delete;
+
+        ~pipeline()
+        {
+            release();
+        }
+
+        /* allocates num_sets io sets, 3 lets every stage hold a frame */
+        int init(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* info, int num_sets, INPUT_OUTPUT_ALLOC_STRATEGY strategy)
+        {
+            release();
+            this->handle = handle;
+            sets.resize(num_sets > 0 ? num_sets : 1);
+            for (size_t i = 0; i < sets.size(); i++)
+            {
+                auto ret = prepare_io(info, &sets[i].io, strategy);
+                if (0 != ret)
+                {
+                    sets.resize(i);
+                    release();
+                    return ret;
+                }
+            }
+            return 0;
+        }
+
+        void release()
+        {
+            for (auto& set : sets)
+            {
+                free_io(&set.io);
+            }
+            sets.clear();
+        }
+
+        int num_sets() const
+        {
+            return (int)sets.size();
+        }
+
+        AX_ENGINE_IO_T* io(int index)
+        {
+            return &sets[index].io;
+        }
+
+        /* runs until preprocess returns false, returns 0 or the first npu error */
+        int run(const pre_fn& preprocess, const post_fn& postprocess, run_fn npu = run_fn())
+        {
+            if (sets.empty())
+                return -1;
+            if (!npu)
+            {
+                AX_ENGINE_HANDLE h = handle;
+                npu = [h](Job&, AX_ENGINE_IO_T* io) { return (int)AX_ENGINE_RunSync(h, io); };
+            }
+
+            const int end_of_stream = -1;
+            spsc_queue<int> free_sets(sets.size());
+            spsc_queue<int> ready(sets.size() + 1);
+            spsc_queue<int> done(sets.size() + 1);
+            for (int i = 0; i < (int)sets.size(); i++)
+            {
+                free_sets.push(i);
+            }
+            std::atomic<bool> stop{false};
+            std::atomic<int> error{0};
+            double busy[STAGE_NUM] = {0, 0, 0};
+            std::vector<double> latencies;
+            std::vector<clock::time_point> finish;
+            auto begin = clock::now();
+
+            std::thread pre_thread([&]() {
+                int index;
+                while (pop(free_sets, index, stop))
+                {
+                    Slot& slot = sets[index];
+                    slot.start = clock::now();
+                    bool more = preprocess(slot.job, &slot.io);
+                    busy[STAGE_PRE] += elapsed_ms(slot.start, clock::now());
+                    if (!more)
+                        break;
+                    push(ready, index);
+                }
+                push(ready, end_of_stream);
+            });
+
+            std::thread npu_thread([&]() {
+                int index;
+                while (pop(ready, index) && index != end_of_stream)
+                {
+                    Slot& slot = sets[index];
+                    if (stop.load(std::memory_order_acquire))
+                    {
+                        // frames behind a failed run are dropped, not run
+                        slot.ret = error.load();
+                        push(done, index);
+                        continue;
+                    }
+                    auto t0 = clock::now();
+                    slot.ret = npu(slot.job, &slot.io);
+                    busy[STAGE_NPU] += elapsed_ms(t0, clock::now());
+                    if (0 != slot.ret)
+                    {
+                        fprintf(stderr, "pipeline npu run failed, ret = 0x%x\n", slot.ret);
+                        int expected = 0;
+                        error.compare_exchange_strong(expected, slot.ret);
+                        stop.store(true, std::memory_order_release);
+                    }
+                    push(done, index);
+                }
+                push(done, end_of_stream);
+            });
+
+            size_t failed = 0;
+            int index;
+            while (pop(done, index) && index != end_of_stream)
+            {
+                Slot& slot = sets[index];
+                auto t0 = clock::now();
+                if (0 == slot.ret)
+                {
+                    postprocess(slot.job, &slot.io);
+                    auto t1 = clock::now();
+                    busy[STAGE_POST] += elapsed_ms(t0, t1);
+                    latencies.push_back(elapsed_ms(slot.start, t1));
+                    finish.push_back(t1);
+                }
+                else
+                {
+                    failed++;
+                }
+                push(free_sets, index);
+            }
+            pre_thread.join();
+            npu_thread.join();
+
+            summarize(begin, busy, latencies, finish, failed);
+            return error.load();
+        }
+
+        const PipelineStats& stats() const
+        {
+            return last_stats;
+        }
+
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        struct Slot
+        {
+            AX_ENGINE_IO_T io;
+            Job job;
+            clock::time_point start;
+            int ret = 0;
+        };
+
+        static double elapsed_ms(clock::time_point t0, clock::time_point t1)
+        {
+            return std::chrono::duration<double, std::milli>(t1 - t0).count();
+        }
+
+        // spin briefly, then yield, then sleep so an idle stage does not eat a core
+        static void backoff(int& spins)
+        {
+            if (++spins < 64)
+                return;
+            if (spins < 128)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+
+        static void push(spsc_queue<int>& queue, int value)
+        {
+            int spins = 0;
+            while (!queue.push(value))
+                backoff(spins);
+        }
+
+        static bool pop(spsc_queue<int>& queue, int& value)
+        {
+            int spins = 0;
+            while (!queue.pop(value))
+                backoff(spins);
+            return true;
+        }
+
+        static bool pop(spsc_queue<int>& queue, int& value, const std::atomic<bool>& stop)
+        {
+            int spins = 0;
+            while (!queue.pop(value))
+            {
+                if (stop.load(std::memory_order_acquire))
+                    return false;
+                backoff(spins);
+            }
+            return !stop.load(std::memory_order_acquire);
+        }
+
+        void summarize(clock::time_point begin, const double* busy, std::vector<double>& latencies, const std::vector<clock::time_point>& finish, size_t failed)
+        {
+            PipelineStats& s = last_stats;
+            s = PipelineStats();
+            s.frames = latencies.size();
+            s.failed = failed;
+            if (finish.empty())
+                return;
+            s.wall_ms = (float)elapsed_ms(begin, finish.back());
+            s.fps = s.wall_ms > 0 ? s.frames * 1000.f / s.wall_ms : 0.f;
+            size_t warmup = sets.size();
+            if (finish.size() > warmup + 1)
+            {
+                double steady_ms = elapsed_ms(finish[warmup - 1], finish.back());
+                s.steady_fps = steady_ms > 0 ? (float)((finish.size() - warmup) * 1000.0 / steady_ms) : 0.f;
+            }
+            else
+            {
+                s.steady_fps = s.fps;
+            }
+            for (int i = 0; i < STAGE_NUM; i++)
+            {
+                s.busy_ms[i] = (float)busy[i];
+                s.occupancy[i] = s.wall_ms > 0 ? (float)(busy[i] / s.wall_ms) : 0.f;
+            }
+            std::sort(latencies.begin(), latencies.end());
+            s.latency_p50 = percentile(latencies, 0.50f);
+            s.latency_p90 = percentile(latencies, 0.90f);
+            s.latency_p99 = percentile(latencies, 0.99f);
+            s.latency_max = (float)latencies.back();
+        }
+
+        AX_ENGINE_HANDLE handle = nullptr;
+        std::vector<Slot> sets;
+        PipelineStats last_stats = PipelineStats();
+    };
+} // namespace middleware
@@ -0,0 +1,231 @@
+/*
+* AXERA is pleased to support the open source community by making ax-samples available.
+*
+* Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+*
+* Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+* in compliance with the License. You may obtain a copy of the License at
+*
+* https://opensource.org/licenses/BSD-3-Clause
+*
+* Unless required by applicable law or agreed to in writing, software distributed
+* under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+* CONDITIONS OF ANY KIND, either express or implied. See the License for the
+* specific language governing permissions and limitations under the License.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "middleware/io.hpp"
+
+#include "utilities/cmdline.hpp"
+#include "utilities/file.hpp"
+#include "utilities/split.hpp"
+#include "utilities/timer.hpp"
+
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+const int DEFAULT_SWITCHES = 30;
+
+/*
+ * cost of switching between models: every switch creates the handle, context and io
+ * buffers of the next model, runs it once and tears it all down again. with --pool_mb the
+ * io buffers come back from the cmm pool instead of the cmm, --preallocate fills the pool
+ * for all models before the first switch.
+ */
+namespace ax
+{
+    enum SwitchPhase
+    {
+        PHASE_LOAD,
+        PHASE_IO,
+        PHASE_RUN,
+        PHASE_FREE,
+        PHASE_NUM,
+    };
+
+    const char* PHASE_NAMES[PHASE_NUM] = {"create handle", "alloc io", "run", "free"};
+
+    // io info of every model, the handles live only while it is read
+    int preallocate(const std::vector<std::vector<char> >& models)
+    {
+        std::vector<AX_ENGINE_HANDLE> handles(models.size(), nullptr);
+        std::vector<AX_ENGINE_IO_INFO_T*> infos;
+        int ret = 0;
+        for (size_t i = 0; i < models.size() && 0 == ret; i++)
+        {
+            AX_ENGINE_IO_INFO_T* io_info = nullptr;
+            ret = AX_ENGINE_CreateHandle(&handles[i], models[i].data(), models[i].size());
+            if (0 == ret)
+                ret = AX_ENGINE_GetIOInfo(handles[i], &io_info);
+            infos.push_back(io_info);
+        }
+        if (0 == ret)
+            ret = middleware::preallocate_io(infos, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
+        for (auto handle : handles)
+        {
+            if (handle)
+                AX_ENGINE_DestroyHandle(handle);
+        }
+        return ret;
+    }
+
+    int switch_models(const std::vector<std::string>& names, const std::vector<std::vector<char> >& models, int switches, std::vector<std::vector<float> >& costs)
+    {
+        costs.assign(PHASE_NUM, std::vector<float>());
+        for (int s = 0; s < switches; s++)
+        {
+            size_t index = s % models.size();
+            timer tick;
+
+            // 1. create handle and context
+            AX_ENGINE_HANDLE handle = nullptr;
+            auto ret = AX_ENGINE_CreateHandle(&handle, models[index].data(), models[index].size());
+            if (0 != ret)
+            {
+                fprintf(stderr, "AX_ENGINE_CreateHandle of %s failed, ret = 0x%x\n", names[index].c_str(), ret);
+                return ret;
+            }
+            ret = AX_ENGINE_CreateContext(handle);
+            if (0 != ret)
+            {
+                fprintf(stderr, "AX_ENGINE_CreateContext of %s failed, ret = 0x%x\n", names[index].c_str(), ret);
+                AX_ENGINE_DestroyHandle(handle);
+                return ret;
+            }
+            costs[PHASE_LOAD].push_back(tick.cost());
+
+            // 2. alloc io, tagged with the model name
+            tick.start();
+            AX_ENGINE_IO_INFO_T* io_info = nullptr;
+            AX_ENGINE_IO_T io_data;
+            memset(&io_data, 0, sizeof(io_data));
+            ret = AX_ENGINE_GetIOInfo(handle, &io_info);
+            if (0 == ret)
+                ret = middleware::prepare_io(io_info, &io_data, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED), names[index].c_str());
+            if (0 != ret)
+            {
+                fprintf(stderr, "io of %s failed, ret = 0x%x\n", names[index].c_str(), ret);
+                middleware::free_io(&io_data);
+                AX_ENGINE_DestroyHandle(handle);
+                return ret;
+            }
+            costs[PHASE_IO].push_back(tick.cost());
+
+            // 3. run once
+            tick.start();
+            ret = AX_ENGINE_RunSync(handle, &io_data);
+            if (0 != ret)
+            {
+                fprintf(stderr, "AX_ENGINE_RunSync of %s failed, ret = 0x%x\n", names[index].c_str(), ret);
+                middleware::free_io(&io_data);
+                AX_ENGINE_DestroyHandle(handle);
+                return ret;
+            }
+            costs[PHASE_RUN].push_back(tick.cost());
+
+            // 4. free
+            tick.start();
+            middleware::free_io(&io_data);
+            ret = AX_ENGINE_DestroyHandle(handle);
+            costs[PHASE_FREE].push_back(tick.cost());
+            if (0 != ret)
+            {
+                return ret;
+            }
+        }
+        return 0;
+    }
+} // namespace ax
+
+int main(int argc, char* argv[])
+{
+    cmdline::parser cmd;
+    cmd.add<std::string>("model", 'm', "joint files, separated by ','", true, "");
+    cmd.add<int>("repeat", 'r', "model switches", false, DEFAULT_SWITCHES);
+    cmd.add<int>("pool_mb", 0, "idle io buffers kept in the cmm pool, 0 frees them at once", false, 0);
+    cmd.add<int>("preallocate", 0, "reserve the io buffers of all models at startup, 0 or 1", false, 0);
+    cmd.parse_check(argc, argv);
+
+    // 0. get app args, can be removed from user's app
+    auto model_files = utilities::split_string(cmd.get<std::string>("model"), ",");
+    std::vector<std::string> names;
+    std::vector<std::vector<char> > models(model_files.size());
+    for (size_t i = 0; i < model_files.size(); i++)
+    {
+        if (!utilities::read_file(model_files[i], models[i]))
+        {
+            fprintf(stderr, "Input file %s(%s) is not exist, please check it.\n", "model", model_files[i].c_str());
+            return -1;
+        }
+        names.push_back(model_files[i].substr(model_files[i].find_last_of('/') + 1));
+    }
+    auto switches = cmd.get<int>("repeat");
+    auto pool_mb = cmd.get<int>("pool_mb");
+    auto preallocate = cmd.get<int>("preallocate") != 0;
+
+    // 1. print args
+    fprintf(stdout, "--------------------------------------\n");
+    fprintf(stdout, "models : %zu, switches : %d, pool : %d MB, preallocate : %d\n", models.size(), switches, pool_mb, (int)preallocate);
+    fprintf(stdout, "--------------------------------------\n");
+
+    // 3. sys_init
+    AX_SYS_Init();
+
+    // 4. -  engine model  -  can only use AX_ENGINE** inside
+    int ret = 0;
+    {
+        AX_ENGINE_NPU_ATTR_T npu_attr;
+        memset(&npu_attr, 0, sizeof(npu_attr));
+        npu_attr.eHardMode = AX_ENGINE_VIRTUAL_NPU_DISABLE;
+        ret = AX_ENGINE_Init(&npu_attr);
+        if (0 == ret)
+        {
+            middleware::default_cmm_pool().set_idle_limit((size_t)pool_mb << 20);
+            if (preallocate)
+            {
+                ret = ax::preallocate(models);
+            }
+        }
+
+        std::vector<std::vector<float> > costs;
+        if (0 == ret)
+        {
+            ret = ax::switch_models(names, models, switches, costs);
+        }
+        if (0 != ret)
+        {
+            fprintf(stderr, "model switch failed, ret = 0x%x\n", ret);
+        }
+        else
+        {
+            fprintf(stdout, "--------------------------------------\n");
+            for (int p = 0; p < (int)costs.size() && !costs[p].empty(); p++)
+            {
+                float total = 0.f, max = 0.f;
+                for (auto cost : costs[p])
+                {
+                    total += cost;
+                    max = std::max(max, cost);
+                }
+                fprintf(stdout, "%-14s avg %.3f ms, max %.3f ms\n", ax::PHASE_NAMES[p], total / costs[p].size(), max);
+            }
+            middleware::print_cmm_pool_stats(middleware::default_cmm_pool().stats());
+            fprintf(stdout, "--------------------------------------\n");
+        }
+
+        // idle pool blocks go back to the cmm before the sys deinit
+        middleware::default_cmm_pool().release();
+
+        // 4.3 engine de init
+        AX_ENGINE_Deinit();
+    }
+    // 4. -  engine model  -
+
+    AX_SYS_Deinit();
+    return 0 != ret ? -1 : 0;
+}
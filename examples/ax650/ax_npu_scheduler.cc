@@ -0,0 +1,187 @@
+/*
+* AXERA is pleased to support the open source community by making ax-samples available.
+*
+* Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+*
+* Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+* in compliance with the License. You may obtain a copy of the License at
+*
+* https://opensource.org/licenses/BSD-3-Clause
+*
+* Unless required by applicable law or agreed to in writing, software distributed
+* under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+* CONDITIONS OF ANY KIND, either express or implied. See the License for the
+* specific language governing permissions and limitations under the License.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "middleware/io.hpp"
+#include "middleware/scheduler.hpp"
+
+#include "utilities/cmdline.hpp"
+#include "utilities/file.hpp"
+
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+const int DEFAULT_REQUESTS = 300;
+const int DEFAULT_CLIENTS = 3;
+
+/*
+ * throughput of one model under concurrent load, to compare
+ *   --mode full     : a 3 core model on the whole npu
+ *   --mode replicas : a 1 core model, one replica per core
+ * the npu mode is fixed at AX_ENGINE_Init, so the two are measured in separate runs.
+ */
+namespace ax
+{
+    typedef struct Job
+    {
+        int id;
+    } Job;
+
+    int run_model(const std::string& model, const middleware::SchedulerOptions& options, int requests, int clients, const std::string& hint)
+    {
+        // 1. init engine
+        auto ret = middleware::init_npu(options.mode);
+        if (0 != ret)
+        {
+            return ret;
+        }
+
+        // 2. load model
+        std::vector<char> model_buffer;
+        if (!utilities::read_file(model, model_buffer))
+        {
+            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
+            return -1;
+        }
+
+        // 3. create handles, contexts and io sets
+        auto preprocess = [](Job& job, AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data) {
+            for (size_t i = 0; i < io_data->nInputSize; i++)
+            {
+                memset(io_data->pInputs[i].pVirAddr, job.id & 0xff, io_info->pInputs[i].nSize);
+            }
+            return true;
+        };
+        auto postprocess = [](Job& job, AX_ENGINE_IO_INFO_T*, AX_ENGINE_IO_T*, int ret) {
+            if (0 != ret)
+            {
+                fprintf(stderr, "request %d failed, ret = 0x%x\n", job.id, ret);
+            }
+        };
+        middleware::scheduler<Job> scheduler;
+        ret = scheduler.init(model_buffer.data(), model_buffer.size(), options, preprocess, postprocess);
+        if (0 != ret)
+        {
+            return ret;
+        }
+        fprintf(stdout, "Engine created %d instances x %d contexts.\n", scheduler.num_instances(), options.contexts);
+
+        // 4. warm up every context
+        for (int i = 0; i < scheduler.num_instances() * options.contexts; i++)
+        {
+            scheduler.submit(Job{-1}, i);
+        }
+        scheduler.wait();
+        scheduler.reset_stats();
+
+        // 5. concurrent clients, each submits every clients-th request
+        std::vector<std::thread> threads;
+        for (int c = 0; c < clients; c++)
+        {
+            threads.emplace_back([&, c]() {
+                for (int i = c; i < requests; i += clients)
+                {
+                    int core = -1;
+                    if (hint == "client")
+                        core = c;
+                    else if (hint == "core0")
+                        core = 0;
+                    scheduler.submit(Job{i}, core);
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        scheduler.wait();
+
+        // 6. stats
+        fprintf(stdout, "--------------------------------------\n");
+        auto stats = scheduler.stats();
+        middleware::print_scheduler_stats(stats);
+        fprintf(stdout, "--------------------------------------\n");
+        return 0 != stats.failed ? -1 : 0;
+    }
+} // namespace ax
+
+int main(int argc, char* argv[])
+{
+    cmdline::parser cmd;
+    cmd.add<std::string>("model", 'm', "joint file(a.k.a. joint model)", true, "");
+    cmd.add<std::string>("mode", 0, "full (3 core model) or replicas (1 core model on each core)", false, "replicas");
+    cmd.add<int>("cores", 0, "replicas in replicas mode", false, 3);
+    cmd.add<int>("contexts", 0, "contexts (worker threads) per instance", false, 1);
+    cmd.add<int>("requests", 'r', "request count", false, DEFAULT_REQUESTS);
+    cmd.add<int>("clients", 0, "threads submitting requests", false, DEFAULT_CLIENTS);
+    cmd.add<std::string>("hint", 0, "core hint of a request: none, client (core = client index) or core0", false, "none");
+    cmd.add<int>("steal", 0, "idle instances take requests hinted to others, 0 or 1", false, 1);
+    cmd.add<int>("depth", 0, "requests waiting before submit blocks", false, 16);
+    cmd.parse_check(argc, argv);
+
+    // 0. get app args, can be removed from user's app
+    auto model_file = cmd.get<std::string>("model");
+    auto mode = cmd.get<std::string>("mode");
+    auto hint = cmd.get<std::string>("hint");
+
+    auto model_file_flag = utilities::file_exist(model_file);
+    if (!model_file_flag)
+    {
+        fprintf(stderr, "Input file %s(%s) is not exist, please check it.\n", "model", model_file.c_str());
+        return -1;
+    }
+    if ((mode != "full" && mode != "replicas") || (hint != "none" && hint != "client" && hint != "core0"))
+    {
+        fprintf(stderr, "Input mode(%s) or hint(%s) is not allowed, please check it.\n", mode.c_str(), hint.c_str());
+        return -1;
+    }
+
+    auto options = middleware::make_scheduler_options(mode == "full" ? middleware::SCHEDULE_FULL : middleware::SCHEDULE_REPLICAS,
+                                                      cmd.get<int>("cores"), cmd.get<int>("contexts"));
+    options.steal = cmd.get<int>("steal") != 0;
+    options.queue_depth = cmd.get<int>("depth");
+
+    // 1. print args
+    fprintf(stdout, "--------------------------------------\n");
+    fprintf(stdout, "model file : %s\n", model_file.c_str());
+    fprintf(stdout, "mode : %s, contexts : %d, clients : %d, hint : %s, steal : %d\n",
+            mode.c_str(), options.contexts, cmd.get<int>("clients"), hint.c_str(), (int)options.steal);
+    fprintf(stdout, "--------------------------------------\n");
+
+    // 3. sys_init
+    AX_SYS_Init();
+
+    // 4. -  engine model  -  can only use AX_ENGINE** inside
+    int ret = 0;
+    {
+        ret = ax::run_model(model_file, options, cmd.get<int>("requests"), cmd.get<int>("clients"), hint);
+        if (0 != ret)
+        {
+            fprintf(stderr, "Run npu scheduler failed, ret = 0x%x\n", ret);
+        }
+
+        // 4.3 engine de init
+        AX_ENGINE_Deinit();
+    }
+    // 4. -  engine model  -
+
+    AX_SYS_Deinit();
+    return 0 != ret ? -1 : 0;
+}
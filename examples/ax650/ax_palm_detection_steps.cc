@@ -74,17 +74,17 @@ namespace ax
         float prob_threshold_unsigmoid =
             -1.0f * (float)std::log((1.0f / PROB_THRESHOLD) - 1.0f);
 
+        auto plan = decode::get_plan(decode::make_key("palm", DEFAULT_IMG_W, DEFAULT_IMG_H), [](decode::DecodePlan& p) {
+            decode::build_palm_plan(p, 2, strides, anchor_size, anchor_offset, map_size);
+        });
+
         det::generate_proposals_palm(proposals,
                                      PROB_THRESHOLD,
                                      DEFAULT_IMG_W,
                                      DEFAULT_IMG_H,
                                      scores_ptr,
                                      bboxes_ptr,
-                                     2,
-                                     strides,
-                                     anchor_size,
-                                     anchor_offset,
-                                     map_size,
+                                     *plan,
                                      prob_threshold_unsigmoid);
 
         det::get_out_bbox_palm(proposals,
@@ -27,7 +27,12 @@
 #include <opencv2/opencv.hpp>
 #include "base/common.hpp"
 #include "base/detection.hpp"
+#include "base/dataset.hpp"
+#include "base/image_io.hpp"
+#include "base/sink.hpp"
 #include "middleware/io.hpp"
+#include "middleware/capture.hpp"
+#include "middleware/pipeline.hpp"
 
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
@@ -46,12 +51,20 @@ const char* CLASS_NAMES[] = {
 int NUM_CLASS = 1;
 
 const int DEFAULT_LOOP_COUNT = 1;
+const int DEFAULT_LOAD_WORKERS = 2;
+const int DEFAULT_IO_SETS = 3;
 
 const float PROB_THRESHOLD = 0.4f;
 const float NMS_THRESHOLD = 0.45f;
 namespace ax
 {
-    void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs, std::string output_dir, std::string basename)
+    typedef struct Job
+    {
+        dataset::Sample sample;
+        std::vector<float> time_costs;
+    } Job;
+
+    std::vector<detection::Object> post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs)
     {
         std::vector<detection::Object> proposals;
         std::vector<detection::Object> objects;
@@ -77,13 +90,11 @@ namespace ax
         fprintf(stdout, "--------------------------------------\n");
         fprintf(stdout, "detection num: %zu\n", objects.size());
 
-        std::string output_img_name = output_dir + "/" + basename;
-        std::string output_txt_name = output_dir + "/" + basename;
-        detection::draw_objects(mat, objects, CLASS_NAMES, output_img_name.c_str());
-        detection::save_txt(mat, objects, output_txt_name);
+        detection::print_objects(objects, CLASS_NAMES);
+        return objects;
     }
 
-    bool run_model(const std::string& model, std::string images_dir, const int& repeat, int input_h, int input_w, std::string output_dir)
+    bool run_model(const std::string& model, std::string images_dir, const int& repeat, int input_h, int input_w, std::string output_dir, int workers, int io_sets, const sink::Options& output, const std::string& capture_path)
     {
         // 1. init engine
         AX_ENGINE_NPU_ATTR_T npu_attr;
@@ -120,67 +131,109 @@ namespace ax
         SAMPLE_AX_ENGINE_DEAL_HANDLE
         fprintf(stdout, "Engine get io info is done. \n");
 
-        // 6. alloc io
-        AX_ENGINE_IO_T io_data;
-        ret = middleware::prepare_io(io_info, &io_data, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
+        // 6. alloc io, one set per frame in flight
+        middleware::pipeline<Job> pipeline;
+        ret = pipeline.init(handle, io_info, io_sets, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
         SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine alloc io is done. \n");
+        fprintf(stdout, "Engine alloc io is done, %d sets. \n", pipeline.num_sets());
+
+        // npu outputs of every frame, for replaying the post process off board
+        middleware::capture_writer capture;
+        ret = capture_path.empty() ? 0 : capture.open(capture_path, io_info, false);
+        if (0 != ret)
+        {
+            pipeline.release();
+            return AX_ENGINE_DestroyHandle(handle);
+        }
 
         // 7. insert input
         // 读取路径内图片列表, 以jpg图片为例
         std::string surffix = "*.jpg";
-        std::vector<std::string> files_vector;
-        utilities::file_list(images_dir, surffix, files_vector);
-        // 遍历输入路径，批量推理
-        for (int index = 0 ; index < files_vector.size(); index++)
-        {
-            std::string file_name = files_vector[index];
-            std::string image_path = images_dir + "/" + file_name;
-            std::string basename = file_name.substr(0, file_name.rfind("."));
-            printf("image path: %s image index: %s\n", image_path.c_str(), basename.c_str());
-            std::vector<uint8_t> image(input_h * input_w * 3, 0);
-            // std::vector<uint8_t> nv12_image(input_h * input_w * 3 / 2, 0);
-            cv::Mat mat = cv::imread(image_path);
-            if (mat.empty())
+        // decode + letterbox run on worker threads and are prefetched while the npu runs
+        auto load = [&](dataset::Sample& sample) {
+            if (!image_io::read(sample.entry.path, input_h, input_w, sample.image))
             {
-                fprintf(stderr, "Read image failed.\n");
-                return -1;
+                return false;
             }
-            common::get_input_data_letterbox(mat, image, input_h, input_w, true);
-            // common::get_input_data_letterbox_nv12(mat, image, input_h, input_w, nv12_image, true);
-        
-            ret = middleware::push_input(image, &io_data, io_info);
-            // ret = middleware::push_input(nv12_image, &io_data, io_info);
-            if (0 != ret)
+            sample.input.resize(input_h * input_w * 3);
+            sample.transform = common::get_input_data_letterbox(sample.image.mat, sample.input.data(), input_h, input_w, true);
+            return true;
+        };
+        dataset::reader reader(dataset::scan_dir(images_dir, surffix), load, workers);
+        // drawing and file writes run on the sink threads
+        sink::writer writer(output);
+        // 遍历输入路径，批量推理: input copy of frame k+1, npu of frame k and post process of frame k-1 overlap
+        auto preprocess = [&](Job& job, AX_ENGINE_IO_T* io_data) {
+            while (reader.next(job.sample))
             {
-                printf("middleware::push_input error !!!\n");
-                continue;
+                if (!job.sample.ok)
+                {
+                    fprintf(stderr, "Read image failed.\n");
+                    return false;
+                }
+                if (0 != middleware::push_input(job.sample.input, io_data, io_info))
+                {
+                    printf("middleware::push_input error !!!\n");
+                    continue;
+                }
+                return true;
             }
-            // SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
-            // fprintf(stdout, "Engine push input is done. \n");
-            // fprintf(stdout, "--------------------------------------\n");
-
-            // 8. warn up
-            // for (int i = 0; i < 5; ++i)
-            // {
-            //     AX_ENGINE_RunSync(handle, &io_data);
-            // }
-
-            // 9. run model
-            std::vector<float> time_costs(repeat, 0);
+            return false;
+        };
+
+        // 9. run model
+        auto run = [&](Job& job, AX_ENGINE_IO_T* io_data) {
+            job.time_costs.assign(repeat, 0);
             for (int i = 0; i < repeat; ++i)
             {
                 timer tick;
-                ret = AX_ENGINE_RunSync(handle, &io_data);
-                time_costs[i] = tick.cost();
-                SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+                auto status = AX_ENGINE_RunSync(handle, io_data);
+                job.time_costs[i] = tick.cost();
+                if (0 != status)
+                {
+                    return status;
+                }
             }
+            if (!capture_path.empty())
+            {
+                return capture.append(io_data);
+            }
+            return 0;
+        };
 
-            // 10. get result
-            post_process(io_info, &io_data, mat, input_w, input_h, time_costs, output_dir, basename);
+        // 10. get result
+        auto postprocess = [&](Job& job, AX_ENGINE_IO_T* io_data) {
+            std::string file_name = job.sample.entry.name;
+            std::string basename = file_name.substr(0, file_name.rfind("."));
+            printf("image path: %s image index: %s\n", job.sample.entry.path.c_str(), basename.c_str());
+            image_io::Image& loaded = job.sample.image;
+            fprintf(stdout, "decode %dx%d at 1/%d cost time:%.2f ms, load on worker:%.2f ms \n", loaded.full_width, loaded.full_height, loaded.factor, loaded.decode_ms, job.sample.load_ms);
+            std::vector<detection::Object> objects = post_process(io_info, io_data, loaded.mat, input_w, input_h, job.time_costs);
+            // detection ran on the reduced decode, the results are written at the original size
+            if (output.modes != sink::MODE_NONE)
+            {
+                for (auto& obj : objects)
+                {
+                    obj.rect = image_io::to_full(loaded, obj.rect);
+                }
+                writer.push(output_dir + "/" + basename, image_io::full(loaded), objects);
+            }
             fprintf(stdout, "--------------------------------------\n");
+        };
+
+        ret = pipeline.run(preprocess, postprocess, run);
+        middleware::print_pipeline_stats(pipeline.stats());
+        fprintf(stdout, "image loading stalled the npu loop for %.2f ms\n", reader.stall_ms());
+        writer.flush();
+        auto output_stats = writer.stats();
+        fprintf(stdout, "results written %zu, failed %zu, sink busy %.2f ms, npu loop blocked on it %.2f ms\n",
+                output_stats.written, output_stats.failed, output_stats.write_ms, output_stats.blocked_ms);
+        if (!capture_path.empty())
+        {
+            fprintf(stdout, "captured %zu frames to %s\n", capture.frames(), capture_path.c_str());
+            capture.close();
         }
-        middleware::free_io(&io_data);
+        pipeline.release();
         return AX_ENGINE_DestroyHandle(handle);
     }
 } // namespace ax
@@ -194,6 +247,11 @@ int main(int argc, char* argv[])
     cmd.add<std::string>("size", 'g', "input_h, input_w", false, std::to_string(DEFAULT_IMG_H) + "," + std::to_string(DEFAULT_IMG_W));
 
     cmd.add<int>("repeat", 'r', "repeat count", false, DEFAULT_LOOP_COUNT);
+    cmd.add<int>("workers", 0, "decode and preprocess threads", false, DEFAULT_LOAD_WORKERS);
+    cmd.add<int>("io_sets", 0, "frames in flight between input copy, npu and post process", false, DEFAULT_IO_SETS);
+    cmd.add<std::string>("save", 0, "outputs, none or any of txt,jsonl,jpeg", false, "jpeg,txt");
+    cmd.add<int>("quality", 0, "jpeg quality of the saved images", false, 95);
+    cmd.add<std::string>("capture", 0, "record the npu outputs of every frame to this file", false, "");
     cmd.parse_check(argc, argv);
 
     // 0. get app args, can be removed from user's app
@@ -202,7 +260,7 @@ int main(int argc, char* argv[])
     auto output_dir = cmd.get<std::string>("output");
 
     auto model_file_flag = utilities::file_exist(model_file);
-    auto image_path_flag = utilities::path_exist(image_dir);
+    auto image_path_flag = utilities::dir_exist(image_dir);
     if (!model_file_flag || !image_path_flag)
     {
         auto show_error = [](const std::string& kind, const std::string& value) {
@@ -215,7 +273,7 @@ int main(int argc, char* argv[])
         return -1;
     }
 
-    if (!utilities::path_exist(output_dir))
+    if (!utilities::dir_exist(output_dir))
     {
         utilities::create_dir(output_dir);
     }
@@ -238,6 +296,13 @@ int main(int argc, char* argv[])
     }
 
     auto repeat = cmd.get<int>("repeat");
+    auto workers = cmd.get<int>("workers");
+    auto io_sets = cmd.get<int>("io_sets");
+    auto save_modes = sink::parse_modes(cmd.get<std::string>("save"));
+    if (save_modes < 0)
+    {
+        return -1;
+    }
 
     // 1. print args
     fprintf(stdout, "--------------------------------------\n");
@@ -246,13 +311,15 @@ int main(int argc, char* argv[])
     fprintf(stdout, "img_h, img_w : %d %d\n", input_size[0], input_size[1]);
     fprintf(stdout, "--------------------------------------\n");
 
+    auto output = sink::make_options(output_dir, save_modes, CLASS_NAMES, cmd.get<int>("quality"));
+
     // 3. sys_init
     AX_SYS_Init();
 
     // 4. -  engine model  -  can only use AX_ENGINE** inside
     {
         // AX_ENGINE_NPUReset(); // todo ??
-        ax::run_model(model_file, image_dir, repeat, input_size[0], input_size[1], output_dir);
+        ax::run_model(model_file, image_dir, repeat, input_size[0], input_size[1], output_dir, workers, io_sets, output, cmd.get<std::string>("capture"));
 
         // 4.3 engine de init
         AX_ENGINE_Deinit();
@@ -25,7 +25,9 @@
 #include <opencv2/opencv.hpp>
 #include "base/common.hpp"
 #include "base/detection.hpp"
+#include "base/thread_pool.hpp"
 #include "middleware/io.hpp"
+#include "middleware/batcher.hpp"
 
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
@@ -51,6 +53,8 @@ const char* CLASS_NAMES[] = {
 const float ANCHORS[18] = {10, 13, 16, 30, 33, 23, 30, 61, 62, 45, 59, 119, 116, 90, 156, 198, 373, 326};
 
 const int DEFAULT_LOOP_COUNT = 1;
+const int DEFAULT_POST_THREADS = 4;
+const float DEFAULT_DEADLINE_MS = 10.f;
 
 const float PROB_THRESHOLD = 0.45f;
 const float NMS_THRESHOLD = 0.45f;
@@ -58,30 +62,43 @@ struct image_data_t
 {
     std::string path;
     cv::Mat mat;
-    std::vector<uint8_t> data;
+    letterbox::LetterboxTransform transform;
 };
 namespace ax
 {
 
-    void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const std::vector<image_data_t>& batchdata, int input_w, int input_h, const std::vector<float>& time_costs)
+    std::vector<detection::Object> detect(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, int b, const letterbox::LetterboxTransform& transform, int input_w, int input_h,
+                                          parallel::thread_pool& pool)
     {
         float prob_threshold_u_sigmoid = -1.0f * (float)std::log((1.0f / PROB_THRESHOLD) - 1.0f);
-        for (size_t b = 0; b < batchdata.size(); b++)
+        std::vector<int> strides;
+        for (uint32_t i = 0; i < io_info->nOutputSize; ++i)
         {
-            std::vector<detection::Object> proposals;
-            std::vector<detection::Object> objects;
+            strides.push_back((1 << i) * 8);
+        }
+
+        std::vector<detection::Object> proposals;
+        std::vector<detection::Object> objects;
+        detection::generate_proposals_parallel(pool, strides, input_w, input_h, proposals,
+                                               [&](int level, int row_begin, int row_end, std::vector<detection::Object>& band) {
+                                                   int32_t stride = strides[level];
+                                                   float* ptr = (float*)io_data->pOutputs[level].pVirAddr;
+                                                   ptr += b * (input_w / stride) * (input_h / stride) * 3 * (CLASS_NUM + 5);
+                                                   detection::generate_proposals_yolov5(stride, ptr, PROB_THRESHOLD, band, input_w, input_h, ANCHORS, prob_threshold_u_sigmoid, CLASS_NUM,
+                                                                                        row_begin, row_end);
+                                               });
+
+        detection::get_out_bbox(proposals, objects, NMS_THRESHOLD, transform);
+        return objects;
+    }
 
+    void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const std::vector<image_data_t>& batchdata, int input_w, int input_h, const std::vector<float>& time_costs,
+                      parallel::thread_pool& pool)
+    {
+        for (size_t b = 0; b < batchdata.size(); b++)
+        {
             timer timer_postprocess;
-            for (uint32_t i = 0; i < io_info->nOutputSize; ++i)
-            {
-                auto& output = io_data->pOutputs[i];
-                float* ptr = (float*)output.pVirAddr;
-                int32_t stride = (1 << i) * 8;
-                ptr += b * (input_w / stride) * (input_h / stride) * 3 * (CLASS_NUM + 5);
-                detection::generate_proposals_yolov5(stride, ptr, PROB_THRESHOLD, proposals, input_w, input_h, ANCHORS, prob_threshold_u_sigmoid, CLASS_NUM);
-            }
-
-            detection::get_out_bbox(proposals, objects, NMS_THRESHOLD, input_h, input_w, batchdata[b].mat.rows, batchdata[b].mat.cols);
+            auto objects = detect(io_info, io_data, b, batchdata[b].transform, input_w, input_h, pool);
             fprintf(stdout, "post process cost time:%.2f ms \n", timer_postprocess.cost());
             fprintf(stdout, "--------------------------------------\n");
             fprintf(stdout, "detection num: %zu\n", objects.size());
@@ -99,7 +116,67 @@ namespace ax
                 *min_max_time.first);
     }
 
-    bool run_model(const std::string& model, const std::vector<image_data_t>& batchdata, const int& repeat, int input_h, int input_w)
+    typedef struct StreamItem
+    {
+        int stream;
+        const image_data_t* image;
+        letterbox::LetterboxTransform transform;
+    } StreamItem;
+
+    /*
+     * every stream thread submits the images one by one, the batcher coalesces the frames of all
+     * streams up to the model batch or until deadline_ms, and hands each frame its own detections
+     */
+    int run_streams(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* io_info, const std::vector<image_data_t>& batchdata, int repeat, int input_h, int input_w,
+                    int streams, float deadline_ms, parallel::thread_pool& pool)
+    {
+        typedef middleware::batcher<StreamItem, std::vector<detection::Object> > batcher_t;
+        batcher_t batcher;
+        auto fill = [&](StreamItem& item, uint8_t* input, int) {
+            item.transform = common::get_input_data_letterbox(item.image->mat, input, input_h, input_w, false, true);
+            return true;
+        };
+        auto scatter = [&](StreamItem& item, AX_ENGINE_IO_INFO_T* info, AX_ENGINE_IO_T* io_data, int b) {
+            return detect(info, io_data, b, item.transform, input_w, input_h, pool);
+        };
+        auto ret = batcher.init(handle, io_info, middleware::make_batcher_options(deadline_ms), fill, scatter);
+        if (0 != ret)
+        {
+            return ret;
+        }
+        fprintf(stdout, "batcher up to %d frames, deadline %.1f ms, %d streams\n", batcher.batch_size(), deadline_ms, streams);
+
+        std::vector<std::thread> threads;
+        for (int s = 0; s < streams; s++)
+        {
+            threads.emplace_back([&, s]() {
+                for (int r = 0; r < repeat; r++)
+                {
+                    for (size_t i = 0; i < batchdata.size(); i++)
+                    {
+                        batcher.submit(StreamItem{s, &batchdata[i], letterbox::LetterboxTransform()}, [](StreamItem& item, batcher_t::Reply& reply) {
+                            if (0 != reply.ret)
+                            {
+                                fprintf(stderr, "stream %d frame %s failed, ret = 0x%x\n", item.stream, item.image->path.c_str(), reply.ret);
+                                return;
+                            }
+                            fprintf(stdout, "stream %d frame %s detection num: %zu\n", item.stream, item.image->path.c_str(), reply.result.size());
+                        });
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        batcher.release();
+        fprintf(stdout, "--------------------------------------\n");
+        middleware::print_batcher_stats(batcher.stats());
+        return 0;
+    }
+
+    bool run_model(const std::string& model, std::vector<image_data_t>& batchdata, const int& repeat, int input_h, int input_w, parallel::thread_pool& pool, int streams, float deadline_ms)
     {
         // 1. init engine
 #ifdef AXERA_TARGET_CHIP_AX620E
@@ -139,6 +216,12 @@ namespace ax
         ret = AX_ENGINE_GetIOInfo(handle, &io_info);
         SAMPLE_AX_ENGINE_DEAL_HANDLE
         fprintf(stdout, "Engine get io info is done. \n");
+        if (streams > 0)
+        {
+            ret = run_streams(handle, io_info, batchdata, repeat, input_h, input_w, streams, deadline_ms, pool);
+            auto destroy_ret = AX_ENGINE_DestroyHandle(handle);
+            return 0 == ret && 0 == destroy_ret;
+        }
         if (batchdata.size() > io_info->nMaxBatchSize)
         {
             fprintf(stderr, "The batch size is too large. %d > %d\n", batchdata.size(), io_info->nMaxBatchSize);
@@ -152,16 +235,13 @@ namespace ax
         SAMPLE_AX_ENGINE_DEAL_HANDLE
         fprintf(stdout, "Engine alloc io is done. \n");
 
-        // 7. insert input
+        // 7. insert input, letterbox of image i goes straight to offset i of the input tensor
         io_data.nBatchSize = batchdata.size();
-        int single_input_size = io_info->pInputs[0].nSize / io_info->nMaxBatchSize;
-        printf("single input size %d \n", single_input_size);
-        uint8_t* input_data = (uint8_t*)io_data.pInputs[0].pVirAddr;
+        printf("single input size %d \n", (int)middleware::get_input_batch_stride(io_info));
         for (int i = 0; i < batchdata.size(); ++i)
         {
-            memcpy(input_data + i * single_input_size, batchdata[i].data.data(), single_input_size);
+            batchdata[i].transform = common::get_input_data_letterbox(batchdata[i].mat, middleware::get_input_buffer(io_info, &io_data, 0, i), input_h, input_w, false, true);
         }
-        // memcpy(io_data.pInputs[0].pVirAddr, data.data(), data.size());
         fprintf(stdout, "Engine push input is done. \n");
         fprintf(stdout, "--------------------------------------\n");
 
@@ -182,7 +262,7 @@ namespace ax
         }
 
         // 10. get result
-        post_process(io_info, &io_data, batchdata, input_w, input_h, time_costs);
+        post_process(io_info, &io_data, batchdata, input_w, input_h, time_costs, pool);
         fprintf(stdout, "--------------------------------------\n");
 
         middleware::free_io(&io_data);
@@ -198,6 +278,10 @@ int main(int argc, char* argv[])
     cmd.add<std::string>("size", 'g', "input_h, input_w", false, std::to_string(DEFAULT_IMG_H) + "," + std::to_string(DEFAULT_IMG_W));
 
     cmd.add<int>("repeat", 'r', "repeat count", false, DEFAULT_LOOP_COUNT);
+    cmd.add<int>("threads", 't', "post process threads", false, DEFAULT_POST_THREADS);
+    cmd.add<std::string>("affinity", 'a', "cpu ids of post process threads, e.g. 4,5,6", false, "");
+    cmd.add<int>("streams", 's', "producer threads feeding a dynamic batcher, 0 runs the folder as one batch", false, 0);
+    cmd.add<float>("deadline", 0, "longest wait of a frame for its batch to fill, ms", false, DEFAULT_DEADLINE_MS);
     cmd.parse_check(argc, argv);
 
     // 0. get app args, can be removed from user's app
@@ -236,6 +320,13 @@ int main(int argc, char* argv[])
 
     auto repeat = cmd.get<int>("repeat");
 
+    std::vector<int> cpu_ids;
+    if (!utilities::parse_string(cmd.get<std::string>("affinity"), cpu_ids))
+    {
+        fprintf(stderr, "Input affinity(%s) is not allowed, please check it.\n", cmd.get<std::string>("affinity").c_str());
+        return -1;
+    }
+
     // 1. print args
     fprintf(stdout, "--------------------------------------\n");
     fprintf(stdout, "model file : %s\n", model_file.c_str());
@@ -273,8 +364,6 @@ int main(int argc, char* argv[])
             fprintf(stderr, "Read image failed.\n");
             return -1;
         }
-        batchdata[i].data.resize(input_size[0] * input_size[1] * 3, 0);
-        common::get_input_data_letterbox(batchdata[i].mat, batchdata[i].data, input_size[0], input_size[1]);
     }
     // cv::Mat mat = cv::imread(image_file);
     // if (mat.empty())
@@ -290,7 +379,8 @@ int main(int argc, char* argv[])
     // 4. -  engine model  -  can only use AX_ENGINE** inside
     {
         // AX_ENGINE_NPUReset(); // todo ??
-        ax::run_model(model_file, batchdata, repeat, input_size[0], input_size[1]);
+        parallel::thread_pool pool(cmd.get<int>("threads"), cpu_ids);
+        ax::run_model(model_file, batchdata, repeat, input_size[0], input_size[1], pool, cmd.get<int>("streams"), cmd.get<float>("deadline"));
 
         // 4.3 engine de init
         AX_ENGINE_Deinit();
@@ -25,6 +25,7 @@
 #include <opencv2/opencv.hpp>
 #include "base/common.hpp"
 #include "base/detection.hpp"
+#include "base/nv12.hpp"
 #include "middleware/io.hpp"
 
 #include "utilities/args.hpp"
@@ -162,6 +163,29 @@ namespace ax
         return true;
     }
 
+    // same csc and auto aspect crop resize as rgb2nv12 on the cpu, for boards or builds without ivps
+    bool rgb2nv12_cpu(const cv::Mat& mat, int cropresize_width, int cropresize_height, std::vector<uint8_t>& image_nv12)
+    {
+        timer timer_cpu;
+        int width = mat.cols & ~1;
+        int height = mat.rows & ~1;
+        std::vector<uint8_t> full(nv12::frame_size(width, height));
+        auto src = nv12::make_frame(full.data(), width, height);
+        if (nv12::bgr_to_nv12(mat.data, (int)mat.step[0], src) != 0)
+        {
+            return false;
+        }
+
+        image_nv12.resize(nv12::frame_size(cropresize_width, cropresize_height));
+        auto dst = nv12::make_frame(image_nv12.data(), cropresize_width, cropresize_height);
+        if (nv12::crop_resize(src, dst, nv12::make_aspect_ratio(nv12::ASPECT_RATIO_AUTO, 0xFFFFFF)) != 0)
+        {
+            return false;
+        }
+        fprintf(stdout, "cpu csc + crop resize cost time:%.2f ms \n", timer_cpu.cost());
+        return true;
+    }
+
     void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs)
     {
         std::vector<detection::Object> proposals;
@@ -277,6 +301,7 @@ int main(int argc, char* argv[])
     cmd.add<std::string>("size", 'g', "input_h, input_w", false, std::to_string(DEFAULT_IMG_H) + "," + std::to_string(DEFAULT_IMG_W));
 
     cmd.add<int>("repeat", 'r', "repeat count", false, DEFAULT_LOOP_COUNT);
+    cmd.add("cpu", 0, "csc and crop resize on the cpu instead of ivps");
     cmd.parse_check(argc, argv);
 
     // 0. get app args, can be removed from user's app
@@ -333,7 +358,17 @@ int main(int argc, char* argv[])
         return -1;
     }
 
-    if (!ax::rgb2nv12(mat, input_size[0], input_size[1], image_nv12))
+    bool nv12_ready = false;
+    if (cmd.exist("cpu"))
+    {
+        AX_SYS_Init();
+        nv12_ready = ax::rgb2nv12_cpu(mat, input_size[0], input_size[1], image_nv12);
+    }
+    else
+    {
+        nv12_ready = ax::rgb2nv12(mat, input_size[0], input_size[1], image_nv12);
+    }
+    if (!nv12_ready)
     {
         fprintf(stderr, "rgb2nv12 failed.\n");
         return -1;
@@ -58,12 +58,12 @@ namespace ax
         std::vector<detection::Object> objects;
         timer timer_postprocess;
 
-        std::vector<int> strides = { 8, 16, 32 };
-        std::vector<detection::GridAndStride> grid_strides;
-        detection::generate_grids_and_stride(input_w, input_h, strides, grid_strides);
+        auto plan = decode::get_plan(decode::make_key("yolov8_obb", input_w, input_h), [&](decode::DecodePlan& p) {
+            decode::build_grid_plan(p, input_w, input_h, {8, 16, 32});
+        });
 
         auto feat_ptr = (float*)io_data->pOutputs[0].pVirAddr;
-        detection::obb::generate_proposals_yolov8_obb_native(grid_strides, feat_ptr, PROB_THRESHOLD, proposals, input_w, input_h, NUM_CLASS);
+        detection::obb::generate_proposals_yolov8_obb_native(*plan, feat_ptr, PROB_THRESHOLD, proposals, input_w, input_h, NUM_CLASS);
         detection::obb::get_out_obb_bbox(proposals, objects, NMS_THRESHOLD, input_h, input_w, mat.rows, mat.cols);
 
         fprintf(stdout, "post process cost time:%.2f ms \n", timer_postprocess.cost());
@@ -56,9 +56,10 @@ namespace ax
 {
     void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs)
     {
-        std::vector<detection::Object> proposals;
+        detection::ProposalArena arena;
         std::vector<detection::Object> objects;
         timer timer_postprocess;
+        arena.reset(detection::ProposalArena::FEAT_KPS, NUM_POINT * 3);
 
         float* output_ptr[3] = {(float*)io_data->pOutputs[0].pVirAddr,      // 1*80*80*65
                                 (float*)io_data->pOutputs[1].pVirAddr,      // 1*40*40*65
@@ -72,10 +73,10 @@ namespace ax
             auto feat_ptr = output_ptr[i];
             auto feat_kps_ptr = output_kps_ptr[i];
             int32_t stride = (1 << i) * 8;
-            detection::generate_proposals_yolov8_pose_native(stride, feat_ptr, feat_kps_ptr, PROB_THRESHOLD, proposals, input_w, input_h, NUM_POINT, NUM_CLASS);
+            detection::generate_proposals_yolov8_pose_native(stride, tensor::make_view(feat_ptr), tensor::make_view(feat_kps_ptr), PROB_THRESHOLD, arena, input_w, input_h, NUM_CLASS);
         }
 
-        detection::get_out_bbox_kps(proposals, objects, NMS_THRESHOLD, input_h, input_w, mat.rows, mat.cols);
+        detection::get_out_bbox_kps(arena, objects, NMS_THRESHOLD, input_h, input_w, mat.rows, mat.cols);
         fprintf(stdout, "post process cost time:%.2f ms \n", timer_postprocess.cost());
         fprintf(stdout, "--------------------------------------\n");
         auto total_time = std::accumulate(time_costs.begin(), time_costs.end(), 0.f);
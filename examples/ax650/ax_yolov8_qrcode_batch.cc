@@ -28,6 +28,9 @@
 #include <opencv2/imgproc.hpp>
 #include "base/common.hpp"
 #include "base/detection.hpp"
+#include "base/dataset.hpp"
+#include "base/image_io.hpp"
+#include "base/sink.hpp"
 #include "middleware/io.hpp"
 
 #include "utilities/args.hpp"
@@ -50,12 +53,13 @@ const char* CLASS_NAMES[] = {
 int NUM_CLASS = 1;
 
 const int DEFAULT_LOOP_COUNT = 1;
+const int DEFAULT_LOAD_WORKERS = 2;
 
 const float PROB_THRESHOLD = 0.45f;
 const float NMS_THRESHOLD = 0.45f;
 namespace ax
 {
-    std::vector<detection::Object> post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs, std::string output_dir, std::string basename)
+    std::vector<detection::Object> post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs)
     {
         std::vector<detection::Object> proposals;
         std::vector<detection::Object> objects;
@@ -80,10 +84,7 @@ namespace ax
                 *min_max_time.first);
         fprintf(stdout, "--------------------------------------\n");
         fprintf(stdout, "detection num: %zu\n", objects.size());
-        std::string output_img_name = output_dir + "/" + basename;
-        std::string output_txt_name = output_dir + "/" + basename;
-        detection::draw_objects(mat, objects, CLASS_NAMES, output_img_name.c_str());
-        // detection::save_txt(mat, objects, output_txt_name);
+        detection::print_objects(objects, CLASS_NAMES);
         // for (size_t i = 0; i < objects.size(); i++)
         // {
         //     detection::Object obj = objects[i];
@@ -95,7 +96,7 @@ namespace ax
         return objects;
     }
 
-    bool run_model(const std::string& model, std::string images_dir, const int& repeat, int input_h, int input_w, std::string output_dir)
+    bool run_model(const std::string& model, std::string images_dir, const int& repeat, int input_h, int input_w, std::string output_dir, int workers, const sink::Options& output)
     {
         // 1. init engine
         AX_ENGINE_NPU_ATTR_T npu_attr;
@@ -142,8 +143,19 @@ namespace ax
         // 7. insert input
         // 读取路径内图片列表, 以jpg图片为例
         std::string surffix = "*.jpg";
-        std::vector<std::string> files_vector;
-        utilities::file_list(images_dir, surffix, files_vector);
+        // decode + letterbox run on worker threads and are prefetched while the npu runs
+        auto load = [&](dataset::Sample& sample) {
+            if (!image_io::read(sample.entry.path, input_h, input_w, sample.image))
+            {
+                return false;
+            }
+            sample.input.resize(input_h * input_w * 3);
+            sample.transform = common::get_input_data_letterbox(sample.image.mat, sample.input.data(), input_h, input_w, true);
+            return true;
+        };
+        dataset::reader reader(dataset::scan_dir(images_dir, surffix), load, workers);
+        // drawing and file writes run on the sink threads
+        sink::writer writer(output);
 
         //zbar init
         zbar::zbar_image_scanner_t *scanner = NULL;
@@ -155,24 +167,26 @@ namespace ax
         zbar::zbar_image_set_format(zbarimage, zbar_fourcc('Y', '8', '0', '0'));
 
         int total_decode_count = 0;
-        for (int index = 0 ; index < files_vector.size(); index++)
+        dataset::Sample sample;
+        while (reader.next(sample))
         {
             bool success = false;
-            std::string file_name = files_vector[index];
-            std::string image_path = images_dir + "/" + file_name;
+            std::string file_name = sample.entry.name;
+            std::string image_path = sample.entry.path;
             std::string basename = file_name.substr(0, file_name.rfind("."));
             printf("image path: %s image index: %s\n", image_path.c_str(), basename.c_str());
-            std::vector<uint8_t> image(input_h * input_w * 3, 0);
-            cv::Mat mat = cv::imread(image_path);
-            if (mat.empty())
+            if (!sample.ok)
             {
                 fprintf(stderr, "Read image failed.\n");
                 return -1;
             }
-            cv::Mat image_org = mat.clone();
-            common::get_input_data_letterbox(mat, image, input_h, input_w, true);
+            image_io::Image& loaded = sample.image;
+            cv::Mat mat = loaded.mat;
+            // detection runs on the reduced decode, zbar on the full one
+            cv::Mat image_org;
+            fprintf(stdout, "decode %dx%d at 1/%d cost time:%.2f ms, load on worker:%.2f ms \n", loaded.full_width, loaded.full_height, loaded.factor, loaded.decode_ms, sample.load_ms);
         
-            ret = middleware::push_input(image, &io_data, io_info);
+            ret = middleware::push_input(sample.input, &io_data, io_info);
             if (0 != ret)
             {
                 printf("middleware::push_input error !!!\n");
@@ -199,7 +213,19 @@ namespace ax
             }
 
             // 10. get result
-            std::vector<detection::Object> QR_Regions = post_process(io_info, &io_data, mat, input_w, input_h, time_costs, output_dir, basename);
+            std::vector<detection::Object> QR_Regions = post_process(io_info, &io_data, mat, input_w, input_h, time_costs);
+            // the boxes go back to the full size image, zbar scans it and the writer draws on it
+            if (!QR_Regions.empty() || output.modes != sink::MODE_NONE)
+            {
+                timer timer_full;
+                image_org = image_io::full(loaded);
+                fprintf(stdout, "full size decode cost time:%.2f ms \n", timer_full.cost());
+            }
+            for (auto& obj : QR_Regions)
+            {
+                obj.rect = image_io::to_full(loaded, obj.rect);
+            }
+            writer.push(output_dir + "/" + basename, image_org, QR_Regions);
             for (size_t i = 0; i < QR_Regions.size(); i++)
             {
                 detection::Object obj = QR_Regions[i];
@@ -336,7 +362,7 @@ namespace ax
                     cv::Mat dstImage;
                     cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(2.0, cv::Size(8, 8));
                     clahe->apply(srcImage, dstImage);
-                    cv::imwrite(output_dir + "/" + basename + "_clahe" + ".jpg", dstImage);
+                    writer.push_image(output_dir + "/" + basename + "_clahe" + ".jpg", dstImage);
                     zbar::zbar_image_set_size(zbarimage, cut_width, cut_height);
                     zbar::zbar_image_set_data(zbarimage, dstImage.data, dstImage.total() * dstImage.elemSize(), NULL);
                     n = zbar_scan_image(scanner, zbarimage);
@@ -368,12 +394,17 @@ namespace ax
             }
             fprintf(stdout, "--------------------------------------\n");
         }
-        fprintf(stdout, "Total pics:%d\n", files_vector.size());
+        fprintf(stdout, "Total pics:%d\n", reader.size());
         fprintf(stdout, "Total decode count:%d\n", total_decode_count);
-        fprintf(stdout, "Decode rate:%.1f%\n",total_decode_count*100.0/files_vector.size());
+        fprintf(stdout, "Decode rate:%.1f%\n",total_decode_count*100.0/reader.size());
 
         zbar::zbar_image_destroy(zbarimage);
         zbar::zbar_image_scanner_destroy(scanner);
+        fprintf(stdout, "image loading stalled the npu loop for %.2f ms\n", reader.stall_ms());
+        writer.flush();
+        auto output_stats = writer.stats();
+        fprintf(stdout, "results written %zu, failed %zu, sink busy %.2f ms, npu loop blocked on it %.2f ms\n",
+                output_stats.written, output_stats.failed, output_stats.write_ms, output_stats.blocked_ms);
         middleware::free_io(&io_data);
         return AX_ENGINE_DestroyHandle(handle);
     }
@@ -388,6 +419,9 @@ int main(int argc, char* argv[])
     cmd.add<std::string>("size", 'g', "input_h, input_w", false, std::to_string(DEFAULT_IMG_H) + "," + std::to_string(DEFAULT_IMG_W));
 
     cmd.add<int>("repeat", 'r', "repeat count", false, DEFAULT_LOOP_COUNT);
+    cmd.add<int>("workers", 0, "decode and preprocess threads", false, DEFAULT_LOAD_WORKERS);
+    cmd.add<std::string>("save", 0, "outputs, none or any of txt,jsonl,jpeg", false, "jpeg");
+    cmd.add<int>("quality", 0, "jpeg quality of the saved images", false, 95);
     cmd.parse_check(argc, argv);
 
     // 0. get app args, can be removed from user's app
@@ -396,7 +430,7 @@ int main(int argc, char* argv[])
     auto output_dir = cmd.get<std::string>("output");
 
     auto model_file_flag = utilities::file_exist(model_file);
-    auto image_path_flag = utilities::path_exist(image_dir);
+    auto image_path_flag = utilities::dir_exist(image_dir);
     if (!model_file_flag || !image_path_flag)
     {
         auto show_error = [](const std::string& kind, const std::string& value) {
@@ -409,7 +443,7 @@ int main(int argc, char* argv[])
         return -1;
     }
 
-    if (!utilities::path_exist(output_dir))
+    if (!utilities::dir_exist(output_dir))
     {
         utilities::create_dir(output_dir);
     }
@@ -432,6 +466,12 @@ int main(int argc, char* argv[])
     }
 
     auto repeat = cmd.get<int>("repeat");
+    auto workers = cmd.get<int>("workers");
+    auto save_modes = sink::parse_modes(cmd.get<std::string>("save"));
+    if (save_modes < 0)
+    {
+        return -1;
+    }
 
     // 1. print args
     fprintf(stdout, "--------------------------------------\n");
@@ -440,13 +480,15 @@ int main(int argc, char* argv[])
     fprintf(stdout, "img_h, img_w : %d %d\n", input_size[0], input_size[1]);
     fprintf(stdout, "--------------------------------------\n");
 
+    auto output = sink::make_options(output_dir, save_modes, CLASS_NAMES, cmd.get<int>("quality"));
+
     // 3. sys_init
     AX_SYS_Init();
 
     // 4. -  engine model  -  can only use AX_ENGINE** inside
     {
         // AX_ENGINE_NPUReset(); // todo ??
-        ax::run_model(model_file, image_dir, repeat, input_size[0], input_size[1], output_dir);
+        ax::run_model(model_file, image_dir, repeat, input_size[0], input_size[1], output_dir, workers, output);
 
         // 4.3 engine de init
         AX_ENGINE_Deinit();
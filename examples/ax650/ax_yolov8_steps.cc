@@ -25,6 +25,7 @@
 #include <opencv2/opencv.hpp>
 #include "base/common.hpp"
 #include "base/detection.hpp"
+#include "base/thread_pool.hpp"
 #include "middleware/io.hpp"
 
 #include "utilities/args.hpp"
@@ -49,27 +50,37 @@ const char* CLASS_NAMES[] = {
     "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear",
     "hair drier", "toothbrush"};
 
-int NUM_CLASS = 80;
-
 const int DEFAULT_LOOP_COUNT = 1;
+const int DEFAULT_POST_THREADS = 4;
 
 const float PROB_THRESHOLD = 0.45f;
 const float NMS_THRESHOLD = 0.45f;
 namespace ax
 {
-    void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs)
+    bool post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, const letterbox::LetterboxTransform& transform, int input_w, int input_h, const std::vector<float>& time_costs,
+                      const std::vector<tensor::QuantParam>& quant, parallel::thread_pool& pool)
     {
         std::vector<detection::Object> proposals;
         std::vector<detection::Object> objects;
         timer timer_postprocess;
-        for (int i = 0; i < 3; ++i)
+        const std::vector<int> strides = {8, 16, 32};
+        std::vector<detection::Yolov8NativeDecoder> decoders;
+        std::vector<tensor::View> feats;
+        for (size_t i = 0; i < strides.size(); ++i)
         {
-            auto feat_ptr = (float*)io_data->pOutputs[i].pVirAddr;
-            int32_t stride = (1 << i) * 8;
-            detection::generate_proposals_yolov8_native(stride, feat_ptr, PROB_THRESHOLD, proposals, input_w, input_h, NUM_CLASS);
+            decoders.push_back(detection::make_yolov8_native_decoder(middleware::get_output_shape(io_info, i)));
+            feats.push_back(middleware::get_output_view(io_info, io_data, i, quant[i].scale, quant[i].zero_point));
+            if (!feats.back().data)
+            {
+                return false;
+            }
         }
+        detection::generate_proposals_parallel(pool, strides, input_w, input_h, proposals,
+                                               [&](int level, int row_begin, int row_end, std::vector<detection::Object>& band) {
+                                                   decoders[level](strides[level], feats[level], PROB_THRESHOLD, band, input_w, input_h, row_begin, row_end);
+                                               });
 
-        detection::get_out_bbox(proposals, objects, NMS_THRESHOLD, input_h, input_w, mat.rows, mat.cols);
+        detection::get_out_bbox(proposals, objects, NMS_THRESHOLD, transform);
         fprintf(stdout, "post process cost time:%.2f ms \n", timer_postprocess.cost());
         fprintf(stdout, "--------------------------------------\n");
         auto total_time = std::accumulate(time_costs.begin(), time_costs.end(), 0.f);
@@ -84,9 +95,10 @@ namespace ax
         fprintf(stdout, "detection num: %zu\n", objects.size());
 
         detection::draw_objects(mat, objects, CLASS_NAMES, "yolov8_out");
+        return true;
     }
 
-    bool run_model(const std::string& model, const std::vector<uint8_t>& data, const int& repeat, cv::Mat& mat, int input_h, int input_w)
+    bool run_model(const std::string& model, const int& repeat, cv::Mat& mat, int input_h, int input_w, const std::vector<tensor::QuantParam>& quant, parallel::thread_pool& pool)
     {
         // 1. init engine
         AX_ENGINE_NPU_ATTR_T npu_attr;
@@ -122,6 +134,15 @@ namespace ax
         ret = AX_ENGINE_GetIOInfo(handle, &io_info);
         SAMPLE_AX_ENGINE_DEAL_HANDLE
         fprintf(stdout, "Engine get io info is done. \n");
+        for (int i = 0; i < 3; ++i)
+        {
+            if (io_info->pOutputs[i].eDataType != AX_ENGINE_DT_FLOAT32 && quant[i].scale <= 0.f)
+            {
+                fprintf(stderr, "Output %s is quantized, pass its scale and zero point with --quant.\n", io_info->pOutputs[i].pName);
+                AX_ENGINE_DestroyHandle(handle);
+                return false;
+            }
+        }
 
         // 6. alloc io
         AX_ENGINE_IO_T io_data;
@@ -129,9 +150,8 @@ namespace ax
         SAMPLE_AX_ENGINE_DEAL_HANDLE
         fprintf(stdout, "Engine alloc io is done. \n");
 
-        // 7. insert input
-        ret = middleware::push_input(data, &io_data, io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+        // 7. insert input, letterbox straight into the input tensor
+        auto transform = common::get_input_data_letterbox(mat, middleware::get_input_buffer(io_info, &io_data), input_h, input_w, false, true);
         fprintf(stdout, "Engine push input is done. \n");
         fprintf(stdout, "--------------------------------------\n");
 
@@ -152,7 +172,12 @@ namespace ax
         }
 
         // 10. get result
-        post_process(io_info, &io_data, mat, input_w, input_h, time_costs);
+        if (!post_process(io_info, &io_data, mat, transform, input_w, input_h, time_costs, quant, pool))
+        {
+            middleware::free_io(&io_data);
+            AX_ENGINE_DestroyHandle(handle);
+            return false;
+        }
         fprintf(stdout, "--------------------------------------\n");
 
         middleware::free_io(&io_data);
@@ -168,6 +193,9 @@ int main(int argc, char* argv[])
     cmd.add<std::string>("size", 'g', "input_h, input_w", false, std::to_string(DEFAULT_IMG_H) + "," + std::to_string(DEFAULT_IMG_W));
 
     cmd.add<int>("repeat", 'r', "repeat count", false, DEFAULT_LOOP_COUNT);
+    cmd.add<int>("threads", 't', "post process threads", false, DEFAULT_POST_THREADS);
+    cmd.add<std::string>("affinity", 'a', "cpu ids of post process threads, e.g. 4,5,6", false, "");
+    cmd.add<std::string>("quant", 'q', "scale,zero_point of the 3 outputs of a quantized model, e.g. 0.08,-128,0.08,-128,0.08,-128", false, "");
     cmd.parse_check(argc, argv);
 
     // 0. get app args, can be removed from user's app
@@ -208,6 +236,26 @@ int main(int argc, char* argv[])
 
     auto repeat = cmd.get<int>("repeat");
 
+    std::vector<int> cpu_ids;
+    if (!utilities::parse_string(cmd.get<std::string>("affinity"), cpu_ids))
+    {
+        fprintf(stderr, "Input affinity(%s) is not allowed, please check it.\n", cmd.get<std::string>("affinity").c_str());
+        return -1;
+    }
+
+    std::vector<float> quant_values;
+    std::vector<tensor::QuantParam> quant(3, tensor::QuantParam{0.f, 0});
+    if (!utilities::parse_string(cmd.get<std::string>("quant"), quant_values) || (!quant_values.empty() && quant_values.size() != 6))
+    {
+        fprintf(stderr, "Input quant(%s) is not allowed, please check it.\n", cmd.get<std::string>("quant").c_str());
+        return -1;
+    }
+    for (size_t i = 0; i < quant_values.size() / 2; i++)
+    {
+        quant[i].scale = quant_values[i * 2];
+        quant[i].zero_point = (int32_t)quant_values[i * 2 + 1];
+    }
+
     // 1. print args
     fprintf(stdout, "--------------------------------------\n");
     fprintf(stdout, "model file : %s\n", model_file.c_str());
@@ -215,15 +263,13 @@ int main(int argc, char* argv[])
     fprintf(stdout, "img_h, img_w : %d %d\n", input_size[0], input_size[1]);
     fprintf(stdout, "--------------------------------------\n");
 
-    // 2. read image & resize & transpose
-    std::vector<uint8_t> image(input_size[0] * input_size[1] * 3, 0);
+    // 2. read image, resized into the input tensor by run_model
     cv::Mat mat = cv::imread(image_file);
     if (mat.empty())
     {
         fprintf(stderr, "Read image failed.\n");
         return -1;
     }
-    common::get_input_data_letterbox(mat, image, input_size[0], input_size[1]);
 
     // 3. sys_init
     AX_SYS_Init();
@@ -231,7 +277,8 @@ int main(int argc, char* argv[])
     // 4. -  engine model  -  can only use AX_ENGINE** inside
     {
         // AX_ENGINE_NPUReset(); // todo ??
-        ax::run_model(model_file, image, repeat, mat, input_size[0], input_size[1]);
+        parallel::thread_pool pool(cmd.get<int>("threads"), cpu_ids);
+        ax::run_model(model_file, repeat, mat, input_size[0], input_size[1], quant, pool);
 
         // 4.3 engine de init
         AX_ENGINE_Deinit();
@@ -0,0 +1,394 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "middleware/io.hpp"
+#include "middleware/pipeline.hpp"
+
+/*
+ * dynamic batching for models with nMaxBatchSize > 1. producers on any thread submit
+ * single items, each one is written by fill straight into its slot of the open batch
+ * (no staging copy). the batch closes when it is full or when its first item has waited
+ * deadline_ms, then the batcher thread runs it and hands every item its own result.
+ * two io sets let producers fill the next batch while the npu runs the current one.
+ */
+namespace middleware
+{
+    typedef struct BatcherOptions
+    {
+        int max_batch;     // <= nMaxBatchSize, 0 takes nMaxBatchSize
+        float deadline_ms; // longest wait of the first item of a batch
+        int io_sets;       // batches being filled or run at the same time
+        INPUT_OUTPUT_ALLOC_STRATEGY strategy;
+    } BatcherOptions;
+
+    static inline BatcherOptions make_batcher_options(float deadline_ms, int max_batch = 0)
+    {
+        return BatcherOptions{max_batch, deadline_ms, 2, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED)};
+    }
+
+    typedef struct BatcherStats
+    {
+        size_t items;
+        size_t failed;
+        size_t batches;
+        size_t full_batches; // closed at max_batch, the others hit the deadline
+        float mean_batch;
+        float npu_ms;
+        float throughput; // items / s, first submit to last result
+        float latency_p50; // submit to result, ms
+        float latency_p90;
+        float latency_p99;
+        float latency_max;
+    } BatcherStats;
+
+    static inline void print_batcher_stats(const BatcherStats& stats)
+    {
+        fprintf(stdout, "batched items %zu, failed %zu, batches %zu (%zu full), mean batch %.2f, npu %.2f ms, throughput %.2f fps\n",
+                stats.items, stats.failed, stats.batches, stats.full_batches, stats.mean_batch, stats.npu_ms, stats.throughput);
+        fprintf(stdout, "latency p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+                stats.latency_p50, stats.latency_p90, stats.latency_p99, stats.latency_max);
+    }
+
+    /*
+     * fill writes the input of one item at the given batch slot of input 0, see get_input_buffer.
+     * scatter reads the result of one item from the batched outputs. Result is delivered
+     * through a callback or a future, with ret the AX_ENGINE_RunSync code (or -1 when fill failed).
+     */
+    template<typename Item, typename Result>
+    class batcher
+    {
+    public:
+        typedef struct Reply
+        {
+            int ret;
+            Result result;
+        } Reply;
+
+        typedef std::function<bool(Item&, uint8_t*, int)> fill_fn;
+        typedef std::function<Result(Item&, AX_ENGINE_IO_INFO_T*, AX_ENGINE_IO_T*, int)> scatter_fn;
+        typedef std::function<void(Item&, Reply&)> callback_fn;
+
+        batcher() = default;
+        batcher(const batcher&) = delete;
+        batcher& operator=(const batcher&) = delete;
+
+        ~batcher()
+        {
+            release();
+        }
+
+        int init(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* info, const BatcherOptions& options, fill_fn fill, scatter_fn scatter)
+        {
+            release();
+            int model_batch = info->nMaxBatchSize > 0 ? (int)info->nMaxBatchSize : 1;
+            if (options.max_batch > model_batch)
+            {
+                fprintf(stderr, "The batch size is too large. %d > %d\n", options.max_batch, model_batch);
+                return -1;
+            }
+            this->handle = handle;
+            this->info = info;
+            this->options = options;
+            this->fill = fill;
+            this->scatter = scatter;
+            max_batch = options.max_batch > 0 ? options.max_batch : model_batch;
+            deadline = std::chrono::microseconds((long long)(options.deadline_ms * 1000.f));
+            sets.resize(std::max(options.io_sets, 1));
+            for (size_t i = 0; i < sets.size(); i++)
+            {
+                sets[i].reset(new Batch());
+                sets[i]->slots.resize(max_batch);
+                auto ret = prepare_io(info, &sets[i]->io, options.strategy);
+                if (0 != ret)
+                {
+                    sets[i].reset();
+                    release();
+                    return ret;
+                }
+                free_sets.push_back(i);
+            }
+            stopping = false;
+            reset_stats();
+            runner = std::thread(&batcher::run_loop, this);
+            return 0;
+        }
+
+        /* runs the batches still open or queued, then frees the io sets */
+        void release()
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            batch_ready.notify_all();
+            if (runner.joinable())
+                runner.join();
+            for (auto& set : sets)
+            {
+                if (set)
+                    free_io(&set->io);
+            }
+            sets.clear();
+            free_sets.clear();
+            closed.clear();
+            open = -1;
+        }
+
+        int batch_size() const
+        {
+            return max_batch;
+        }
+
+        /* fills the item into the open batch on the calling thread, callback runs on the batcher thread */
+        void submit(Item item, callback_fn callback)
+        {
+            // latency includes the wait for a free batch
+            auto now = clock::now();
+            std::unique_lock<std::mutex> guard(lock);
+            slot_free.wait(guard, [this]() { return open >= 0 || !free_sets.empty(); });
+            if (open < 0)
+            {
+                open = free_sets.front();
+                free_sets.pop_front();
+            }
+            int index = open;
+            Batch& batch = *sets[index];
+            int slot = batch.reserved++;
+            if (slot == 0)
+            {
+                batch.opened = clock::now();
+                batch_ready.notify_all();
+            }
+            if (submitted++ == 0)
+                first_submit = now;
+            if (batch.reserved == max_batch)
+                close_open(true);
+            guard.unlock();
+
+            Slot& s = batch.slots[slot];
+            s.submitted = now;
+            s.ok = fill(item, get_input_buffer(info, &batch.io, 0, slot), slot);
+            s.item = std::move(item);
+            s.callback = std::move(callback);
+
+            guard.lock();
+            if (++batch.filled == batch.reserved)
+                batch_ready.notify_all();
+        }
+
+        std::future<Reply> submit(Item item)
+        {
+            auto promise = std::make_shared<std::promise<Reply> >();
+            auto future = promise->get_future();
+            submit(std::move(item), [promise](Item&, Reply& reply) { promise->set_value(std::move(reply)); });
+            return future;
+        }
+
+        /* closes the open batch now instead of at its deadline */
+        void flush()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (open >= 0 && sets[open]->reserved > 0)
+                close_open(false);
+            batch_ready.notify_all();
+        }
+
+        BatcherStats stats()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            BatcherStats s = totals;
+            s.mean_batch = s.batches > 0 ? (float)(s.items + s.failed) / s.batches : 0.f;
+            float wall_ms = (float)elapsed_ms(first_submit, last_done);
+            s.throughput = wall_ms > 0 ? s.items * 1000.f / wall_ms : 0.f;
+            std::vector<double> sorted = latencies;
+            std::sort(sorted.begin(), sorted.end());
+            s.latency_p50 = percentile(sorted, 0.50f);
+            s.latency_p90 = percentile(sorted, 0.90f);
+            s.latency_p99 = percentile(sorted, 0.99f);
+            s.latency_max = sorted.empty() ? 0.f : (float)sorted.back();
+            return s;
+        }
+
+        void reset_stats()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            totals = BatcherStats();
+            submitted = 0;
+            latencies.clear();
+        }
+
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        struct Slot
+        {
+            Item item;
+            callback_fn callback;
+            clock::time_point submitted;
+            bool ok = false;
+        };
+
+        struct Batch
+        {
+            AX_ENGINE_IO_T io;
+            std::vector<Slot> slots;
+            int reserved = 0; // slots handed to producers
+            int filled = 0;   // slots whose fill has returned
+            bool full = false;
+            clock::time_point opened;
+
+            Batch()
+            {
+                memset(&io, 0, sizeof(io));
+            }
+        };
+
+        static double elapsed_ms(clock::time_point t0, clock::time_point t1)
+        {
+            return std::chrono::duration<double, std::milli>(t1 - t0).count();
+        }
+
+        // lock held
+        void close_open(bool full)
+        {
+            sets[open]->full = full;
+            closed.push_back(open);
+            open = -1;
+            if (!free_sets.empty())
+            {
+                open = free_sets.front();
+                free_sets.pop_front();
+            }
+            batch_ready.notify_all();
+            slot_free.notify_all();
+        }
+
+        void run_loop()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            for (;;)
+            {
+                if (!closed.empty() && sets[closed.front()]->filled == sets[closed.front()]->reserved)
+                {
+                    int index = closed.front();
+                    closed.pop_front();
+                    guard.unlock();
+                    run_batch(*sets[index]);
+                    guard.lock();
+                    free_sets.push_back(index);
+                    if (open < 0)
+                    {
+                        open = free_sets.front();
+                        free_sets.pop_front();
+                    }
+                    slot_free.notify_all();
+                    continue;
+                }
+                bool has_open = open >= 0 && sets[open]->reserved > 0;
+                if (has_open && (stopping || clock::now() >= sets[open]->opened + deadline))
+                {
+                    close_open(false);
+                    continue;
+                }
+                if (stopping && closed.empty() && !has_open)
+                    return;
+                if (has_open)
+                    batch_ready.wait_until(guard, sets[open]->opened + deadline);
+                else
+                    batch_ready.wait(guard);
+            }
+        }
+
+        void run_batch(Batch& batch)
+        {
+            int count = batch.reserved;
+            // a model compiled for a fixed batch always runs all of its slots
+            batch.io.nBatchSize = info->bDynamicBatchSize ? count : 0;
+            auto t0 = clock::now();
+            int ret = AX_ENGINE_RunSync(handle, &batch.io);
+            double npu_ms = elapsed_ms(t0, clock::now());
+            if (0 != ret)
+                fprintf(stderr, "batcher run of %d items failed, ret = 0x%x\n", count, ret);
+
+            std::vector<double> done(count);
+            size_t failed = 0;
+            for (int i = 0; i < count; i++)
+            {
+                Slot& slot = batch.slots[i];
+                Reply reply = Reply();
+                reply.ret = slot.ok ? ret : -1;
+                if (0 == reply.ret)
+                    reply.result = scatter(slot.item, info, &batch.io, i);
+                else
+                    failed++;
+                slot.callback(slot.item, reply);
+                done[i] = elapsed_ms(slot.submitted, clock::now());
+                slot = Slot();
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            totals.batches++;
+            totals.full_batches += batch.full ? 1 : 0;
+            totals.items += count - failed;
+            totals.failed += failed;
+            totals.npu_ms += (float)npu_ms;
+            latencies.insert(latencies.end(), done.begin(), done.end());
+            last_done = clock::now();
+            batch.reserved = 0;
+            batch.filled = 0;
+            batch.full = false;
+        }
+
+        AX_ENGINE_HANDLE handle = nullptr;
+        AX_ENGINE_IO_INFO_T* info = nullptr;
+        BatcherOptions options = BatcherOptions();
+        fill_fn fill;
+        scatter_fn scatter;
+        int max_batch = 1;
+        clock::duration deadline;
+
+        std::vector<std::unique_ptr<Batch> > sets;
+        std::deque<int> free_sets;
+        std::deque<int> closed; // full or expired, in run order
+        int open = -1;           // batch taking new items
+        std::thread runner;
+
+        std::mutex lock;
+        std::condition_variable batch_ready;
+        std::condition_variable slot_free;
+        bool stopping = false;
+        size_t submitted = 0;
+        clock::time_point first_submit;
+        clock::time_point last_done;
+        BatcherStats totals = BatcherStats();
+        std::vector<double> latencies;
+    };
+} // namespace middleware
@@ -28,6 +28,9 @@
 #include <ax_sys_api.h>
 #include <ax_engine_api.h>
 
+#include "base/tensor.hpp"
+#include "middleware/cmm_pool.hpp"
+
 #define AX_CMM_ALIGN_SIZE 128
 
 const char* AX_CMM_SESSION_NAME = "ax-samples-cmm";
@@ -61,7 +64,7 @@ namespace middleware
         for (int i = 0; i < (int)index; ++i)
         {
             AX_ENGINE_IO_BUFFER_T* pBuf = io_buf + i;
-            AX_SYS_MemFree(pBuf->phyAddr, pBuf->pVirAddr);
+            default_cmm_pool().free(pBuf->phyAddr, pBuf->pVirAddr);
         }
     }
 
@@ -70,18 +73,19 @@ namespace middleware
         for (size_t j = 0; j < io->nInputSize; ++j)
         {
             AX_ENGINE_IO_BUFFER_T* pBuf = io->pInputs + j;
-            AX_SYS_MemFree(pBuf->phyAddr, pBuf->pVirAddr);
+            default_cmm_pool().free(pBuf->phyAddr, pBuf->pVirAddr);
         }
         for (size_t j = 0; j < io->nOutputSize; ++j)
         {
             AX_ENGINE_IO_BUFFER_T* pBuf = io->pOutputs + j;
-            AX_SYS_MemFree(pBuf->phyAddr, pBuf->pVirAddr);
+            default_cmm_pool().free(pBuf->phyAddr, pBuf->pVirAddr);
         }
         delete[] io->pInputs;
         delete[] io->pOutputs;
     }
 
-    static inline int prepare_io(AX_ENGINE_IO_INFO_T* info, AX_ENGINE_IO_T* io_data, INPUT_OUTPUT_ALLOC_STRATEGY strategy)
+    /* io buffers from default_cmm_pool(), session tags the cmm blocks and the pool statistics */
+    static inline int prepare_io(AX_ENGINE_IO_INFO_T* info, AX_ENGINE_IO_T* io_data, INPUT_OUTPUT_ALLOC_STRATEGY strategy, const char* session = AX_CMM_SESSION_NAME)
     {
         memset(io_data, 0, sizeof(*io_data));
         io_data->pInputs = new AX_ENGINE_IO_BUFFER_T[info->nInputSize];
@@ -93,19 +97,15 @@ namespace middleware
         {
             auto meta = info->pInputs[i];
             auto buffer = &io_data->pInputs[i];
-            if (strategy.first == AX_ENGINE_ABST_CACHED)
-            {
-                ret = AX_SYS_MemAllocCached((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8*)(AX_CMM_SESSION_NAME));
-            }
-            else
-            {
-                ret = AX_SYS_MemAlloc((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8*)(AX_CMM_SESSION_NAME));
-            }
+            ret = default_cmm_pool().alloc((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, strategy.first == AX_ENGINE_ABST_CACHED, session);
 
             if (ret != 0)
             {
                 free_io_index(io_data->pInputs, i);
                 fprintf(stderr, "Allocate input{%d} { phy: %p, vir: %p, size: %lu Bytes }. fail \n", i, (void*)buffer->phyAddr, buffer->pVirAddr, (long)meta.nSize);
+                // nothing left for free_io to release
+                delete[] io_data->pInputs;
+                memset(io_data, 0, sizeof(*io_data));
                 return ret;
             }
             // fprintf(stderr, "Allocate input{%d} { phy: %p, vir: %p, size: %lu Bytes }. \n", i, (void*)buffer->phyAddr, buffer->pVirAddr, (long)meta.nSize);
@@ -119,19 +119,15 @@ namespace middleware
             auto meta = info->pOutputs[i];
             auto buffer = &io_data->pOutputs[i];
             buffer->nSize = meta.nSize;
-            if (strategy.second == AX_ENGINE_ABST_CACHED)
-            {
-                ret = AX_SYS_MemAllocCached((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8*)(AX_CMM_SESSION_NAME));
-            }
-            else
-            {
-                ret = AX_SYS_MemAlloc((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8*)(AX_CMM_SESSION_NAME));
-            }
+            ret = default_cmm_pool().alloc((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, strategy.second == AX_ENGINE_ABST_CACHED, session);
             if (ret != 0)
             {
                 fprintf(stderr, "Allocate output{%d} { phy: %p, vir: %p, size: %lu Bytes }. fail \n", i, (void*)buffer->phyAddr, buffer->pVirAddr, (long)meta.nSize);
                 free_io_index(io_data->pInputs, io_data->nInputSize);
                 free_io_index(io_data->pOutputs, i);
+                delete[] io_data->pInputs;
+                delete[] io_data->pOutputs;
+                memset(io_data, 0, sizeof(*io_data));
                 return ret;
             }
             // fprintf(stderr, "Allocate output{%d} { phy: %p, vir: %p, size: %lu Bytes }.\n", i, (void*)buffer->phyAddr, buffer->pVirAddr, (long)meta.nSize);
@@ -140,7 +136,43 @@ namespace middleware
         return 0;
     }
 
-    static int push_input(const std::vector<uint8_t>& data, AX_ENGINE_IO_T* io_t, AX_ENGINE_IO_INFO_T* info_t)
+    /*
+     * io buffers of models loaded later, reserved in the pool at startup. concurrent models
+     * get sets each at the same time, otherwise only the largest need of any one model is
+     * kept, as when switching between them.
+     */
+    static inline int preallocate_io(const std::vector<AX_ENGINE_IO_INFO_T*>& models, INPUT_OUTPUT_ALLOC_STRATEGY strategy, int sets = 1, bool concurrent = false, const char* session = AX_CMM_SESSION_NAME)
+    {
+        std::map<std::pair<bool, size_t>, int> need;
+        for (auto info : models)
+        {
+            std::map<std::pair<bool, size_t>, int> model;
+            for (int i = 0; i < (int)info->nInputSize; ++i)
+            {
+                model[std::make_pair(strategy.first == AX_ENGINE_ABST_CACHED, cmm_size_class(info->pInputs[i].nSize))] += sets;
+            }
+            for (int i = 0; i < (int)info->nOutputSize; ++i)
+            {
+                model[std::make_pair(strategy.second == AX_ENGINE_ABST_CACHED, cmm_size_class(info->pOutputs[i].nSize))] += sets;
+            }
+            for (const auto& item : model)
+            {
+                need[item.first] = concurrent ? need[item.first] + item.second : std::max(need[item.first], item.second);
+            }
+        }
+        for (const auto& item : need)
+        {
+            auto ret = default_cmm_pool().reserve(item.first.second, item.first.first, item.second, session);
+            if (ret != 0)
+            {
+                fprintf(stderr, "Preallocate %d x %zu Bytes fail \n", item.second, item.first.second);
+                return ret;
+            }
+        }
+        return 0;
+    }
+
+    static inline int push_input(const std::vector<uint8_t>& data, AX_ENGINE_IO_T* io_t, AX_ENGINE_IO_INFO_T* info_t)
     {
         if (info_t->nInputSize != 1)
         {
@@ -159,7 +191,50 @@ namespace middleware
         return 0;
     }
 
-    static void print_io_info(AX_ENGINE_IO_INFO_T* io_info)
+    /* bytes of one image in input index, a dynamic batch input holds nMaxBatchSize images back to back */
+    static inline size_t get_input_batch_stride(AX_ENGINE_IO_INFO_T* info, int index = 0)
+    {
+        size_t max_batch = info->nMaxBatchSize > 0 ? info->nMaxBatchSize : 1;
+        return info->pInputs[index].nSize / max_batch;
+    }
+
+    /* preprocess straight into the cmm input buffer instead of push_input, see common::get_input_data_letterbox */
+    static inline uint8_t* get_input_buffer(AX_ENGINE_IO_INFO_T* info, AX_ENGINE_IO_T* io_data, int index = 0, int batch_index = 0)
+    {
+        return (uint8_t*)io_data->pInputs[index].pVirAddr + batch_index * get_input_batch_stride(info, index);
+    }
+
+    /*
+     * typed view of an output tensor, so quantized outputs can be decoded without a float copy.
+     * the io meta does not carry the quantization, scale / zero_point come from the compile config.
+     * data is null for data types the decoders do not read.
+     */
+    static inline tensor::View get_output_view(AX_ENGINE_IO_INFO_T* info, AX_ENGINE_IO_T* io_data, int index, float scale = 1.f, int32_t zero_point = 0)
+    {
+        const void* data = io_data->pOutputs[index].pVirAddr;
+        switch (info->pOutputs[index].eDataType)
+        {
+        case AX_ENGINE_DT_SINT8:
+            return tensor::make_view((const int8_t*)data, scale, zero_point);
+        case AX_ENGINE_DT_UINT8:
+            return tensor::make_view((const uint8_t*)data, scale, zero_point);
+        case AX_ENGINE_DT_UINT16:
+            return tensor::make_view((const uint16_t*)data, scale, zero_point);
+        case AX_ENGINE_DT_FLOAT32:
+            return tensor::make_view((const float*)data);
+        default:
+            fprintf(stderr, "Unsupported output data type %d of tensor %s.\n", (int)info->pOutputs[index].eDataType, info->pOutputs[index].pName);
+            return tensor::View{nullptr, tensor::DT_FLOAT32, {1.f, 0}};
+        }
+    }
+
+    static inline std::vector<int> get_output_shape(AX_ENGINE_IO_INFO_T* info, int index)
+    {
+        const auto& meta = info->pOutputs[index];
+        return std::vector<int>(meta.pShape, meta.pShape + meta.nShapeSize);
+    }
+
+    static inline void print_io_info(AX_ENGINE_IO_INFO_T* io_info)
     {
         static std::map<AX_ENGINE_DATA_TYPE_T, const char*> data_type = {
             {AX_ENGINE_DT_UNKNOWN, "UNKNOWN"},
@@ -0,0 +1,424 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "middleware/io.hpp"
+#include "middleware/pipeline.hpp"
+
+/*
+ * multi-core npu scheduler for ax650. a model runs either as one instance on the whole
+ * npu (SCHEDULE_FULL, a model compiled for 3 cores) or as one replica per core
+ * (SCHEDULE_REPLICAS, a model compiled for 1 core, AX_ENGINE_CreateHandleV2 with nNpuSet).
+ * every instance has its own request queue and one worker per context; an idle worker
+ * steals from the longest queue of the other instances.
+ */
+namespace middleware
+{
+    enum ScheduleMode
+    {
+        SCHEDULE_FULL = 0,
+        SCHEDULE_REPLICAS = 1,
+    };
+
+    typedef struct SchedulerOptions
+    {
+        int mode;         // ScheduleMode
+        int num_cores;    // replicas, one per core, in SCHEDULE_REPLICAS
+        int contexts;     // workers per instance, each with its own context and io set
+        int queue_depth;  // submit blocks while this many requests are waiting
+        bool steal;       // false makes the core hint of submit strict
+        INPUT_OUTPUT_ALLOC_STRATEGY strategy;
+    } SchedulerOptions;
+
+    static inline SchedulerOptions make_scheduler_options(int mode, int num_cores = 3, int contexts = 1)
+    {
+        return SchedulerOptions{mode, num_cores, contexts, 16, true, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED)};
+    }
+
+    /* the npu mode is process wide: replicas need the virtual npu split, full models need it off */
+    static inline int init_npu(int mode)
+    {
+        AX_ENGINE_NPU_ATTR_T npu_attr;
+        memset(&npu_attr, 0, sizeof(npu_attr));
+        npu_attr.eHardMode = mode == SCHEDULE_REPLICAS ? AX_ENGINE_VIRTUAL_NPU_STD : AX_ENGINE_VIRTUAL_NPU_DISABLE;
+        return AX_ENGINE_Init(&npu_attr);
+    }
+
+    typedef struct InstanceStats
+    {
+        size_t requests;
+        size_t stolen; // requests taken from the queue of another instance
+        float busy_ms; // time in AX_ENGINE_RunSyncV2, summed over the contexts
+        float occupancy;
+    } InstanceStats;
+
+    typedef struct SchedulerStats
+    {
+        size_t requests;
+        size_t failed;
+        float wall_ms; // first submit to last completion
+        float throughput;
+        float latency_p50; // submit to completion, ms
+        float latency_p90;
+        float latency_p99;
+        float latency_max;
+        float queue_p50; // submit to start on a worker, ms
+        std::vector<InstanceStats> instances;
+    } SchedulerStats;
+
+    static inline void print_scheduler_stats(const SchedulerStats& stats)
+    {
+        fprintf(stdout, "requests %zu, failed %zu, wall %.2f ms, throughput %.2f fps\n",
+                stats.requests, stats.failed, stats.wall_ms, stats.throughput);
+        fprintf(stdout, "latency p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms, queued p50 %.2f ms\n",
+                stats.latency_p50, stats.latency_p90, stats.latency_p99, stats.latency_max, stats.queue_p50);
+        for (size_t i = 0; i < stats.instances.size(); i++)
+        {
+            const InstanceStats& s = stats.instances[i];
+            fprintf(stdout, "instance %zu: requests %zu, stolen %zu, npu busy %.2f ms (%.1f%%)\n",
+                    i, s.requests, s.stolen, s.busy_ms, s.occupancy * 100.f);
+        }
+    }
+
+    /*
+     * preprocess fills the inputs of the worker io set, postprocess gets its outputs and the
+     * AX_ENGINE_RunSyncV2 return code. both run on the worker thread of the request.
+     */
+    template<typename Job>
+    class scheduler
+    {
+    public:
+        typedef std::function<bool(Job&, AX_ENGINE_IO_INFO_T*, AX_ENGINE_IO_T*)> pre_fn;
+        typedef std::function<void(Job&, AX_ENGINE_IO_INFO_T*, AX_ENGINE_IO_T*, int)> post_fn;
+
+        scheduler() = default;
+        scheduler(const scheduler&) = delete;
+        scheduler& operator=(const scheduler&) = delete;
+
+        ~scheduler()
+        {
+            release();
+        }
+
+        /* creates the handles, contexts and io sets and starts the workers, init_npu goes first */
+        int init(const void* model, size_t size, const SchedulerOptions& options, pre_fn preprocess, post_fn postprocess)
+        {
+            release();
+            this->options = options;
+            this->preprocess = preprocess;
+            this->postprocess = postprocess;
+            int num_instances = options.mode == SCHEDULE_REPLICAS ? options.num_cores : 1;
+            int contexts = options.contexts > 0 ? options.contexts : 1;
+            instances.resize(num_instances);
+            for (int i = 0; i < num_instances; i++)
+            {
+                Instance& instance = instances[i];
+                int ret;
+                if (options.mode == SCHEDULE_REPLICAS)
+                {
+                    AX_ENGINE_HANDLE_EXTRA_T extra;
+                    memset(&extra, 0, sizeof(extra));
+                    extra.nNpuSet = static_cast<decltype(extra.nNpuSet)>(1 << i);
+                    ret = AX_ENGINE_CreateHandleV2(&instance.handle, model, size, &extra);
+                }
+                else
+                {
+                    ret = AX_ENGINE_CreateHandle(&instance.handle, model, size);
+                }
+                if (0 == ret)
+                    ret = AX_ENGINE_GetIOInfo(instance.handle, &instance.info);
+                if (0 != ret)
+                {
+                    fprintf(stderr, "scheduler create instance %d failed, ret = 0x%x\n", i, ret);
+                    instance.handle = nullptr;
+                    release();
+                    return ret;
+                }
+                for (int c = 0; c < contexts; c++)
+                {
+                    Worker* worker = new Worker();
+                    worker->instance = i;
+                    ret = AX_ENGINE_CreateContextV2(instance.handle, &worker->context);
+                    if (0 == ret)
+                        ret = prepare_io(instance.info, &worker->io, options.strategy);
+                    if (0 != ret)
+                    {
+                        fprintf(stderr, "scheduler create context %d of instance %d failed, ret = 0x%x\n", c, i, ret);
+                        delete worker;
+                        release();
+                        return ret;
+                    }
+                    workers.push_back(worker);
+                }
+            }
+            stopping = false;
+            reset_stats();
+            for (auto worker : workers)
+            {
+                worker->thread = std::thread(&scheduler::worker_loop, this, worker);
+            }
+            return 0;
+        }
+
+        /* stops the workers after the queued requests, frees the io sets and handles */
+        void release()
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            work_ready.notify_all();
+            for (auto worker : workers)
+            {
+                if (worker->thread.joinable())
+                    worker->thread.join();
+                free_io(&worker->io);
+                delete worker;
+            }
+            workers.clear();
+            for (auto& instance : instances)
+            {
+                if (instance.handle)
+                    AX_ENGINE_DestroyHandle(instance.handle);
+            }
+            instances.clear();
+        }
+
+        int num_instances() const
+        {
+            return (int)instances.size();
+        }
+
+        /* core_hint < 0 picks the shortest queue, safe to call from several threads */
+        void submit(Job job, int core_hint = -1)
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            space_ready.wait(guard, [this]() { return waiting < (size_t)std::max(options.queue_depth, 1); });
+            int target = core_hint >= 0 ? core_hint % (int)instances.size() : shortest_queue();
+            Request request;
+            request.job = std::move(job);
+            request.submitted = clock::now();
+            if (submitted == 0)
+                first_submit = request.submitted;
+            instances[target].queue.push_back(std::move(request));
+            waiting++;
+            submitted++;
+            work_ready.notify_all();
+        }
+
+        /* blocks until every submitted request has completed */
+        void wait()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            all_done.wait(guard, [this]() { return completed == submitted; });
+        }
+
+        SchedulerStats stats()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            SchedulerStats s;
+            s.requests = completed - failed;
+            s.failed = failed;
+            s.wall_ms = completed > 0 ? (float)elapsed_ms(first_submit, last_done) : 0.f;
+            s.throughput = s.wall_ms > 0 ? s.requests * 1000.f / s.wall_ms : 0.f;
+            std::vector<double> sorted = latencies;
+            std::sort(sorted.begin(), sorted.end());
+            s.latency_p50 = percentile(sorted, 0.50f);
+            s.latency_p90 = percentile(sorted, 0.90f);
+            s.latency_p99 = percentile(sorted, 0.99f);
+            s.latency_max = sorted.empty() ? 0.f : (float)sorted.back();
+            sorted = queued;
+            std::sort(sorted.begin(), sorted.end());
+            s.queue_p50 = percentile(sorted, 0.50f);
+            for (auto& instance : instances)
+            {
+                InstanceStats is = instance.stats;
+                is.occupancy = s.wall_ms > 0 ? is.busy_ms / s.wall_ms : 0.f;
+                s.instances.push_back(is);
+            }
+            return s;
+        }
+
+        /* call between runs, with nothing in flight */
+        void reset_stats()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            submitted = completed = failed = 0;
+            latencies.clear();
+            queued.clear();
+            for (auto& instance : instances)
+            {
+                instance.stats = InstanceStats();
+            }
+        }
+
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        struct Request
+        {
+            Job job;
+            clock::time_point submitted;
+        };
+
+        struct Instance
+        {
+            AX_ENGINE_HANDLE handle = nullptr;
+            AX_ENGINE_IO_INFO_T* info = nullptr;
+            std::deque<Request> queue;
+            InstanceStats stats = InstanceStats();
+        };
+
+        struct Worker
+        {
+            int instance = 0;
+            AX_ENGINE_CONTEXT_T context = nullptr;
+            AX_ENGINE_IO_T io;
+            std::thread thread;
+
+            Worker()
+            {
+                memset(&io, 0, sizeof(io));
+            }
+        };
+
+        static double elapsed_ms(clock::time_point t0, clock::time_point t1)
+        {
+            return std::chrono::duration<double, std::milli>(t1 - t0).count();
+        }
+
+        int shortest_queue() const
+        {
+            int best = 0;
+            for (int i = 1; i < (int)instances.size(); i++)
+            {
+                if (instances[i].queue.size() < instances[best].queue.size())
+                    best = i;
+            }
+            return best;
+        }
+
+        // own queue from the front, otherwise the newest request of the longest other queue
+        bool take(int own, Request& request, bool& stolen)
+        {
+            auto& queue = instances[own].queue;
+            if (!queue.empty())
+            {
+                request = std::move(queue.front());
+                queue.pop_front();
+                stolen = false;
+                return true;
+            }
+            if (!options.steal)
+                return false;
+            int victim = -1;
+            for (int i = 0; i < (int)instances.size(); i++)
+            {
+                if (i != own && !instances[i].queue.empty() && (victim < 0 || instances[i].queue.size() > instances[victim].queue.size()))
+                    victim = i;
+            }
+            if (victim < 0)
+                return false;
+            request = std::move(instances[victim].queue.back());
+            instances[victim].queue.pop_back();
+            stolen = true;
+            return true;
+        }
+
+        void worker_loop(Worker* worker)
+        {
+            Instance& instance = instances[worker->instance];
+            for (;;)
+            {
+                Request request;
+                bool stolen = false;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    while (!take(worker->instance, request, stolen))
+                    {
+                        if (stopping)
+                            return;
+                        work_ready.wait(guard);
+                    }
+                    waiting--;
+                }
+                space_ready.notify_one();
+
+                auto start = clock::now();
+                int ret = -1;
+                double busy = 0;
+                if (preprocess(request.job, instance.info, &worker->io))
+                {
+                    auto t0 = clock::now();
+                    ret = AX_ENGINE_RunSyncV2(instance.handle, worker->context, &worker->io);
+                    busy = elapsed_ms(t0, clock::now());
+                }
+                postprocess(request.job, instance.info, &worker->io, ret);
+                auto done = clock::now();
+
+                std::lock_guard<std::mutex> guard(lock);
+                InstanceStats& s = instance.stats;
+                s.busy_ms += (float)busy;
+                if (0 == ret)
+                {
+                    s.requests++;
+                    s.stolen += stolen ? 1 : 0;
+                    latencies.push_back(elapsed_ms(request.submitted, done));
+                    queued.push_back(elapsed_ms(request.submitted, start));
+                }
+                else
+                {
+                    failed++;
+                }
+                last_done = done;
+                if (++completed == submitted)
+                    all_done.notify_all();
+            }
+        }
+
+        SchedulerOptions options = SchedulerOptions();
+        pre_fn preprocess;
+        post_fn postprocess;
+        std::vector<Instance> instances;
+        std::vector<Worker*> workers;
+
+        std::mutex lock;
+        std::condition_variable work_ready;
+        std::condition_variable space_ready;
+        std::condition_variable all_done;
+        bool stopping = false;
+        size_t waiting = 0;
+        size_t submitted = 0;
+        size_t completed = 0;
+        size_t failed = 0;
+        clock::time_point first_submit;
+        clock::time_point last_done;
+        std::vector<double> latencies;
+        std::vector<double> queued;
+    };
+} // namespace middleware
@@ -21,61 +21,113 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <algorithm>
 #include <cmath>
 #include <string>
 
+#include "base/letterbox.hpp"
+#include "base/resize.hpp"
+
+/*
+ * get_input_data_no_letterbox, _letterbox and _centercrop resize with cv::resize. fused = true
+ * opts a CV_8UC3 mat into resize::bilinear_letterbox, resize, border and rb swap in one pass
+ * with 8 bit fixed point weights instead of the 11 bit ones of cv::resize: a model input byte
+ * can then differ by 1 from what cv::resize gives, never more. accuracy tools keep the default.
+ */
 namespace common
 {
     // opencv mat(h, w)
     // resize cv::Size(dstw, dsth)
-    void get_input_data_no_letterbox(const cv::Mat& mat, std::vector<uint8_t>& image, int model_h, int model_w, bool bgr2rgb = false)
+    letterbox::LetterboxTransform get_input_data_no_letterbox(const cv::Mat& mat, std::vector<uint8_t>& image, int model_h, int model_w, bool bgr2rgb = false, bool fused = false)
     {
+        if (fused && mat.type() == CV_8UC3)
+        {
+            resize::bilinear_letterbox(mat.data, mat.cols, mat.rows, (int)mat.step[0], image.data(), model_w, model_h, model_w * 3,
+                                       resize::make_layout(model_w, model_h, 0, 0, 0, 0, model_w, model_h), bgr2rgb);
+            return letterbox::make_stretch(mat.rows, mat.cols, model_h, model_w);
+        }
+
         cv::Mat img_new(model_h, model_w, CV_8UC3, image.data());
         cv::resize(mat, img_new, cv::Size(model_w, model_h));
         if (bgr2rgb)
         {
             cv::cvtColor(img_new, img_new, cv::COLOR_BGR2RGB);
         }
+        return letterbox::make_stretch(mat.rows, mat.cols, model_h, model_w);
     }
 
-    void get_input_data_letterbox(cv::Mat mat, std::vector<uint8_t>& image, int letterbox_rows, int letterbox_cols, bool bgr2rgb = false)
+    static inline void swap_rb(uint8_t* pixels, int count)
     {
-        /* letterbox process to support different letterbox size */
-        float scale_letterbox;
-        int resize_rows;
-        int resize_cols;
-        if ((letterbox_rows * 1.0 / mat.rows) < (letterbox_cols * 1.0 / mat.cols))
+        for (int i = 0; i < count; i++, pixels += 3)
         {
-            scale_letterbox = (float)letterbox_rows * 1.0f / (float)mat.rows;
+            std::swap(pixels[0], pixels[2]);
         }
-        else
+    }
+
+    /*
+     * letterbox straight into a preallocated input tensor, e.g. middleware::get_input_buffer:
+     * mat is resized into the roi, only the border strips are cleared and the rb swap is done
+     * in the same pass over the rows. returns the mapping of the model input back to mat, to be
+     * carried with the frame to the post process.
+     */
+    letterbox::LetterboxTransform get_input_data_letterbox(const cv::Mat& mat, uint8_t* dst, int letterbox_rows, int letterbox_cols, bool bgr2rgb = false, bool fused = false)
+    {
+        letterbox::LetterboxTransform transform = letterbox::make(mat.rows, mat.cols, letterbox_rows, letterbox_cols);
+
+        // resize, border and rb swap fused in one pass
+        if (fused && mat.type() == CV_8UC3)
         {
-            scale_letterbox = (float)letterbox_cols * 1.0f / (float)mat.cols;
+            resize::bilinear_letterbox(mat.data, mat.cols, mat.rows, (int)mat.step[0], dst, letterbox_cols, letterbox_rows, letterbox_cols * 3,
+                                       resize::make_layout(transform.resize_w, transform.resize_h, 0, 0, transform.pad_x, transform.pad_y, transform.resize_w, transform.resize_h), bgr2rgb);
+            return transform;
         }
-        resize_cols = int(scale_letterbox * (float)mat.cols);
-        resize_rows = int(scale_letterbox * (float)mat.rows);
-
-        cv::Mat img_new(letterbox_rows, letterbox_cols, CV_8UC3, image.data());
 
-        cv::resize(mat, mat, cv::Size(resize_cols, resize_rows));
+        const size_t row_bytes = (size_t)letterbox_cols * 3;
+        const size_t left_bytes = (size_t)transform.pad_x * 3;
+        const size_t roi_bytes = (size_t)transform.resize_w * 3;
+        const int bottom = transform.pad_y + transform.resize_h;
 
-        int top = (letterbox_rows - resize_rows) / 2;
-        int bot = (letterbox_rows - resize_rows + 1) / 2;
-        int left = (letterbox_cols - resize_cols) / 2;
-        int right = (letterbox_cols - resize_cols + 1) / 2;
+        // resize writes through the roi header, size and type already match
+        cv::Mat img_new(letterbox_rows, letterbox_cols, CV_8UC3, dst);
+        cv::Mat roi = img_new(cv::Rect(transform.pad_x, transform.pad_y, transform.resize_w, transform.resize_h));
+        cv::resize(mat, roi, cv::Size(transform.resize_w, transform.resize_h));
 
         // Letterbox filling
-        cv::copyMakeBorder(mat, img_new, top, bot, left, right, cv::BORDER_CONSTANT, cv::Scalar(0, 0, 0));
-        if (bgr2rgb)
+        memset(dst, 0, transform.pad_y * row_bytes);
+        memset(dst + bottom * row_bytes, 0, (letterbox_rows - bottom) * row_bytes);
+        for (int y = transform.pad_y; y < bottom; y++)
         {
-            cv::cvtColor(img_new, img_new, cv::COLOR_BGR2RGB);
+            uint8_t* row = dst + y * row_bytes;
+            memset(row, 0, left_bytes);
+            memset(row + left_bytes + roi_bytes, 0, row_bytes - left_bytes - roi_bytes);
+            if (bgr2rgb)
+            {
+                swap_rb(row + left_bytes, transform.resize_w);
+            }
+        }
+        return transform;
+    }
+
+    letterbox::LetterboxTransform get_input_data_letterbox(cv::Mat mat, std::vector<uint8_t>& image, int letterbox_rows, int letterbox_cols, bool bgr2rgb = false, bool fused = false)
+    {
+        return get_input_data_letterbox(mat, image.data(), letterbox_rows, letterbox_cols, bgr2rgb, fused);
+    }
+
+    /* dynamic batch input, image i is written at dst + i * batch_stride */
+    std::vector<letterbox::LetterboxTransform> get_input_data_letterbox_batch(const std::vector<cv::Mat>& mats, uint8_t* dst, size_t batch_stride, int letterbox_rows, int letterbox_cols, bool bgr2rgb = false, bool fused = false)
+    {
+        std::vector<letterbox::LetterboxTransform> transforms(mats.size());
+        for (size_t i = 0; i < mats.size(); i++)
+        {
+            transforms[i] = get_input_data_letterbox(mats[i], dst + i * batch_stride, letterbox_rows, letterbox_cols, bgr2rgb, fused);
         }
+        return transforms;
     }
 
-    void get_input_data_centercrop(cv::Mat mat, std::vector<uint8_t>& image, int model_h, int model_w, bool bgr2rgb = false)
+    void get_input_data_centercrop(cv::Mat mat, std::vector<uint8_t>& image, int model_h, int model_w, bool bgr2rgb = false, bool fused = false)
     {
         /* letterbox process to support different letterbox size */
 
@@ -106,6 +158,14 @@ namespace common
         int center_h = int(h0 / 2);
         int center_w = int(w0 / 2);
 
+        /* resize and crop in one pass, the crop is a window of the resized image */
+        if (fused && mat.type() == CV_8UC3)
+        {
+            resize::bilinear_letterbox(mat.data, mat.cols, mat.rows, (int)mat.step[0], image.data(), model_w, model_h, model_w * 3,
+                                       resize::make_layout(w0, h0, center_w - int(model_w / 2), center_h - int(model_h / 2), 0, 0, model_w, model_h), bgr2rgb);
+            return;
+        }
+
         cv::resize(mat, mat, cv::Size(w0, h0));
 
         // cv::imwrite("center.jpg", mat);
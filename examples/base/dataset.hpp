@@ -0,0 +1,238 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/image_io.hpp"
+#include "base/letterbox.hpp"
+#include "utilities/file.hpp"
+#include "utilities/timer.hpp"
+
+/*
+ * dataset reader for batch and accuracy tools: a file list from a directory glob or a
+ * manifest, decoded and preprocessed by worker threads into a bounded prefetch window
+ * while the caller runs the npu on the previous samples.
+ */
+namespace dataset
+{
+    typedef struct Entry
+    {
+        std::string path;   // file to open
+        std::string name;   // as listed, relative to the root
+        std::string label;  // rest of the manifest line, empty for directory scans
+    } Entry;
+
+    static inline std::string join_path(const std::string& root, const std::string& name)
+    {
+        if (!name.empty() && name[0] == '/')
+            return name;
+        if (root.empty() || root.back() == '/')
+            return root + name;
+        return root + "/" + name;
+    }
+
+    /* files in dir matching pattern ("*.jpg", or several joined by ';'), sorted by name */
+    static std::vector<Entry> scan_dir(const std::string& dir, const std::string& pattern)
+    {
+        std::vector<std::string> names;
+        utilities::file_list(dir, pattern, names);
+
+        std::vector<Entry> entries(names.size());
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            entries[i].path = join_path(dir, names[i]);
+            entries[i].name = names[i];
+        }
+        return entries;
+    }
+
+    /*
+     * one sample per line as "file [label ...]", file relative to root unless absolute,
+     * like the imagenet val list. empty lines are skipped.
+     */
+    static bool read_manifest(const std::string& manifest, const std::string& root, std::vector<Entry>& entries)
+    {
+        std::ifstream fs(manifest);
+        if (!fs.is_open())
+        {
+            fprintf(stderr, "[ERR] cannot open manifest %s \n", manifest.c_str());
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(fs, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            std::stringstream ss(line);
+            Entry entry;
+            if (!(ss >> entry.name))
+                continue;
+            std::getline(ss >> std::ws, entry.label);
+            entry.path = join_path(root, entry.name);
+            entries.push_back(entry);
+        }
+        return true;
+    }
+
+    typedef struct Sample
+    {
+        size_t index;                         // position in the entry list
+        Entry entry;
+        image_io::Image image;                // decoded by the load function
+        std::vector<uint8_t> input;           // preprocessed model input
+        letterbox::LetterboxTransform transform;
+        bool ok;                              // false if load failed, the sample is still delivered
+        float load_ms;                        // decode + preprocess on the worker
+    } Sample;
+
+    /*
+     * runs load(sample) for every entry on num_workers threads. at most depth samples are
+     * loaded ahead of the consumer, so memory stays bounded however slow the npu side is.
+     * ordered delivers in entry order, otherwise samples come as soon as they are ready.
+     */
+    class reader
+    {
+    public:
+        typedef std::function<bool(Sample&)> load_fn;
+
+        reader(const std::vector<Entry>& entries, load_fn load, int num_workers = 2, int depth = 8, bool ordered = true)
+            : entries(entries), load(load), depth(depth > 0 ? (size_t)depth : 1), ordered(ordered), delivered_flags(entries.size(), false)
+        {
+            if (num_workers <= 0)
+                num_workers = 1;
+            for (int i = 0; i < num_workers; i++)
+            {
+                workers.emplace_back(&reader::worker_loop, this);
+            }
+        }
+
+        ~reader()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            space_cond.notify_all();
+            for (auto& t : workers)
+            {
+                t.join();
+            }
+        }
+
+        reader(const reader&) = delete;
+        reader& operator=(const reader&) = delete;
+
+        size_t size() const
+        {
+            return entries.size();
+        }
+
+        /* blocks until the next sample is ready, false once every entry was delivered */
+        bool next(Sample& sample)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (delivered == entries.size())
+                return false;
+
+            timer timer_wait;
+            ready_cond.wait(lock, [this] {
+                return ordered ? ready.count(next_delivery) != 0 : !ready.empty();
+            });
+            wait_ms += timer_wait.cost();
+
+            auto it = ordered ? ready.find(next_delivery) : ready.begin();
+            sample = std::move(it->second);
+            ready.erase(it);
+            delivered++;
+            // the window starts at the first sample not delivered yet, unordered mode can leave holes
+            delivered_flags[sample.index] = true;
+            while (next_delivery < entries.size() && delivered_flags[next_delivery])
+                next_delivery++;
+            lock.unlock();
+            space_cond.notify_all();
+            return true;
+        }
+
+        /* time next() spent waiting on the workers, i.e. how much the loading still stalls the caller */
+        float stall_ms() const
+        {
+            return wait_ms;
+        }
+
+    private:
+        void worker_loop()
+        {
+            for (;;)
+            {
+                size_t index;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    space_cond.wait(lock, [this] {
+                        return stop || claimed == entries.size() || claimed < next_delivery + depth;
+                    });
+                    if (stop || claimed == entries.size())
+                        return;
+                    index = claimed++;
+                }
+
+                Sample sample;
+                sample.index = index;
+                sample.entry = entries[index];
+                sample.transform = letterbox::LetterboxTransform();
+                timer timer_load;
+                sample.ok = load(sample);
+                sample.load_ms = timer_load.cost();
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ready.emplace(index, std::move(sample));
+                }
+                ready_cond.notify_one();
+            }
+        }
+
+        std::vector<Entry> entries;
+        load_fn load;
+        size_t depth;
+        bool ordered;
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable ready_cond;
+        std::condition_variable space_cond;
+        std::map<size_t, Sample> ready;
+        std::vector<bool> delivered_flags;
+        size_t claimed = 0;
+        size_t delivered = 0;
+        size_t next_delivery = 0;
+        float wait_ms = 0.f;
+        bool stop = false;
+    };
+} // namespace dataset
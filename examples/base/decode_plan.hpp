@@ -0,0 +1,260 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace decode
+{
+    template<typename T, size_t ALIGN = 64>
+    struct aligned_allocator
+    {
+        typedef T value_type;
+
+        template<typename U>
+        struct rebind
+        {
+            typedef aligned_allocator<U, ALIGN> other;
+        };
+
+        aligned_allocator() = default;
+
+        template<typename U>
+        aligned_allocator(const aligned_allocator<U, ALIGN>&)
+        {
+        }
+
+        T* allocate(size_t n)
+        {
+            void* p = nullptr;
+            if (posix_memalign(&p, ALIGN, n * sizeof(T)) != 0)
+                throw std::bad_alloc();
+            return (T*)p;
+        }
+
+        void deallocate(T* p, size_t)
+        {
+            free(p);
+        }
+
+        template<typename U>
+        bool operator==(const aligned_allocator<U, ALIGN>&) const
+        {
+            return true;
+        }
+
+        template<typename U>
+        bool operator!=(const aligned_allocator<U, ALIGN>&) const
+        {
+            return false;
+        }
+    };
+
+    typedef std::vector<float, aligned_allocator<float> > AlignedVector;
+
+    typedef struct Level
+    {
+        int stride;
+        int grid_w;
+        int grid_h;
+        /* points per cell */
+        int anchors;
+        /* index of the first point of the level */
+        int offset;
+    } Level;
+
+    /*
+     * grid points / anchors of a model in the order its head emits them, so a decoder reads
+     * point i of the plan next to cell i of the output instead of rebuilding the tables per frame.
+     */
+    struct DecodePlan
+    {
+        std::vector<Level> levels;
+        /* per point: anchor center, anchor size and stride, units depend on the builder */
+        AlignedVector cx;
+        AlignedVector cy;
+        AlignedVector width;
+        AlignedVector height;
+        AlignedVector stride;
+
+        int size() const
+        {
+            return (int)cx.size();
+        }
+
+        void reserve(size_t n)
+        {
+            cx.reserve(n);
+            cy.reserve(n);
+            width.reserve(n);
+            height.reserve(n);
+            stride.reserve(n);
+        }
+
+        void push_back(float x, float y, float w, float h, float s)
+        {
+            cx.push_back(x);
+            cy.push_back(y);
+            width.push_back(w);
+            height.push_back(h);
+            stride.push_back(s);
+        }
+
+        void add_level(int level_stride, int grid_w, int grid_h, int anchors)
+        {
+            levels.push_back(Level{level_stride, grid_w, grid_h, anchors, size()});
+            reserve(cx.size() + (size_t)grid_w * grid_h * anchors);
+        }
+    };
+
+    /* cell centers (grid + offset) * stride in input pixels, anchor size = stride. yolov8 / yolox / obb */
+    static void build_grid_plan(DecodePlan& plan, int input_w, int input_h, const std::vector<int>& strides, float offset = 0.5f)
+    {
+        for (auto s : strides)
+        {
+            int grid_w = input_w / s;
+            int grid_h = input_h / s;
+            plan.add_level(s, grid_w, grid_h, 1);
+            for (int g1 = 0; g1 < grid_h; g1++)
+            {
+                for (int g0 = 0; g0 < grid_w; g0++)
+                {
+                    plan.push_back((g0 + offset) * s, (g1 + offset) * s, (float)s, (float)s, (float)s);
+                }
+            }
+        }
+    }
+
+    /* rows x lines points spread evenly in each cell, in input pixels. p2pnet crowd counting */
+    static void build_point_plan(DecodePlan& plan, int input_w, int input_h, const std::vector<int>& strides, int rows, int lines)
+    {
+        for (auto s : strides)
+        {
+            int grid_w = (input_w + s - 1) / s;
+            int grid_h = (input_h + s - 1) / s;
+            float row_step = (float)s / rows;
+            float line_step = (float)s / lines;
+            plan.add_level(s, grid_w, grid_h, rows * lines);
+            for (int g1 = 0; g1 < grid_h; g1++)
+            {
+                for (int g0 = 0; g0 < grid_w; g0++)
+                {
+                    float shift_x = (g0 + 0.5) * s;
+                    float shift_y = (g1 + 0.5) * s;
+                    for (int i = 0; i < rows; i++)
+                    {
+                        float y = (i + 0.5) * row_step - s / 2;
+                        for (int j = 0; j < lines; j++)
+                        {
+                            float x = (j + 0.5) * line_step - s / 2;
+                            plan.push_back(shift_x + x, shift_y + y, line_step, row_step, (float)s);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /* square feature maps with anchor_size[i] anchors per cell, centers normalized to [0, 1]. mediapipe palm */
+    static void build_palm_plan(DecodePlan& plan, int head_count, const int* strides, const int* anchor_size, const float* anchor_offset, const int* feature_map_size)
+    {
+        for (int i = 0; i < head_count; i++)
+        {
+            plan.add_level(strides[i], feature_map_size[i], feature_map_size[i], anchor_size[i]);
+            for (int y = 0; y < feature_map_size[i]; y++)
+            {
+                for (int x = 0; x < feature_map_size[i]; x++)
+                {
+                    const float x_center = (x + anchor_offset[i]) * 1.0f / feature_map_size[i];
+                    const float y_center = (y + anchor_offset[i]) * 1.0f / feature_map_size[i];
+                    for (int k = 0; k < anchor_size[i]; k++)
+                    {
+                        plan.push_back(x_center, y_center, 1.f, 1.f, (float)strides[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+     * ssd prior boxes, centers and sizes normalized by the input size. anchor_info holds
+     * anchor_size[i] (w, h) pairs per head in input pixels.
+     */
+    static void build_ssd_plan(DecodePlan& plan, int head_count, const int* feature_map_size, const int* anchor_size, const float* strides, const float* anchor_info,
+                               float input_size = 300.f)
+    {
+        for (int head = 0; head < head_count; ++head)
+        {
+            plan.add_level((int)strides[head], feature_map_size[head], feature_map_size[head], anchor_size[head]);
+            for (int fea_h = 0; fea_h < feature_map_size[head]; ++fea_h)
+            {
+                for (int fea_w = 0; fea_w < feature_map_size[head]; ++fea_w)
+                {
+                    for (int anchor_i = 0; anchor_i < anchor_size[head]; ++anchor_i)
+                    {
+                        float x = ((float)fea_w + 0.5f) / (input_size / strides[head]);
+                        float y = ((float)fea_h + 0.5f) / (input_size / strides[head]);
+                        plan.push_back(x, y, anchor_info[anchor_i * 2] / input_size, anchor_info[anchor_i * 2 + 1] / input_size, strides[head]);
+                    }
+                }
+            }
+            anchor_info += anchor_size[head] * 2;
+        }
+    }
+
+    typedef std::shared_ptr<const DecodePlan> PlanPtr;
+
+    struct PlanCache
+    {
+        std::mutex mutex;
+        std::map<std::string, PlanPtr> plans;
+    };
+
+    static inline PlanCache& plan_cache()
+    {
+        static PlanCache cache;
+        return cache;
+    }
+
+    static inline std::string make_key(const std::string& model, int input_w, int input_h)
+    {
+        return model + "@" + std::to_string(input_w) + "x" + std::to_string(input_h);
+    }
+
+    /* plan of key (see make_key), built by build(DecodePlan&) on first use and shared afterwards */
+    template<typename Build>
+    static PlanPtr get_plan(const std::string& key, Build&& build)
+    {
+        PlanCache& cache = plan_cache();
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto it = cache.plans.find(key);
+        if (it != cache.plans.end())
+            return it->second;
+
+        auto plan = std::make_shared<DecodePlan>();
+        build(*plan);
+        cache.plans[key] = plan;
+        return plan;
+    }
+} // namespace decode
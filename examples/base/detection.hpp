@@ -26,6 +26,16 @@
 #include <algorithm>
 #include <cmath>
 #include <string>
+
+#include "base/decode_plan.hpp"
+#include "base/letterbox.hpp"
+#include "base/mask.hpp"
+#include "base/math.hpp"
+#include "base/nms.hpp"
+#include "base/simd.hpp"
+#include "base/tensor.hpp"
+#include "base/thread_pool.hpp"
+
 namespace detection
 {
     typedef struct
@@ -43,6 +53,8 @@ namespace detection
         cv::Point2f landmark[5];
         /* for yolov5-seg */
         cv::Mat mask;
+        /* filled instead of mask with mask::FORMAT_PACKED */
+        mask::PackedMask packed_mask;
         std::vector<float> mask_feat;
         std::vector<float> kps_feat;
         /* for yolov8-obb */
@@ -60,114 +72,369 @@ namespace detection
         cv::Mat affine_trans_mat_inv;
     } PalmObject;
 
+    /*
+     * trivially copyable proposal used before NMS, side data (mask coefficients or
+     * keypoints) is kept in ProposalArena and copied out only for NMS survivors.
+     */
+    typedef struct Proposal
+    {
+        float x;
+        float y;
+        float width;
+        float height;
+        float prob;
+        int label;
+        /* row in ProposalArena::feats, -1 without side data */
+        int feat_index;
+    } Proposal;
+
+    /* per-frame proposal storage, reset() keeps the capacity so steady state frames do not allocate */
+    struct ProposalArena
+    {
+        enum FeatKind
+        {
+            FEAT_NONE = 0,
+            FEAT_MASK = 1,
+            FEAT_KPS = 2,
+        };
+
+        std::vector<Proposal> proposals;
+        std::vector<float> feats;
+        FeatKind feat_kind = FEAT_NONE;
+        int feat_dim = 0;
+
+        void reset(FeatKind kind = FEAT_NONE, int dim = 0)
+        {
+            proposals.clear();
+            feats.clear();
+            feat_kind = kind;
+            feat_dim = kind == FEAT_NONE ? 0 : dim;
+        }
+
+        int size() const
+        {
+            return (int)proposals.size();
+        }
+
+        // returns the feat_dim floats reserved for the side data of p
+        float* push_back(const Proposal& p)
+        {
+            proposals.push_back(p);
+            proposals.back().feat_index = feat_dim > 0 ? (int)proposals.size() - 1 : -1;
+            feats.resize(feats.size() + feat_dim);
+            return feats.data() + feats.size() - feat_dim;
+        }
+
+        const float* feat(int i) const
+        {
+            return feats.data() + (size_t)proposals[i].feat_index * feat_dim;
+        }
+    };
+
     static inline float sigmoid(float x)
     {
-        return static_cast<float>(1.f / (1.f + exp(-x)));
+        return math::sigmoid(x);
     }
 
+    /* writes softmax(src) to dst and returns its expectation over the bin indices */
     static float softmax(const float* src, float* dst, int length)
     {
-        const float alpha = *std::max_element(src, src + length);
-        float denominator = 0;
+        math::softmax(src, dst, length);
         float dis_sum = 0;
         for (int i = 0; i < length; ++i)
         {
-            dst[i] = exp(src[i] - alpha);
-            denominator += dst[i];
-        }
-        for (int i = 0; i < length; ++i)
-        {
-            dst[i] /= denominator;
             dis_sum += i * dst[i];
         }
         return dis_sum;
     }
 
+    /* sigmoid(x) > p  <=>  x > log(p / (1 - p)), so cls logits can be compared before any exp */
+    static inline float logit_threshold(float prob_threshold)
+    {
+        if (prob_threshold <= 0.f)
+            return -FLT_MAX;
+        if (prob_threshold >= 1.f)
+            return FLT_MAX;
+        return -std::log(1.f / prob_threshold - 1.f);
+    }
+
+    /* anchor-free head (yolov8/v9/11, yolo-world, obb): per cell cls logits and 4 * reg_max dfl bins */
+    template<typename T = float>
+    struct AnchorFreeHead
+    {
+        const T* cls_ptr;
+        const T* dfl_ptr;
+        int cls_step;
+        int dfl_step;
+        int cls_num;
+        int reg_max;
+        /* yolo-world: logit = cls * cls_scale + cls_bias */
+        float cls_scale;
+        float cls_bias;
+        /* quantized outputs, ignored for float */
+        tensor::QuantParam cls_quant;
+        tensor::QuantParam dfl_quant;
+    };
+
+    template<typename T>
+    static inline AnchorFreeHead<T> make_anchor_free_head(const T* cls_ptr, int cls_step, const T* dfl_ptr, int dfl_step, int cls_num, int reg_max = 16,
+                                                          const tensor::QuantParam& quant = {1.f, 0})
+    {
+        AnchorFreeHead<T> head;
+        head.cls_ptr = cls_ptr;
+        head.dfl_ptr = dfl_ptr;
+        head.cls_step = cls_step;
+        head.dfl_step = dfl_step;
+        head.cls_num = cls_num;
+        head.reg_max = reg_max;
+        head.cls_scale = 1.f;
+        head.cls_bias = 0.f;
+        head.cls_quant = quant;
+        head.dfl_quant = quant;
+        return head;
+    }
+
+    static inline const float* dequantize_bins(const float* src, float*, int, const tensor::QuantParam&)
+    {
+        return src;
+    }
+
     template<typename T>
-    static inline float intersection_area(const T& a, const T& b)
+    static inline const float* dequantize_bins(const T* src, float* dst, int n, const tensor::QuantParam& quant)
     {
-        cv::Rect_<float> inter = a.rect & b.rect;
-        return inter.area();
+        tensor::dequantize(src, dst, n, quant);
+        return dst;
     }
 
+    /*
+     * shared decode path of the anchor-free heads. cells are rejected on raw logits by a
+     * vectorized any-above-threshold scan, argmax / sigmoid / dfl only run on survivors.
+     * quantized heads are scanned in the integer domain and only survivors are dequantized.
+     * on_proposal(cell, class_index, box_prob, ltrb) receives ltrb in units of stride.
+     */
     template<typename T>
-    static void qsort_descent_inplace(std::vector<T>& faceobjects, int left, int right)
+    static inline T scan_threshold(const AnchorFreeHead<T>& head, float prob_threshold, bool& all_pass, bool& none_pass)
+    {
+        float threshold = logit_threshold(prob_threshold);
+        if (head.cls_scale > 0.f)
+        {
+            threshold = (threshold - head.cls_bias) / head.cls_scale;
+            /* keep the scan conservative, the exact check is done on sigmoid */
+            threshold -= 1e-5f * (1.f + std::fabs(threshold));
+        }
+        else
+        {
+            threshold = -FLT_MAX;
+        }
+        return tensor::quantize_threshold<T>(threshold, head.cls_quant, all_pass, none_pass);
+    }
+
+    template<typename T, typename Callback>
+    static void decode_anchor_free_head(const AnchorFreeHead<T>& head, int num_cells, float prob_threshold, Callback&& on_proposal)
     {
-        int i = left;
-        int j = right;
-        float p = faceobjects[(left + right) / 2].prob;
+        bool all_pass, none_pass;
+        T q_threshold = scan_threshold(head, prob_threshold, all_pass, none_pass);
+        if (none_pass)
+            return;
 
-        while (i <= j)
+        /* bins on the stack for the usual reg_max <= 16, so a frame does not allocate */
+        float stack_bins[4 * 16];
+        std::vector<float> heap_bins(head.reg_max > 16 ? 4 * head.reg_max : 0);
+        float* dfl_bins = head.reg_max > 16 ? heap_bins.data() : stack_bins;
+        auto cls_ptr = head.cls_ptr;
+        auto dfl_ptr = head.dfl_ptr;
+        for (int i = 0; i < num_cells; i++, cls_ptr += head.cls_step, dfl_ptr += head.dfl_step)
         {
-            while (faceobjects[i].prob > p)
-                i++;
+            if (!all_pass && !simd::any_greater(cls_ptr, head.cls_num, q_threshold))
+                continue;
 
-            while (faceobjects[j].prob < p)
-                j--;
+            T class_q;
+            int class_index = simd::argmax(cls_ptr, head.cls_num, class_q);
+            float class_score = tensor::dequantize(class_q, head.cls_quant);
 
-            if (i <= j)
+            float box_prob = sigmoid(class_score * head.cls_scale + head.cls_bias);
+            if (box_prob > prob_threshold)
             {
-                // swap
-                std::swap(faceobjects[i], faceobjects[j]);
-
-                i++;
-                j--;
+                const float* dfl = dequantize_bins(dfl_ptr, dfl_bins, 4 * head.reg_max, head.dfl_quant);
+                float pred_ltrb[4];
+                for (int k = 0; k < 4; k++)
+                {
+                    pred_ltrb[k] = math::dfl(dfl + k * head.reg_max, head.reg_max);
+                }
+                on_proposal(i, class_index, box_prob, pred_ltrb);
             }
         }
-#pragma omp parallel sections
+    }
+
+    /* tensor layouts of the anchor-free heads */
+    enum HeadLayout
+    {
+        /* one tensor, per cell 4 * reg_max dfl bins followed by cls_num logits (yolov8/11 native) */
+        LAYOUT_DFL_CLS = 0,
+        /* cls logits and dfl bins in separate tensors (yolo-world, split heads) */
+        LAYOUT_SPLIT = 1,
+    };
+
+    /*
+     * decode_anchor_free_head with class count, reg_max and layout fixed at compile time, the
+     * scan / argmax / dfl loops get constant trip counts and the bins live on the stack.
+     * head.cls_num, reg_max, cls_step and dfl_step are not read.
+     */
+    template<int CLS_NUM, int REG_MAX, int LAYOUT, typename T, typename Callback>
+    static void decode_anchor_free_head(const AnchorFreeHead<T>& head, int num_cells, float prob_threshold, Callback&& on_proposal)
+    {
+        const int cls_step = LAYOUT == LAYOUT_DFL_CLS ? CLS_NUM + 4 * REG_MAX : CLS_NUM;
+        const int dfl_step = LAYOUT == LAYOUT_DFL_CLS ? CLS_NUM + 4 * REG_MAX : 4 * REG_MAX;
+
+        bool all_pass, none_pass;
+        T q_threshold = scan_threshold(head, prob_threshold, all_pass, none_pass);
+        if (none_pass)
+            return;
+
+        float dfl_bins[4 * REG_MAX];
+        auto cls_ptr = head.cls_ptr;
+        auto dfl_ptr = head.dfl_ptr;
+        for (int i = 0; i < num_cells; i++, cls_ptr += cls_step, dfl_ptr += dfl_step)
         {
-#pragma omp section
-            {
-                if (left < j) qsort_descent_inplace(faceobjects, left, j);
-            }
-#pragma omp section
+            if (!all_pass && !simd::any_greater(cls_ptr, CLS_NUM, q_threshold))
+                continue;
+
+            T class_q;
+            int class_index = simd::argmax(cls_ptr, CLS_NUM, class_q);
+            float class_score = tensor::dequantize(class_q, head.cls_quant);
+
+            float box_prob = sigmoid(class_score * head.cls_scale + head.cls_bias);
+            if (box_prob > prob_threshold)
             {
-                if (i < right) qsort_descent_inplace(faceobjects, i, right);
+                const float* dfl = dequantize_bins(dfl_ptr, dfl_bins, 4 * REG_MAX, head.dfl_quant);
+                float pred_ltrb[4];
+                for (int k = 0; k < 4; k++)
+                {
+                    pred_ltrb[k] = math::dfl(dfl + k * REG_MAX, REG_MAX);
+                }
+                on_proposal(i, class_index, box_prob, pred_ltrb);
             }
         }
     }
 
+    /* ltrb distances around the cell center, clamped to the letterbox */
+    static inline cv::Rect_<float> ltrb_to_rect(const float* pred_ltrb, int w, int h, int stride, int letterbox_cols, int letterbox_rows)
+    {
+        float pb_cx = (w + 0.5f) * stride;
+        float pb_cy = (h + 0.5f) * stride;
+
+        float x0 = pb_cx - pred_ltrb[0] * stride;
+        float y0 = pb_cy - pred_ltrb[1] * stride;
+        float x1 = pb_cx + pred_ltrb[2] * stride;
+        float y1 = pb_cy + pred_ltrb[3] * stride;
+
+        x0 = std::max(std::min(x0, (float)(letterbox_cols - 1)), 0.f);
+        y0 = std::max(std::min(y0, (float)(letterbox_rows - 1)), 0.f);
+        x1 = std::max(std::min(x1, (float)(letterbox_cols - 1)), 0.f);
+        y1 = std::max(std::min(y1, (float)(letterbox_rows - 1)), 0.f);
+
+        return cv::Rect_<float>(x0, y0, x1 - x0, y1 - y0);
+    }
+
+    /* indices of the top_k best proposals (all of them when top_k < 0), best first, see nms::top_k_order */
     template<typename T>
-    static void qsort_descent_inplace(std::vector<T>& faceobjects)
+    static void select_top_k(const std::vector<T>& proposals, std::vector<int>& order, int top_k = -1)
     {
-        if (faceobjects.empty())
-            return;
+        nms::top_k_order(proposals, [](const T& proposal) { return proposal.prob; }, order, top_k);
+    }
+
+    /* sorts proposals by score descending and keeps the best top_k, each survivor is moved once */
+    template<typename T>
+    static void sort_top_k(std::vector<T>& proposals, int top_k = -1)
+    {
+        nms::sort_top_k(proposals, [](const T& proposal) { return proposal.prob; }, top_k);
+    }
+
+    template<typename T>
+    static inline int nms_label(const T&)
+    {
+        return 0;
+    }
+
+    static inline int nms_label(const Object& obj)
+    {
+        return obj.label;
+    }
+
+    template<typename T>
+    static inline void nms_push(nms::Boxes& boxes, const T& obj)
+    {
+        boxes.push_back(obj.rect.x, obj.rect.y, obj.rect.x + obj.rect.width, obj.rect.y + obj.rect.height, obj.rect.area(), nms_label(obj));
+    }
 
-        qsort_descent_inplace(faceobjects, 0, faceobjects.size() - 1);
+    static inline void nms_push(nms::Boxes& boxes, const Proposal& p)
+    {
+        boxes.push_back(p.x, p.y, p.x + p.width, p.y + p.height, p.width * p.height, p.label);
     }
 
     template<typename T>
-    static void nms_sorted_bboxes(const std::vector<T>& faceobjects, std::vector<int>& picked, float nms_threshold)
+    static void nms_sorted_bboxes(const std::vector<T>& faceobjects, std::vector<int>& picked, float nms_threshold, bool class_aware = false, int top_k = -1)
     {
-        picked.clear();
+        nms::Boxes boxes;
+        boxes.reserve(faceobjects.size());
+        for (const auto& obj : faceobjects)
+        {
+            nms_push(boxes, obj);
+        }
 
-        const int n = faceobjects.size();
+        nms::nms_sorted(boxes, picked, nms_threshold, class_aware, top_k);
+    }
+
+    /*
+     * nms over the top_k best proposals without reordering them,
+     * picked holds indices into proposals, best first.
+     */
+    template<typename T>
+    static void nms_top_k(const std::vector<T>& proposals, std::vector<int>& picked, float nms_threshold, int top_k = -1, bool class_aware = false)
+    {
+        std::vector<int> order;
+        select_top_k(proposals, order, top_k);
 
-        std::vector<float> areas(n);
-        for (int i = 0; i < n; i++)
+        nms::Boxes boxes;
+        boxes.reserve(order.size());
+        for (int i : order)
         {
-            areas[i] = faceobjects[i].rect.area();
+            nms_push(boxes, proposals[i]);
         }
 
-        for (int i = 0; i < n; i++)
+        std::vector<int> kept;
+        nms::nms_sorted(boxes, kept, nms_threshold, class_aware);
+
+        picked.resize(kept.size());
+        for (size_t k = 0; k < kept.size(); k++)
         {
-            const T& a = faceobjects[i];
+            picked[k] = order[kept[k]];
+        }
+    }
 
-            int keep = 1;
-            for (int j = 0; j < (int)picked.size(); j++)
+    /* copies the NMS survivors out of the arena into the public result type */
+    static void promote_proposals(const ProposalArena& arena, const std::vector<int>& picked, std::vector<Object>& objects)
+    {
+        objects.resize(picked.size());
+        for (size_t k = 0; k < picked.size(); k++)
+        {
+            const Proposal& p = arena.proposals[picked[k]];
+            Object& obj = objects[k];
+            obj.rect = cv::Rect_<float>(p.x, p.y, p.width, p.height);
+            obj.label = p.label;
+            obj.prob = p.prob;
+            obj.mask.release();
+            obj.packed_mask = mask::PackedMask();
+            obj.mask_feat.clear();
+            obj.kps_feat.clear();
+            if (p.feat_index >= 0)
             {
-                const T& b = faceobjects[picked[j]];
-
-                // intersection over union
-                float inter_area = intersection_area(a, b);
-                float union_area = areas[i] + areas[picked[j]] - inter_area;
-                // float IoU = inter_area / union_area
-                if (inter_area / union_area > nms_threshold)
-                    keep = 0;
+                const float* feat = arena.feat(picked[k]);
+                if (arena.feat_kind == ProposalArena::FEAT_MASK)
+                    obj.mask_feat.assign(feat, feat + arena.feat_dim);
+                else if (arena.feat_kind == ProposalArena::FEAT_KPS)
+                    obj.kps_feat.assign(feat, feat + arena.feat_dim);
             }
-
-            if (keep)
-                picked.push_back(i);
         }
     }
 
@@ -283,6 +550,7 @@ namespace detection
         auto ptr_score = score;
         auto ptr_boxes = boxes;
         auto ptr_anchor_info = anchor_info;
+        std::vector<float> class_prob(cls_num + 1);
         for (int head = 0; head < head_count; ++head)
         {
             for (int fea_h = 0; fea_h < feature_map_size[head]; ++fea_h)
@@ -291,16 +559,12 @@ namespace detection
                 {
                     for (int anchor_i = 0; anchor_i < anchor_size[head]; ++anchor_i)
                     {
-                        float softmax_sum = 0;
                         float class_score = -FLT_MAX;
                         int class_index = 0;
-                        for (int s = 0; s < cls_num + 1; s++)
-                        {
-                            softmax_sum += std::exp(ptr_score[s]);
-                        }
+                        math::softmax(ptr_score, class_prob.data(), cls_num + 1);
                         for (int i = 0; i < cls_num + 1; ++i)
                         {
-                            float temp = std::exp(ptr_score[i]) / softmax_sum;
+                            float temp = class_prob[i];
                             //                            if (temp > class_score)
                             //                            {
                             //                                class_index = i;
@@ -316,8 +580,8 @@ namespace detection
 
                                 float pred_x = (((float)fea_w + 0.5f) / (300.0f / strides[head]) + ptr_boxes[0] * center_val * ptr_anchor_info[anchor_i * 2] / 300.0f);
                                 float pred_y = (((float)fea_h + 0.5f) / (300.0f / strides[head]) + ptr_boxes[1] * center_val * ptr_anchor_info[anchor_i * 2 + 1] / 300.0f);
-                                float pred_w = std::exp(ptr_boxes[2] * scale_val) * ptr_anchor_info[anchor_i * 2] / 300.0f;
-                                float pred_h = std::exp(ptr_boxes[3] * scale_val) * ptr_anchor_info[anchor_i * 2 + 1] / 300.0f;
+                                float pred_w = math::exp(ptr_boxes[2] * scale_val) * ptr_anchor_info[anchor_i * 2] / 300.0f;
+                                float pred_h = math::exp(ptr_boxes[3] * scale_val) * ptr_anchor_info[anchor_i * 2 + 1] / 300.0f;
 
                                 float x0 = (pred_x - pred_w * 0.5f) * 300.0f;
                                 float y0 = (pred_y - pred_h * 0.5f) * 300.0f;
@@ -345,6 +609,43 @@ namespace detection
         }
     }
 
+    /* generate_proposals_mobilenet_ssd with the prior boxes of decode::build_ssd_plan (input_size 300) */
+    static void generate_proposals_mobilenet_ssd(const float* score, const float* boxes, const decode::DecodePlan& plan, const int cls_num,
+                                                 float prob_threshold, const float center_val, const float scale_val, std::vector<detection::Object>& objects)
+    {
+        const int num_anchors = plan.size();
+        std::vector<float> class_prob(cls_num + 1);
+        for (int a = 0; a < num_anchors; a++, score += cls_num + 1, boxes += 4)
+        {
+            math::softmax(score, class_prob.data(), cls_num + 1);
+            for (int i = 1; i < cls_num + 1; ++i)
+            {
+                if (class_prob[i] < prob_threshold)
+                    continue;
+
+                float pred_x = plan.cx[a] + boxes[0] * center_val * plan.width[a];
+                float pred_y = plan.cy[a] + boxes[1] * center_val * plan.height[a];
+                float pred_w = math::exp(boxes[2] * scale_val) * plan.width[a];
+                float pred_h = math::exp(boxes[3] * scale_val) * plan.height[a];
+
+                float x0 = (pred_x - pred_w * 0.5f) * 300.0f;
+                float y0 = (pred_y - pred_h * 0.5f) * 300.0f;
+                float x1 = (pred_x + pred_w * 0.5f) * 300.0f;
+                float y1 = (pred_y + pred_h * 0.5f) * 300.0f;
+
+                Object obj;
+                obj.rect.x = x0;
+                obj.rect.y = y0;
+                obj.rect.width = x1 - x0;
+                obj.rect.height = y1 - y0;
+                obj.label = i;
+                obj.prob = class_prob[i];
+
+                objects.push_back(obj);
+            }
+        }
+    }
+
     static void generate_proposals_yolox(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
                                          int letterbox_cols, int letterbox_rows, int cls_num = 80)
     {
@@ -644,7 +945,8 @@ namespace detection
     }
 
     static void generate_proposals_yolov5(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
-                                          int letterbox_cols, int letterbox_rows, const float* anchors, float prob_threshold_unsigmoid, int cls_num = 80)
+                                          int letterbox_cols, int letterbox_rows, const float* anchors, float prob_threshold_unsigmoid, int cls_num = 80,
+                                          int row_begin = 0, int row_end = -1)
     {
         int anchor_num = 3;
         int feat_w = letterbox_cols / stride;
@@ -656,10 +958,12 @@ namespace detection
             anchor_group = 2;
         if (stride == 32)
             anchor_group = 3;
+        if (row_end < 0 || row_end > feat_h)
+            row_end = feat_h;
 
-        auto feature_ptr = feat;
+        auto feature_ptr = feat + (size_t)row_begin * feat_w * anchor_num * (cls_num + 5);
 
-        for (int h = 0; h <= feat_h - 1; h++)
+        for (int h = row_begin; h <= row_end - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
             {
@@ -720,6 +1024,59 @@ namespace detection
         }
     }
 
+    /*
+     * splits the feature maps of a multi-stride head into row bands and decodes them on the pool.
+     * decode(level, row_begin, row_end, band_objects) fills one buffer per band, buffers are
+     * appended in stride / row order so the proposals come out in the same order as the serial loop.
+     */
+    template<typename Decode>
+    static void generate_proposals_parallel(parallel::thread_pool& pool, const std::vector<int>& strides, int letterbox_cols, int letterbox_rows,
+                                            std::vector<Object>& objects, Decode&& decode)
+    {
+        struct Band
+        {
+            int level;
+            int row_begin;
+            int row_end;
+        };
+
+        int total_cells = 0;
+        for (auto stride : strides)
+        {
+            total_cells += (letterbox_cols / stride) * (letterbox_rows / stride);
+        }
+        // a few bands per worker keep the load balanced when one stride has most cells
+        int band_cells = std::max(1, total_cells / (pool.size() * 4));
+
+        std::vector<Band> bands;
+        for (int level = 0; level < (int)strides.size(); level++)
+        {
+            int feat_w = std::max(1, letterbox_cols / strides[level]);
+            int feat_h = letterbox_rows / strides[level];
+            int band_rows = pool.size() == 1 ? feat_h : std::max(1, band_cells / feat_w);
+            for (int row = 0; row < feat_h; row += band_rows)
+            {
+                bands.push_back({level, row, std::min(row + band_rows, feat_h)});
+            }
+        }
+
+        std::vector<std::vector<Object> > band_objects(bands.size());
+        pool.parallel_for((int)bands.size(), [&](int t, int) {
+            decode(bands[t].level, bands[t].row_begin, bands[t].row_end, band_objects[t]);
+        });
+
+        size_t count = objects.size();
+        for (auto& band : band_objects)
+        {
+            count += band.size();
+        }
+        objects.reserve(count);
+        for (auto& band : band_objects)
+        {
+            objects.insert(objects.end(), band.begin(), band.end());
+        }
+    }
+
     static void generate_proposals_yolov5_seg(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
                                               int letterbox_cols, int letterbox_rows, const float* anchors, float prob_threshold_unsigmoid, int cls_num = 80, int mask_proto_dim = 32)
     {
@@ -1139,7 +1496,6 @@ namespace detection
         auto cls_ptr = cls_feat;
         auto cls_idx_ptr = cls_idx;
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
         for (int h = 0; h <= feat_h - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
@@ -1155,7 +1511,7 @@ namespace detection
                     float pred_ltrb[4];
                     for (int k = 0; k < 4; k++)
                     {
-                        float dis = softmax(dfl_ptr + k * reg_max, dis_after_sm.data(), reg_max);
+                        float dis = math::dfl(dfl_ptr + k * reg_max, reg_max);
                         pred_ltrb[k] = dis * stride;
                     }
 
@@ -1198,7 +1554,6 @@ namespace detection
         auto cls_ptr = cls_feat;
         auto cls_idx_ptr = cls_idx;
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
         for (int h = 0; h <= feat_h - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
@@ -1213,7 +1568,7 @@ namespace detection
                     float pred_ltrb[4];
                     for (int k = 0; k < 4; k++)
                     {
-                        float dis = softmax(dfl_ptr + k * reg_max, dis_after_sm.data(), reg_max);
+                        float dis = math::dfl(dfl_ptr + k * reg_max, reg_max);
                         pred_ltrb[k] = dis * stride;
                     }
 
@@ -1257,7 +1612,6 @@ namespace detection
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
         for (int h = 0; h <= feat_h - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
@@ -1273,7 +1627,7 @@ namespace detection
                     float pred_ltrb[4];
                     for (int k = 0; k < 4; k++)
                     {
-                        float dis = softmax(bboxes + k * reg_max, dis_after_sm.data(), reg_max);
+                        float dis = math::dfl(bboxes + k * reg_max, reg_max);
                         pred_ltrb[k] = dis * stride;
                     }
 
@@ -1321,347 +1675,288 @@ namespace detection
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
 
-        auto feat_ptr = feat;
-
-        std::vector<float> dis_after_sm(reg_max, 0.f);
-        for (int h = 0; h <= feat_h - 1; h++)
-        {
-            for (int w = 0; w <= feat_w - 1; w++)
-            {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
-                {
-                    float score = feat_ptr[s + 4 * reg_max];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
-
-                float box_prob = sigmoid(class_score);
-                if (box_prob > prob_threshold)
-                {
-                    float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
-
-                    float pb_cx = (w + 0.5f) * stride;
-                    float pb_cy = (h + 0.5f) * stride;
-
-                    float x0 = pb_cx - pred_ltrb[0];
-                    float y0 = pb_cy - pred_ltrb[1];
-                    float x1 = pb_cx + pred_ltrb[2];
-                    float y1 = pb_cy + pred_ltrb[3];
-
-                    x0 = std::max(std::min(x0, (float)(letterbox_cols - 1)), 0.f);
-                    y0 = std::max(std::min(y0, (float)(letterbox_rows - 1)), 0.f);
-                    x1 = std::max(std::min(x1, (float)(letterbox_cols - 1)), 0.f);
-                    y1 = std::max(std::min(y1, (float)(letterbox_rows - 1)), 0.f);
-
-                    Object obj;
-                    obj.rect.x = x0;
-                    obj.rect.y = y0;
-                    obj.rect.width = x1 - x0;
-                    obj.rect.height = y1 - y0;
-                    obj.label = class_index;
-                    obj.prob = box_prob;
-
-                    objects.push_back(obj);
-                }
+        auto head = make_anchor_free_head(feat + 4 * reg_max, cls_num + 4 * reg_max, feat, cls_num + 4 * reg_max, cls_num, reg_max);
+        decode_anchor_free_head(head, feat_w * feat_h, prob_threshold, [&](int cell, int class_index, float box_prob, const float* pred_ltrb) {
+            Object obj;
+            obj.rect = ltrb_to_rect(pred_ltrb, cell % feat_w, cell / feat_w, stride, letterbox_cols, letterbox_rows);
+            obj.label = class_index;
+            obj.prob = box_prob;
 
-                feat_ptr += (cls_num + 4 * reg_max);
-            }
-        }
+            objects.push_back(obj);
+        });
     }
     
-    static void generate_proposals_yolov8_native(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
-                                                 int letterbox_cols, int letterbox_rows, int cls_num = 80)
+    /* rows [row_begin, row_end) of the feature map only, for row band parallel decoding */
+    static void generate_proposals_yolov8_native(int stride, const tensor::View& feat, float prob_threshold, std::vector<Object>& objects,
+                                                 int letterbox_cols, int letterbox_rows, int cls_num = 80, int row_begin = 0, int row_end = -1)
     {
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
+        if (row_end < 0 || row_end > feat_h)
+            row_end = feat_h;
+        if (row_begin >= row_end)
+            return;
 
-        auto feat_ptr = feat;
+        int cell_begin = row_begin * feat_w;
+        int cell_step = cls_num + 4 * reg_max;
+        tensor::visit(feat, [&](auto feat_ptr) {
+            auto band_ptr = feat_ptr + (size_t)cell_begin * cell_step;
+            auto head = make_anchor_free_head(band_ptr + 4 * reg_max, cell_step, band_ptr, cell_step, cls_num, reg_max, feat.quant);
+            decode_anchor_free_head(head, (row_end - row_begin) * feat_w, prob_threshold, [&](int cell, int class_index, float box_prob, const float* pred_ltrb) {
+                cell += cell_begin;
+
+                Object obj;
+                obj.rect = ltrb_to_rect(pred_ltrb, cell % feat_w, cell / feat_w, stride, letterbox_cols, letterbox_rows);
+                obj.label = class_index;
+                obj.prob = box_prob;
+
+                objects.push_back(obj);
+            });
+        });
+    }
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
-        for (int h = 0; h <= feat_h - 1; h++)
-        {
-            for (int w = 0; w <= feat_w - 1; w++)
-            {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
-                {
-                    float score = feat_ptr[s + 4 * reg_max];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
+    static void generate_proposals_yolov8_native(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
+                                                 int letterbox_cols, int letterbox_rows, int cls_num = 80, int row_begin = 0, int row_end = -1)
+    {
+        generate_proposals_yolov8_native(stride, tensor::make_view(feat), prob_threshold, objects, letterbox_cols, letterbox_rows, cls_num, row_begin, row_end);
+    }
 
-                float box_prob = sigmoid(class_score);
-                if (box_prob > prob_threshold)
-                {
-                    float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
+    /* generate_proposals_yolov8_native with the class count as template argument, e.g. generate_proposals_yolov8_native<80>(...) */
+    template<int CLS_NUM, int REG_MAX = 16>
+    static void generate_proposals_yolov8_native(int stride, const tensor::View& feat, float prob_threshold, std::vector<Object>& objects,
+                                                 int letterbox_cols, int letterbox_rows, int row_begin = 0, int row_end = -1)
+    {
+        int feat_w = letterbox_cols / stride;
+        int feat_h = letterbox_rows / stride;
+        if (row_end < 0 || row_end > feat_h)
+            row_end = feat_h;
+        if (row_begin >= row_end)
+            return;
 
-                    float pb_cx = (w + 0.5f) * stride;
-                    float pb_cy = (h + 0.5f) * stride;
+        int cell_begin = row_begin * feat_w;
+        const int cell_step = CLS_NUM + 4 * REG_MAX;
+        tensor::visit(feat, [&](auto feat_ptr) {
+            auto band_ptr = feat_ptr + (size_t)cell_begin * cell_step;
+            auto head = make_anchor_free_head(band_ptr + 4 * REG_MAX, cell_step, band_ptr, cell_step, CLS_NUM, REG_MAX, feat.quant);
+            decode_anchor_free_head<CLS_NUM, REG_MAX, LAYOUT_DFL_CLS>(head, (row_end - row_begin) * feat_w, prob_threshold, [&](int cell, int class_index, float box_prob, const float* pred_ltrb) {
+                cell += cell_begin;
+
+                Object obj;
+                obj.rect = ltrb_to_rect(pred_ltrb, cell % feat_w, cell / feat_w, stride, letterbox_cols, letterbox_rows);
+                obj.label = class_index;
+                obj.prob = box_prob;
+
+                objects.push_back(obj);
+            });
+        });
+    }
 
-                    float x0 = pb_cx - pred_ltrb[0];
-                    float y0 = pb_cy - pred_ltrb[1];
-                    float x1 = pb_cx + pred_ltrb[2];
-                    float y1 = pb_cy + pred_ltrb[3];
+    /*
+     * yolov8 native decoder for an output of shape [1, h, w, 4 * 16 + cls_num]. class counts with
+     * an instantiation in make_yolov8_native_decoder get the fixed decoder, others the runtime one.
+     */
+    struct Yolov8NativeDecoder
+    {
+        typedef void (*Function)(int, const tensor::View&, float, std::vector<Object>&, int, int, int, int);
 
-                    x0 = std::max(std::min(x0, (float)(letterbox_cols - 1)), 0.f);
-                    y0 = std::max(std::min(y0, (float)(letterbox_rows - 1)), 0.f);
-                    x1 = std::max(std::min(x1, (float)(letterbox_cols - 1)), 0.f);
-                    y1 = std::max(std::min(y1, (float)(letterbox_rows - 1)), 0.f);
+        int cls_num;
+        Function function;
 
-                    Object obj;
-                    obj.rect.x = x0;
-                    obj.rect.y = y0;
-                    obj.rect.width = x1 - x0;
-                    obj.rect.height = y1 - y0;
-                    obj.label = class_index;
-                    obj.prob = box_prob;
+        void operator()(int stride, const tensor::View& feat, float prob_threshold, std::vector<Object>& objects,
+                        int letterbox_cols, int letterbox_rows, int row_begin = 0, int row_end = -1) const
+        {
+            if (function)
+                function(stride, feat, prob_threshold, objects, letterbox_cols, letterbox_rows, row_begin, row_end);
+            else
+                generate_proposals_yolov8_native(stride, feat, prob_threshold, objects, letterbox_cols, letterbox_rows, cls_num, row_begin, row_end);
+        }
+    };
 
-                    objects.push_back(obj);
-                }
+    static inline Yolov8NativeDecoder make_yolov8_native_decoder(const std::vector<int>& shape)
+    {
+        static const struct
+        {
+            int cls_num;
+            Yolov8NativeDecoder::Function function;
+        } table[] = {
+            {80, &generate_proposals_yolov8_native<80>},
+            {4, &generate_proposals_yolov8_native<4>},
+            {1, &generate_proposals_yolov8_native<1>},
+        };
 
-                feat_ptr += (cls_num + 4 * reg_max);
-            }
+        Yolov8NativeDecoder decoder;
+        decoder.cls_num = shape.empty() ? 0 : shape.back() - 4 * 16;
+        decoder.function = nullptr;
+        for (const auto& entry : table)
+        {
+            if (entry.cls_num == decoder.cls_num)
+                decoder.function = entry.function;
         }
+        return decoder;
+    }
+
+    static void generate_proposals_yolov8_seg_native(int stride, const tensor::View& feat, const tensor::View& feat_seg, float prob_threshold, std::vector<Object>& objects,
+                                                     int letterbox_cols, int letterbox_rows, int cls_num = 80, int mask_proto_dim = 32)
+    {
+        int feat_w = letterbox_cols / stride;
+        int feat_h = letterbox_rows / stride;
+        int reg_max = 16;
+
+        tensor::visit(feat, [&](auto feat_ptr) {
+            auto head = make_anchor_free_head(feat_ptr + 4 * reg_max, cls_num + 4 * reg_max, feat_ptr, cls_num + 4 * reg_max, cls_num, reg_max, feat.quant);
+            decode_anchor_free_head(head, feat_w * feat_h, prob_threshold, [&](int cell, int class_index, float box_prob, const float* pred_ltrb) {
+                Object obj;
+                obj.rect = ltrb_to_rect(pred_ltrb, cell % feat_w, cell / feat_w, stride, letterbox_cols, letterbox_rows);
+                obj.label = class_index;
+                obj.prob = box_prob;
+                obj.mask_feat.resize(mask_proto_dim);
+                tensor::dequantize(tensor::offset(feat_seg, (size_t)cell * mask_proto_dim), obj.mask_feat.data(), mask_proto_dim);
+
+                objects.push_back(obj);
+            });
+        });
     }
 
     static void generate_proposals_yolov8_seg_native(int stride, const float* feat, const float* feat_seg, float prob_threshold, std::vector<Object>& objects,
                                                      int letterbox_cols, int letterbox_rows, int cls_num = 80, int mask_proto_dim = 32)
+    {
+        generate_proposals_yolov8_seg_native(stride, tensor::make_view(feat), tensor::make_view(feat_seg), prob_threshold, objects, letterbox_cols, letterbox_rows, cls_num, mask_proto_dim);
+    }
+
+    static void generate_proposals_yolov8_pose_native(int stride, const tensor::View& feat, const tensor::View& feat_kps, float prob_threshold, std::vector<Object>& objects,
+                                                      int letterbox_cols, int letterbox_rows, const int num_point = 17, int cls_num = 1)
     {
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
 
-        auto feat_ptr = feat;
-        auto feat_seg_ptr = feat_seg;
+        std::vector<float> kps(3 * num_point);
+        tensor::visit(feat, [&](auto feat_ptr) {
+            auto head = make_anchor_free_head(feat_ptr + 4 * reg_max, cls_num + 4 * reg_max, feat_ptr, cls_num + 4 * reg_max, cls_num, reg_max, feat.quant);
+            decode_anchor_free_head(head, feat_w * feat_h, prob_threshold, [&](int cell, int class_index, float box_prob, const float* pred_ltrb) {
+                int w = cell % feat_w;
+                int h = cell / feat_w;
+                tensor::dequantize(tensor::offset(feat_kps, (size_t)cell * 3 * num_point), kps.data(), 3 * num_point);
+
+                Object obj;
+                obj.rect = ltrb_to_rect(pred_ltrb, w, h, stride, letterbox_cols, letterbox_rows);
+                obj.label = class_index;
+                obj.prob = box_prob;
+                obj.kps_feat.clear();
+                for (int k = 0; k < num_point; k++)
+                {
+                    float kps_x = (kps[k * 3] * 2.f + w) * stride;
+                    float kps_y = (kps[k * 3 + 1] * 2.f + h) * stride;
+                    float kps_s = sigmoid(kps[k * 3 + 2]);
+                    obj.kps_feat.push_back(kps_x);
+                    obj.kps_feat.push_back(kps_y);
+                    obj.kps_feat.push_back(kps_s);
+                }
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
-        for (int h = 0; h <= feat_h - 1; h++)
-        {
-            for (int w = 0; w <= feat_w - 1; w++)
-            {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
-                {
-                    float score = feat_ptr[s + 4 * reg_max];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
-
-                float box_prob = sigmoid(class_score);
-                if (box_prob > prob_threshold)
-                {
-                    float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
-
-                    float pb_cx = (w + 0.5f) * stride;
-                    float pb_cy = (h + 0.5f) * stride;
-
-                    float x0 = pb_cx - pred_ltrb[0];
-                    float y0 = pb_cy - pred_ltrb[1];
-                    float x1 = pb_cx + pred_ltrb[2];
-                    float y1 = pb_cy + pred_ltrb[3];
-
-                    x0 = std::max(std::min(x0, (float)(letterbox_cols - 1)), 0.f);
-                    y0 = std::max(std::min(y0, (float)(letterbox_rows - 1)), 0.f);
-                    x1 = std::max(std::min(x1, (float)(letterbox_cols - 1)), 0.f);
-                    y1 = std::max(std::min(y1, (float)(letterbox_rows - 1)), 0.f);
-
-                    Object obj;
-                    obj.rect.x = x0;
-                    obj.rect.y = y0;
-                    obj.rect.width = x1 - x0;
-                    obj.rect.height = y1 - y0;
-                    obj.label = class_index;
-                    obj.prob = box_prob;
-                    obj.mask_feat.resize(mask_proto_dim);
-                    memcpy(obj.mask_feat.data(), feat_seg_ptr, sizeof(float) * mask_proto_dim);
-                    // for (int k = 0; k < mask_proto_dim; k++)
-                    // {
-                    //     obj.mask_feat[k] = feat_seg_ptr[k];
-                    // }
-                    objects.push_back(obj);
-                }
-
-                feat_ptr += cls_num + 4 * reg_max;
-                feat_seg_ptr += mask_proto_dim;
-            }
-        }
+                objects.push_back(obj);
+            });
+        });
     }
 
     static void generate_proposals_yolov8_pose_native(int stride, const float* feat, const float* feat_kps, float prob_threshold, std::vector<Object>& objects,
                                                       int letterbox_cols, int letterbox_rows, const int num_point = 17, int cls_num = 1)
+    {
+        generate_proposals_yolov8_pose_native(stride, tensor::make_view(feat), tensor::make_view(feat_kps), prob_threshold, objects, letterbox_cols, letterbox_rows, num_point, cls_num);
+    }
+
+    static inline Proposal make_proposal(const cv::Rect_<float>& rect, int label, float prob)
+    {
+        Proposal p;
+        p.x = rect.x;
+        p.y = rect.y;
+        p.width = rect.width;
+        p.height = rect.height;
+        p.prob = prob;
+        p.label = label;
+        p.feat_index = -1;
+        return p;
+    }
+
+    /* arena variants, the caller resets the arena once per frame with the matching feat kind */
+    static void generate_proposals_yolov8_native(int stride, const tensor::View& feat, float prob_threshold, ProposalArena& arena,
+                                                 int letterbox_cols, int letterbox_rows, int cls_num = 80)
     {
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
 
-        auto feat_ptr = feat;
+        tensor::visit(feat, [&](auto feat_ptr) {
+            auto head = make_anchor_free_head(feat_ptr + 4 * reg_max, cls_num + 4 * reg_max, feat_ptr, cls_num + 4 * reg_max, cls_num, reg_max, feat.quant);
+            decode_anchor_free_head(head, feat_w * feat_h, prob_threshold, [&](int cell, int class_index, float box_prob, const float* pred_ltrb) {
+                auto rect = ltrb_to_rect(pred_ltrb, cell % feat_w, cell / feat_w, stride, letterbox_cols, letterbox_rows);
+                arena.push_back(make_proposal(rect, class_index, box_prob));
+            });
+        });
+    }
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
-        for (int h = 0; h <= feat_h - 1; h++)
-        {
-            for (int w = 0; w <= feat_w - 1; w++)
-            {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
-                {
-                    float score = feat_ptr[s + 4 * reg_max];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
+    static void generate_proposals_yolov8_seg_native(int stride, const tensor::View& feat, const tensor::View& feat_seg, float prob_threshold, ProposalArena& arena,
+                                                     int letterbox_cols, int letterbox_rows, int cls_num = 80)
+    {
+        int feat_w = letterbox_cols / stride;
+        int feat_h = letterbox_rows / stride;
+        int reg_max = 16;
+        int mask_proto_dim = arena.feat_dim;
+
+        tensor::visit(feat, [&](auto feat_ptr) {
+            auto head = make_anchor_free_head(feat_ptr + 4 * reg_max, cls_num + 4 * reg_max, feat_ptr, cls_num + 4 * reg_max, cls_num, reg_max, feat.quant);
+            decode_anchor_free_head(head, feat_w * feat_h, prob_threshold, [&](int cell, int class_index, float box_prob, const float* pred_ltrb) {
+                auto rect = ltrb_to_rect(pred_ltrb, cell % feat_w, cell / feat_w, stride, letterbox_cols, letterbox_rows);
+                float* mask_feat = arena.push_back(make_proposal(rect, class_index, box_prob));
+                tensor::dequantize(tensor::offset(feat_seg, (size_t)cell * mask_proto_dim), mask_feat, mask_proto_dim);
+            });
+        });
+    }
 
-                float box_prob = sigmoid(class_score);
-                if (box_prob > prob_threshold)
+    static void generate_proposals_yolov8_pose_native(int stride, const tensor::View& feat, const tensor::View& feat_kps, float prob_threshold, ProposalArena& arena,
+                                                      int letterbox_cols, int letterbox_rows, int cls_num = 1)
+    {
+        int feat_w = letterbox_cols / stride;
+        int feat_h = letterbox_rows / stride;
+        int reg_max = 16;
+        int num_point = arena.feat_dim / 3;
+
+        tensor::visit(feat, [&](auto feat_ptr) {
+            auto head = make_anchor_free_head(feat_ptr + 4 * reg_max, cls_num + 4 * reg_max, feat_ptr, cls_num + 4 * reg_max, cls_num, reg_max, feat.quant);
+            decode_anchor_free_head(head, feat_w * feat_h, prob_threshold, [&](int cell, int class_index, float box_prob, const float* pred_ltrb) {
+                int w = cell % feat_w;
+                int h = cell / feat_w;
+                auto rect = ltrb_to_rect(pred_ltrb, w, h, stride, letterbox_cols, letterbox_rows);
+                float* kps = arena.push_back(make_proposal(rect, class_index, box_prob));
+                tensor::dequantize(tensor::offset(feat_kps, (size_t)cell * 3 * num_point), kps, 3 * num_point);
+                for (int k = 0; k < num_point; k++)
                 {
-                    float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
-
-                    float pb_cx = (w + 0.5f) * stride;
-                    float pb_cy = (h + 0.5f) * stride;
-
-                    float x0 = pb_cx - pred_ltrb[0];
-                    float y0 = pb_cy - pred_ltrb[1];
-                    float x1 = pb_cx + pred_ltrb[2];
-                    float y1 = pb_cy + pred_ltrb[3];
-
-                    x0 = std::max(std::min(x0, (float)(letterbox_cols - 1)), 0.f);
-                    y0 = std::max(std::min(y0, (float)(letterbox_rows - 1)), 0.f);
-                    x1 = std::max(std::min(x1, (float)(letterbox_cols - 1)), 0.f);
-                    y1 = std::max(std::min(y1, (float)(letterbox_rows - 1)), 0.f);
-
-                    Object obj;
-                    obj.rect.x = x0;
-                    obj.rect.y = y0;
-                    obj.rect.width = x1 - x0;
-                    obj.rect.height = y1 - y0;
-                    obj.label = class_index;
-                    obj.prob = box_prob;
-                    obj.kps_feat.clear();
-                    for (int k = 0; k < num_point; k++)
-                    {
-                        float kps_x = (feat_kps[k * 3] * 2.f + w) * stride;
-                        float kps_y = (feat_kps[k * 3 + 1] * 2.f + h) * stride;
-                        float kps_s = sigmoid(feat_kps[k * 3 + 2]);
-                        obj.kps_feat.push_back(kps_x);
-                        obj.kps_feat.push_back(kps_y);
-                        obj.kps_feat.push_back(kps_s);
-                    }
-                    objects.push_back(obj);
+                    kps[k * 3] = (kps[k * 3] * 2.f + w) * stride;
+                    kps[k * 3 + 1] = (kps[k * 3 + 1] * 2.f + h) * stride;
+                    kps[k * 3 + 2] = sigmoid(kps[k * 3 + 2]);
                 }
-                feat_ptr += (cls_num + 4 * reg_max);
-                feat_kps += 3 * num_point;
-            }
-        }
+            });
+        });
     }
 
-        static void generate_proposals_yolo_world(int stride, const float* feat_cls, const float* feat_reg, float exp, float bias, float prob_threshold, std::vector<Object>& objects,
+    static void generate_proposals_yolo_world(int stride, const float* feat_cls, const float* feat_reg, float exp, float bias, float prob_threshold, std::vector<Object>& objects,
                                               int letterbox_cols, int letterbox_rows, int cls_num = 80)
     {
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
 
-        auto feat_cls_ptr = feat_cls;
-        auto feat_reg_ptr = feat_reg;
-
-        std::vector<float> dis_after_sm(reg_max, 0.f);
-        for (int h = 0; h <= feat_h - 1; h++)
-        {
-            for (int w = 0; w <= feat_w - 1; w++)
-            {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
-                {
-                    float score = feat_cls_ptr[s];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
-
-                class_score = class_score * exp + bias;
-
-                float box_prob = sigmoid(class_score);
-                if (box_prob > prob_threshold)
-                {
-                    float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_reg_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
-
-                    float pb_cx = (w + 0.5f) * stride;
-                    float pb_cy = (h + 0.5f) * stride;
-
-                    float x0 = pb_cx - pred_ltrb[0];
-                    float y0 = pb_cy - pred_ltrb[1];
-                    float x1 = pb_cx + pred_ltrb[2];
-                    float y1 = pb_cy + pred_ltrb[3];
-
-                    x0 = std::max(std::min(x0, (float)(letterbox_cols - 1)), 0.f);
-                    y0 = std::max(std::min(y0, (float)(letterbox_rows - 1)), 0.f);
-                    x1 = std::max(std::min(x1, (float)(letterbox_cols - 1)), 0.f);
-                    y1 = std::max(std::min(y1, (float)(letterbox_rows - 1)), 0.f);
-
-                    Object obj;
-                    obj.rect.x = x0;
-                    obj.rect.y = y0;
-                    obj.rect.width = x1 - x0;
-                    obj.rect.height = y1 - y0;
-                    obj.label = class_index;
-                    obj.prob = box_prob;
-
-                    objects.push_back(obj);
-                }
-
-                feat_cls_ptr += cls_num;
-                feat_reg_ptr += 4 * reg_max;
-            }
-        }
+        auto head = make_anchor_free_head(feat_cls, cls_num, feat_reg, 4 * reg_max, cls_num, reg_max);
+        head.cls_scale = exp;
+        head.cls_bias = bias;
+        decode_anchor_free_head(head, feat_w * feat_h, prob_threshold, [&](int cell, int class_index, float box_prob, const float* pred_ltrb) {
+            Object obj;
+            obj.rect = ltrb_to_rect(pred_ltrb, cell % feat_w, cell / feat_w, stride, letterbox_cols, letterbox_rows);
+            obj.label = class_index;
+            obj.prob = box_prob;
+
+            objects.push_back(obj);
+        });
     }
 
     static void generate_proposals(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
@@ -1800,18 +2095,78 @@ namespace detection
         }
     }
 
-    static void draw_objects(const cv::Mat& bgr, const std::vector<Object>& objects, const char** class_names, const char* output_name, double fontScale = 0.5, int thickness = 1)
+    /* generate_proposals_palm with the anchor centers of decode::build_palm_plan */
+    static void generate_proposals_palm(std::vector<PalmObject>& region_list, float score_thresh, int input_img_w, int input_img_h, const float* scores_ptr, const float* bboxes_ptr,
+                                        const decode::DecodePlan& plan, float prob_threshold_unsigmoid)
     {
-        static const std::vector<cv::Scalar> COCO_COLORS = {
-            {128, 56, 0, 255}, {128, 226, 255, 0}, {128, 0, 94, 255}, {128, 0, 37, 255}, {128, 0, 255, 94}, {128, 255, 226, 0}, {128, 0, 18, 255}, {128, 255, 151, 0}, {128, 170, 0, 255}, {128, 0, 255, 56}, {128, 255, 0, 75}, {128, 0, 75, 255}, {128, 0, 255, 169}, {128, 255, 0, 207}, {128, 75, 255, 0}, {128, 207, 0, 255}, {128, 37, 0, 255}, {128, 0, 207, 255}, {128, 94, 0, 255}, {128, 0, 255, 113}, {128, 255, 18, 0}, {128, 255, 0, 56}, {128, 18, 0, 255}, {128, 0, 255, 226}, {128, 170, 255, 0}, {128, 255, 0, 245}, {128, 151, 255, 0}, {128, 132, 255, 0}, {128, 75, 0, 255}, {128, 151, 0, 255}, {128, 0, 151, 255}, {128, 132, 0, 255}, {128, 0, 255, 245}, {128, 255, 132, 0}, {128, 226, 0, 255}, {128, 255, 37, 0}, {128, 207, 255, 0}, {128, 0, 255, 207}, {128, 94, 255, 0}, {128, 0, 226, 255}, {128, 56, 255, 0}, {128, 255, 94, 0}, {128, 255, 113, 0}, {128, 0, 132, 255}, {128, 255, 0, 132}, {128, 255, 170, 0}, {128, 255, 0, 188}, {128, 113, 255, 0}, {128, 245, 0, 255}, {128, 113, 0, 255}, {128, 255, 188, 0}, {128, 0, 113, 255}, {128, 255, 0, 0}, {128, 0, 56, 255}, {128, 255, 0, 113}, {128, 0, 255, 188}, {128, 255, 0, 94}, {128, 255, 0, 18}, {128, 18, 255, 0}, {128, 0, 255, 132}, {128, 0, 188, 255}, {128, 0, 245, 255}, {128, 0, 169, 255}, {128, 37, 255, 0}, {128, 255, 0, 151}, {128, 188, 0, 255}, {128, 0, 255, 37}, {128, 0, 255, 0}, {128, 255, 0, 170}, {128, 255, 0, 37}, {128, 255, 75, 0}, {128, 0, 0, 255}, {128, 255, 207, 0}, {128, 255, 0, 226}, {128, 255, 245, 0}, {128, 188, 255, 0}, {128, 0, 255, 18}, {128, 0, 255, 75}, {128, 0, 255, 151}, {128, 255, 56, 0}, {128, 245, 255, 0}};
-        cv::Mat image = bgr.clone();
+        const int num_anchors = plan.size();
+        for (int idx = 0; idx < num_anchors; idx++)
+        {
+            if (scores_ptr[idx] < prob_threshold_unsigmoid)
+                continue;
 
+            float score = sigmoid(scores_ptr[idx]);
+            if (score > score_thresh)
+            {
+                const float x_center = plan.cx[idx];
+                const float y_center = plan.cy[idx];
+                const float* p = bboxes_ptr + (idx * 18);
+
+                float cx = p[0] / input_img_w + x_center;
+                float cy = p[1] / input_img_h + y_center;
+                float w = p[2] / input_img_w;
+                float h = p[3] / input_img_h;
+
+                float x0 = cx - w * 0.5f;
+                float y0 = cy - h * 0.5f;
+                float x1 = cx + w * 0.5f;
+                float y1 = cy + h * 0.5f;
+
+                PalmObject region;
+                region.prob = score;
+                region.rect.x = x0;
+                region.rect.y = y0;
+                region.rect.width = x1 - x0;
+                region.rect.height = y1 - y0;
+
+                for (int j = 0; j < 7; j++)
+                {
+                    float lx = p[4 + (2 * j) + 0];
+                    float ly = p[4 + (2 * j) + 1];
+                    lx += x_center * input_img_w;
+                    ly += y_center * input_img_h;
+                    lx /= (float)input_img_w;
+                    ly /= (float)input_img_h;
+
+                    region.landmarks[j].x = lx;
+                    region.landmarks[j].y = ly;
+                }
+                region_list.push_back(region);
+            }
+        }
+    }
+
+    static void print_objects(const std::vector<Object>& objects, const char** class_names)
+    {
         for (size_t i = 0; i < objects.size(); i++)
         {
             const Object& obj = objects[i];
 
             fprintf(stdout, "%2d: %3.0f%%, [%4.0f, %4.0f, %4.0f, %4.0f], %s\n", obj.label, obj.prob * 100, obj.rect.x,
                     obj.rect.y, obj.rect.x + obj.rect.width, obj.rect.y + obj.rect.height, class_names[obj.label]);
+        }
+    }
+
+    /* boxes and labels drawn on a copy of bgr, without writing it */
+    static cv::Mat render_objects(const cv::Mat& bgr, const std::vector<Object>& objects, const char** class_names, double fontScale = 0.5, int thickness = 1)
+    {
+        static const std::vector<cv::Scalar> COCO_COLORS = {
+            {128, 56, 0, 255}, {128, 226, 255, 0}, {128, 0, 94, 255}, {128, 0, 37, 255}, {128, 0, 255, 94}, {128, 255, 226, 0}, {128, 0, 18, 255}, {128, 255, 151, 0}, {128, 170, 0, 255}, {128, 0, 255, 56}, {128, 255, 0, 75}, {128, 0, 75, 255}, {128, 0, 255, 169}, {128, 255, 0, 207}, {128, 75, 255, 0}, {128, 207, 0, 255}, {128, 37, 0, 255}, {128, 0, 207, 255}, {128, 94, 0, 255}, {128, 0, 255, 113}, {128, 255, 18, 0}, {128, 255, 0, 56}, {128, 18, 0, 255}, {128, 0, 255, 226}, {128, 170, 255, 0}, {128, 255, 0, 245}, {128, 151, 255, 0}, {128, 132, 255, 0}, {128, 75, 0, 255}, {128, 151, 0, 255}, {128, 0, 151, 255}, {128, 132, 0, 255}, {128, 0, 255, 245}, {128, 255, 132, 0}, {128, 226, 0, 255}, {128, 255, 37, 0}, {128, 207, 255, 0}, {128, 0, 255, 207}, {128, 94, 255, 0}, {128, 0, 226, 255}, {128, 56, 255, 0}, {128, 255, 94, 0}, {128, 255, 113, 0}, {128, 0, 132, 255}, {128, 255, 0, 132}, {128, 255, 170, 0}, {128, 255, 0, 188}, {128, 113, 255, 0}, {128, 245, 0, 255}, {128, 113, 0, 255}, {128, 255, 188, 0}, {128, 0, 113, 255}, {128, 255, 0, 0}, {128, 0, 56, 255}, {128, 255, 0, 113}, {128, 0, 255, 188}, {128, 255, 0, 94}, {128, 255, 0, 18}, {128, 18, 255, 0}, {128, 0, 255, 132}, {128, 0, 188, 255}, {128, 0, 245, 255}, {128, 0, 169, 255}, {128, 37, 255, 0}, {128, 255, 0, 151}, {128, 188, 0, 255}, {128, 0, 255, 37}, {128, 0, 255, 0}, {128, 255, 0, 170}, {128, 255, 0, 37}, {128, 255, 75, 0}, {128, 0, 0, 255}, {128, 255, 207, 0}, {128, 255, 0, 226}, {128, 255, 245, 0}, {128, 188, 255, 0}, {128, 0, 255, 18}, {128, 0, 255, 75}, {128, 0, 255, 151}, {128, 255, 56, 0}, {128, 245, 255, 0}};
+        cv::Mat image = bgr.clone();
+
+        for (size_t i = 0; i < objects.size(); i++)
+        {
+            const Object& obj = objects[i];
 
             cv::rectangle(image, obj.rect, COCO_COLORS[obj.label], thickness);
 
@@ -1834,8 +2189,33 @@ namespace detection
             cv::putText(image, text, cv::Point(x, y + label_size.height), cv::FONT_HERSHEY_SIMPLEX, fontScale,
                         cv::Scalar(255, 255, 255), thickness);
         }
+        return image;
+    }
 
-        cv::imwrite(std::string(output_name) + ".jpg", image);
+    static void draw_objects(const cv::Mat& bgr, const std::vector<Object>& objects, const char** class_names, const char* output_name, double fontScale = 0.5, int thickness = 1)
+    {
+        print_objects(objects, class_names);
+        cv::imwrite(std::string(output_name) + ".jpg", render_objects(bgr, objects, class_names, fontScale, thickness));
+    }
+
+    /* one "label cx cy w h prob" line per object, box normalized by the image size like yolo labels */
+    static bool save_txt(const cv::Mat& bgr, const std::vector<Object>& objects, const std::string& output_name)
+    {
+        FILE* fp = fopen((output_name + ".txt").c_str(), "w");
+        if (!fp)
+        {
+            fprintf(stderr, "[ERR] cannot open file %s.txt \n", output_name.c_str());
+            return false;
+        }
+        float inv_w = 1.f / bgr.cols;
+        float inv_h = 1.f / bgr.rows;
+        for (const auto& obj : objects)
+        {
+            fprintf(fp, "%d %.6f %.6f %.6f %.6f %.6f\n", obj.label, (obj.rect.x + obj.rect.width * 0.5f) * inv_w,
+                    (obj.rect.y + obj.rect.height * 0.5f) * inv_h, obj.rect.width * inv_w, obj.rect.height * inv_h, obj.prob);
+        }
+        fclose(fp);
+        return true;
     }
 
     static void draw_keypoints(const cv::Mat& bgr, const std::vector<Object>& objects,
@@ -1925,7 +2305,10 @@ namespace detection
             fprintf(stdout, "%2d: %3.0f%%, [%4.0f, %4.0f, %4.0f, %4.0f], %s\n", obj.label, obj.prob * 100, obj.rect.x,
                     obj.rect.y, obj.rect.x + obj.rect.width, obj.rect.y + obj.rect.height, class_names[obj.label]);
 
-            mask(cv::Rect((int)obj.rect.x, (int)obj.rect.y, (int)objects[i].rect.width, (int)objects[i].rect.height)).setTo(color, objects[i].mask);
+            if (!obj.packed_mask.empty())
+                mask::blit(obj.packed_mask, mask, cv::Point((int)obj.rect.x, (int)obj.rect.y), color);
+            else
+                mask(cv::Rect((int)obj.rect.x, (int)obj.rect.y, (int)objects[i].rect.width, (int)objects[i].rect.height)).setTo(color, objects[i].mask);
 
             cv::rectangle(image, obj.rect, cv::Scalar(255, 0, 0));
 
@@ -1997,254 +2380,149 @@ namespace detection
         cv::imwrite(std::string(output_name) + ".jpg", image);
     }
 
-    void reverse_letterbox(std::vector<Object>& proposal, std::vector<Object>& objects, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    /*
+     * box corners, keypoints and landmarks of all objects back to the source image,
+     * gathered into one structure of arrays so the frame is mapped in a single pass.
+     * clip keeps the box corners inside the source image, keypoints and landmarks never are.
+     */
+    static void map_objects(std::vector<Object>& objects, const letterbox::LetterboxTransform& transform, bool landmarks, bool kps, bool clip = true)
     {
-        float scale_letterbox;
-        int resize_rows;
-        int resize_cols;
-        if ((letterbox_rows * 1.0 / src_rows) < (letterbox_cols * 1.0 / src_cols))
+        letterbox::PointBuffer points;
+        size_t count = objects.size();
+        points.x.reserve(count * (landmarks ? 7 : 2));
+        points.y.reserve(count * (landmarks ? 7 : 2));
+        for (auto& object : objects)
         {
-            scale_letterbox = letterbox_rows * 1.0 / src_rows;
+            points.push_back(object.rect.x, object.rect.y);
+            points.push_back(object.rect.x + object.rect.width, object.rect.y + object.rect.height);
+            for (size_t j = 0; kps && j < object.kps_feat.size() / 3; j++)
+            {
+                points.push_back(object.kps_feat[j * 3], object.kps_feat[j * 3 + 1]);
+            }
         }
-        else
+        if (clip)
         {
-            scale_letterbox = letterbox_cols * 1.0 / src_cols;
+            points.end_clipped();
         }
-        resize_cols = int(scale_letterbox * src_cols);
-        resize_rows = int(scale_letterbox * src_rows);
-
-        int tmp_h = (letterbox_rows - resize_rows) / 2;
-        int tmp_w = (letterbox_cols - resize_cols) / 2;
-
-        float ratio_x = (float)src_rows / resize_rows;
-        float ratio_y = (float)src_cols / resize_cols;
-
-        int count = proposal.size();
-
-        objects.resize(count);
-        for (int i = 0; i < count; i++)
+        for (size_t i = 0; landmarks && i < count; i++)
         {
-            objects[i] = proposal[i];
-            float x0 = (objects[i].rect.x);
-            float y0 = (objects[i].rect.y);
-            float x1 = (objects[i].rect.x + objects[i].rect.width);
-            float y1 = (objects[i].rect.y + objects[i].rect.height);
-
-            x0 = (x0 - tmp_w) * ratio_x;
-            y0 = (y0 - tmp_h) * ratio_y;
-            x1 = (x1 - tmp_w) * ratio_x;
-            y1 = (y1 - tmp_h) * ratio_y;
-
-            x0 = std::max(std::min(x0, (float)(src_cols - 1)), 0.f);
-            y0 = std::max(std::min(y0, (float)(src_rows - 1)), 0.f);
-            x1 = std::max(std::min(x1, (float)(src_cols - 1)), 0.f);
-            y1 = std::max(std::min(y1, (float)(src_rows - 1)), 0.f);
-
-            objects[i].rect.x = x0;
-            objects[i].rect.y = y0;
-            objects[i].rect.width = x1 - x0;
-            objects[i].rect.height = y1 - y0;
+            for (int l = 0; l < 5; l++)
+            {
+                points.push_back(objects[i].landmark[l].x, objects[i].landmark[l].y);
+            }
         }
-    }
-
-    void get_out_bbox_no_letterbox(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int model_h, int model_w, int src_rows, int src_cols)
-    {
-        qsort_descent_inplace(proposals);
-        std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
-
-        /* yolov5 draw the result */
-        float ratio_x = (float)src_cols / (float)model_w;
-        float ratio_y = (float)src_rows / (float)model_h;
-
-        int count = picked.size();
 
-        objects.resize(count);
-        for (int i = 0; i < count; i++)
-        {
-            objects[i] = proposals[picked[i]];
-            float x0 = (objects[i].rect.x);
-            float y0 = (objects[i].rect.y);
-            float x1 = (objects[i].rect.x + objects[i].rect.width);
-            float y1 = (objects[i].rect.y + objects[i].rect.height);
+        points.map(transform);
 
-            x0 = (x0)*ratio_x;
-            y0 = (y0)*ratio_y;
-            x1 = (x1)*ratio_x;
-            y1 = (y1)*ratio_y;
-
-            x0 = std::max(std::min(x0, (float)(src_cols - 1)), 0.f);
-            y0 = std::max(std::min(y0, (float)(src_rows - 1)), 0.f);
-            x1 = std::max(std::min(x1, (float)(src_cols - 1)), 0.f);
-            y1 = std::max(std::min(y1, (float)(src_rows - 1)), 0.f);
-
-            objects[i].rect.x = x0;
-            objects[i].rect.y = y0;
-            objects[i].rect.width = x1 - x0;
-            objects[i].rect.height = y1 - y0;
-        }
-    }
-
-    void get_out_bbox(std::vector<Object>& objects, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
-    {
-        /* yolov5 draw the result */
-        float scale_letterbox;
-        int resize_rows;
-        int resize_cols;
-        if ((letterbox_rows * 1.0 / src_rows) < (letterbox_cols * 1.0 / src_cols))
-        {
-            scale_letterbox = letterbox_rows * 1.0 / src_rows;
-        }
-        else
+        size_t p = 0;
+        for (auto& object : objects)
         {
-            scale_letterbox = letterbox_cols * 1.0 / src_cols;
+            float x0 = points.x[p], y0 = points.y[p];
+            float x1 = points.x[p + 1], y1 = points.y[p + 1];
+            p += 2;
+            object.rect.x = x0;
+            object.rect.y = y0;
+            object.rect.width = x1 - x0;
+            object.rect.height = y1 - y0;
+            for (size_t j = 0; kps && j < object.kps_feat.size() / 3; j++, p++)
+            {
+                object.kps_feat[j * 3] = points.x[p];
+                object.kps_feat[j * 3 + 1] = points.y[p];
+            }
         }
-        resize_cols = int(scale_letterbox * src_cols);
-        resize_rows = int(scale_letterbox * src_rows);
-
-        int tmp_h = (letterbox_rows - resize_rows) / 2;
-        int tmp_w = (letterbox_cols - resize_cols) / 2;
-
-        float ratio_x = (float)src_rows / resize_rows;
-        float ratio_y = (float)src_cols / resize_cols;
-
-        int count = objects.size();
-
-        objects.resize(count);
-        for (int i = 0; i < count; i++)
+        for (size_t i = 0; landmarks && i < count; i++)
         {
-            float x0 = (objects[i].rect.x);
-            float y0 = (objects[i].rect.y);
-            float x1 = (objects[i].rect.x + objects[i].rect.width);
-            float y1 = (objects[i].rect.y + objects[i].rect.height);
-
-            x0 = (x0 - tmp_w) * ratio_x;
-            y0 = (y0 - tmp_h) * ratio_y;
-            x1 = (x1 - tmp_w) * ratio_x;
-            y1 = (y1 - tmp_h) * ratio_y;
-
-            for (int l = 0; l < 5; l++)
+            for (int l = 0; l < 5; l++, p++)
             {
-                auto lx = objects[i].landmark[l].x;
-                auto ly = objects[i].landmark[l].y;
-                objects[i].landmark[l] = cv::Point2f((lx - tmp_w) * ratio_x, (ly - tmp_h) * ratio_y);
+                objects[i].landmark[l] = cv::Point2f(points.x[p], points.y[p]);
             }
+        }
+    }
 
-            x0 = std::max(std::min(x0, (float)(src_cols - 1)), 0.f);
-            y0 = std::max(std::min(y0, (float)(src_rows - 1)), 0.f);
-            x1 = std::max(std::min(x1, (float)(src_cols - 1)), 0.f);
-            y1 = std::max(std::min(y1, (float)(src_rows - 1)), 0.f);
+    void reverse_letterbox(std::vector<Object>& proposal, std::vector<Object>& objects, const letterbox::LetterboxTransform& transform)
+    {
+        objects = proposal;
+        map_objects(objects, transform, false, false);
+    }
 
-            objects[i].rect.x = x0;
-            objects[i].rect.y = y0;
-            objects[i].rect.width = x1 - x0;
-            objects[i].rect.height = y1 - y0;
-        }
+    void reverse_letterbox(std::vector<Object>& proposal, std::vector<Object>& objects, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    {
+        reverse_letterbox(proposal, objects, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols));
     }
 
-    void get_out_bbox(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    void get_out_bbox_no_letterbox(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int model_h, int model_w, int src_rows, int src_cols, int top_k = -1)
     {
-        qsort_descent_inplace(proposals);
         std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
+        nms_top_k(proposals, picked, nms_threshold, top_k);
 
-        /* yolov5 draw the result */
-        float scale_letterbox;
-        int resize_rows;
-        int resize_cols;
-        if ((letterbox_rows * 1.0 / src_rows) < (letterbox_cols * 1.0 / src_cols))
-        {
-            scale_letterbox = letterbox_rows * 1.0 / src_rows;
-        }
-        else
+        objects.resize(picked.size());
+        for (size_t i = 0; i < picked.size(); i++)
         {
-            scale_letterbox = letterbox_cols * 1.0 / src_cols;
+            objects[i] = proposals[picked[i]];
         }
-        resize_cols = int(scale_letterbox * src_cols);
-        resize_rows = int(scale_letterbox * src_rows);
+        map_objects(objects, letterbox::make_stretch(src_rows, src_cols, model_h, model_w), false, false);
+    }
 
-        int tmp_h = (letterbox_rows - resize_rows) / 2;
-        int tmp_w = (letterbox_cols - resize_cols) / 2;
+    /* landmarks for the face and plate detectors that fill Object::landmark, clip as in map_objects */
+    void get_out_bbox(std::vector<Object>& objects, const letterbox::LetterboxTransform& transform, bool landmarks = false, bool clip = true)
+    {
+        map_objects(objects, transform, landmarks, false, clip);
+    }
 
-        float ratio_x = (float)src_rows / resize_rows;
-        float ratio_y = (float)src_cols / resize_cols;
+    void get_out_bbox(std::vector<Object>& objects, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols, bool landmarks = false, bool clip = true)
+    {
+        get_out_bbox(objects, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols), landmarks, clip);
+    }
 
-        int count = picked.size();
+    void get_out_bbox(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, const letterbox::LetterboxTransform& transform, int top_k = -1,
+                      bool landmarks = false, bool clip = true)
+    {
+        std::vector<int> picked;
+        nms_top_k(proposals, picked, nms_threshold, top_k);
 
-        objects.resize(count);
-        for (int i = 0; i < count; i++)
+        objects.resize(picked.size());
+        for (size_t i = 0; i < picked.size(); i++)
         {
             objects[i] = proposals[picked[i]];
-            float x0 = (objects[i].rect.x);
-            float y0 = (objects[i].rect.y);
-            float x1 = (objects[i].rect.x + objects[i].rect.width);
-            float y1 = (objects[i].rect.y + objects[i].rect.height);
-
-            x0 = (x0 - tmp_w) * ratio_x;
-            y0 = (y0 - tmp_h) * ratio_y;
-            x1 = (x1 - tmp_w) * ratio_x;
-            y1 = (y1 - tmp_h) * ratio_y;
-
-            for (int l = 0; l < 5; l++)
-            {
-                auto lx = objects[i].landmark[l].x;
-                auto ly = objects[i].landmark[l].y;
-                objects[i].landmark[l] = cv::Point2f((lx - tmp_w) * ratio_x, (ly - tmp_h) * ratio_y);
-            }
-
-            x0 = std::max(std::min(x0, (float)(src_cols - 1)), 0.f);
-            y0 = std::max(std::min(y0, (float)(src_rows - 1)), 0.f);
-            x1 = std::max(std::min(x1, (float)(src_cols - 1)), 0.f);
-            y1 = std::max(std::min(y1, (float)(src_rows - 1)), 0.f);
-
-            objects[i].rect.x = x0;
-            objects[i].rect.y = y0;
-            objects[i].rect.width = x1 - x0;
-            objects[i].rect.height = y1 - y0;
         }
+        get_out_bbox(objects, transform, landmarks, clip);
     }
 
-    void get_out_bbox_mask(std::vector<Object>& proposals, std::vector<Object>& objects, const float* mask_proto, int mask_proto_dim, int mask_stride, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    void get_out_bbox(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols, int top_k = -1,
+                      bool landmarks = false, bool clip = true)
     {
-        qsort_descent_inplace(proposals);
-        std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
+        get_out_bbox(proposals, objects, nms_threshold, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols), top_k, landmarks, clip);
+    }
 
-        /* yolov5 draw the result */
-        float scale_letterbox;
-        int resize_rows;
-        int resize_cols;
-        if ((letterbox_rows * 1.0 / src_rows) < (letterbox_cols * 1.0 / src_cols))
-        {
-            scale_letterbox = letterbox_rows * 1.0 / src_rows;
-        }
-        else
-        {
-            scale_letterbox = letterbox_cols * 1.0 / src_cols;
-        }
-        resize_cols = int(scale_letterbox * src_cols);
-        resize_rows = int(scale_letterbox * src_rows);
+    void get_out_bbox(ProposalArena& arena, std::vector<Object>& objects, const float nms_threshold, const letterbox::LetterboxTransform& transform, int top_k = -1,
+                      bool landmarks = false, bool clip = true)
+    {
+        std::vector<int> picked;
+        nms_top_k(arena.proposals, picked, nms_threshold, top_k);
 
-        int tmp_h = (letterbox_rows - resize_rows) / 2;
-        int tmp_w = (letterbox_cols - resize_cols) / 2;
+        promote_proposals(arena, picked, objects);
+        get_out_bbox(objects, transform, landmarks, clip);
+    }
 
-        float ratio_x = (float)src_rows / resize_rows;
-        float ratio_y = (float)src_cols / resize_cols;
+    void get_out_bbox(ProposalArena& arena, std::vector<Object>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols, int top_k = -1,
+                      bool landmarks = false, bool clip = true)
+    {
+        get_out_bbox(arena, objects, nms_threshold, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols), top_k, landmarks, clip);
+    }
 
-        int mask_proto_h = int(letterbox_rows / mask_stride);
-        int mask_proto_w = int(letterbox_cols / mask_stride);
+    void get_out_bbox_mask(std::vector<Object>& objects, const float* mask_proto, int mask_proto_dim, int mask_stride, const letterbox::LetterboxTransform& transform,
+                           int interpolation = cv::INTER_LINEAR, mask::Format format = mask::FORMAT_MAT)
+    {
+        int mask_proto_h = int(transform.dst_h / mask_stride);
+        int mask_proto_w = int(transform.dst_w / mask_stride);
 
-        int count = picked.size();
-        objects.resize(count);
+        int count = objects.size();
 
+        /* bbox roi of every instance on the proto, coefficients stacked for one batched pass */
+        std::vector<cv::Rect> rois(count);
+        std::vector<float> coeffs((size_t)count * mask_proto_dim, 0.f);
         for (int i = 0; i < count; i++)
         {
-            objects[i] = proposals[picked[i]];
-            float x0 = (objects[i].rect.x);
-            float y0 = (objects[i].rect.y);
-            float x1 = (objects[i].rect.x + objects[i].rect.width);
-            float y1 = (objects[i].rect.y + objects[i].rect.height);
-            /* naive RoiAlign by opencv */
             int hstart = std::floor(objects[i].rect.y / mask_stride);
             int hend = std::ceil(objects[i].rect.y / mask_stride + objects[i].rect.height / mask_stride);
             int wstart = std::floor(objects[i].rect.x / mask_stride);
@@ -2255,109 +2533,114 @@ namespace detection
             hend = std::min(std::max(hend, 0), mask_proto_h);
             wend = std::min(std::max(wend, 0), mask_proto_w);
 
-            int mask_w = wend - wstart;
-            int mask_h = hend - hstart;
+            rois[i] = cv::Rect(wstart, hstart, std::max(wend - wstart, 0), std::max(hend - hstart, 0));
+            std::copy_n(objects[i].mask_feat.begin(), std::min((int)objects[i].mask_feat.size(), mask_proto_dim), coeffs.begin() + (size_t)i * mask_proto_dim);
+        }
+
+        std::vector<cv::Mat> masks;
+        mask::assemble_masks(coeffs.data(), count, mask_proto, mask_proto_dim, mask_proto_h, mask_proto_w, rois, masks);
 
-            cv::Mat mask = cv::Mat(mask_h, mask_w, CV_32FC1);
-            if (mask_w > 0 && mask_h > 0)
+        map_objects(objects, transform, false, false);
+
+        cv::Mat scratch;
+        for (int i = 0; i < count; i++)
+        {
+            cv::Size mask_size((int)objects[i].rect.width, (int)objects[i].rect.height);
+            if (format == mask::FORMAT_PACKED)
             {
-                std::vector<cv::Range> roi_ranges;
-                roi_ranges.push_back(cv::Range(0, 1));
-                roi_ranges.push_back(cv::Range::all());
-                roi_ranges.push_back(cv::Range(hstart, hend));
-                roi_ranges.push_back(cv::Range(wstart, wend));
-
-                cv::Mat mask_protos = cv::Mat(mask_proto_dim, mask_proto_h * mask_proto_w, CV_32FC1, (float*)mask_proto);
-                int sz[] = {1, mask_proto_dim, mask_proto_h, mask_proto_w};
-                cv::Mat mask_protos_reshape = mask_protos.reshape(1, 4, sz);
-                cv::Mat protos = mask_protos_reshape(roi_ranges).clone().reshape(0, {mask_proto_dim, mask_w * mask_h});
-                cv::Mat mask_proposals = cv::Mat(1, mask_proto_dim, CV_32FC1, (float*)objects[i].mask_feat.data());
-                cv::Mat masks_feature = (mask_proposals * protos);
-                /* sigmoid */
-                cv::exp(-masks_feature.reshape(1, {mask_h, mask_w}), mask);
-                mask = 1.0 / (1.0 + mask);
+                objects[i].mask.release();
+                mask::upsample_mask(masks[i], objects[i].packed_mask, mask_size, interpolation, scratch);
             }
+            else
+            {
+                objects[i].packed_mask = mask::PackedMask();
+                mask::upsample_mask(masks[i], objects[i].mask, mask_size, interpolation);
+            }
+        }
+    }
 
-            x0 = (x0 - tmp_w) * ratio_x;
-            y0 = (y0 - tmp_h) * ratio_y;
-            x1 = (x1 - tmp_w) * ratio_x;
-            y1 = (y1 - tmp_h) * ratio_y;
+    void get_out_bbox_mask(std::vector<Object>& objects, const float* mask_proto, int mask_proto_dim, int mask_stride, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols,
+                           int interpolation = cv::INTER_LINEAR, mask::Format format = mask::FORMAT_MAT)
+    {
+        get_out_bbox_mask(objects, mask_proto, mask_proto_dim, mask_stride, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols), interpolation, format);
+    }
 
-            x0 = std::max(std::min(x0, (float)(src_cols - 1)), 0.f);
-            y0 = std::max(std::min(y0, (float)(src_rows - 1)), 0.f);
-            x1 = std::max(std::min(x1, (float)(src_cols - 1)), 0.f);
-            y1 = std::max(std::min(y1, (float)(src_rows - 1)), 0.f);
+    void get_out_bbox_mask(std::vector<Object>& proposals, std::vector<Object>& objects, const float* mask_proto, int mask_proto_dim, int mask_stride, const float nms_threshold, const letterbox::LetterboxTransform& transform, int top_k = -1,
+                           mask::Format format = mask::FORMAT_MAT)
+    {
+        std::vector<int> picked;
+        nms_top_k(proposals, picked, nms_threshold, top_k);
 
-            objects[i].rect.x = x0;
-            objects[i].rect.y = y0;
-            objects[i].rect.width = x1 - x0;
-            objects[i].rect.height = y1 - y0;
-            cv::resize(mask, mask, cv::Size((int)objects[i].rect.width, (int)objects[i].rect.height));
-            objects[i].mask = mask > 0.5;
+        objects.resize(picked.size());
+        for (size_t i = 0; i < picked.size(); i++)
+        {
+            objects[i] = proposals[picked[i]];
         }
+        get_out_bbox_mask(objects, mask_proto, mask_proto_dim, mask_stride, transform, cv::INTER_LINEAR, format);
+    }
+
+    void get_out_bbox_mask(std::vector<Object>& proposals, std::vector<Object>& objects, const float* mask_proto, int mask_proto_dim, int mask_stride, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols, int top_k = -1,
+                           mask::Format format = mask::FORMAT_MAT)
+    {
+        get_out_bbox_mask(proposals, objects, mask_proto, mask_proto_dim, mask_stride, nms_threshold, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols), top_k, format);
     }
 
-    void get_out_bbox_kps(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    void get_out_bbox_mask(ProposalArena& arena, std::vector<Object>& objects, const float* mask_proto, int mask_stride, const float nms_threshold, const letterbox::LetterboxTransform& transform, int top_k = -1,
+                           mask::Format format = mask::FORMAT_MAT)
     {
-        qsort_descent_inplace(proposals);
         std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
+        nms_top_k(arena.proposals, picked, nms_threshold, top_k);
 
-        /* yolov8 draw the result */
-        float scale_letterbox;
-        int resize_rows;
-        int resize_cols;
-        if ((letterbox_rows * 1.0 / src_rows) < (letterbox_cols * 1.0 / src_cols))
-        {
-            scale_letterbox = letterbox_rows * 1.0 / src_rows;
-        }
-        else
-        {
-            scale_letterbox = letterbox_cols * 1.0 / src_cols;
-        }
-        resize_cols = int(scale_letterbox * src_cols);
-        resize_rows = int(scale_letterbox * src_rows);
+        promote_proposals(arena, picked, objects);
+        get_out_bbox_mask(objects, mask_proto, arena.feat_dim, mask_stride, transform, cv::INTER_LINEAR, format);
+    }
 
-        int tmp_h = (letterbox_rows - resize_rows) / 2;
-        int tmp_w = (letterbox_cols - resize_cols) / 2;
+    void get_out_bbox_mask(ProposalArena& arena, std::vector<Object>& objects, const float* mask_proto, int mask_stride, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols, int top_k = -1,
+                           mask::Format format = mask::FORMAT_MAT)
+    {
+        get_out_bbox_mask(arena, objects, mask_proto, mask_stride, nms_threshold, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols), top_k, format);
+    }
 
-        float ratio_x = (float)src_rows / resize_rows;
-        float ratio_y = (float)src_cols / resize_cols;
+    void get_out_bbox_kps(std::vector<Object>& objects, const letterbox::LetterboxTransform& transform)
+    {
+        map_objects(objects, transform, false, true);
+    }
 
-        int count = picked.size();
+    void get_out_bbox_kps(std::vector<Object>& objects, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    {
+        get_out_bbox_kps(objects, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols));
+    }
 
-        objects.resize(count);
-        for (int i = 0; i < count; i++)
+    void get_out_bbox_kps(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, const letterbox::LetterboxTransform& transform, int top_k = -1)
+    {
+        std::vector<int> picked;
+        nms_top_k(proposals, picked, nms_threshold, top_k);
+
+        objects.resize(picked.size());
+        for (size_t i = 0; i < picked.size(); i++)
         {
             objects[i] = proposals[picked[i]];
-            float x0 = (objects[i].rect.x);
-            float y0 = (objects[i].rect.y);
-            float x1 = (objects[i].rect.x + objects[i].rect.width);
-            float y1 = (objects[i].rect.y + objects[i].rect.height);
-
-            x0 = (x0 - tmp_w) * ratio_x;
-            y0 = (y0 - tmp_h) * ratio_y;
-            x1 = (x1 - tmp_w) * ratio_x;
-            y1 = (y1 - tmp_h) * ratio_y;
-
-            x0 = std::max(std::min(x0, (float)(src_cols - 1)), 0.f);
-            y0 = std::max(std::min(y0, (float)(src_rows - 1)), 0.f);
-            x1 = std::max(std::min(x1, (float)(src_cols - 1)), 0.f);
-            y1 = std::max(std::min(y1, (float)(src_rows - 1)), 0.f);
-
-            objects[i].rect.x = x0;
-            objects[i].rect.y = y0;
-            objects[i].rect.width = x1 - x0;
-            objects[i].rect.height = y1 - y0;
-
-            for (int j = 0; j < objects[i].kps_feat.size() / 3; j++)
-            {
-                objects[i].kps_feat[j * 3] = std::max(
-                    std::min((objects[i].kps_feat[j * 3] - tmp_w) * ratio_x, (float)(src_cols - 1)), 0.f);
-                objects[i].kps_feat[j * 3 + 1] = std::max(
-                    std::min((objects[i].kps_feat[j * 3 + 1] - tmp_h) * ratio_y, (float)(src_rows - 1)), 0.f);
-            }
         }
+        get_out_bbox_kps(objects, transform);
+    }
+
+    void get_out_bbox_kps(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols, int top_k = -1)
+    {
+        get_out_bbox_kps(proposals, objects, nms_threshold, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols), top_k);
+    }
+
+    void get_out_bbox_kps(ProposalArena& arena, std::vector<Object>& objects, const float nms_threshold, const letterbox::LetterboxTransform& transform, int top_k = -1)
+    {
+        std::vector<int> picked;
+        nms_top_k(arena.proposals, picked, nms_threshold, top_k);
+
+        promote_proposals(arena, picked, objects);
+        get_out_bbox_kps(objects, transform);
+    }
+
+    void get_out_bbox_kps(ProposalArena& arena, std::vector<Object>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols, int top_k = -1)
+    {
+        get_out_bbox_kps(arena, objects, nms_threshold, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols), top_k);
     }
 
     static void transform_rects_palm(PalmObject& object)
@@ -2409,11 +2692,10 @@ namespace detection
         }
     }
 
-    static void get_out_bbox_palm(std::vector<PalmObject>& proposals, std::vector<PalmObject>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    static void get_out_bbox_palm(std::vector<PalmObject>& proposals, std::vector<PalmObject>& objects, const float nms_threshold, const letterbox::LetterboxTransform& transform, int top_k = -1)
     {
-        qsort_descent_inplace(proposals);
         std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
+        nms_top_k(proposals, picked, nms_threshold, top_k);
 
         int count = picked.size();
         objects.resize(count);
@@ -2423,39 +2705,37 @@ namespace detection
             transform_rects_palm(objects[i]);
         }
 
-        float scale_letterbox;
-        int resize_rows;
-        int resize_cols;
-        if ((letterbox_rows * 1.0 / src_rows) < (letterbox_cols * 1.0 / src_cols))
-        {
-            scale_letterbox = letterbox_rows * 1.0 / src_rows;
-        }
-        else
+        /* palm outputs are normalized to the model input, vertices and landmarks are mapped together */
+        letterbox::PointBuffer points;
+        points.x.reserve(count * 11);
+        points.y.reserve(count * 11);
+        for (auto& object : objects)
         {
-            scale_letterbox = letterbox_cols * 1.0 / src_cols;
+            for (auto& vertice : object.vertices)
+            {
+                points.push_back(vertice.x * transform.dst_w, vertice.y * transform.dst_h);
+            }
+            for (auto& ld : object.landmarks)
+            {
+                points.push_back(ld.x * transform.dst_w, ld.y * transform.dst_h);
+            }
         }
-        resize_cols = int(scale_letterbox * src_cols);
-        resize_rows = int(scale_letterbox * src_rows);
-
-        int tmp_h = (letterbox_rows - resize_rows) / 2;
-        int tmp_w = (letterbox_cols - resize_cols) / 2;
-
-        float ratio_x = (float)src_cols / resize_cols;
-        float ratio_y = (float)src_rows / resize_rows;
+        points.map(transform);
 
+        size_t p = 0;
         for (auto& object : objects)
         {
             for (auto& vertice : object.vertices)
             {
-                vertice.x = (vertice.x * letterbox_cols - tmp_w) * ratio_x;
-                vertice.y = (vertice.y * letterbox_rows - tmp_h) * ratio_y;
+                vertice = cv::Point2f(points.x[p], points.y[p]);
+                p++;
             }
-
             for (auto& ld : object.landmarks)
             {
-                ld.x = (ld.x * letterbox_cols - tmp_w) * ratio_x;
-                ld.y = (ld.y * letterbox_rows - tmp_h) * ratio_y;
+                ld = cv::Point2f(points.x[p], points.y[p]);
+                p++;
             }
+
             // get warpaffine transform mat to landmark detect
             cv::Point2f src_pts[4];
             src_pts[0] = object.vertices[0];
@@ -2474,67 +2754,38 @@ namespace detection
         }
     }
 
-    void get_out_bbox_yolopv2(std::vector<Object>& proposals, std::vector<Object>& objects, const float* da_ptr, const float* ll_ptr, cv::Mat& ll_seg_mask, cv::Mat& da_seg_mask, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    static void get_out_bbox_palm(std::vector<PalmObject>& proposals, std::vector<PalmObject>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols, int top_k = -1)
     {
-        qsort_descent_inplace(proposals);
-        std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
-
-        /* yolov5 draw the result */
-        float scale_letterbox;
-        int resize_rows;
-        int resize_cols;
-        if ((letterbox_rows * 1.0 / src_rows) < (letterbox_cols * 1.0 / src_cols))
-        {
-            scale_letterbox = letterbox_rows * 1.0 / src_rows;
-        }
-        else
-        {
-            scale_letterbox = letterbox_cols * 1.0 / src_cols;
-        }
-        resize_cols = int(scale_letterbox * src_cols);
-        resize_rows = int(scale_letterbox * src_rows);
-
-        int tmp_h = (letterbox_rows - resize_rows) / 2;
-        int tmp_w = (letterbox_cols - resize_cols) / 2;
-
-        float ratio_x = (float)src_rows / resize_rows;
-        float ratio_y = (float)src_cols / resize_cols;
+        get_out_bbox_palm(proposals, objects, nms_threshold, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols), top_k);
+    }
 
-        int count = picked.size();
+    void get_out_bbox_yolopv2(std::vector<Object>& proposals, std::vector<Object>& objects, const float* da_ptr, const float* ll_ptr, cv::Mat& ll_seg_mask, cv::Mat& da_seg_mask, const float nms_threshold, const letterbox::LetterboxTransform& transform, int top_k = -1)
+    {
+        std::vector<int> picked;
+        nms_top_k(proposals, picked, nms_threshold, top_k);
 
-        objects.resize(count);
-        for (int i = 0; i < count; i++)
+        objects.resize(picked.size());
+        for (size_t i = 0; i < picked.size(); i++)
         {
             objects[i] = proposals[picked[i]];
-            float x0 = (objects[i].rect.x);
-            float y0 = (objects[i].rect.y);
-            float x1 = (objects[i].rect.x + objects[i].rect.width);
-            float y1 = (objects[i].rect.y + objects[i].rect.height);
-
-            x0 = (x0 - tmp_w) * ratio_x;
-            y0 = (y0 - tmp_h) * ratio_y;
-            x1 = (x1 - tmp_w) * ratio_x;
-            y1 = (y1 - tmp_h) * ratio_y;
-
-            x0 = std::max(std::min(x0, (float)(src_cols - 1)), 0.f);
-            y0 = std::max(std::min(y0, (float)(src_rows - 1)), 0.f);
-            x1 = std::max(std::min(x1, (float)(src_cols - 1)), 0.f);
-            y1 = std::max(std::min(y1, (float)(src_rows - 1)), 0.f);
-
-            objects[i].rect.x = x0;
-            objects[i].rect.y = y0;
-            objects[i].rect.width = x1 - x0;
-            objects[i].rect.height = y1 - y0;
         }
+        map_objects(objects, transform, false, false);
 
-        cv::Mat ll = cv::Mat(cv::Size(letterbox_cols, letterbox_rows), CV_32FC1, (float*)ll_ptr);
+        cv::Rect roi(transform.pad_x, transform.pad_y, transform.resize_w, transform.resize_h);
+        cv::Size src_size(transform.src_w, transform.src_h);
+
+        cv::Mat ll = cv::Mat(cv::Size(transform.dst_w, transform.dst_h), CV_32FC1, (float*)ll_ptr);
         ll = ll > 0.5;
-        cv::resize(ll(cv::Rect(tmp_w, tmp_h, resize_cols, resize_rows)), ll_seg_mask, cv::Size(src_cols, src_rows), 0, 0, cv::INTER_LINEAR);
+        cv::resize(ll(roi), ll_seg_mask, src_size, 0, 0, cv::INTER_LINEAR);
 
-        cv::Mat da = cv::Mat(cv::Size(letterbox_cols, letterbox_rows), CV_32FC1, (float*)da_ptr);
+        cv::Mat da = cv::Mat(cv::Size(transform.dst_w, transform.dst_h), CV_32FC1, (float*)da_ptr);
         da = da > 0;
-        cv::resize(da(cv::Rect(tmp_w, tmp_h, resize_cols, resize_rows)), da_seg_mask, cv::Size(src_cols, src_rows), 0, 0, cv::INTER_NEAREST);
+        cv::resize(da(roi), da_seg_mask, src_size, 0, 0, cv::INTER_NEAREST);
+    }
+
+    void get_out_bbox_yolopv2(std::vector<Object>& proposals, std::vector<Object>& objects, const float* da_ptr, const float* ll_ptr, cv::Mat& ll_seg_mask, cv::Mat& da_seg_mask, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols, int top_k = -1)
+    {
+        get_out_bbox_yolopv2(proposals, objects, da_ptr, ll_ptr, ll_seg_mask, da_seg_mask, nms_threshold, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols), top_k);
     }
 
     namespace mmyolo
@@ -2547,43 +2798,6 @@ namespace detection
             return val > min ? (val < max ? val : max) : min;
         }
 
-        inline float fast_exp(const float& x)
-        {
-            union
-            {
-                uint32_t i;
-                float f;
-            } v{};
-            v.i = (1 << 23) * (1.4426950409 * x + 126.93490512f);
-            return v.f;
-        }
-
-        inline float fast_sigmoid(const float& x)
-        {
-            return 1.0f / (1.0f + fast_exp(-x));
-        }
-
-        inline static float fast_softmax(
-            const float* src,
-            float* dst,
-            int length)
-        {
-            const float alpha = *std::max_element(src, src + length);
-            float denominator = 0;
-            float dis_sum = 0;
-            for (int i = 0; i < length; ++i)
-            {
-                dst[i] = fast_exp(src[i] - alpha);
-                denominator += dst[i];
-            }
-            for (int i = 0; i < length; ++i)
-            {
-                dst[i] /= denominator;
-                dis_sum += i * dst[i];
-            }
-            return dis_sum;
-        }
-
         static void generate_proposals_ppyoloeplus(
             int stride,
             const float* cls_feat,
@@ -2599,21 +2813,20 @@ namespace detection
             auto cls_ptr = cls_feat;
             auto boxes_ptr = box_feat;
             int reg_max = 17;
-            float dis_after_sm[reg_max];
 
             for (int h = 0; h < feat_h; h++)
             {
                 for (int w = 0; w < feat_w; w++)
                 {
                     auto max = std::max_element(cls_ptr, cls_ptr + cls_num);
-                    float box_prob = fast_sigmoid(*max);
+                    float box_prob = math::sigmoid(*max);
 
                     if (box_prob > prob_threshold)
                     {
-                        float x0 = w + 0.5f - fast_softmax(boxes_ptr, dis_after_sm, reg_max);
-                        float y0 = h + 0.5f - fast_softmax(boxes_ptr + reg_max, dis_after_sm, reg_max);
-                        float x1 = w + 0.5f + fast_softmax(boxes_ptr + 2 * reg_max, dis_after_sm, reg_max);
-                        float y1 = h + 0.5f + fast_softmax(boxes_ptr + 3 * reg_max, dis_after_sm, reg_max);
+                        float x0 = w + 0.5f - math::dfl(boxes_ptr, reg_max);
+                        float y0 = h + 0.5f - math::dfl(boxes_ptr + reg_max, reg_max);
+                        float x1 = w + 0.5f + math::dfl(boxes_ptr + 2 * reg_max, reg_max);
+                        float y1 = h + 0.5f + math::dfl(boxes_ptr + 3 * reg_max, reg_max);
 
                         x0 *= stride;
                         y0 *= stride;
@@ -2664,15 +2877,15 @@ namespace detection
                 {
                     //process cls score
                     auto max = std::max_element(cls_ptr, cls_ptr + cls_num);
-                    float box_prob = fast_sigmoid(*max) * fast_sigmoid(*conf_ptr);
+                    float box_prob = math::sigmoid(*max) * math::sigmoid(*conf_ptr);
 
                     if (box_prob > prob_threshold)
                     {
                         float x = (w + boxes_ptr[0]) * stride;
                         float y = (h + boxes_ptr[1]) * stride;
 
-                        float width = fast_exp(boxes_ptr[2]) * stride;
-                        float height = fast_exp(boxes_ptr[3]) * stride;
+                        float width = math::exp(boxes_ptr[2]) * stride;
+                        float height = math::exp(boxes_ptr[3]) * stride;
 
                         float x0 = x - width * 0.5f;
                         float y0 = y - height * 0.5f;
@@ -2718,7 +2931,7 @@ namespace detection
                 {
                     //process cls score
                     auto max = std::max_element(cls_ptr, cls_ptr + cls_num);
-                    float box_prob = fast_sigmoid(*max);
+                    float box_prob = math::sigmoid(*max);
 
                     if (box_prob > prob_threshold)
                     {
@@ -2763,21 +2976,20 @@ namespace detection
             auto cls_ptr = cls_feat;
             auto boxes_ptr = box_feat;
             int reg_max = 16;
-            float dis_after_sm[reg_max];
 
             for (int h = 0; h < feat_h; h++)
             {
                 for (int w = 0; w < feat_w; w++)
                 {
                     auto max = std::max_element(cls_ptr, cls_ptr + cls_num);
-                    float box_prob = fast_sigmoid(*max);
+                    float box_prob = math::sigmoid(*max);
 
                     if (box_prob > prob_threshold)
                     {
-                        float x0 = w + 0.5f - fast_softmax(boxes_ptr, dis_after_sm, reg_max);
-                        float y0 = h + 0.5f - fast_softmax(boxes_ptr + reg_max, dis_after_sm, reg_max);
-                        float x1 = w + 0.5f + fast_softmax(boxes_ptr + 2 * reg_max, dis_after_sm, reg_max);
-                        float y1 = h + 0.5f + fast_softmax(boxes_ptr + 3 * reg_max, dis_after_sm, reg_max);
+                        float x0 = w + 0.5f - math::dfl(boxes_ptr, reg_max);
+                        float y0 = h + 0.5f - math::dfl(boxes_ptr + reg_max, reg_max);
+                        float x1 = w + 0.5f + math::dfl(boxes_ptr + 2 * reg_max, reg_max);
+                        float y1 = h + 0.5f + math::dfl(boxes_ptr + 3 * reg_max, reg_max);
 
                         x0 *= stride;
                         y0 *= stride;
@@ -2808,232 +3020,337 @@ namespace detection
 
     namespace obb
     {
-        static inline float fast_exp(const float& x)
-        {
-            union
-            {
-                uint32_t i;
-                float f;
-            } v;
-            v.i = (1 << 23) * (1.4426950409 * x + 126.93490512f);
-            return v.f;
-        }
-
         static inline float clamp_(float v, float min = 0.f, float max = std::numeric_limits<float>::infinity())
         {
             return std::max(std::min(v, max), min);
         }
-        static inline void get_covariance_matrix(
-            const std::vector<Object>& objects, 
-            std::vector<cv::Point3f>& covar_maxtirx)
+
+        /* per box terms of probiou as structure of arrays, so kept boxes can be tested in simd lanes */
+        struct RotatedBoxes
         {
-            int n = objects.size();
-            for (size_t i = 0; i < n; ++i) {
-
-                float a = objects[i].rect.width * objects[i].rect.width * 0.0833333333f;
-                float b = objects[i].rect.height * objects[i].rect.height * 0.0833333333f;
-                float c = objects[i].angle;
-                
-                float c_sin = std::sin(c);
-                float c_cos = std::cos(c);
-
-                float x = a * c_cos * c_cos + b * c_sin * c_sin;
-                float y = a * c_sin * c_sin + b * c_cos * c_cos;
-                float z = a * c_cos * c_sin - b * c_sin * c_cos;
-                covar_maxtirx.push_back(cv::Point3f(x, y, z));
+            std::vector<float> cx;
+            std::vector<float> cy;
+            /* covariance (a, b, c), sqrt of its clamped determinant and its trace */
+            std::vector<float> a;
+            std::vector<float> b;
+            std::vector<float> c;
+            std::vector<float> sqrt_det;
+            std::vector<float> trace;
+
+            int size() const
+            {
+                return (int)cx.size();
+            }
+
+            void reserve(size_t n)
+            {
+                cx.reserve(n);
+                cy.reserve(n);
+                a.reserve(n);
+                b.reserve(n);
+                c.reserve(n);
+                sqrt_det.reserve(n);
+                trace.reserve(n);
             }
-        }
 
-        static inline float fast_log2 (float x)
-        {
-            union {
-                float f; 
-                int i;
-            } v;
-            v.f = x;
-            int* const exp_ptr = &v.i;
-            int m  = *exp_ptr;
-            const int log_2 = ((m >> 23) & 255) - 128;
-            m &= ~(255 << 23);
-            m += 127 << 23;
-            *exp_ptr = m;
-            return (((-1.f / 3) * v.f + 2) * v.f - 2.f / 3 + log_2);
-        }
-
-        static inline float fast_log (const float x)
-        {
-            return 0.69314718f * fast_log2 (x);
-        }
-        
-        static inline float probiou(
-            const Object& obj1,
-            const Object& obj2,
-            const cv::Point3f& covar1,
-            const cv::Point3f& covar2)
-        {
-            
-            float v_x1_x2 = covar1.x + covar2.x;
-            float v_y1_y2 = covar1.y + covar2.y;
-            float x1_x2 = obj1.rect.x - obj2.rect.x;
-            float y1_y2 = obj1.rect.y - obj2.rect.y;
-            float dem1 = clamp_(covar1.x * covar1.y - covar1.z * covar1.z);
-            float dem2 = clamp_(covar2.x * covar2.y - covar2.z * covar2.z);
-            float dem_num = v_x1_x2 * v_y1_y2 - (covar1.z + covar2.z) * (covar1.z + covar2.z);
-            
-            float t1 = (v_x1_x2 * y1_y2 * y1_y2 + v_y1_y2 * x1_x2 * x1_x2) / (dem_num + 1e-7) * 0.25f;
-            float t2 = ((covar1.z + covar2.z) * (-x1_x2) * y1_y2) / (dem_num + 1e-7) * 0.5f;
-            float t3 = fast_log(0.25f * dem_num / (std::sqrt(dem1 * dem2) + 1e-7) + 1e-7) * 0.5f;
-           
-            float bd = t1 + t2 + t3;
-            float iou = fast_exp(-clamp_(bd, 1e-7, 100.f));
-            return iou;
+            void push_back(const Object& obj)
+            {
+                float w2 = obj.rect.width * obj.rect.width * 0.0833333333f;
+                float h2 = obj.rect.height * obj.rect.height * 0.0833333333f;
+                float c_sin = std::sin(obj.angle);
+                float c_cos = std::cos(obj.angle);
+                float x = w2 * c_cos * c_cos + h2 * c_sin * c_sin;
+                float y = w2 * c_sin * c_sin + h2 * c_cos * c_cos;
+                float z = w2 * c_cos * c_sin - h2 * c_sin * c_cos;
+
+                cx.push_back(obj.rect.x);
+                cy.push_back(obj.rect.y);
+                a.push_back(x);
+                b.push_back(y);
+                c.push_back(z);
+                sqrt_det.push_back(std::sqrt(clamp_(x * y - z * z)));
+                trace.push_back(w2 + h2);
+            }
+
+            void push_back(const RotatedBoxes& boxes, int i)
+            {
+                cx.push_back(boxes.cx[i]);
+                cy.push_back(boxes.cy[i]);
+                a.push_back(boxes.a[i]);
+                b.push_back(boxes.b[i]);
+                c.push_back(boxes.c[i]);
+                sqrt_det.push_back(boxes.sqrt_det[i]);
+                trace.push_back(boxes.trace[i]);
+            }
+        };
+
+        /* probiou of box i of b1 and box j of b2, in float only so scalar and simd lanes agree */
+        static inline float probiou(const RotatedBoxes& b1, int i, const RotatedBoxes& b2, int j)
+        {
+            float v_x1_x2 = b1.a[i] + b2.a[j];
+            float v_y1_y2 = b1.b[i] + b2.b[j];
+            float v_z1_z2 = b1.c[i] + b2.c[j];
+            float x1_x2 = b1.cx[i] - b2.cx[j];
+            float y1_y2 = b1.cy[i] - b2.cy[j];
+            float dem_num = v_x1_x2 * v_y1_y2 - v_z1_z2 * v_z1_z2;
+            float inv = 1.f / (dem_num + 1e-7f);
+
+            float t1 = (v_x1_x2 * y1_y2 * y1_y2 + v_y1_y2 * x1_x2 * x1_x2) * inv * 0.25f;
+            float t2 = (v_z1_z2 * (-x1_x2) * y1_y2) * inv * 0.5f;
+            float t3 = math::log(0.25f * dem_num / (b1.sqrt_det[i] * b2.sqrt_det[j] + 1e-7f) + 1e-7f) * 0.5f;
+
+            float bd = clamp_(t1 + t2 + t3, 1e-7f, 100.f);
+            return math::exp(-bd);
+        }
+
+        /*
+         * true if box i of boxes would be suppressed by any of kept, i.e. probiou >= threshold.
+         * pairs whose centers are too far apart for the bhattacharyya distance to get below
+         * max_bd are skipped: bd >= |d|^2 / (4 * (trace1 + trace2)).
+         */
+        static inline bool probiou_suppressed(const RotatedBoxes& kept, const RotatedBoxes& boxes, int i, float threshold, float max_bd)
+        {
+            const int n = kept.size();
+            const float reach = 4.f * max_bd;
+            int j = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+            float32x4_t cx = vdupq_n_f32(boxes.cx[i]);
+            float32x4_t cy = vdupq_n_f32(boxes.cy[i]);
+            float32x4_t a1 = vdupq_n_f32(boxes.a[i]);
+            float32x4_t b1 = vdupq_n_f32(boxes.b[i]);
+            float32x4_t c1 = vdupq_n_f32(boxes.c[i]);
+            float32x4_t s1 = vdupq_n_f32(boxes.sqrt_det[i]);
+            float32x4_t tr1 = vdupq_n_f32(boxes.trace[i]);
+            float32x4_t eps = vdupq_n_f32(1e-7f);
+            for (; j + 4 <= n; j += 4)
+            {
+                float32x4_t dx = vsubq_f32(cx, vld1q_f32(&kept.cx[j]));
+                float32x4_t dy = vsubq_f32(cy, vld1q_f32(&kept.cy[j]));
+                float32x4_t d2 = vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+                uint32x4_t near = vcleq_f32(d2, vmulq_n_f32(vaddq_f32(tr1, vld1q_f32(&kept.trace[j])), reach));
+                if (!simd::any_lane(near))
+                    continue;
+
+                float32x4_t vx = vaddq_f32(a1, vld1q_f32(&kept.a[j]));
+                float32x4_t vy = vaddq_f32(b1, vld1q_f32(&kept.b[j]));
+                float32x4_t vz = vaddq_f32(c1, vld1q_f32(&kept.c[j]));
+                float32x4_t dem_num = vsubq_f32(vmulq_f32(vx, vy), vmulq_f32(vz, vz));
+                float32x4_t inv = math::div_ps(vdupq_n_f32(1.f), vaddq_f32(dem_num, eps));
+                float32x4_t t1 = vmulq_n_f32(vmulq_f32(vaddq_f32(vmulq_f32(vmulq_f32(vx, dy), dy), vmulq_f32(vmulq_f32(vy, dx), dx)), inv), 0.25f);
+                float32x4_t t2 = vmulq_n_f32(vmulq_f32(vmulq_f32(vmulq_f32(vz, vnegq_f32(dx)), dy), inv), 0.5f);
+                float32x4_t arg = vaddq_f32(math::div_ps(vmulq_n_f32(dem_num, 0.25f), vaddq_f32(vmulq_f32(s1, vld1q_f32(&kept.sqrt_det[j])), eps)), eps);
+                float32x4_t t3 = vmulq_n_f32(math::log_ps(arg), 0.5f);
+
+                float32x4_t bd = vminq_f32(vmaxq_f32(vaddq_f32(vaddq_f32(t1, t2), t3), eps), vdupq_n_f32(100.f));
+                float32x4_t iou = math::exp_ps(vnegq_f32(bd));
+                uint32x4_t hit = vandq_u32(near, vcgeq_f32(iou, vdupq_n_f32(threshold)));
+                if (simd::any_lane(hit))
+                    return true;
+            }
+#elif defined(AX_SAMPLES_SIMD_SSE)
+            __m128 cx = _mm_set1_ps(boxes.cx[i]);
+            __m128 cy = _mm_set1_ps(boxes.cy[i]);
+            __m128 a1 = _mm_set1_ps(boxes.a[i]);
+            __m128 b1 = _mm_set1_ps(boxes.b[i]);
+            __m128 c1 = _mm_set1_ps(boxes.c[i]);
+            __m128 s1 = _mm_set1_ps(boxes.sqrt_det[i]);
+            __m128 tr1 = _mm_set1_ps(boxes.trace[i]);
+            __m128 eps = _mm_set1_ps(1e-7f);
+            for (; j + 4 <= n; j += 4)
+            {
+                __m128 dx = _mm_sub_ps(cx, _mm_loadu_ps(&kept.cx[j]));
+                __m128 dy = _mm_sub_ps(cy, _mm_loadu_ps(&kept.cy[j]));
+                __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+                __m128 near = _mm_cmple_ps(d2, _mm_mul_ps(_mm_add_ps(tr1, _mm_loadu_ps(&kept.trace[j])), _mm_set1_ps(reach)));
+                if (!_mm_movemask_ps(near))
+                    continue;
+
+                __m128 vx = _mm_add_ps(a1, _mm_loadu_ps(&kept.a[j]));
+                __m128 vy = _mm_add_ps(b1, _mm_loadu_ps(&kept.b[j]));
+                __m128 vz = _mm_add_ps(c1, _mm_loadu_ps(&kept.c[j]));
+                __m128 dem_num = _mm_sub_ps(_mm_mul_ps(vx, vy), _mm_mul_ps(vz, vz));
+                __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), _mm_add_ps(dem_num, eps));
+                __m128 t1 = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(vx, dy), dy), _mm_mul_ps(_mm_mul_ps(vy, dx), dx)), inv), _mm_set1_ps(0.25f));
+                __m128 t2 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(vz, _mm_sub_ps(_mm_setzero_ps(), dx)), dy), inv), _mm_set1_ps(0.5f));
+                __m128 arg = _mm_add_ps(_mm_div_ps(_mm_mul_ps(_mm_set1_ps(0.25f), dem_num), _mm_add_ps(_mm_mul_ps(s1, _mm_loadu_ps(&kept.sqrt_det[j])), eps)), eps);
+                __m128 t3 = _mm_mul_ps(math::log_ps(arg), _mm_set1_ps(0.5f));
+
+                __m128 bd = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_add_ps(t1, t2), t3), eps), _mm_set1_ps(100.f));
+                __m128 iou = math::exp_ps(_mm_sub_ps(_mm_setzero_ps(), bd));
+                __m128 hit = _mm_and_ps(near, _mm_cmpge_ps(iou, _mm_set1_ps(threshold)));
+                if (_mm_movemask_ps(hit))
+                    return true;
+            }
+#endif
+            for (; j < n; j++)
+            {
+                float dx = boxes.cx[i] - kept.cx[j];
+                float dy = boxes.cy[i] - kept.cy[j];
+                if (dx * dx + dy * dy > (boxes.trace[i] + kept.trace[j]) * reach)
+                    continue;
+                if (probiou(boxes, i, kept, j) >= threshold)
+                    return true;
+            }
+            return false;
         }
 
+        /*
+         * greedy rotated nms over proposals sorted by score, a box is kept when its probiou
+         * with every kept box is below (1 - nms_threshold)^2. only kept boxes are compared.
+         */
         static inline void nms_rotated_sorted_bboxes(
-            const std::vector<Object>& objects, 
+            const std::vector<Object>& objects,
             std::vector<int>& picked,
             float nms_threshold)
         {
-            std::vector<cv::Point3f> covar_maxtrix;
-            get_covariance_matrix(objects, covar_maxtrix);
-            
+            picked.clear();
+
             float nms_threshold_ = (1.f - nms_threshold) * (1.f - nms_threshold);
+            /* probiou >= threshold needs bd <= -ln(threshold), the margin covers rounding of the float terms */
+            float max_bd = -std::log(std::max(nms_threshold_, 1e-30f)) + 0.1f;
             int n = objects.size();
-            
-            for (size_t i = 0; i < n; ++i) {
-                float max_iou = 0.f;
-                const Object& obj1 = objects[i];
-
-                for (size_t j = 0; j < i; ++j) {
-                    const Object& obj2 = objects[j];
-                    
-                    float iou = probiou(obj1, obj2, covar_maxtrix[i], covar_maxtrix[j]);
-                    if (iou > max_iou){
-                        max_iou = iou;
-                    }
-                    
-                }
-                if (max_iou < nms_threshold_)
+
+            RotatedBoxes boxes;
+            boxes.reserve(n);
+            for (int i = 0; i < n; ++i)
+            {
+                boxes.push_back(objects[i]);
+            }
+
+            RotatedBoxes kept;
+            kept.reserve(std::min(n, 256));
+            for (int i = 0; i < n; ++i)
+            {
+                if (!probiou_suppressed(kept, boxes, i, nms_threshold_, max_bd))
+                {
                     picked.push_back(i);
+                    kept.push_back(boxes, i);
+                }
             }
         }
-        static void get_out_obb_bbox(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+
+        static void get_out_obb_bbox(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, const letterbox::LetterboxTransform& transform, int top_k = -1)
         {
-            qsort_descent_inplace(proposals);
+            sort_top_k(proposals, top_k);
             std::vector<int> picked;
             obb::nms_rotated_sorted_bboxes(proposals, picked, nms_threshold);
-            
-            /* yolov5 draw the result */
-            float scale_letterbox;
-            int resize_rows;
-            int resize_cols;
-            if ((letterbox_rows * 1.0 / src_rows) < (letterbox_cols * 1.0 / src_cols))
-            {
-                scale_letterbox = letterbox_rows * 1.0 / src_rows;
-            }
-            else
-            {
-                scale_letterbox = letterbox_cols * 1.0 / src_cols;
-            }
-            resize_cols = int(scale_letterbox * src_cols);
-            resize_rows = int(scale_letterbox * src_rows);
-
-            int tmp_h = (letterbox_rows - resize_rows) / 2;
-            int tmp_w = (letterbox_cols - resize_cols) / 2;
-
-            float ratio_x = (float)src_rows / resize_rows;
-            float ratio_y = (float)src_cols / resize_cols;
 
             int count = picked.size();
             double pi = M_PI;
             double pi_2 = M_PI_2;
             objects.resize(count);
-            for (int i = 0; i < count; i++) {
+
+            /* long side first, then centers and sizes of all survivors mapped in one pass */
+            letterbox::PointBuffer centers;
+            std::vector<float> w(count), h(count);
+            centers.x.reserve(count);
+            centers.y.reserve(count);
+            for (int i = 0; i < count; i++)
+            {
                 objects[i] = proposals[picked[i]];
-                
-                float w_ = objects[i].rect.width > objects[i].rect.height ? objects[i].rect.width : objects[i].rect.height;
-                float h_ = objects[i].rect.width > objects[i].rect.height ? objects[i].rect.height : objects[i].rect.width;
-                float a_ = (float)std::fmod((objects[i].rect.width > objects[i].rect.height ? objects[i].angle : objects[i].angle + pi_2), pi);
-
-                float xc = (objects[i].rect.x - tmp_w) * ratio_x;
-                float yc = (objects[i].rect.y - tmp_h) * ratio_y;
-                float w = w_ * ratio_x;
-                float h = h_ * ratio_y;
-
-                // clip
-                xc = std::max(std::min(xc, (float)(src_cols - 1)), 0.f);
-                yc = std::max(std::min(yc, (float)(src_rows - 1)), 0.f);
-                w = std::max(std::min(w, (float)(src_cols - 1)), 0.f);
-                h = std::max(std::min(h, (float)(src_rows - 1)), 0.f);
-
-
-                objects[i].rect.x = xc;
-                objects[i].rect.y = yc;
-                objects[i].rect.width = w;
-                objects[i].rect.height = h;
-                objects[i].angle = a_;
+
+                bool landscape = objects[i].rect.width > objects[i].rect.height;
+                w[i] = landscape ? objects[i].rect.width : objects[i].rect.height;
+                h[i] = landscape ? objects[i].rect.height : objects[i].rect.width;
+                objects[i].angle = (float)std::fmod((landscape ? objects[i].angle : objects[i].angle + pi_2), pi);
+                centers.push_back(objects[i].rect.x, objects[i].rect.y);
+            }
+            centers.end_clipped();
+            centers.map(transform);
+            letterbox::map_sizes(transform, w.data(), h.data(), count);
+
+            for (int i = 0; i < count; i++)
+            {
+                objects[i].rect.x = centers.x[i];
+                objects[i].rect.y = centers.y[i];
+                objects[i].rect.width = w[i];
+                objects[i].rect.height = h[i];
             }
         }
+
+        static void get_out_obb_bbox(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols, int top_k = -1)
+        {
+            get_out_obb_bbox(proposals, objects, nms_threshold, letterbox::make(src_rows, src_cols, letterbox_rows, letterbox_cols), top_k);
+        }
         static void generate_proposals_yolov8_obb_native(const std::vector<GridAndStride>& grid_strides, const float* feat, float prob_threshold, std::vector<Object>& objects,
                                                  int letterbox_cols, int letterbox_rows, int cls_num = 15)
         {
             const int num_points = grid_strides.size();
             int reg_max = 16;
-            auto feat_ptr = feat;
-            std::vector<float> dis_after_sm(reg_max, 0.f);
-            for (int i = 0; i < num_points; i++)
-            {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
+
+            auto head = make_anchor_free_head(feat + 4 * reg_max, cls_num + 4 * reg_max + 1, feat, cls_num + 4 * reg_max + 1, cls_num, reg_max);
+            decode_anchor_free_head(head, num_points, prob_threshold, [&](int i, int class_index, float box_prob, const float* ltrb) {
+                const GridAndStride& gs = grid_strides[i];
+                float pred_ltrb[4];
+                for (int k = 0; k < 4; k++)
                 {
-                    float score = feat_ptr[s + 4 * reg_max];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
+                    pred_ltrb[k] = ltrb[k] * gs.stride;
                 }
 
-                float box_prob = sigmoid(class_score);
-                if (box_prob > prob_threshold)
-                {
-                    float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * grid_strides[i].stride;
-                    }
+                float angle = feat[i * (cls_num + 4 * reg_max + 1) + 4 * reg_max + cls_num];
 
-                    float angle = feat_ptr[4 * reg_max + cls_num];
+                float pb_cx = (gs.grid0 + 0.5f) * gs.stride;
+                float pb_cy = (gs.grid1 + 0.5f) * gs.stride;
 
-                    float pb_cx = (grid_strides[i].grid0 + 0.5f) * grid_strides[i].stride;
-                    float pb_cy = (grid_strides[i].grid1 + 0.5f) * grid_strides[i].stride;
+                float cos = std::cos(angle);
+                float sin = std::sin(angle);
 
-                    float cos = std::cos(angle);
-                    float sin = std::sin(angle);
+                float x = (pred_ltrb[2] - pred_ltrb[0]) * 0.5f;
+                float y = (pred_ltrb[3] - pred_ltrb[1]) * 0.5f;
+                float xc = x * cos - y * sin + pb_cx;
+                float yc = x * sin + y * cos + pb_cy;
+                float w = pred_ltrb[2] + pred_ltrb[0];
+                float h = pred_ltrb[3] + pred_ltrb[1];
 
-                    float x = (pred_ltrb[2] - pred_ltrb[0]) * 0.5f;
-                    float y = (pred_ltrb[3] - pred_ltrb[1]) * 0.5f;
-                    float xc = x * cos - y * sin + pb_cx;
-                    float yc = x * sin + y * cos + pb_cy;
-                    float w = pred_ltrb[2] + pred_ltrb[0];
-                    float h = pred_ltrb[3] + pred_ltrb[1];
+                Object obj;
+                obj.rect.x = xc; //center x
+                obj.rect.y = yc; //center y
+                obj.rect.width = w;
+                obj.rect.height = h;
+                obj.label = class_index;
+                obj.prob = box_prob;
+                obj.angle = angle;
 
-                    Object obj;
-                    obj.rect.x = xc; //center x
-                    obj.rect.y = yc; //center y
-                    obj.rect.width = w;
-                    obj.rect.height = h;
-                    obj.label = class_index;
-                    obj.prob = box_prob;
-                    obj.angle = angle;
+                objects.push_back(obj);
+            });
+        }
 
-                    objects.push_back(obj);
+        /* generate_proposals_yolov8_obb_native with the cell centers of decode::build_grid_plan */
+        static void generate_proposals_yolov8_obb_native(const decode::DecodePlan& plan, const float* feat, float prob_threshold, std::vector<Object>& objects,
+                                                         int letterbox_cols, int letterbox_rows, int cls_num = 15)
+        {
+            const int num_points = plan.size();
+            const int reg_max = 16;
+            const int cell_step = cls_num + 4 * reg_max + 1;
+
+            auto head = make_anchor_free_head(feat + 4 * reg_max, cell_step, feat, cell_step, cls_num, reg_max);
+            decode_anchor_free_head(head, num_points, prob_threshold, [&](int i, int class_index, float box_prob, const float* ltrb) {
+                const float stride = plan.stride[i];
+                float pred_ltrb[4];
+                for (int k = 0; k < 4; k++)
+                {
+                    pred_ltrb[k] = ltrb[k] * stride;
                 }
-                feat_ptr += (cls_num + 4 * reg_max + 1);
-            }
+
+                float angle = feat[i * cell_step + 4 * reg_max + cls_num];
+
+                float cos = std::cos(angle);
+                float sin = std::sin(angle);
+
+                float x = (pred_ltrb[2] - pred_ltrb[0]) * 0.5f;
+                float y = (pred_ltrb[3] - pred_ltrb[1]) * 0.5f;
+
+                Object obj;
+                obj.rect.x = x * cos - y * sin + plan.cx[i]; //center x
+                obj.rect.y = x * sin + y * cos + plan.cy[i]; //center y
+                obj.rect.width = pred_ltrb[2] + pred_ltrb[0];
+                obj.rect.height = pred_ltrb[3] + pred_ltrb[1];
+                obj.label = class_index;
+                obj.prob = box_prob;
+                obj.angle = angle;
+
+                objects.push_back(obj);
+            });
         }
         static void draw_objects_obb(const cv::Mat& bgr, const std::vector<Object>& objects, const char** class_names, const char* output_name, int thickness = 1)
         {
@@ -3076,7 +3393,6 @@ namespace detection
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
         auto feat_ptr = feat;
-        float dis[16];
         for (int h = 0; h <= feat_h - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
@@ -3096,10 +3412,10 @@ namespace detection
 
                 if(c_score >= prob_threshold)
                 {
-                    float x0 = w + 0.5f - mmyolo::fast_softmax(feat_ptr + cls_num  +  0 * 16,dis, 16);
-                    float y0 = h + 0.5f - mmyolo::fast_softmax(feat_ptr + cls_num  +  1 * 16,dis, 16);
-                    float x1 = w + 0.5f + mmyolo::fast_softmax(feat_ptr + cls_num  +  2 * 16,dis, 16);
-                    float y1 = h + 0.5f + mmyolo::fast_softmax(feat_ptr + cls_num  +  3 * 16,dis, 16);
+                    float x0 = w + 0.5f - math::dfl(feat_ptr + cls_num + 0 * 16, 16);
+                    float y0 = h + 0.5f - math::dfl(feat_ptr + cls_num + 1 * 16, 16);
+                    float x1 = w + 0.5f + math::dfl(feat_ptr + cls_num + 2 * 16, 16);
+                    float y1 = h + 0.5f + math::dfl(feat_ptr + cls_num + 3 * 16, 16);
 
                     x0 *= stride;
                     y0 *= stride;
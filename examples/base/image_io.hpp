@@ -0,0 +1,200 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "utilities/file.hpp"
+#include "utilities/timer.hpp"
+
+/*
+ * image loading for batch samples: large jpegs are decoded at 1/2, 1/4 or 1/8 scale
+ * (libjpeg dct scaling through IMREAD_REDUCED_COLOR_*) when that is still at least the
+ * model input size, the file content is kept to decode at full size on demand.
+ */
+namespace image_io
+{
+    typedef struct JpegInfo
+    {
+        int width;
+        int height;
+        int components;
+    } JpegInfo;
+
+    /* size from the SOF segment, false if data is not a jpeg or ends before the SOF */
+    static bool read_jpeg_info(const uint8_t* data, size_t size, JpegInfo& info)
+    {
+        if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+            return false;
+
+        size_t pos = 2;
+        while (pos + 4 <= size)
+        {
+            if (data[pos] != 0xFF)
+                return false;
+            uint8_t marker = data[pos + 1];
+            if (marker == 0xFF)
+            {
+                // fill byte
+                pos++;
+                continue;
+            }
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+            {
+                pos += 2;
+                continue;
+            }
+            // scan data or end of image before any frame header
+            if (marker == 0xDA || marker == 0xD9)
+                return false;
+
+            size_t length = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+            if (length < 2 || pos + 2 + length > size)
+                return false;
+
+            // SOF0 - SOF15, except DHT, JPG and DAC which share the range
+            if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            {
+                if (length < 8)
+                    return false;
+                const uint8_t* sof = data + pos + 4;
+                info.height = (sof[1] << 8) | sof[2];
+                info.width = (sof[3] << 8) | sof[4];
+                info.components = sof[5];
+                return info.width > 0 && info.height > 0;
+            }
+            pos += 2 + length;
+        }
+        return false;
+    }
+
+    /*
+     * largest of 8, 4, 2 that keeps the letterboxed content at least as large as in a full
+     * decode, 1 if none does. checked for both orientations since imread applies the exif one.
+     */
+    static int reduction_factor(int width, int height, int target_h, int target_w)
+    {
+        if (target_h <= 0 || target_w <= 0)
+            return 1;
+
+        // a letterbox to target_w x target_h scales by 1 / max(width / target_w, height / target_h)
+        float limit = std::min(std::max((float)width / target_w, (float)height / target_h),
+                               std::max((float)height / target_w, (float)width / target_h));
+        for (int factor = 8; factor > 1; factor /= 2)
+        {
+            if ((float)factor <= limit)
+                return factor;
+        }
+        return 1;
+    }
+
+    static inline int reduced_flag(int factor)
+    {
+        switch (factor)
+        {
+        case 2:
+            return cv::IMREAD_REDUCED_COLOR_2;
+        case 4:
+            return cv::IMREAD_REDUCED_COLOR_4;
+        case 8:
+            return cv::IMREAD_REDUCED_COLOR_8;
+        default:
+            return cv::IMREAD_COLOR;
+        }
+    }
+
+    typedef struct Image
+    {
+        cv::Mat mat;               // decoded bgr, reduced by factor
+        std::vector<char> data;    // file content, for full()
+        int full_width;
+        int full_height;
+        int factor;
+        float decode_ms;
+    } Image;
+
+    /*
+     * reads path and decodes it at the largest reduction that still covers a target_h x target_w
+     * letterbox, target 0 decodes at full size. non jpeg files are always decoded at full size.
+     */
+    static bool read(const std::string& path, int target_h, int target_w, Image& image)
+    {
+        image.data.clear();
+        if (!utilities::read_file(path, image.data) || image.data.empty())
+            return false;
+
+        timer timer_decode;
+        JpegInfo info;
+        image.factor = 1;
+        if (read_jpeg_info((const uint8_t*)image.data.data(), image.data.size(), info))
+            image.factor = reduction_factor(info.width, info.height, target_h, target_w);
+
+        cv::Mat encoded(1, (int)image.data.size(), CV_8UC1, image.data.data());
+        image.mat = cv::imdecode(encoded, reduced_flag(image.factor));
+        if (image.mat.empty() && image.factor != 1)
+        {
+            // decoders without dct scaling
+            image.factor = 1;
+            image.mat = cv::imdecode(encoded, cv::IMREAD_COLOR);
+        }
+        image.decode_ms = timer_decode.cost();
+        if (image.mat.empty())
+            return false;
+
+        // the reduced size is rounded up, take the full one from the header (rotated by exif if needed)
+        image.full_width = image.mat.cols * image.factor;
+        image.full_height = image.mat.rows * image.factor;
+        if (image.factor != 1)
+        {
+            bool rotated = (image.mat.cols > image.mat.rows) != (info.width > info.height);
+            image.full_width = rotated ? info.height : info.width;
+            image.full_height = rotated ? info.width : info.height;
+        }
+        return true;
+    }
+
+    /* full size decode, the reduced mat itself if it was not reduced */
+    static cv::Mat full(const Image& image)
+    {
+        if (image.factor == 1)
+            return image.mat;
+        cv::Mat encoded(1, (int)image.data.size(), CV_8UC1, (void*)image.data.data());
+        return cv::imdecode(encoded, cv::IMREAD_COLOR);
+    }
+
+    /* rect on image.mat to the same area of full(image), clipped to it */
+    template<typename T>
+    static cv::Rect_<T> to_full(const Image& image, const cv::Rect_<T>& rect)
+    {
+        if (image.factor == 1)
+            return rect;
+        float sx = (float)image.full_width / image.mat.cols;
+        float sy = (float)image.full_height / image.mat.rows;
+        float x0 = std::max(rect.x * sx, 0.f);
+        float y0 = std::max(rect.y * sy, 0.f);
+        float x1 = std::min((rect.x + rect.width) * sx, (float)image.full_width);
+        float y1 = std::min((rect.y + rect.height) * sy, (float)image.full_height);
+        return cv::Rect_<T>((T)x0, (T)y0, (T)std::max(x1 - x0, 0.f), (T)std::max(y1 - y0, 0.f));
+    }
+} // namespace image_io
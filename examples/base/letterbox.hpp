@@ -0,0 +1,176 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+#include "base/simd.hpp"
+
+namespace letterbox
+{
+    /*
+     * mapping between the model input and the source image, filled once by the
+     * preprocessing and carried with the frame: src = (dst - pad) * scale
+     */
+    typedef struct LetterboxTransform
+    {
+        float scale_x;
+        float scale_y;
+        int pad_x;
+        int pad_y;
+        int resize_w;
+        int resize_h;
+        int src_w;
+        int src_h;
+        int dst_w;
+        int dst_h;
+    } LetterboxTransform;
+
+    /* same rounding as common::get_input_data_letterbox */
+    static inline LetterboxTransform make(int src_rows, int src_cols, int letterbox_rows, int letterbox_cols)
+    {
+        float scale_letterbox;
+        if ((letterbox_rows * 1.0 / src_rows) < (letterbox_cols * 1.0 / src_cols))
+        {
+            scale_letterbox = letterbox_rows * 1.0 / src_rows;
+        }
+        else
+        {
+            scale_letterbox = letterbox_cols * 1.0 / src_cols;
+        }
+
+        LetterboxTransform t;
+        t.resize_w = int(scale_letterbox * src_cols);
+        t.resize_h = int(scale_letterbox * src_rows);
+        t.pad_x = (letterbox_cols - t.resize_w) / 2;
+        t.pad_y = (letterbox_rows - t.resize_h) / 2;
+        t.scale_x = (float)src_cols / t.resize_w;
+        t.scale_y = (float)src_rows / t.resize_h;
+        t.src_w = src_cols;
+        t.src_h = src_rows;
+        t.dst_w = letterbox_cols;
+        t.dst_h = letterbox_rows;
+        return t;
+    }
+
+    /* plain resize without border, as common::get_input_data_no_letterbox */
+    static inline LetterboxTransform make_stretch(int src_rows, int src_cols, int model_h, int model_w)
+    {
+        LetterboxTransform t;
+        t.resize_w = model_w;
+        t.resize_h = model_h;
+        t.pad_x = 0;
+        t.pad_y = 0;
+        t.scale_x = (float)src_cols / (float)model_w;
+        t.scale_y = (float)src_rows / (float)model_h;
+        t.src_w = src_cols;
+        t.src_h = src_rows;
+        t.dst_w = model_w;
+        t.dst_h = model_h;
+        return t;
+    }
+
+    // x[i], y[i] from model input to source coordinates, clipped to the image if clip
+    static inline void map_points(const LetterboxTransform& t, float* x, float* y, int n, bool clip)
+    {
+        const float pad_x = (float)t.pad_x;
+        const float pad_y = (float)t.pad_y;
+        const float max_x = clip ? (float)(t.src_w - 1) : FLT_MAX;
+        const float max_y = clip ? (float)(t.src_h - 1) : FLT_MAX;
+        const float min_v = clip ? 0.f : -FLT_MAX;
+        int i = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+        float32x4_t vpx = vdupq_n_f32(pad_x), vpy = vdupq_n_f32(pad_y);
+        float32x4_t vsx = vdupq_n_f32(t.scale_x), vsy = vdupq_n_f32(t.scale_y);
+        float32x4_t vmx = vdupq_n_f32(max_x), vmy = vdupq_n_f32(max_y), vmin = vdupq_n_f32(min_v);
+        for (; i + 4 <= n; i += 4)
+        {
+            float32x4_t vx = vmulq_f32(vsubq_f32(vld1q_f32(x + i), vpx), vsx);
+            float32x4_t vy = vmulq_f32(vsubq_f32(vld1q_f32(y + i), vpy), vsy);
+            vst1q_f32(x + i, vmaxq_f32(vminq_f32(vx, vmx), vmin));
+            vst1q_f32(y + i, vmaxq_f32(vminq_f32(vy, vmy), vmin));
+        }
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        __m128 vpx = _mm_set1_ps(pad_x), vpy = _mm_set1_ps(pad_y);
+        __m128 vsx = _mm_set1_ps(t.scale_x), vsy = _mm_set1_ps(t.scale_y);
+        __m128 vmx = _mm_set1_ps(max_x), vmy = _mm_set1_ps(max_y), vmin = _mm_set1_ps(min_v);
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 vx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x + i), vpx), vsx);
+            __m128 vy = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(y + i), vpy), vsy);
+            _mm_storeu_ps(x + i, _mm_max_ps(_mm_min_ps(vx, vmx), vmin));
+            _mm_storeu_ps(y + i, _mm_max_ps(_mm_min_ps(vy, vmy), vmin));
+        }
+#endif
+        for (; i < n; i++)
+        {
+            x[i] = std::max(std::min((x[i] - pad_x) * t.scale_x, max_x), min_v);
+            y[i] = std::max(std::min((y[i] - pad_y) * t.scale_y, max_y), min_v);
+        }
+    }
+
+    // sizes only scale, clipped to the image like the box corners
+    static inline void map_sizes(const LetterboxTransform& t, float* w, float* h, int n)
+    {
+        const float max_x = (float)(t.src_w - 1);
+        const float max_y = (float)(t.src_h - 1);
+        for (int i = 0; i < n; i++)
+        {
+            w[i] = std::max(std::min(w[i] * t.scale_x, max_x), 0.f);
+            h[i] = std::max(std::min(h[i] * t.scale_y, max_y), 0.f);
+        }
+    }
+
+    /*
+     * structure of arrays for all survivors of a frame: clipped points (box corners,
+     * keypoints, obb centers) first, unclipped points (landmarks) after them, so the
+     * whole frame is mapped by two calls without per object branching
+     */
+    typedef struct PointBuffer
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+        int clipped = 0;
+
+        void clear()
+        {
+            x.clear();
+            y.clear();
+            clipped = 0;
+        }
+
+        void push_back(float px, float py)
+        {
+            x.push_back(px);
+            y.push_back(py);
+        }
+
+        /* everything pushed so far gets clipped */
+        void end_clipped()
+        {
+            clipped = (int)x.size();
+        }
+
+        void map(const LetterboxTransform& t)
+        {
+            map_points(t, x.data(), y.data(), clipped, true);
+            map_points(t, x.data() + clipped, y.data() + clipped, (int)x.size() - clipped, false);
+        }
+    } PointBuffer;
+} // namespace letterbox
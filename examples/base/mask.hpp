@@ -0,0 +1,401 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace mask
+{
+    enum
+    {
+        MASK_TILE = 64,
+        MASK_BLOCK = 4,
+    };
+
+    /*
+     * acc[j][x - x0] = sum over k of c[j][k] * row[k * plane + x] for x in [lo, hi), k in order.
+     * eight columns of the J instances stay in registers over the whole k loop, every proto
+     * value loaded is used J times.
+     */
+    template<int J>
+    static inline void mask_logits(const float* const* c, const float* row, size_t plane, int dim, int lo, int hi, int x0, float (*acc)[MASK_TILE])
+    {
+        int x = lo;
+        for (; x + 8 <= hi; x += 8)
+        {
+            float a[J][8] = {};
+            for (int k = 0; k < dim; k++)
+            {
+                const float* p = row + k * plane + x;
+                for (int j = 0; j < J; j++)
+                {
+                    const float cj = c[j][k];
+                    for (int l = 0; l < 8; l++)
+                    {
+                        a[j][l] += cj * p[l];
+                    }
+                }
+            }
+            for (int j = 0; j < J; j++)
+            {
+                std::copy(a[j], a[j] + 8, acc[j] + (x - x0));
+            }
+        }
+        for (; x < hi; x++)
+        {
+            for (int j = 0; j < J; j++)
+            {
+                float a = 0.f;
+                for (int k = 0; k < dim; k++)
+                {
+                    a += c[j][k] * row[k * plane + x];
+                }
+                acc[j][x - x0] = a;
+            }
+        }
+    }
+
+    // columns [lo, hi) of row y of the mask of roi, logits[x - lo] is the logit of column x
+    static inline void store_mask_row(const float* logits, int lo, int hi, int y, const cv::Rect& roi, cv::Mat& mask)
+    {
+        uint8_t* dst = mask.ptr<uint8_t>(y - roi.y) + (lo - roi.x);
+        for (int i = 0; i < hi - lo; i++)
+        {
+            dst[i] = logits[i] > 0.f ? 255 : 0;
+        }
+    }
+
+    // an instance on a tile, [lo, hi) are the columns of the tile it covers
+    struct MaskHit
+    {
+        int lo, hi, index;
+    };
+
+    /*
+     * instance masks of a prototype head (yolov5-seg / yolov8-seg / yolo11-seg).
+     * logits = coeffs (n x dim) * proto (dim x proto_h * proto_w), evaluated only inside rois[i].
+     * the product is blocked: every proto row is cut into tiles of MASK_TILE columns over the
+     * union of the rois on that row, and a tile (dim x MASK_TILE floats) stays in l1 while it is
+     * multiplied with the coefficients of MASK_BLOCK instances at a time (mask_logits), the
+     * instances left over go one at a time on the same tile. a proto value is read from memory
+     * once per frame however many instances cover it. every logit sums k in order, as a per
+     * instance loop does. sigmoid(x) > 0.5 <=> x > 0, masks[i] is a CV_8UC1 0 / 255 mask of
+     * rois[i] size at proto resolution.
+     */
+    static inline void assemble_masks(const float* coeffs, int n, const float* proto, int dim, int proto_h, int proto_w,
+                                      const std::vector<cv::Rect>& rois, std::vector<cv::Mat>& masks)
+    {
+        const size_t plane = (size_t)proto_h * proto_w;
+
+        masks.resize(n);
+        for (int i = 0; i < n; i++)
+        {
+            if (rois[i].width <= 0 || rois[i].height <= 0)
+                masks[i] = cv::Mat();
+            else
+                masks[i].create(rois[i].height, rois[i].width, CV_8UC1);
+        }
+
+        std::vector<int> rows;
+        std::vector<MaskHit> hits;
+        rows.reserve(n);
+        hits.reserve(n);
+        float acc[MASK_BLOCK][MASK_TILE];
+        for (int y = 0; y < proto_h; y++)
+        {
+            // the instances on this row and the union of their columns
+            rows.clear();
+            int x_lo = proto_w, x_hi = 0;
+            for (int i = 0; i < n; i++)
+            {
+                const cv::Rect& roi = rois[i];
+                if (roi.width > 0 && y >= roi.y && y < roi.y + roi.height)
+                {
+                    rows.push_back(i);
+                    x_lo = std::min(x_lo, roi.x);
+                    x_hi = std::max(x_hi, roi.x + roi.width);
+                }
+            }
+
+            const float* row = proto + (size_t)y * proto_w;
+            for (int x0 = x_lo; x0 < x_hi; x0 += MASK_TILE)
+            {
+                const int x1 = std::min(x0 + MASK_TILE, x_hi);
+                hits.clear();
+                for (int i : rows)
+                {
+                    const int lo = std::max(x0, rois[i].x);
+                    const int hi = std::min(x1, rois[i].x + rois[i].width);
+                    if (lo < hi)
+                        hits.push_back({lo, hi, i});
+                }
+                // instances with alike column ranges share a block, a block computes the union of them
+                if (hits.size() > MASK_BLOCK)
+                {
+                    std::sort(hits.begin(), hits.end(), [](const MaskHit& a, const MaskHit& b) {
+                        return a.lo != b.lo ? a.lo < b.lo : a.hi < b.hi;
+                    });
+                }
+
+                size_t h = 0;
+                for (; h + MASK_BLOCK <= hits.size(); h += MASK_BLOCK)
+                {
+                    int lo = x1, hi = x0;
+                    const float* c[MASK_BLOCK];
+                    for (int j = 0; j < MASK_BLOCK; j++)
+                    {
+                        lo = std::min(lo, hits[h + j].lo);
+                        hi = std::max(hi, hits[h + j].hi);
+                        c[j] = coeffs + (size_t)hits[h + j].index * dim;
+                    }
+                    mask_logits<MASK_BLOCK>(c, row, plane, dim, lo, hi, x0, acc);
+                    for (int j = 0; j < MASK_BLOCK; j++)
+                    {
+                        const MaskHit& hit = hits[h + j];
+                        store_mask_row(acc[j] + (hit.lo - x0), hit.lo, hit.hi, y, rois[hit.index], masks[hit.index]);
+                    }
+                }
+                for (; h < hits.size(); h++)
+                {
+                    const MaskHit& hit = hits[h];
+                    const float* c = coeffs + (size_t)hit.index * dim;
+                    mask_logits<1>(&c, row, plane, dim, hit.lo, hit.hi, x0, acc);
+                    store_mask_row(acc[0] + (hit.lo - x0), hit.lo, hit.hi, y, rois[hit.index], masks[hit.index]);
+                }
+            }
+        }
+    }
+
+    // resizes a 0 / 255 mask, INTER_NEAREST keeps it binary, INTER_LINEAR is re-thresholded at half
+    static inline void upsample_mask(const cv::Mat& src, cv::Mat& dst, cv::Size size, int interpolation = cv::INTER_LINEAR)
+    {
+        if (size.width <= 0 || size.height <= 0)
+        {
+            dst = cv::Mat();
+            return;
+        }
+        if (src.empty())
+        {
+            dst = cv::Mat::zeros(size, CV_8UC1);
+            return;
+        }
+
+        if (interpolation == cv::INTER_NEAREST)
+        {
+            cv::resize(src, dst, size, 0, 0, cv::INTER_NEAREST);
+            return;
+        }
+
+        cv::Mat resized;
+        cv::resize(src, resized, size, 0, 0, cv::INTER_LINEAR);
+        dst = resized > 127;
+    }
+
+    enum Format
+    {
+        FORMAT_MAT = 0,
+        FORMAT_PACKED = 1,
+    };
+
+    /* 1 bit per pixel, bit (x % 8) of byte x / 8 in every row, rows padded to whole bytes */
+    typedef struct PackedMask
+    {
+        int width = 0;
+        int height = 0;
+        int stride = 0;
+        std::vector<uint8_t> bits;
+
+        bool empty() const
+        {
+            return width <= 0 || height <= 0;
+        }
+
+        const uint8_t* row(int y) const
+        {
+            return bits.data() + (size_t)y * stride;
+        }
+    } PackedMask;
+
+    /* coco style rle: column major runs, alternating 0 / 1 and starting with a (maybe empty) run of 0 */
+    typedef struct RleMask
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<uint32_t> counts;
+    } RleMask;
+
+    /* bit x of the packed row is set where src[x] > 127 */
+    static inline void pack_row(const uint8_t* src, int width, uint8_t* dst)
+    {
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            uint8_t b = 0;
+            for (int k = 0; k < 8; k++)
+            {
+                b |= (src[x + k] > 127) << k;
+            }
+            dst[x >> 3] = b;
+        }
+        if (x < width)
+        {
+            uint8_t b = 0;
+            for (int k = 0; x + k < width; k++)
+            {
+                b |= (src[x + k] > 127) << k;
+            }
+            dst[x >> 3] = b;
+        }
+    }
+
+    /*
+     * same pixels as the cv::Mat upsample_mask, bit for bit: cv::resize writes into scratch and
+     * the rows are thresholded while they are packed. scratch is reused across the instances of
+     * a frame, so one full resolution byte mask exists at a time instead of one per instance.
+     */
+    static inline void upsample_mask(const cv::Mat& src, PackedMask& dst, cv::Size size, int interpolation, cv::Mat& scratch)
+    {
+        dst.width = std::max(size.width, 0);
+        dst.height = std::max(size.height, 0);
+        dst.stride = (dst.width + 7) / 8;
+        dst.bits.assign((size_t)dst.stride * dst.height, 0);
+        if (dst.empty() || src.empty())
+            return;
+
+        // INTER_NEAREST gives 0 / 255, INTER_LINEAR is thresholded at half like the cv::Mat path
+        cv::resize(src, scratch, size, 0, 0, interpolation == cv::INTER_NEAREST ? cv::INTER_NEAREST : cv::INTER_LINEAR);
+        for (int y = 0; y < dst.height; y++)
+        {
+            pack_row(scratch.ptr<uint8_t>(y), dst.width, dst.bits.data() + (size_t)y * dst.stride);
+        }
+    }
+
+    static inline void upsample_mask(const cv::Mat& src, PackedMask& dst, cv::Size size, int interpolation = cv::INTER_LINEAR)
+    {
+        cv::Mat scratch;
+        upsample_mask(src, dst, size, interpolation, scratch);
+    }
+
+    static inline bool bit(const PackedMask& mask, int x, int y)
+    {
+        return (mask.row(y)[x >> 3] >> (x & 7)) & 1;
+    }
+
+    static inline void decode(const PackedMask& src, cv::Mat& dst)
+    {
+        if (src.empty())
+        {
+            dst = cv::Mat();
+            return;
+        }
+        dst.create(src.height, src.width, CV_8UC1);
+        for (int y = 0; y < src.height; y++)
+        {
+            const uint8_t* bits = src.row(y);
+            uint8_t* d = dst.ptr<uint8_t>(y);
+            for (int x = 0; x < src.width; x++)
+            {
+                d[x] = ((bits[x >> 3] >> (x & 7)) & 1) ? 255 : 0;
+            }
+        }
+    }
+
+    static inline void encode_rle(const PackedMask& src, RleMask& dst)
+    {
+        dst.width = src.width;
+        dst.height = src.height;
+        dst.counts.clear();
+
+        bool value = false;
+        uint32_t run = 0;
+        for (int x = 0; x < src.width; x++)
+        {
+            for (int y = 0; y < src.height; y++)
+            {
+                if (bit(src, x, y) != value)
+                {
+                    dst.counts.push_back(run);
+                    value = !value;
+                    run = 0;
+                }
+                run++;
+            }
+        }
+        dst.counts.push_back(run);
+    }
+
+    static inline void decode(const RleMask& src, PackedMask& dst)
+    {
+        dst.width = src.width;
+        dst.height = src.height;
+        dst.stride = (src.width + 7) / 8;
+        dst.bits.assign((size_t)dst.stride * dst.height, 0);
+
+        size_t pos = 0;
+        const size_t total = (size_t)src.width * src.height;
+        for (size_t r = 0; r < src.counts.size() && pos < total; r++)
+        {
+            size_t end = std::min(pos + src.counts[r], total);
+            if (r & 1)
+            {
+                for (size_t p = pos; p < end; p++)
+                {
+                    int x = (int)(p / src.height);
+                    int y = (int)(p % src.height);
+                    dst.bits[(size_t)y * dst.stride + (x >> 3)] |= 1 << (x & 7);
+                }
+            }
+            pos = end;
+        }
+    }
+
+    /* paints color into the CV_8UC3 image where the mask is set, mask pixel (0, 0) lands on offset */
+    static inline void blit(const PackedMask& src, cv::Mat& image, cv::Point offset, const std::vector<uint8_t>& color)
+    {
+        int x_begin = std::max(0, -offset.x);
+        int y_begin = std::max(0, -offset.y);
+        int x_end = std::min(src.width, image.cols - offset.x);
+        int y_end = std::min(src.height, image.rows - offset.y);
+        for (int y = y_begin; y < y_end; y++)
+        {
+            const uint8_t* bits = src.row(y);
+            uint8_t* d = image.ptr<uint8_t>(y + offset.y);
+            for (int x = x_begin; x < x_end;)
+            {
+                // skip empty bytes eight pixels at a time
+                if ((x & 7) == 0 && bits[x >> 3] == 0)
+                {
+                    x += 8;
+                    continue;
+                }
+                if ((bits[x >> 3] >> (x & 7)) & 1)
+                {
+                    uint8_t* pixel = d + (size_t)(x + offset.x) * 3;
+                    pixel[0] = color[0];
+                    pixel[1] = color[1];
+                    pixel[2] = color[2];
+                }
+                x++;
+            }
+        }
+    }
+} // namespace mask
@@ -0,0 +1,467 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "base/simd.hpp"
+
+// exp / log / sigmoid / softmax shared by the decoders. exp and log are the cephes
+// polynomials, the scalar versions evaluate the same polynomials as the neon / sse lanes
+// so a tail element gets the same result as a lane would. max error against double:
+//   exp      relative 8e-8, inputs are clamped to [-88.38, 88.38]
+//   log      absolute 6e-8, nan for x <= 0
+//   sigmoid  absolute 9e-8
+//   softmax  absolute 5e-7 per probability
+//   dfl      absolute 5e-6 for reg_max 16, the result is in [0, reg_max - 1]
+namespace math
+{
+    namespace detail
+    {
+        const float exp_hi = 88.3762626647949f;
+        const float exp_lo = -88.3762626647949f;
+        const float log2e = 1.44269504088896341f;
+        const float ln2_hi = 0.693359375f;
+        const float ln2_lo = -2.12194440e-4f;
+        const float exp_p0 = 1.9875691500e-4f;
+        const float exp_p1 = 1.3981999507e-3f;
+        const float exp_p2 = 8.3334519073e-3f;
+        const float exp_p3 = 4.1665795894e-2f;
+        const float exp_p4 = 1.6666665459e-1f;
+        const float exp_p5 = 5.0000001201e-1f;
+
+        const float sqrt_half = 0.707106781186547524f;
+        const float log_p0 = 7.0376836292e-2f;
+        const float log_p1 = -1.1514610310e-1f;
+        const float log_p2 = 1.1676998740e-1f;
+        const float log_p3 = -1.2420140846e-1f;
+        const float log_p4 = 1.4249322787e-1f;
+        const float log_p5 = -1.6668057665e-1f;
+        const float log_p6 = 2.0000714765e-1f;
+        const float log_p7 = -2.4999993993e-1f;
+        const float log_p8 = 3.3333331174e-1f;
+
+        union bits
+        {
+            int32_t i;
+            float f;
+        };
+    } // namespace detail
+
+    static inline float exp(float x)
+    {
+        using namespace detail;
+        x = x < exp_lo ? exp_lo : (x > exp_hi ? exp_hi : x);
+        float fx = x * log2e + 0.5f;
+        float t = (float)(int32_t)fx;
+        fx = t > fx ? t - 1.f : t;
+        x = x - fx * ln2_hi;
+        x = x - fx * ln2_lo;
+        float z = x * x;
+        float y = exp_p0;
+        y = y * x + exp_p1;
+        y = y * x + exp_p2;
+        y = y * x + exp_p3;
+        y = y * x + exp_p4;
+        y = y * x + exp_p5;
+        y = y * z + x;
+        y = y + 1.f;
+        bits n;
+        n.i = ((int32_t)fx + 127) << 23;
+        return y * n.f;
+    }
+
+    static inline float log(float x)
+    {
+        using namespace detail;
+        if (!(x > 0.f))
+            return NAN;
+        bits u;
+        u.f = x < 1.17549435e-38f ? 1.17549435e-38f : x;
+        float e = (float)(((u.i >> 23) & 0xff) - 0x7f) + 1.f;
+        u.i = (u.i & ~0x7f800000) | 0x3f000000;
+        x = u.f;
+        if (x < sqrt_half)
+        {
+            e -= 1.f;
+            x = x + x - 1.f;
+        }
+        else
+        {
+            x = x - 1.f;
+        }
+        float z = x * x;
+        float y = log_p0;
+        y = y * x + log_p1;
+        y = y * x + log_p2;
+        y = y * x + log_p3;
+        y = y * x + log_p4;
+        y = y * x + log_p5;
+        y = y * x + log_p6;
+        y = y * x + log_p7;
+        y = y * x + log_p8;
+        y = y * x * z;
+        y = y + e * ln2_lo;
+        y = y - 0.5f * z;
+        x = x + y;
+        return x + e * ln2_hi;
+    }
+
+    static inline float sigmoid(float x)
+    {
+        return 1.f / (1.f + exp(-x));
+    }
+
+#if defined(AX_SAMPLES_SIMD_NEON)
+    static inline float32x4_t div_ps(float32x4_t num, float32x4_t den)
+    {
+#if defined(__aarch64__)
+        return vdivq_f32(num, den);
+#else
+        float32x4_t r = vrecpeq_f32(den);
+        r = vmulq_f32(vrecpsq_f32(den, r), r);
+        r = vmulq_f32(vrecpsq_f32(den, r), r);
+        return vmulq_f32(num, r);
+#endif
+    }
+
+    static inline float32x4_t floor_ps(float32x4_t x)
+    {
+        float32x4_t t = vcvtq_f32_s32(vcvtq_s32_f32(x));
+        uint32x4_t gt = vcgtq_f32(t, x);
+        return vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(gt, vreinterpretq_u32_f32(vdupq_n_f32(1.f)))));
+    }
+
+    static inline float32x4_t exp_ps(float32x4_t x)
+    {
+        using namespace detail;
+        x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(exp_lo)), vdupq_n_f32(exp_hi));
+        float32x4_t fx = floor_ps(vaddq_f32(vmulq_n_f32(x, log2e), vdupq_n_f32(0.5f)));
+        x = vsubq_f32(x, vmulq_n_f32(fx, ln2_hi));
+        x = vsubq_f32(x, vmulq_n_f32(fx, ln2_lo));
+        float32x4_t z = vmulq_f32(x, x);
+        float32x4_t y = vdupq_n_f32(exp_p0);
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(exp_p1));
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(exp_p2));
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(exp_p3));
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(exp_p4));
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(exp_p5));
+        y = vaddq_f32(vmulq_f32(y, z), x);
+        y = vaddq_f32(y, vdupq_n_f32(1.f));
+        int32x4_t n = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(fx), vdupq_n_s32(127)), 23);
+        return vmulq_f32(y, vreinterpretq_f32_s32(n));
+    }
+
+    static inline float32x4_t log_ps(float32x4_t x)
+    {
+        using namespace detail;
+        uint32x4_t invalid = vcleq_f32(x, vdupq_n_f32(0.f));
+        x = vmaxq_f32(x, vdupq_n_f32(1.17549435e-38f));
+        int32x4_t u = vreinterpretq_s32_f32(x);
+        float32x4_t e = vaddq_f32(vcvtq_f32_s32(vsubq_s32(vandq_s32(vshrq_n_s32(u, 23), vdupq_n_s32(0xff)), vdupq_n_s32(0x7f))), vdupq_n_f32(1.f));
+        x = vreinterpretq_f32_s32(vorrq_s32(vandq_s32(u, vdupq_n_s32(~0x7f800000)), vdupq_n_s32(0x3f000000)));
+        uint32x4_t small = vcltq_f32(x, vdupq_n_f32(sqrt_half));
+        float32x4_t tmp = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(x), small));
+        x = vsubq_f32(x, vdupq_n_f32(1.f));
+        e = vsubq_f32(e, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vdupq_n_f32(1.f)), small)));
+        x = vaddq_f32(x, tmp);
+        float32x4_t z = vmulq_f32(x, x);
+        float32x4_t y = vdupq_n_f32(log_p0);
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(log_p1));
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(log_p2));
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(log_p3));
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(log_p4));
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(log_p5));
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(log_p6));
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(log_p7));
+        y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(log_p8));
+        y = vmulq_f32(vmulq_f32(y, x), z);
+        y = vaddq_f32(y, vmulq_n_f32(e, ln2_lo));
+        y = vsubq_f32(y, vmulq_n_f32(z, 0.5f));
+        x = vaddq_f32(x, y);
+        x = vaddq_f32(x, vmulq_n_f32(e, ln2_hi));
+        return vbslq_f32(invalid, vdupq_n_f32(NAN), x);
+    }
+
+    static inline float32x4_t sigmoid_ps(float32x4_t x)
+    {
+        float32x4_t one = vdupq_n_f32(1.f);
+        return div_ps(one, vaddq_f32(one, exp_ps(vnegq_f32(x))));
+    }
+
+    static inline float reduce_max(float32x4_t v)
+    {
+#if defined(__aarch64__)
+        return vmaxvq_f32(v);
+#else
+        float32x2_t m = vpmax_f32(vget_low_f32(v), vget_high_f32(v));
+        return vget_lane_f32(vpmax_f32(m, m), 0);
+#endif
+    }
+
+    static inline float reduce_add(float32x4_t v)
+    {
+#if defined(__aarch64__)
+        return vaddvq_f32(v);
+#else
+        float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+        return vget_lane_f32(vpadd_f32(s, s), 0);
+#endif
+    }
+#elif defined(AX_SAMPLES_SIMD_SSE)
+    static inline __m128 div_ps(__m128 num, __m128 den)
+    {
+        return _mm_div_ps(num, den);
+    }
+
+    static inline __m128 floor_ps(__m128 x)
+    {
+        __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.f)));
+    }
+
+    static inline __m128 exp_ps(__m128 x)
+    {
+        using namespace detail;
+        x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(exp_lo)), _mm_set1_ps(exp_hi));
+        __m128 fx = floor_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(log2e)), _mm_set1_ps(0.5f)));
+        x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(ln2_hi)));
+        x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(ln2_lo)));
+        __m128 z = _mm_mul_ps(x, x);
+        __m128 y = _mm_set1_ps(exp_p0);
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(exp_p1));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(exp_p2));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(exp_p3));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(exp_p4));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(exp_p5));
+        y = _mm_add_ps(_mm_mul_ps(y, z), x);
+        y = _mm_add_ps(y, _mm_set1_ps(1.f));
+        __m128i n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127)), 23);
+        return _mm_mul_ps(y, _mm_castsi128_ps(n));
+    }
+
+    static inline __m128 log_ps(__m128 x)
+    {
+        using namespace detail;
+        __m128 invalid = _mm_cmple_ps(x, _mm_setzero_ps());
+        x = _mm_max_ps(x, _mm_set1_ps(1.17549435e-38f));
+        __m128i u = _mm_castps_si128(x);
+        __m128 e = _mm_add_ps(_mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(u, 23), _mm_set1_epi32(0xff)), _mm_set1_epi32(0x7f))), _mm_set1_ps(1.f));
+        x = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(u, _mm_set1_epi32(~0x7f800000)), _mm_set1_epi32(0x3f000000)));
+        __m128 small = _mm_cmplt_ps(x, _mm_set1_ps(sqrt_half));
+        __m128 tmp = _mm_and_ps(x, small);
+        x = _mm_sub_ps(x, _mm_set1_ps(1.f));
+        e = _mm_sub_ps(e, _mm_and_ps(_mm_set1_ps(1.f), small));
+        x = _mm_add_ps(x, tmp);
+        __m128 z = _mm_mul_ps(x, x);
+        __m128 y = _mm_set1_ps(log_p0);
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p1));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p2));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p3));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p4));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p5));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p6));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p7));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p8));
+        y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+        y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(ln2_lo)));
+        y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+        x = _mm_add_ps(x, y);
+        x = _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(ln2_hi)));
+        return _mm_or_ps(_mm_andnot_ps(invalid, x), _mm_and_ps(invalid, _mm_set1_ps(NAN)));
+    }
+
+    static inline __m128 sigmoid_ps(__m128 x)
+    {
+        __m128 one = _mm_set1_ps(1.f);
+        return _mm_div_ps(one, _mm_add_ps(one, exp_ps(_mm_sub_ps(_mm_setzero_ps(), x))));
+    }
+
+    static inline float reduce_max(__m128 v)
+    {
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(v);
+    }
+
+    static inline float reduce_add(__m128 v)
+    {
+        v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(v);
+    }
+#endif
+
+    // dst[i] = exp(src[i]), src and dst may alias
+    static inline void exp(const float* src, float* dst, int n)
+    {
+        int i = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+        for (; i + 4 <= n; i += 4)
+            vst1q_f32(dst + i, exp_ps(vld1q_f32(src + i)));
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(dst + i, exp_ps(_mm_loadu_ps(src + i)));
+#endif
+        for (; i < n; i++)
+            dst[i] = exp(src[i]);
+    }
+
+    static inline void sigmoid(const float* src, float* dst, int n)
+    {
+        int i = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+        for (; i + 4 <= n; i += 4)
+            vst1q_f32(dst + i, sigmoid_ps(vld1q_f32(src + i)));
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(dst + i, sigmoid_ps(_mm_loadu_ps(src + i)));
+#endif
+        for (; i < n; i++)
+            dst[i] = sigmoid(src[i]);
+    }
+
+    static inline float max(const float* src, int n)
+    {
+        int i = 0;
+        float m = -INFINITY;
+#if defined(AX_SAMPLES_SIMD_NEON)
+        if (n >= 4)
+        {
+            float32x4_t v = vld1q_f32(src);
+            for (i = 4; i + 4 <= n; i += 4)
+                v = vmaxq_f32(v, vld1q_f32(src + i));
+            m = reduce_max(v);
+        }
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        if (n >= 4)
+        {
+            __m128 v = _mm_loadu_ps(src);
+            for (i = 4; i + 4 <= n; i += 4)
+                v = _mm_max_ps(v, _mm_loadu_ps(src + i));
+            m = reduce_max(v);
+        }
+#endif
+        for (; i < n; i++)
+            m = src[i] > m ? src[i] : m;
+        return m;
+    }
+
+    // dst = softmax(src), src and dst may alias
+    static inline void softmax(const float* src, float* dst, int n)
+    {
+        const float m = max(src, n);
+        float sum = 0.f;
+        int i = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+        float32x4_t vm = vdupq_n_f32(m);
+        float32x4_t vsum = vdupq_n_f32(0.f);
+        for (; i + 4 <= n; i += 4)
+        {
+            float32x4_t e = exp_ps(vsubq_f32(vld1q_f32(src + i), vm));
+            vst1q_f32(dst + i, e);
+            vsum = vaddq_f32(vsum, e);
+        }
+        sum = reduce_add(vsum);
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        __m128 vm = _mm_set1_ps(m);
+        __m128 vsum = _mm_setzero_ps();
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 e = exp_ps(_mm_sub_ps(_mm_loadu_ps(src + i), vm));
+            _mm_storeu_ps(dst + i, e);
+            vsum = _mm_add_ps(vsum, e);
+        }
+        sum = reduce_add(vsum);
+#endif
+        for (; i < n; i++)
+        {
+            dst[i] = exp(src[i] - m);
+            sum += dst[i];
+        }
+
+        const float scale = 1.f / sum;
+        i = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+        for (; i + 4 <= n; i += 4)
+            vst1q_f32(dst + i, vmulq_n_f32(vld1q_f32(dst + i), scale));
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), _mm_set1_ps(scale)));
+#endif
+        for (; i < n; i++)
+            dst[i] *= scale;
+    }
+
+    // distribution focal loss integral: sum(i * softmax(src)[i]) over reg_max bins,
+    // without writing the distribution out. reg_max 16 stays in four registers.
+    static inline float dfl(const float* src, int reg_max)
+    {
+#if defined(AX_SAMPLES_SIMD_NEON)
+        if (reg_max == 16)
+        {
+            float32x4_t v0 = vld1q_f32(src);
+            float32x4_t v1 = vld1q_f32(src + 4);
+            float32x4_t v2 = vld1q_f32(src + 8);
+            float32x4_t v3 = vld1q_f32(src + 12);
+            float32x4_t vm = vdupq_n_f32(reduce_max(vmaxq_f32(vmaxq_f32(v0, v1), vmaxq_f32(v2, v3))));
+            v0 = exp_ps(vsubq_f32(v0, vm));
+            v1 = exp_ps(vsubq_f32(v1, vm));
+            v2 = exp_ps(vsubq_f32(v2, vm));
+            v3 = exp_ps(vsubq_f32(v3, vm));
+            const float bins[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+            float32x4_t sum = vaddq_f32(vaddq_f32(v0, v1), vaddq_f32(v2, v3));
+            float32x4_t acc = vmulq_f32(v0, vld1q_f32(bins));
+            acc = vaddq_f32(acc, vmulq_f32(v1, vld1q_f32(bins + 4)));
+            acc = vaddq_f32(acc, vmulq_f32(v2, vld1q_f32(bins + 8)));
+            acc = vaddq_f32(acc, vmulq_f32(v3, vld1q_f32(bins + 12)));
+            return reduce_add(acc) / reduce_add(sum);
+        }
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        if (reg_max == 16)
+        {
+            __m128 v0 = _mm_loadu_ps(src);
+            __m128 v1 = _mm_loadu_ps(src + 4);
+            __m128 v2 = _mm_loadu_ps(src + 8);
+            __m128 v3 = _mm_loadu_ps(src + 12);
+            __m128 vm = _mm_set1_ps(reduce_max(_mm_max_ps(_mm_max_ps(v0, v1), _mm_max_ps(v2, v3))));
+            v0 = exp_ps(_mm_sub_ps(v0, vm));
+            v1 = exp_ps(_mm_sub_ps(v1, vm));
+            v2 = exp_ps(_mm_sub_ps(v2, vm));
+            v3 = exp_ps(_mm_sub_ps(v3, vm));
+            __m128 sum = _mm_add_ps(_mm_add_ps(v0, v1), _mm_add_ps(v2, v3));
+            __m128 acc = _mm_mul_ps(v0, _mm_setr_ps(0, 1, 2, 3));
+            acc = _mm_add_ps(acc, _mm_mul_ps(v1, _mm_setr_ps(4, 5, 6, 7)));
+            acc = _mm_add_ps(acc, _mm_mul_ps(v2, _mm_setr_ps(8, 9, 10, 11)));
+            acc = _mm_add_ps(acc, _mm_mul_ps(v3, _mm_setr_ps(12, 13, 14, 15)));
+            return reduce_add(acc) / reduce_add(sum);
+        }
+#endif
+        const float m = max(src, reg_max);
+        float sum = 0.f;
+        float acc = 0.f;
+        for (int i = 0; i < reg_max; i++)
+        {
+            float e = exp(src[i] - m);
+            sum += e;
+            acc += i * e;
+        }
+        return acc / sum;
+    }
+} // namespace math
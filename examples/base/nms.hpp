@@ -0,0 +1,246 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "base/simd.hpp"
+
+namespace nms
+{
+    /* boxes as structure of arrays so one box can be tested against many with simd */
+    struct Boxes
+    {
+        std::vector<float> x0;
+        std::vector<float> y0;
+        std::vector<float> x1;
+        std::vector<float> y1;
+        std::vector<float> area;
+        std::vector<int> label;
+
+        int size() const
+        {
+            return (int)x0.size();
+        }
+
+        void clear()
+        {
+            x0.clear();
+            y0.clear();
+            x1.clear();
+            y1.clear();
+            area.clear();
+            label.clear();
+        }
+
+        void reserve(size_t n)
+        {
+            x0.reserve(n);
+            y0.reserve(n);
+            x1.reserve(n);
+            y1.reserve(n);
+            area.reserve(n);
+            label.reserve(n);
+        }
+
+        void push_back(float bx0, float by0, float bx1, float by1, float barea, int blabel = 0)
+        {
+            x0.push_back(bx0);
+            y0.push_back(by0);
+            x1.push_back(bx1);
+            y1.push_back(by1);
+            area.push_back(barea);
+            label.push_back(blabel);
+        }
+
+        void push_back(const Boxes& boxes, int i)
+        {
+            push_back(boxes.x0[i], boxes.y0[i], boxes.x1[i], boxes.y1[i], boxes.area[i], boxes.label[i]);
+        }
+    };
+
+    // true if box i of boxes has iou > nms_threshold with any of kept, stops at the first hit
+    static inline bool overlaps_any(const Boxes& kept, const Boxes& boxes, int i, float nms_threshold)
+    {
+        const float x0 = boxes.x0[i];
+        const float y0 = boxes.y0[i];
+        const float x1 = boxes.x1[i];
+        const float y1 = boxes.y1[i];
+        const float area = boxes.area[i];
+        const int n = kept.size();
+
+        int j = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+        float32x4_t ax0 = vdupq_n_f32(x0);
+        float32x4_t ay0 = vdupq_n_f32(y0);
+        float32x4_t ax1 = vdupq_n_f32(x1);
+        float32x4_t ay1 = vdupq_n_f32(y1);
+        float32x4_t aarea = vdupq_n_f32(area);
+        float32x4_t thr = vdupq_n_f32(nms_threshold);
+        float32x4_t zero = vdupq_n_f32(0.f);
+        for (; j + 4 <= n; j += 4)
+        {
+            float32x4_t w = vmaxq_f32(vsubq_f32(vminq_f32(ax1, vld1q_f32(&kept.x1[j])), vmaxq_f32(ax0, vld1q_f32(&kept.x0[j]))), zero);
+            float32x4_t h = vmaxq_f32(vsubq_f32(vminq_f32(ay1, vld1q_f32(&kept.y1[j])), vmaxq_f32(ay0, vld1q_f32(&kept.y0[j]))), zero);
+            float32x4_t inter = vmulq_f32(w, h);
+            float32x4_t uni = vsubq_f32(vaddq_f32(aarea, vld1q_f32(&kept.area[j])), inter);
+            if (simd::any_lane(vcgtq_f32(inter, vmulq_f32(thr, uni))))
+                return true;
+        }
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        __m128 ax0 = _mm_set1_ps(x0);
+        __m128 ay0 = _mm_set1_ps(y0);
+        __m128 ax1 = _mm_set1_ps(x1);
+        __m128 ay1 = _mm_set1_ps(y1);
+        __m128 aarea = _mm_set1_ps(area);
+        __m128 thr = _mm_set1_ps(nms_threshold);
+        __m128 zero = _mm_setzero_ps();
+        for (; j + 4 <= n; j += 4)
+        {
+            __m128 w = _mm_max_ps(_mm_sub_ps(_mm_min_ps(ax1, _mm_loadu_ps(&kept.x1[j])), _mm_max_ps(ax0, _mm_loadu_ps(&kept.x0[j]))), zero);
+            __m128 h = _mm_max_ps(_mm_sub_ps(_mm_min_ps(ay1, _mm_loadu_ps(&kept.y1[j])), _mm_max_ps(ay0, _mm_loadu_ps(&kept.y0[j]))), zero);
+            __m128 inter = _mm_mul_ps(w, h);
+            __m128 uni = _mm_sub_ps(_mm_add_ps(aarea, _mm_loadu_ps(&kept.area[j])), inter);
+            if (_mm_movemask_ps(_mm_cmpgt_ps(inter, _mm_mul_ps(thr, uni))))
+                return true;
+        }
+#endif
+        for (; j < n; j++)
+        {
+            float w = std::max(std::min(x1, kept.x1[j]) - std::max(x0, kept.x0[j]), 0.f);
+            float h = std::max(std::min(y1, kept.y1[j]) - std::max(y0, kept.y0[j]), 0.f);
+            float inter = w * h;
+            float uni = area + kept.area[j] - inter;
+            if (inter > nms_threshold * uni)
+                return true;
+        }
+        return false;
+    }
+
+    static void nms_indices(const Boxes& boxes, const int* indices, int n, std::vector<int>& picked, float nms_threshold, Boxes& kept)
+    {
+        kept.clear();
+        for (int k = 0; k < n; k++)
+        {
+            int i = indices[k];
+            if (!overlaps_any(kept, boxes, i, nms_threshold))
+            {
+                kept.push_back(boxes, i);
+                picked.push_back(i);
+            }
+        }
+    }
+
+    /*
+     * greedy nms over boxes sorted by score descending, picked holds indices into boxes in
+     * score order. a box is suppressed when iou > nms_threshold with a kept box, and it is
+     * only tested against kept boxes, so the cost is n * kept rather than n * n.
+     * class_aware runs nms per label, top_k >= 0 only considers the top_k best boxes.
+     */
+    static void nms_sorted(const Boxes& boxes, std::vector<int>& picked, float nms_threshold, bool class_aware = false, int top_k = -1)
+    {
+        picked.clear();
+
+        int n = boxes.size();
+        if (top_k >= 0 && top_k < n)
+            n = top_k;
+        if (n == 0)
+            return;
+
+        std::vector<int> indices(n);
+        for (int i = 0; i < n; i++)
+        {
+            indices[i] = i;
+        }
+
+        Boxes kept;
+        kept.reserve(std::min(n, 256));
+        if (!class_aware)
+        {
+            nms_indices(boxes, indices.data(), n, picked, nms_threshold, kept);
+            return;
+        }
+
+        // bucket by label, keeping the score order inside every bucket
+        std::stable_sort(indices.begin(), indices.end(), [&boxes](int a, int b) { return boxes.label[a] < boxes.label[b]; });
+        for (int begin = 0; begin < n;)
+        {
+            int end = begin + 1;
+            while (end < n && boxes.label[indices[end]] == boxes.label[indices[begin]])
+                end++;
+            nms_indices(boxes, indices.data() + begin, end - begin, picked, nms_threshold, kept);
+            begin = end;
+        }
+        std::sort(picked.begin(), picked.end());
+    }
+
+    /*
+     * indices of the top_k best items (all of them when top_k < 0), best first, by score(item).
+     * only an index / score array is reordered, so the cost does not depend on the item
+     * payload. ties keep the item order.
+     */
+    template<typename T, typename Score>
+    static void top_k_order(const std::vector<T>& items, Score score, std::vector<int>& order, int top_k = -1)
+    {
+        struct ScoreIndex
+        {
+            float score;
+            int index;
+        };
+
+        const int n = (int)items.size();
+        std::vector<ScoreIndex> ranked(n);
+        for (int i = 0; i < n; i++)
+        {
+            ranked[i] = {score(items[i]), i};
+        }
+
+        auto greater = [](const ScoreIndex& a, const ScoreIndex& b) {
+            return a.score > b.score || (a.score == b.score && a.index < b.index);
+        };
+        if (top_k >= 0 && top_k < n)
+        {
+            std::nth_element(ranked.begin(), ranked.begin() + top_k, ranked.end(), greater);
+            ranked.resize(top_k);
+        }
+        std::sort(ranked.begin(), ranked.end(), greater);
+
+        order.resize(ranked.size());
+        for (size_t i = 0; i < ranked.size(); i++)
+        {
+            order[i] = ranked[i].index;
+        }
+    }
+
+    /* sorts items by score descending and keeps the best top_k, each survivor is moved once */
+    template<typename T, typename Score>
+    static void sort_top_k(std::vector<T>& items, Score score, int top_k = -1)
+    {
+        std::vector<int> order;
+        top_k_order(items, score, order, top_k);
+
+        std::vector<T> sorted;
+        sorted.reserve(order.size());
+        for (int i : order)
+        {
+            sorted.push_back(std::move(items[i]));
+        }
+        items.swap(sorted);
+    }
+} // namespace nms
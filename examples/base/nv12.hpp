@@ -0,0 +1,381 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "base/letterbox.hpp"
+#include "base/resize.hpp"
+#include "base/simd.hpp"
+
+/*
+ * cpu nv12 / nv21 helpers for boards or builds without ivps: csc from / to packed bgr and
+ * crop + resize with the same aspect ratio control as AX_IVPS_ASPECT_RATIO_T.
+ * bt.601 limited range, the same as the ivps csc and the npu nv12 input.
+ */
+namespace nv12
+{
+    /* y plane followed by the interleaved uv plane, both with the same row stride in bytes */
+    typedef struct Frame
+    {
+        uint8_t* y;
+        uint8_t* uv;
+        int width;
+        int height;
+        int stride;
+        bool nv21;
+    } Frame;
+
+    static inline size_t frame_size(int stride, int height)
+    {
+        return (size_t)stride * height * 3 / 2;
+    }
+
+    /* frame in one contiguous buffer of frame_size(stride, height) bytes, stride 0 means width */
+    static inline Frame make_frame(uint8_t* data, int width, int height, int stride = 0, bool nv21 = false)
+    {
+        if (stride <= 0)
+            stride = width;
+        return Frame{data, data + (size_t)stride * height, width, height, stride, nv21};
+    }
+
+    typedef struct Rect
+    {
+        int x;
+        int y;
+        int width;
+        int height;
+    } Rect;
+
+    /* same values as AX_IVPS_ASPECT_RATIO_E and the AX_IVPS_ASPECT_RATIO_*_CENTER / LEFT / RIGHT aligns */
+    enum AspectMode
+    {
+        ASPECT_RATIO_STRETCH = 0,
+        ASPECT_RATIO_AUTO = 1,
+        ASPECT_RATIO_MANUAL = 2,
+    };
+
+    enum Align
+    {
+        ALIGN_CENTER = 0,
+        ALIGN_START = 1,
+        ALIGN_END = 2,
+    };
+
+    /* bg_color is 0xRRGGBB like nBgColor, rect is the destination area of ASPECT_RATIO_MANUAL */
+    typedef struct AspectRatio
+    {
+        AspectMode mode;
+        Align align_x;
+        Align align_y;
+        uint32_t bg_color;
+        Rect rect;
+    } AspectRatio;
+
+    static inline AspectRatio make_aspect_ratio(AspectMode mode = ASPECT_RATIO_AUTO, uint32_t bg_color = 0, Align align_x = ALIGN_CENTER, Align align_y = ALIGN_CENTER)
+    {
+        return AspectRatio{mode, align_x, align_y, bg_color, Rect{0, 0, 0, 0}};
+    }
+
+    namespace detail
+    {
+        static inline uint8_t clamp_u8(int v)
+        {
+            return (uint8_t)std::min(std::max(v, 0), 255);
+        }
+
+        static inline uint8_t luma(int r, int g, int b)
+        {
+            return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+
+        static inline uint8_t chroma_u(int r, int g, int b)
+        {
+            return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        }
+
+        static inline uint8_t chroma_v(int r, int g, int b)
+        {
+            return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+
+        // q8 coefficients of the inverse, c = y - 16, d = u - 128, e = v - 128; the chroma terms are shared by a pixel pair
+        static inline void chroma_terms(int u, int v, int& tb, int& tg, int& tr)
+        {
+            int d = u - 128;
+            int e = v - 128;
+            tb = 516 * d + 128;
+            tg = -100 * d - 208 * e + 128;
+            tr = 409 * e + 128;
+        }
+
+        static inline void yuv_to_bgr(int y, int tb, int tg, int tr, uint8_t* bgr)
+        {
+            int c = 298 * (y - 16);
+            bgr[0] = clamp_u8((c + tb) >> 8);
+            bgr[1] = clamp_u8((c + tg) >> 8);
+            bgr[2] = clamp_u8((c + tr) >> 8);
+        }
+
+        static inline int align_offset(Align align, int space)
+        {
+            switch (align)
+            {
+            case ALIGN_START:
+                return 0;
+            case ALIGN_END:
+                return space;
+            default:
+                return space / 2 & ~1;
+            }
+        }
+
+        // keeps planes aligned to the 2x2 chroma grid
+        static inline bool is_even(const Rect& r)
+        {
+            return !((r.x | r.y | r.width | r.height) & 1) && r.width > 0 && r.height > 0;
+        }
+
+#if defined(AX_SAMPLES_SIMD_NEON)
+        static inline uint8x16_t luma_x16(uint8x16_t r, uint8x16_t g, uint8x16_t b)
+        {
+            uint16x8_t lo = vmull_u8(vget_low_u8(r), vdup_n_u8(66));
+            lo = vmlal_u8(lo, vget_low_u8(g), vdup_n_u8(129));
+            lo = vmlal_u8(lo, vget_low_u8(b), vdup_n_u8(25));
+            uint16x8_t hi = vmull_u8(vget_high_u8(r), vdup_n_u8(66));
+            hi = vmlal_u8(hi, vget_high_u8(g), vdup_n_u8(129));
+            hi = vmlal_u8(hi, vget_high_u8(b), vdup_n_u8(25));
+            return vaddq_u8(vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)), vdupq_n_u8(16));
+        }
+
+        static inline uint8x8_t narrow_q8(int32x4_t lo, int32x4_t hi)
+        {
+            return vqmovun_s16(vcombine_s16(vqrshrn_n_s32(lo, 8), vqrshrn_n_s32(hi, 8)));
+        }
+
+        static inline void yuv_to_bgr_x8(int16x8_t c, int16x8_t d, int16x8_t e, uint8x8x3_t& bgr)
+        {
+            int32x4_t yl = vmull_n_s16(vget_low_s16(c), 298);
+            int32x4_t yh = vmull_n_s16(vget_high_s16(c), 298);
+            bgr.val[0] = narrow_q8(vmlal_n_s16(yl, vget_low_s16(d), 516), vmlal_n_s16(yh, vget_high_s16(d), 516));
+            bgr.val[1] = narrow_q8(vmlal_n_s16(vmlal_n_s16(yl, vget_low_s16(d), -100), vget_low_s16(e), -208),
+                                   vmlal_n_s16(vmlal_n_s16(yh, vget_high_s16(d), -100), vget_high_s16(e), -208));
+            bgr.val[2] = narrow_q8(vmlal_n_s16(yl, vget_low_s16(e), 409), vmlal_n_s16(yh, vget_high_s16(e), 409));
+        }
+#endif
+    } // namespace detail
+
+    /* bt.601 value of a 0xRRGGBB color, written as y and the two chroma bytes in dst order */
+    static inline void color_to_yuv(uint32_t rgb, bool nv21, uint8_t& y, uint8_t* uv)
+    {
+        int r = (rgb >> 16) & 0xFF, g = (rgb >> 8) & 0xFF, b = rgb & 0xFF;
+        y = detail::luma(r, g, b);
+        uv[nv21 ? 1 : 0] = detail::chroma_u(r, g, b);
+        uv[nv21 ? 0 : 1] = detail::chroma_v(r, g, b);
+    }
+
+    /* packed bgr to dst, dst width and height have to be even, chroma is the mean of each 2x2 block */
+    static inline int bgr_to_nv12(const uint8_t* bgr, int bgr_stride, const Frame& dst)
+    {
+        if ((dst.width | dst.height) & 1)
+        {
+            fprintf(stderr, "nv12: odd frame size %dx%d.\n", dst.width, dst.height);
+            return -1;
+        }
+
+        const int u_index = dst.nv21 ? 1 : 0;
+        for (int y = 0; y < dst.height; y += 2)
+        {
+            const uint8_t* s0 = bgr + (size_t)y * bgr_stride;
+            const uint8_t* s1 = s0 + bgr_stride;
+            uint8_t* y0 = dst.y + (size_t)y * dst.stride;
+            uint8_t* y1 = y0 + dst.stride;
+            uint8_t* uv = dst.uv + (size_t)(y / 2) * dst.stride;
+
+            int x = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+            for (; x + 16 <= dst.width; x += 16)
+            {
+                uint8x16x3_t p0 = vld3q_u8(s0 + x * 3);
+                uint8x16x3_t p1 = vld3q_u8(s1 + x * 3);
+                vst1q_u8(y0 + x, detail::luma_x16(p0.val[2], p0.val[1], p0.val[0]));
+                vst1q_u8(y1 + x, detail::luma_x16(p1.val[2], p1.val[1], p1.val[0]));
+
+                // 2x2 means, (sum + 2) >> 2
+                int16x8_t b = vreinterpretq_s16_u16(vrshrq_n_u16(vaddq_u16(vpaddlq_u8(p0.val[0]), vpaddlq_u8(p1.val[0])), 2));
+                int16x8_t g = vreinterpretq_s16_u16(vrshrq_n_u16(vaddq_u16(vpaddlq_u8(p0.val[1]), vpaddlq_u8(p1.val[1])), 2));
+                int16x8_t r = vreinterpretq_s16_u16(vrshrq_n_u16(vaddq_u16(vpaddlq_u8(p0.val[2]), vpaddlq_u8(p1.val[2])), 2));
+
+                int16x8_t u = vmlsq_n_s16(vmlsq_n_s16(vmulq_n_s16(b, 112), r, 38), g, 74);
+                int16x8_t v = vmlsq_n_s16(vmlsq_n_s16(vmulq_n_s16(r, 112), g, 94), b, 18);
+                uint8x8x2_t out;
+                out.val[u_index] = vqmovun_s16(vaddq_s16(vrshrq_n_s16(u, 8), vdupq_n_s16(128)));
+                out.val[1 - u_index] = vqmovun_s16(vaddq_s16(vrshrq_n_s16(v, 8), vdupq_n_s16(128)));
+                vst2_u8(uv + x, out);
+            }
+#endif
+            for (; x < dst.width; x += 2)
+            {
+                const uint8_t* a = s0 + x * 3;
+                const uint8_t* c = s1 + x * 3;
+                y0[x] = detail::luma(a[2], a[1], a[0]);
+                y0[x + 1] = detail::luma(a[5], a[4], a[3]);
+                y1[x] = detail::luma(c[2], c[1], c[0]);
+                y1[x + 1] = detail::luma(c[5], c[4], c[3]);
+
+                int b = (a[0] + a[3] + c[0] + c[3] + 2) >> 2;
+                int g = (a[1] + a[4] + c[1] + c[4] + 2) >> 2;
+                int r = (a[2] + a[5] + c[2] + c[5] + 2) >> 2;
+                uv[x + u_index] = detail::chroma_u(r, g, b);
+                uv[x + 1 - u_index] = detail::chroma_v(r, g, b);
+            }
+        }
+        return 0;
+    }
+
+    /* src to packed bgr, the inverse of bgr_to_nv12 */
+    static inline void nv12_to_bgr(const Frame& src, uint8_t* bgr, int bgr_stride)
+    {
+        const int u_index = src.nv21 ? 1 : 0;
+        for (int y = 0; y < src.height; y++)
+        {
+            const uint8_t* yp = src.y + (size_t)y * src.stride;
+            const uint8_t* uv = src.uv + (size_t)(y / 2) * src.stride;
+            uint8_t* d = bgr + (size_t)y * bgr_stride;
+
+            int x = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+            const int16x8_t k16 = vdupq_n_s16(16);
+            const int16x8_t k128 = vdupq_n_s16(128);
+            for (; x + 16 <= src.width; x += 16)
+            {
+                uint8x16_t yv = vld1q_u8(yp + x);
+                uint8x8x2_t c = vld2_u8(uv + x);
+                uint8x8x2_t u = vzip_u8(c.val[u_index], c.val[u_index]);
+                uint8x8x2_t v = vzip_u8(c.val[1 - u_index], c.val[1 - u_index]);
+
+                uint8x8x3_t lo, hi;
+                detail::yuv_to_bgr_x8(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(yv))), k16),
+                                      vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u.val[0])), k128),
+                                      vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v.val[0])), k128), lo);
+                detail::yuv_to_bgr_x8(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(yv))), k16),
+                                      vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u.val[1])), k128),
+                                      vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v.val[1])), k128), hi);
+                vst3_u8(d + x * 3, lo);
+                vst3_u8(d + x * 3 + 24, hi);
+            }
+#endif
+            for (; x < src.width; x += 2)
+            {
+                int tb, tg, tr;
+                detail::chroma_terms(uv[x + u_index], uv[x + 1 - u_index], tb, tg, tr);
+                detail::yuv_to_bgr(yp[x], tb, tg, tr, d + x * 3);
+                if (x + 1 < src.width)
+                    detail::yuv_to_bgr(yp[x + 1], tb, tg, tr, d + x * 3 + 3);
+            }
+        }
+    }
+
+    /*
+     * crop of src resized into dst like AX_IVPS_CropResizeVpp, the area of dst outside of the
+     * resized crop is filled with aspect.bg_color. crop, dst size and the manual rect have to be
+     * even. transform, if given, maps dst coordinates back into the crop.
+     */
+    static inline int crop_resize(const Frame& src, const Rect& crop, const Frame& dst, const AspectRatio& aspect,
+                                  letterbox::LetterboxTransform* transform = nullptr)
+    {
+        if (!detail::is_even(crop) || crop.x + crop.width > src.width || crop.y + crop.height > src.height)
+        {
+            fprintf(stderr, "nv12: crop (%d, %d, %d, %d) is odd or out of the %dx%d frame.\n",
+                    crop.x, crop.y, crop.width, crop.height, src.width, src.height);
+            return -1;
+        }
+        if ((dst.width | dst.height) & 1)
+        {
+            fprintf(stderr, "nv12: odd frame size %dx%d.\n", dst.width, dst.height);
+            return -1;
+        }
+
+        Rect roi = {0, 0, dst.width, dst.height};
+        if (aspect.mode == ASPECT_RATIO_AUTO)
+        {
+            float scale = std::min((float)dst.width / crop.width, (float)dst.height / crop.height);
+            roi.width = std::max((int)(crop.width * scale) & ~1, 2);
+            roi.height = std::max((int)(crop.height * scale) & ~1, 2);
+            roi.x = detail::align_offset(aspect.align_x, dst.width - roi.width);
+            roi.y = detail::align_offset(aspect.align_y, dst.height - roi.height);
+        }
+        else if (aspect.mode == ASPECT_RATIO_MANUAL)
+        {
+            roi = aspect.rect;
+            if (!detail::is_even(roi) || roi.x + roi.width > dst.width || roi.y + roi.height > dst.height)
+            {
+                fprintf(stderr, "nv12: manual rect (%d, %d, %d, %d) is odd or out of the %dx%d frame.\n",
+                        roi.x, roi.y, roi.width, roi.height, dst.width, dst.height);
+                return -1;
+            }
+        }
+
+        uint8_t bg_y, bg_uv[2];
+        color_to_yuv(aspect.bg_color, dst.nv21, bg_y, bg_uv);
+
+        const uint8_t* src_y = src.y + (size_t)crop.y * src.stride + crop.x;
+        const uint8_t* src_uv = src.uv + (size_t)(crop.y / 2) * src.stride + crop.x;
+        resize::bilinear_plane<1>(src_y, crop.width, crop.height, src.stride, dst.y, dst.width, dst.height, dst.stride,
+                                  resize::make_layout(roi.width, roi.height, 0, 0, roi.x, roi.y, roi.width, roi.height), false, &bg_y);
+        resize::bilinear_plane<2>(src_uv, crop.width / 2, crop.height / 2, src.stride, dst.uv, dst.width / 2, dst.height / 2, dst.stride,
+                                  resize::make_layout(roi.width / 2, roi.height / 2, 0, 0, roi.x / 2, roi.y / 2, roi.width / 2, roi.height / 2),
+                                  src.nv21 != dst.nv21, bg_uv);
+
+        if (transform)
+        {
+            letterbox::LetterboxTransform& t = *transform;
+            t.scale_x = (float)crop.width / roi.width;
+            t.scale_y = (float)crop.height / roi.height;
+            t.pad_x = roi.x;
+            t.pad_y = roi.y;
+            t.resize_w = roi.width;
+            t.resize_h = roi.height;
+            t.src_w = crop.width;
+            t.src_h = crop.height;
+            t.dst_w = dst.width;
+            t.dst_h = dst.height;
+        }
+        return 0;
+    }
+
+    static inline int crop_resize(const Frame& src, const Frame& dst, const AspectRatio& aspect, letterbox::LetterboxTransform* transform = nullptr)
+    {
+        return crop_resize(src, Rect{0, 0, src.width & ~1, src.height & ~1}, dst, aspect, transform);
+    }
+
+    /* one source, count crops into count frames, like AX_IVPS_CropResizeV2Vpp; stops at the first failing box */
+    static inline int crop_resize(const Frame& src, const Rect* boxes, int count, const Frame* dst, const AspectRatio& aspect,
+                                  letterbox::LetterboxTransform* transforms = nullptr)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            int ret = crop_resize(src, boxes[i], dst[i], aspect, transforms ? transforms + i : nullptr);
+            if (ret != 0)
+                return ret;
+        }
+        return 0;
+    }
+} // namespace nv12
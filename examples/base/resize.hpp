@@ -0,0 +1,309 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "base/simd.hpp"
+
+namespace resize
+{
+    /*
+     * where the resized image goes: the source is scaled to scaled_w x scaled_h, the window at
+     * (offset_x, offset_y) of that is written to the roi of the destination, the rest of the
+     * destination is border. covers letterbox, plain resize and center crop.
+     */
+    typedef struct Layout
+    {
+        int scaled_w;
+        int scaled_h;
+        int offset_x;
+        int offset_y;
+        int roi_x;
+        int roi_y;
+        int roi_w;
+        int roi_h;
+    } Layout;
+
+    static inline Layout make_layout(int scaled_w, int scaled_h, int offset_x, int offset_y, int roi_x, int roi_y, int roi_w, int roi_h)
+    {
+        return Layout{scaled_w, scaled_h, offset_x, offset_y, roi_x, roi_y, roi_w, roi_h};
+    }
+
+    /* 8 bit weights, a row is interpolated to value * 256 in uint16, the column blend rounds back */
+    static const int WEIGHT_BITS = 8;
+    static const int WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+    namespace detail
+    {
+        // same coordinate convention as cv::resize INTER_LINEAR (pixel centers aligned)
+        static inline void source_coord(int d, int offset, float scale, int size, int& index0, int& index1, int& weight)
+        {
+            float f = ((float)(d + offset) + 0.5f) * scale - 0.5f;
+            int s = (int)std::floor(f);
+            float a = f - (float)s;
+            if (s < 0)
+            {
+                s = 0;
+                a = 0.f;
+            }
+            if (s >= size - 1)
+            {
+                s = size - 1;
+                a = 0.f;
+            }
+            index0 = s;
+            index1 = s + 1 < size ? s + 1 : s;
+            weight = (int)(a * WEIGHT_ONE + 0.5f);
+        }
+
+        static inline uint8_t blend(uint32_t h0, uint32_t h1, uint32_t b)
+        {
+            return (uint8_t)((h0 * (WEIGHT_ONE - b) + h1 * b + (1u << 15)) >> 16);
+        }
+
+        template<int CN>
+        static inline void fill_border(uint8_t* dst, int pixels, const uint8_t* border)
+        {
+            bool flat = true;
+            for (int c = 1; c < CN; c++)
+            {
+                flat = flat && border[c] == border[0];
+            }
+            if (flat)
+            {
+                memset(dst, border[0], (size_t)pixels * CN);
+                return;
+            }
+            for (int i = 0; i < pixels; i++, dst += CN)
+            {
+                for (int c = 0; c < CN; c++)
+                {
+                    dst[c] = border[c];
+                }
+            }
+        }
+
+        // channel c of the output is read from channel source_channel of the input, swap reverses the order
+        template<int CN>
+        static inline constexpr int source_channel(int c, bool swap)
+        {
+            return swap ? CN - 1 - c : c;
+        }
+
+        // out[i] = blend(h0[i], h1[i], b) for n values
+        static inline void blend_rows(const uint16_t* h0, const uint16_t* h1, uint8_t* out, int n, uint32_t b)
+        {
+            int i = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+            uint16_t w0 = (uint16_t)(WEIGHT_ONE - b);
+            uint16_t w1 = (uint16_t)b;
+            for (; i + 8 <= n; i += 8)
+            {
+                uint16x8_t a = vld1q_u16(h0 + i);
+                uint16x8_t c = vld1q_u16(h1 + i);
+                uint32x4_t lo = vmlal_n_u16(vmull_n_u16(vget_low_u16(a), w0), vget_low_u16(c), w1);
+                uint32x4_t hi = vmlal_n_u16(vmull_n_u16(vget_high_u16(a), w0), vget_high_u16(c), w1);
+                uint16x8_t r = vcombine_u16(vrshrn_n_u32(lo, 16), vrshrn_n_u32(hi, 16));
+                vst1_u8(out + i, vmovn_u16(r));
+            }
+#elif defined(AX_SAMPLES_SIMD_SSE)
+            __m128i w0 = _mm_set1_epi16((short)(WEIGHT_ONE - b));
+            __m128i w1 = _mm_set1_epi16((short)b);
+            __m128i half = _mm_set1_epi32(1 << 15);
+            for (; i + 8 <= n; i += 8)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i*)(h0 + i));
+                __m128i c = _mm_loadu_si128((const __m128i*)(h1 + i));
+                // 16 x 16 -> 32 bit products from the low and high halves
+                __m128i al = _mm_mullo_epi16(a, w0), ah = _mm_mulhi_epu16(a, w0);
+                __m128i cl = _mm_mullo_epi16(c, w1), ch = _mm_mulhi_epu16(c, w1);
+                __m128i lo = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(al, ah), _mm_unpacklo_epi16(cl, ch)), half);
+                __m128i hi = _mm_add_epi32(_mm_add_epi32(_mm_unpackhi_epi16(al, ah), _mm_unpackhi_epi16(cl, ch)), half);
+                __m128i r = _mm_packs_epi32(_mm_srli_epi32(lo, 16), _mm_srli_epi32(hi, 16));
+                _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(r, r));
+            }
+#endif
+            for (; i < n; i++)
+            {
+                out[i] = blend(h0[i], h1[i], b);
+            }
+        }
+
+        /* per pixel scalar version of bilinear_plane with the same fixed point math */
+        template<int CN>
+        static inline void bilinear_plane_reference(const uint8_t* src, int src_w, int src_h, int src_stride, uint8_t* dst, int dst_w, int dst_h, int dst_stride,
+                                                    const Layout& layout, bool swap, const uint8_t* border)
+        {
+            float scale_x = (float)src_w / (float)layout.scaled_w;
+            float scale_y = (float)src_h / (float)layout.scaled_h;
+            for (int y = 0; y < dst_h; y++)
+            {
+                uint8_t* row = dst + (size_t)y * dst_stride;
+                for (int x = 0; x < dst_w; x++)
+                {
+                    uint8_t* px = row + x * CN;
+                    int dx = x - layout.roi_x;
+                    int dy = y - layout.roi_y;
+                    if (dx < 0 || dy < 0 || dx >= layout.roi_w || dy >= layout.roi_h)
+                    {
+                        for (int c = 0; c < CN; c++)
+                        {
+                            px[c] = border[c];
+                        }
+                        continue;
+                    }
+                    int x0, x1, a, y0, y1, b;
+                    source_coord(dx, layout.offset_x, scale_x, src_w, x0, x1, a);
+                    source_coord(dy, layout.offset_y, scale_y, src_h, y0, y1, b);
+                    const uint8_t* r0 = src + (size_t)y0 * src_stride;
+                    const uint8_t* r1 = src + (size_t)y1 * src_stride;
+                    for (int c = 0; c < CN; c++)
+                    {
+                        int sc = source_channel<CN>(c, swap);
+                        uint32_t h0 = r0[x0 * CN + sc] * (WEIGHT_ONE - a) + r0[x1 * CN + sc] * a;
+                        uint32_t h1 = r1[x0 * CN + sc] * (WEIGHT_ONE - a) + r1[x1 * CN + sc] * a;
+                        px[c] = blend(h0, h1, b);
+                    }
+                }
+            }
+        }
+
+        // one source row interpolated at the precomputed columns, value * 256 per channel (CN <= 3)
+        template<int CN, bool SWAP>
+        static inline void interpolate_columns(const uint8_t* s, const int* x0, const int* x1, const uint16_t* alpha, int n, uint16_t* h)
+        {
+            const int c0 = source_channel<CN>(0, SWAP);
+            const int c1 = source_channel<CN>(1 % CN, SWAP);
+            const int c2 = source_channel<CN>(2 % CN, SWAP);
+            for (int dx = 0; dx < n; dx++)
+            {
+                const uint8_t* p0 = s + x0[dx];
+                const uint8_t* p1 = s + x1[dx];
+                uint32_t a = alpha[dx];
+                uint32_t ia = WEIGHT_ONE - a;
+                h[dx * CN + 0] = (uint16_t)(p0[c0] * ia + p1[c0] * a);
+                if (CN > 1)
+                    h[dx * CN + 1] = (uint16_t)(p0[c1] * ia + p1[c1] * a);
+                if (CN > 2)
+                    h[dx * CN + 2] = (uint16_t)(p0[c2] * ia + p1[c2] * a);
+            }
+        }
+
+        /*
+         * bilinear resize of a packed CN channel plane into the roi of dst with a constant border
+         * and optional channel reversal, in one pass over the destination rows. columns are
+         * interpolated from precomputed offsets into two cached uint16 rows, the row blend is simd.
+         */
+        template<int CN, bool SWAP>
+        static inline void bilinear_plane(const uint8_t* src, int src_w, int src_h, int src_stride, uint8_t* dst, int dst_w, int dst_h, int dst_stride,
+                                          const Layout& layout, const uint8_t* border)
+        {
+            float scale_x = (float)src_w / (float)layout.scaled_w;
+            float scale_y = (float)src_h / (float)layout.scaled_h;
+            const int roi_w = layout.roi_w;
+            const int n = roi_w * CN;
+
+            std::vector<int> xofs0(roi_w), xofs1(roi_w);
+            std::vector<uint16_t> alpha(roi_w);
+            for (int dx = 0; dx < roi_w; dx++)
+            {
+                int x0, x1, a;
+                source_coord(dx, layout.offset_x, scale_x, src_w, x0, x1, a);
+                xofs0[dx] = x0 * CN;
+                xofs1[dx] = x1 * CN;
+                alpha[dx] = (uint16_t)a;
+            }
+
+            // two interpolated source rows, reused while consecutive output rows share them
+            std::vector<uint16_t> cache((size_t)n * 2);
+            uint16_t* rows[2] = {cache.data(), cache.data() + n};
+            int cached[2] = {-1, -1};
+            auto interpolate_row = [&](int sy, int slot) {
+                interpolate_columns<CN, SWAP>(src + (size_t)sy * src_stride, xofs0.data(), xofs1.data(), alpha.data(), roi_w, rows[slot]);
+                cached[slot] = sy;
+            };
+
+            const int roi_bottom = layout.roi_y + layout.roi_h;
+            const int right = dst_w - layout.roi_x - roi_w;
+            for (int y = 0; y < dst_h; y++)
+            {
+                uint8_t* row = dst + (size_t)y * dst_stride;
+                if (y < layout.roi_y || y >= roi_bottom)
+                {
+                    fill_border<CN>(row, dst_w, border);
+                    continue;
+                }
+
+                int y0, y1, b;
+                source_coord(y - layout.roi_y, layout.offset_y, scale_y, src_h, y0, y1, b);
+
+                int slot0 = cached[0] == y0 ? 0 : (cached[1] == y0 ? 1 : -1);
+                if (slot0 < 0)
+                {
+                    slot0 = cached[0] == y1 ? 1 : 0;
+                    interpolate_row(y0, slot0);
+                }
+                int slot1 = 1 - slot0;
+                if (cached[slot1] != y1)
+                {
+                    interpolate_row(y1, slot1);
+                }
+
+                fill_border<CN>(row, layout.roi_x, border);
+                blend_rows(rows[slot0], rows[slot1], row + layout.roi_x * CN, n, b);
+                fill_border<CN>(row + (layout.roi_x + roi_w) * CN, right, border);
+            }
+        }
+    } // namespace detail
+
+    /* packed 1 to 3 channel plane, border holds one value per channel, swap reverses the channel order */
+    template<int CN>
+    static inline void bilinear_plane(const uint8_t* src, int src_w, int src_h, int src_stride, uint8_t* dst, int dst_w, int dst_h, int dst_stride,
+                                      const Layout& layout, bool swap, const uint8_t* border)
+    {
+        if (swap)
+            detail::bilinear_plane<CN, true>(src, src_w, src_h, src_stride, dst, dst_w, dst_h, dst_stride, layout, border);
+        else
+            detail::bilinear_plane<CN, false>(src, src_w, src_h, src_stride, dst, dst_w, dst_h, dst_stride, layout, border);
+    }
+
+    /*
+     * per pixel scalar version of bilinear_letterbox with the same fixed point math,
+     * the fast path has to match it bit by bit
+     */
+    static inline void bilinear_letterbox_reference(const uint8_t* src, int src_w, int src_h, int src_stride, uint8_t* dst, int dst_w, int dst_h, int dst_stride,
+                                                    const Layout& layout, bool swap_rb = false, uint8_t border = 0)
+    {
+        const uint8_t value[3] = {border, border, border};
+        detail::bilinear_plane_reference<3>(src, src_w, src_h, src_stride, dst, dst_w, dst_h, dst_stride, layout, swap_rb, value);
+    }
+
+    /*
+     * bilinear resize of a packed 3 channel image into the roi of dst, constant border around
+     * it and optional r / b swap, in one pass over the destination rows
+     */
+    static inline void bilinear_letterbox(const uint8_t* src, int src_w, int src_h, int src_stride, uint8_t* dst, int dst_w, int dst_h, int dst_stride,
+                                          const Layout& layout, bool swap_rb = false, uint8_t border = 0)
+    {
+        const uint8_t value[3] = {border, border, border};
+        bilinear_plane<3>(src, src_w, src_h, src_stride, dst, dst_w, dst_h, dst_stride, layout, swap_rb, value);
+    }
+} // namespace resize
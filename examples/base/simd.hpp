@@ -0,0 +1,206 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+
+/* AX_SAMPLES_NO_SIMD keeps the scalar paths, so they can be tested on a simd host */
+#if defined(AX_SAMPLES_NO_SIMD)
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AX_SAMPLES_SIMD_NEON 1
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define AX_SAMPLES_SIMD_AVX 1
+#define AX_SAMPLES_SIMD_SSE 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AX_SAMPLES_SIMD_SSE 1
+#endif
+
+namespace simd
+{
+#if defined(AX_SAMPLES_SIMD_NEON)
+    static inline bool any_lane(uint32x4_t mask)
+    {
+#if defined(__aarch64__)
+        return vmaxvq_u32(mask) != 0;
+#else
+        uint32x2_t m = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+        return vget_lane_u32(vpmax_u32(m, m), 0) != 0;
+#endif
+    }
+#endif
+
+    // true if any of src[0, n) > threshold, 16 values are reduced per compare so
+    // most rejected cells leave the loop after a few iterations
+    static inline bool any_greater(const float* src, int n, float threshold)
+    {
+        int i = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+        float32x4_t thr = vdupq_n_f32(threshold);
+        for (; i + 16 <= n; i += 16)
+        {
+            float32x4_t m0 = vmaxq_f32(vld1q_f32(src + i), vld1q_f32(src + i + 4));
+            float32x4_t m1 = vmaxq_f32(vld1q_f32(src + i + 8), vld1q_f32(src + i + 12));
+            if (any_lane(vcgtq_f32(vmaxq_f32(m0, m1), thr)))
+                return true;
+        }
+        for (; i + 4 <= n; i += 4)
+        {
+            if (any_lane(vcgtq_f32(vld1q_f32(src + i), thr)))
+                return true;
+        }
+#elif defined(AX_SAMPLES_SIMD_AVX)
+        __m256 thr = _mm256_set1_ps(threshold);
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256 m = _mm256_max_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(src + i + 8));
+            if (_mm256_movemask_ps(_mm256_cmp_ps(m, thr, _CMP_GT_OQ)))
+                return true;
+        }
+        for (; i + 8 <= n; i += 8)
+        {
+            if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(src + i), thr, _CMP_GT_OQ)))
+                return true;
+        }
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        __m128 thr = _mm_set1_ps(threshold);
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128 m0 = _mm_max_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(src + i + 4));
+            __m128 m1 = _mm_max_ps(_mm_loadu_ps(src + i + 8), _mm_loadu_ps(src + i + 12));
+            if (_mm_movemask_ps(_mm_cmpgt_ps(_mm_max_ps(m0, m1), thr)))
+                return true;
+        }
+        for (; i + 4 <= n; i += 4)
+        {
+            if (_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(src + i), thr)))
+                return true;
+        }
+#endif
+        for (; i < n; i++)
+        {
+            if (src[i] > threshold)
+                return true;
+        }
+        return false;
+    }
+
+    // quantized npu outputs, compared in the integer domain
+    static inline bool any_greater(const int8_t* src, int n, int8_t threshold)
+    {
+        int i = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+        int8x16_t thr = vdupq_n_s8(threshold);
+        for (; i + 16 <= n; i += 16)
+        {
+            if (any_lane(vreinterpretq_u32_u8(vcgtq_s8(vld1q_s8(src + i), thr))))
+                return true;
+        }
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        __m128i thr = _mm_set1_epi8(threshold);
+        for (; i + 16 <= n; i += 16)
+        {
+            if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_loadu_si128((const __m128i*)(src + i)), thr)))
+                return true;
+        }
+#endif
+        for (; i < n; i++)
+        {
+            if (src[i] > threshold)
+                return true;
+        }
+        return false;
+    }
+
+    static inline bool any_greater(const uint8_t* src, int n, uint8_t threshold)
+    {
+        int i = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+        uint8x16_t thr = vdupq_n_u8(threshold);
+        for (; i + 16 <= n; i += 16)
+        {
+            if (any_lane(vreinterpretq_u32_u8(vcgtq_u8(vld1q_u8(src + i), thr))))
+                return true;
+        }
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        // sse2 has no unsigned compare, flip the sign bit and compare signed
+        __m128i sign = _mm_set1_epi8((char)0x80);
+        __m128i thr = _mm_xor_si128(_mm_set1_epi8((char)threshold), sign);
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(src + i)), sign);
+            if (_mm_movemask_epi8(_mm_cmpgt_epi8(v, thr)))
+                return true;
+        }
+#endif
+        for (; i < n; i++)
+        {
+            if (src[i] > threshold)
+                return true;
+        }
+        return false;
+    }
+
+    static inline bool any_greater(const uint16_t* src, int n, uint16_t threshold)
+    {
+        int i = 0;
+#if defined(AX_SAMPLES_SIMD_NEON)
+        uint16x8_t thr = vdupq_n_u16(threshold);
+        for (; i + 8 <= n; i += 8)
+        {
+            if (any_lane(vreinterpretq_u32_u16(vcgtq_u16(vld1q_u16(src + i), thr))))
+                return true;
+        }
+#elif defined(AX_SAMPLES_SIMD_SSE)
+        __m128i sign = _mm_set1_epi16((short)0x8000);
+        __m128i thr = _mm_xor_si128(_mm_set1_epi16((short)threshold), sign);
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(src + i)), sign);
+            if (_mm_movemask_epi8(_mm_cmpgt_epi16(v, thr)))
+                return true;
+        }
+#endif
+        for (; i < n; i++)
+        {
+            if (src[i] > threshold)
+                return true;
+        }
+        return false;
+    }
+
+    // index of the first maximum, same tie-breaking as the scalar loops in detection.hpp
+    template<typename T>
+    static inline int argmax(const T* src, int n, T& max_value)
+    {
+        int index = 0;
+        T value = src[0];
+        for (int i = 1; i < n; i++)
+        {
+            if (src[i] > value)
+            {
+                index = i;
+                value = src[i];
+            }
+        }
+        max_value = value;
+        return index;
+    }
+} // namespace simd
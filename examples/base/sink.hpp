@@ -0,0 +1,320 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "base/detection.hpp"
+#include "utilities/timer.hpp"
+
+/*
+ * result output off the inference loop: drawing, jpeg encoding and txt / json lines writes
+ * run on writer threads behind a bounded queue. push blocks while the queue is full, so a
+ * slow disk throttles the loop instead of growing memory.
+ */
+namespace sink
+{
+    enum Mode
+    {
+        MODE_NONE = 0,
+        MODE_TXT = 1 << 0,   // <name>.txt, see detection::save_txt
+        MODE_JSONL = 1 << 1, // one line per image in <output_dir>/results.jsonl
+        MODE_JPEG = 1 << 2,  // <name>.jpg with boxes drawn
+    };
+
+    /* "none", or any of "txt", "jsonl", "jpeg" joined by ',', -1 on an unknown name */
+    static inline int parse_modes(const std::string& text)
+    {
+        int modes = MODE_NONE;
+        std::string::size_type begin = 0;
+        while (begin <= text.size())
+        {
+            auto end = text.find(',', begin);
+            if (end == std::string::npos)
+                end = text.size();
+            std::string name = text.substr(begin, end - begin);
+            if (name == "txt")
+                modes |= MODE_TXT;
+            else if (name == "jsonl")
+                modes |= MODE_JSONL;
+            else if (name == "jpeg" || name == "jpg")
+                modes |= MODE_JPEG;
+            else if (name != "none" && !name.empty())
+            {
+                fprintf(stderr, "Unknown output mode %s.\n", name.c_str());
+                return -1;
+            }
+            begin = end + 1;
+        }
+        return modes;
+    }
+
+    typedef struct Options
+    {
+        std::string output_dir;
+        int modes;
+        int jpeg_quality;
+        int num_workers;
+        int queue_depth;
+        const char** class_names;
+        double font_scale;
+        int thickness;
+    } Options;
+
+    static inline Options make_options(const std::string& output_dir, int modes, const char** class_names, int jpeg_quality = 95)
+    {
+        return Options{output_dir, modes, jpeg_quality, 1, 16, class_names, 0.5, 1};
+    }
+
+    typedef struct Stats
+    {
+        size_t written;
+        size_t failed;
+        float blocked_ms; // time push() waited on a full queue
+        float write_ms;   // render + encode + write, summed over the writers
+    } Stats;
+
+    class writer
+    {
+    public:
+        explicit writer(const Options& options)
+            : options(options)
+        {
+            if (options.modes & MODE_JSONL)
+            {
+                std::string path = options.output_dir + "/results.jsonl";
+                jsonl = fopen(path.c_str(), "w");
+                if (!jsonl)
+                    fprintf(stderr, "[ERR] cannot open file %s \n", path.c_str());
+            }
+            int num_workers = options.num_workers > 0 ? options.num_workers : 1;
+            for (int i = 0; i < num_workers; i++)
+            {
+                workers.emplace_back(&writer::worker_loop, this);
+            }
+        }
+
+        ~writer()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            job_cond.notify_all();
+            for (auto& t : workers)
+            {
+                t.join();
+            }
+            if (jsonl)
+                fclose(jsonl);
+        }
+
+        writer(const writer&) = delete;
+        writer& operator=(const writer&) = delete;
+
+        /*
+         * queues the results of one image, name is the output path without extension.
+         * image is shared, not copied: the caller must not write into its pixels afterwards.
+         */
+        void push(const std::string& name, const cv::Mat& image, const std::vector<detection::Object>& objects)
+        {
+            if (options.modes == MODE_NONE)
+                return;
+            Job job;
+            job.name = name;
+            job.image = image;
+            job.objects = objects;
+            job.raw = false;
+            enqueue(std::move(job));
+        }
+
+        /* plain image write, e.g. debug crops, at the configured jpeg quality */
+        void push_image(const std::string& path, const cv::Mat& image)
+        {
+            Job job;
+            job.name = path;
+            job.image = image;
+            job.raw = true;
+            enqueue(std::move(job));
+        }
+
+        /* blocks until every queued job is written */
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            idle_cond.wait(lock, [this] { return jobs.empty() && busy == 0; });
+            if (jsonl)
+                fflush(jsonl);
+        }
+
+        Stats stats()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return current;
+        }
+
+    private:
+        typedef struct Job
+        {
+            std::string name;
+            cv::Mat image;
+            std::vector<detection::Object> objects;
+            bool raw;
+        } Job;
+
+        void enqueue(Job&& job)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (jobs.size() >= (size_t)std::max(options.queue_depth, 1))
+            {
+                timer timer_blocked;
+                space_cond.wait(lock, [this] { return jobs.size() < (size_t)std::max(options.queue_depth, 1); });
+                current.blocked_ms += timer_blocked.cost();
+            }
+            jobs.push_back(std::move(job));
+            lock.unlock();
+            job_cond.notify_one();
+        }
+
+        std::string to_json(const Job& job) const
+        {
+            std::string line = "{\"image\":\"" + escape(job.name) + "\",\"width\":" + std::to_string(job.image.cols) +
+                               ",\"height\":" + std::to_string(job.image.rows) + ",\"objects\":[";
+            // names are appended as they are, only the numbers go through the buffer
+            char numbers[256];
+            for (size_t i = 0; i < job.objects.size(); i++)
+            {
+                const auto& obj = job.objects[i];
+                line += i ? ",{\"label\":" : "{\"label\":";
+                line += std::to_string(obj.label) + ",\"name\":\"";
+                if (options.class_names)
+                    line += escape(options.class_names[obj.label]);
+                snprintf(numbers, sizeof(numbers), "\",\"prob\":%.4f,\"bbox\":[%.1f,%.1f,%.1f,%.1f]}",
+                         obj.prob, obj.rect.x, obj.rect.y, obj.rect.width, obj.rect.height);
+                line += numbers;
+            }
+            return line + "]}\n";
+        }
+
+        static std::string escape(const std::string& text)
+        {
+            std::string out;
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    out += '\\';
+                    out += c;
+                }
+                else if ((unsigned char)c < 0x20)
+                {
+                    // control characters are not allowed raw in a json string
+                    char code[8];
+                    snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+                    out += code;
+                }
+                else
+                {
+                    out += c;
+                }
+            }
+            return out;
+        }
+
+        bool write(const Job& job)
+        {
+            std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, options.jpeg_quality};
+            if (job.raw)
+                return cv::imwrite(job.name, job.image, params);
+
+            bool ok = true;
+            if (options.modes & MODE_TXT)
+                ok &= detection::save_txt(job.image, job.objects, job.name);
+            if ((options.modes & MODE_JSONL) && jsonl)
+            {
+                std::string line = to_json(job);
+                std::lock_guard<std::mutex> lock(jsonl_mutex);
+                ok &= fwrite(line.data(), 1, line.size(), jsonl) == line.size();
+            }
+            // drawing only happens for jpeg output
+            if (options.modes & MODE_JPEG)
+            {
+                cv::Mat rendered = detection::render_objects(job.image, job.objects, options.class_names, options.font_scale, options.thickness);
+                ok &= cv::imwrite(job.name + ".jpg", rendered, params);
+            }
+            return ok;
+        }
+
+        void worker_loop()
+        {
+            for (;;)
+            {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    job_cond.wait(lock, [this] { return stop || !jobs.empty(); });
+                    // queued jobs are still written on shutdown
+                    if (jobs.empty())
+                        return;
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                    busy++;
+                }
+                space_cond.notify_one();
+
+                timer timer_write;
+                bool ok = write(job);
+                float cost = timer_write.cost();
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    busy--;
+                    current.write_ms += cost;
+                    if (ok)
+                        current.written++;
+                    else
+                        current.failed++;
+                }
+                idle_cond.notify_all();
+            }
+        }
+
+        Options options;
+        FILE* jsonl = nullptr;
+        std::mutex jsonl_mutex;
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable job_cond;
+        std::condition_variable space_cond;
+        std::condition_variable idle_cond;
+        std::deque<Job> jobs;
+        int busy = 0;
+        Stats current = {0, 0, 0.f, 0.f};
+        bool stop = false;
+    };
+} // namespace sink
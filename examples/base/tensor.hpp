@@ -0,0 +1,175 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+
+namespace tensor
+{
+    enum DataType
+    {
+        DT_FLOAT32 = 0,
+        DT_SINT8 = 1,
+        DT_UINT8 = 2,
+        DT_UINT16 = 3,
+    };
+
+    /* per-tensor affine quantization, real = (q - zero_point) * scale, scale > 0 */
+    typedef struct QuantParam
+    {
+        float scale;
+        int32_t zero_point;
+    } QuantParam;
+
+    /* npu output tensor as it is in cmm, without dequantization */
+    typedef struct View
+    {
+        const void* data;
+        DataType dtype;
+        QuantParam quant;
+    } View;
+
+    static inline View make_view(const float* data)
+    {
+        return View{data, DT_FLOAT32, {1.f, 0}};
+    }
+
+    static inline View make_view(const int8_t* data, float scale, int32_t zero_point)
+    {
+        return View{data, DT_SINT8, {scale, zero_point}};
+    }
+
+    static inline View make_view(const uint8_t* data, float scale, int32_t zero_point)
+    {
+        return View{data, DT_UINT8, {scale, zero_point}};
+    }
+
+    static inline View make_view(const uint16_t* data, float scale, int32_t zero_point)
+    {
+        return View{data, DT_UINT16, {scale, zero_point}};
+    }
+
+    static inline size_t element_size(DataType dtype)
+    {
+        switch (dtype)
+        {
+        case DT_SINT8:
+        case DT_UINT8:
+            return 1;
+        case DT_UINT16:
+            return 2;
+        default:
+            return 4;
+        }
+    }
+
+    /* view of the element at offset, keeping type and quantization */
+    static inline View offset(const View& view, size_t elements)
+    {
+        View v = view;
+        v.data = (const uint8_t*)view.data + elements * element_size(view.dtype);
+        return v;
+    }
+
+    static inline float dequantize(float q, const QuantParam&)
+    {
+        return q;
+    }
+
+    template<typename T>
+    static inline float dequantize(T q, const QuantParam& quant)
+    {
+        return (float)((int32_t)q - quant.zero_point) * quant.scale;
+    }
+
+    template<typename T>
+    static inline void dequantize(const T* src, float* dst, int n, const QuantParam& quant)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            dst[i] = dequantize(src[i], quant);
+        }
+    }
+
+    static inline void dequantize(const View& view, float* dst, int n)
+    {
+        switch (view.dtype)
+        {
+        case DT_SINT8:
+            dequantize((const int8_t*)view.data, dst, n, view.quant);
+            break;
+        case DT_UINT8:
+            dequantize((const uint8_t*)view.data, dst, n, view.quant);
+            break;
+        case DT_UINT16:
+            dequantize((const uint16_t*)view.data, dst, n, view.quant);
+            break;
+        default:
+            dequantize((const float*)view.data, dst, n, view.quant);
+            break;
+        }
+    }
+
+    /* calls fn with the data pointer of view cast to its element type */
+    template<typename Fn>
+    static inline void visit(const View& view, Fn&& fn)
+    {
+        switch (view.dtype)
+        {
+        case DT_SINT8:
+            fn((const int8_t*)view.data);
+            break;
+        case DT_UINT8:
+            fn((const uint8_t*)view.data);
+            break;
+        case DT_UINT16:
+            fn((const uint16_t*)view.data);
+            break;
+        default:
+            fn((const float*)view.data);
+            break;
+        }
+    }
+
+    /*
+     * threshold on the stored values: dequantize(q) > value  <=>  q > quantize_threshold(value).
+     * all_pass / none_pass report thresholds outside of the range of T.
+     */
+    template<typename T>
+    static inline T quantize_threshold(float value, const QuantParam& quant, bool& all_pass, bool& none_pass)
+    {
+        double q = std::floor((double)value / quant.scale + quant.zero_point);
+        all_pass = q < (double)std::numeric_limits<T>::min();
+        none_pass = q >= (double)std::numeric_limits<T>::max();
+        if (all_pass)
+            return std::numeric_limits<T>::min();
+        if (none_pass)
+            return std::numeric_limits<T>::max();
+        return (T)q;
+    }
+
+    template<>
+    inline float quantize_threshold<float>(float value, const QuantParam&, bool& all_pass, bool& none_pass)
+    {
+        all_pass = false;
+        none_pass = false;
+        return value;
+    }
+} // namespace tensor
@@ -0,0 +1,182 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace parallel
+{
+    /*
+     * persistent worker pool for post processing. the calling thread takes part in every
+     * parallel_for as worker 0, so a pool of size 1 runs inline without any thread.
+     * parallel_for is not reentrant and must be called from one thread at a time.
+     */
+    class thread_pool
+    {
+    public:
+        // num_threads <= 0 uses every core, cpu_ids[k] pins the k-th pool thread (worker k + 1)
+        explicit thread_pool(int num_threads = 1, const std::vector<int>& cpu_ids = std::vector<int>())
+        {
+            if (num_threads <= 0)
+            {
+                num_threads = (int)std::thread::hardware_concurrency();
+            }
+            if (num_threads <= 0)
+            {
+                num_threads = 1;
+            }
+
+            for (int i = 1; i < num_threads; i++)
+            {
+                threads.emplace_back(&thread_pool::worker_loop, this, i);
+                if ((size_t)(i - 1) < cpu_ids.size() && !set_affinity(threads.back(), cpu_ids[i - 1]))
+                {
+                    fprintf(stderr, "Bind post process worker %d to cpu %d failed.\n", i, cpu_ids[i - 1]);
+                }
+            }
+        }
+
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            start_cond.notify_all();
+            for (auto& t : threads)
+            {
+                t.join();
+            }
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        int size() const
+        {
+            return (int)threads.size() + 1;
+        }
+
+        // runs fn(task, worker) for every task in [0, num_tasks) and returns when all are done
+        template<typename Fn>
+        void parallel_for(int num_tasks, Fn&& fn)
+        {
+            if (threads.empty() || num_tasks <= 1)
+            {
+                for (int t = 0; t < num_tasks; t++)
+                {
+                    fn(t, 0);
+                }
+                return;
+            }
+
+            std::function<void(int, int)> job = std::forward<Fn>(fn);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                task_fn = &job;
+                task_count = num_tasks;
+                next_task = 0;
+                pending = (int)threads.size();
+                generation++;
+            }
+            start_cond.notify_all();
+
+            run_tasks(0);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            done_cond.wait(lock, [this] { return pending == 0; });
+            task_fn = nullptr;
+        }
+
+        static bool set_affinity(std::thread& thread, int cpu)
+        {
+#if defined(__linux__) && defined(CPU_SET)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+            (void)thread;
+            (void)cpu;
+            return false;
+#endif
+        }
+
+    private:
+        void run_tasks(int worker)
+        {
+            for (;;)
+            {
+                int t = next_task.fetch_add(1);
+                if (t >= task_count)
+                {
+                    break;
+                }
+                (*task_fn)(t, worker);
+            }
+        }
+
+        void worker_loop(int worker)
+        {
+            uint64_t seen = 0;
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    start_cond.wait(lock, [&] { return stop || generation != seen; });
+                    if (stop)
+                    {
+                        return;
+                    }
+                    seen = generation;
+                }
+
+                run_tasks(worker);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0)
+                {
+                    done_cond.notify_one();
+                }
+            }
+        }
+
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable start_cond;
+        std::condition_variable done_cond;
+        const std::function<void(int, int)>* task_fn = nullptr;
+        int task_count = 0;
+        std::atomic<int> next_task{0};
+        int pending = 0;
+        uint64_t generation = 0;
+        bool stop = false;
+    };
+} // namespace parallel
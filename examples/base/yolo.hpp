@@ -26,6 +26,8 @@
 #include <algorithm>
 #include <cmath>
 
+#include "base/nms.hpp"
+
 namespace yolo
 {
     enum
@@ -55,87 +57,25 @@ namespace yolo
     {
         return (float)(1.f / (1.f + std::exp(-x)));
     }
-    static inline float intersection_area(const BBoxRect& a, const BBoxRect& b)
-    {
-        if (a.xmin > b.xmax || a.xmax < b.xmin || a.ymin > b.ymax || a.ymax < b.ymin)
-        {
-            // no intersection
-            return 0.f;
-        }
-
-        float inter_width = std::min(a.xmax, b.xmax) - std::max(a.xmin, b.xmin);
-        float inter_height = std::min(a.ymax, b.ymax) - std::max(a.ymin, b.ymin);
-
-        return inter_width * inter_height;
-    }
-    static void qsort_descent_inplace(std::vector<BBoxRect>& datas, int left, int right)
-    {
-        int i = left;
-        int j = right;
-        float p = datas[(left + right) / 2].score;
-
-        while (i <= j)
-        {
-            while (datas[i].score > p)
-                i++;
-
-            while (datas[j].score < p)
-                j--;
-
-            if (i <= j)
-            {
-                // swap
-                std::swap(datas[i], datas[j]);
-
-                i++;
-                j--;
-            }
-        }
-
-        if (left < j)
-            qsort_descent_inplace(datas, left, j);
-
-        if (i < right)
-            qsort_descent_inplace(datas, i, right);
-    }
 
-    static void qsort_descent_inplace(std::vector<BBoxRect>& datas)
+    /* same score order and tie rule as detection::sort_top_k */
+    static inline void sort_descent(std::vector<BBoxRect>& bboxes)
     {
-        if (datas.empty())
-            return;
-
-        qsort_descent_inplace(datas, 0, (int)(datas.size() - 1));
+        nms::sort_top_k(bboxes, [](const BBoxRect& b) { return b.score; });
     }
 
     static void nms_sorted_bboxes(std::vector<BBoxRect>& bboxes, std::vector<size_t>& picked, float nms_threshold)
     {
-        picked.clear();
-
-        const size_t n = bboxes.size();
-
-        for (size_t i = 0; i < n; i++)
+        nms::Boxes boxes;
+        boxes.reserve(bboxes.size());
+        for (const auto& b : bboxes)
         {
-            const BBoxRect& a = bboxes[i];
-
-            int keep = 1;
-            for (unsigned int j : picked)
-            {
-                const BBoxRect& b = bboxes[j];
-
-                // intersection over union
-                float inter_area = intersection_area(a, b);
-                float union_area = a.area + b.area - inter_area;
-                // float IoU = inter_area / union_area
-                if (inter_area > nms_threshold * union_area)
-                {
-                    keep = 0;
-                    break;
-                }
-            }
-
-            if (keep)
-                picked.push_back(i);
+            boxes.push_back(b.xmin, b.ymin, b.xmax, b.ymax, b.area, b.label);
         }
+
+        std::vector<int> kept;
+        nms::nms_sorted(boxes, kept, nms_threshold);
+        picked.assign(kept.begin(), kept.end());
     }
 
     struct TMat
@@ -389,7 +329,7 @@ namespace yolo
         }
 
         // global sort inplace
-        qsort_descent_inplace(all_bbox_rects);
+        sort_descent(all_bbox_rects);
 
         // apply nms
         std::vector<size_t> picked;
@@ -533,7 +473,7 @@ namespace yolo
         }
 
         // global sort inplace
-        qsort_descent_inplace(all_bbox_rects);
+        sort_descent(all_bbox_rects);
 
         // apply nms
         std::vector<size_t> picked;
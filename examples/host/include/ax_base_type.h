@@ -0,0 +1,45 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef _AX_BASE_TYPE_H_
+#define _AX_BASE_TYPE_H_
+
+/* host replay backend: the scalar types of the board sdk */
+
+#include <stdint.h>
+
+typedef uint8_t AX_U8;
+typedef uint16_t AX_U16;
+typedef uint32_t AX_U32;
+typedef uint64_t AX_U64;
+typedef int8_t AX_S8;
+typedef int16_t AX_S16;
+typedef int32_t AX_S32;
+typedef int64_t AX_S64;
+typedef char AX_CHAR;
+typedef float AX_F32;
+typedef double AX_F64;
+typedef void AX_VOID;
+
+typedef enum
+{
+    AX_FALSE = 0,
+    AX_TRUE = 1,
+} AX_BOOL;
+
+#define AX_SUCCESS 0
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef _AX_ENGINE_API_H_
+#define _AX_ENGINE_API_H_
+
+/*
+ * host replay backend: the AX_ENGINE subset used by the samples and middleware, laid out
+ * after the ax650 sdk. the model buffer given to AX_ENGINE_CreateHandle is a text manifest,
+ * see examples/host/README.md.
+ */
+
+#include "ax_base_type.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef AX_VOID* AX_ENGINE_HANDLE;
+typedef AX_VOID* AX_ENGINE_CONTEXT_T;
+typedef AX_S32 AX_ENGINE_NPU_SET_T;
+
+typedef enum
+{
+    AX_ENGINE_TENSOR_LAYOUT_UNKNOWN = 0,
+    AX_ENGINE_TENSOR_LAYOUT_NHWC = 1,
+    AX_ENGINE_TENSOR_LAYOUT_NCHW = 2,
+} AX_ENGINE_TENSOR_LAYOUT_T;
+
+typedef enum
+{
+    AX_ENGINE_MT_PHYSICAL = 0,
+    AX_ENGINE_MT_VIRTUAL = 1,
+    AX_ENGINE_MT_OCM = 2,
+} AX_ENGINE_MEMORY_TYPE_T;
+
+typedef enum
+{
+    AX_ENGINE_DT_UNKNOWN = 0,
+    AX_ENGINE_DT_UINT8 = 1,
+    AX_ENGINE_DT_UINT16 = 2,
+    AX_ENGINE_DT_FLOAT32 = 3,
+    AX_ENGINE_DT_SINT16 = 4,
+    AX_ENGINE_DT_SINT8 = 5,
+    AX_ENGINE_DT_SINT32 = 6,
+    AX_ENGINE_DT_UINT32 = 7,
+    AX_ENGINE_DT_FLOAT64 = 8,
+    AX_ENGINE_DT_UINT10_PACKED = 100,
+    AX_ENGINE_DT_UINT12_PACKED = 101,
+    AX_ENGINE_DT_UINT14_PACKED = 102,
+    AX_ENGINE_DT_UINT16_PACKED = 103,
+} AX_ENGINE_DATA_TYPE_T;
+
+typedef enum
+{
+    AX_ENGINE_CS_FEATUREMAP = 0,
+    AX_ENGINE_CS_RAW8 = 12,
+    AX_ENGINE_CS_RAW10 = 13,
+    AX_ENGINE_CS_RAW12 = 14,
+    AX_ENGINE_CS_RAW14 = 15,
+    AX_ENGINE_CS_RAW16 = 16,
+    AX_ENGINE_CS_NV12 = 20,
+    AX_ENGINE_CS_NV21 = 21,
+    AX_ENGINE_CS_RGB = 30,
+    AX_ENGINE_CS_BGR = 31,
+    AX_ENGINE_CS_RGBA = 32,
+    AX_ENGINE_CS_GRAY = 33,
+    AX_ENGINE_CS_YUV444 = 34,
+} AX_ENGINE_COLOR_SPACE_T;
+
+typedef enum
+{
+    AX_ENGINE_VIRTUAL_NPU_DISABLE = 0,
+    AX_ENGINE_VIRTUAL_NPU_STD = 1,
+    AX_ENGINE_VIRTUAL_NPU_BIG_LITTLE = 2,
+} AX_ENGINE_NPU_MODE_T;
+
+typedef struct
+{
+    AX_ENGINE_NPU_MODE_T eHardMode;
+    AX_U32 reserve[8];
+} AX_ENGINE_NPU_ATTR_T;
+
+typedef struct
+{
+    AX_ENGINE_NPU_SET_T nNpuSet;
+    AX_S8* pName;
+    AX_U32 reserve[8];
+} AX_ENGINE_HANDLE_EXTRA_T;
+
+typedef struct
+{
+    AX_ENGINE_COLOR_SPACE_T eColorSpace;
+    AX_U64 u64Reserved[18];
+} AX_ENGINE_IOMETA_EX_T;
+
+typedef struct
+{
+    AX_CHAR* pName;
+    AX_S32* pShape;
+    AX_U8 nShapeSize;
+    AX_ENGINE_TENSOR_LAYOUT_T eLayout;
+    AX_ENGINE_MEMORY_TYPE_T eMemoryType;
+    AX_ENGINE_DATA_TYPE_T eDataType;
+    AX_ENGINE_IOMETA_EX_T* pExtraMeta;
+    AX_U32 nSize;
+    AX_U32 nQuantizationValue;
+    AX_S32* pStride;
+    AX_U64 u64Reserved[9];
+} AX_ENGINE_IOMETA_T;
+
+typedef struct
+{
+    AX_ENGINE_IOMETA_T* pInputs;
+    AX_U32 nInputSize;
+    AX_ENGINE_IOMETA_T* pOutputs;
+    AX_U32 nOutputSize;
+    AX_U32 nMaxBatchSize;
+    AX_BOOL bDynamicBatchSize;
+    AX_U64 u64Reserved[11];
+} AX_ENGINE_IO_INFO_T;
+
+typedef struct
+{
+    AX_U64 phyAddr;
+    AX_VOID* pVirAddr;
+    AX_U32 nSize;
+    AX_S32* pStride;
+    AX_U8 nStrideSize;
+    AX_U64 u64Reserved[11];
+} AX_ENGINE_IO_BUFFER_T;
+
+typedef struct
+{
+    AX_U32 nWbtIndex;
+    AX_U64 u64Reserved[7];
+} AX_ENGINE_IO_SETTING_T;
+
+typedef struct
+{
+    AX_ENGINE_IO_BUFFER_T* pInputs;
+    AX_U32 nInputSize;
+    AX_ENGINE_IO_BUFFER_T* pOutputs;
+    AX_U32 nOutputSize;
+    AX_U32 nBatchSize;
+    AX_ENGINE_IO_SETTING_T* pIoSetting;
+    AX_U64 u64Reserved[10];
+} AX_ENGINE_IO_T;
+
+AX_S32 AX_ENGINE_Init(AX_ENGINE_NPU_ATTR_T* pNpuAttr);
+AX_S32 AX_ENGINE_Deinit(AX_VOID);
+AX_S32 AX_ENGINE_NPUReset(AX_VOID);
+const AX_CHAR* AX_ENGINE_GetVersion(AX_VOID);
+
+AX_S32 AX_ENGINE_CreateHandle(AX_ENGINE_HANDLE* pHandle, const AX_VOID* pData, AX_U32 nDataSize);
+AX_S32 AX_ENGINE_CreateHandleV2(AX_ENGINE_HANDLE* pHandle, const AX_VOID* pData, AX_U32 nDataSize, AX_ENGINE_HANDLE_EXTRA_T* pExtraParam);
+AX_S32 AX_ENGINE_DestroyHandle(AX_ENGINE_HANDLE nHandle);
+
+AX_S32 AX_ENGINE_CreateContext(AX_ENGINE_HANDLE handle);
+AX_S32 AX_ENGINE_CreateContextV2(AX_ENGINE_HANDLE nHandle, AX_ENGINE_CONTEXT_T* pContext);
+AX_S32 AX_ENGINE_GetIOInfo(AX_ENGINE_HANDLE nHandle, AX_ENGINE_IO_INFO_T** pIO);
+
+AX_S32 AX_ENGINE_RunSync(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_T* pIO);
+AX_S32 AX_ENGINE_RunSyncV2(AX_ENGINE_HANDLE handle, AX_ENGINE_CONTEXT_T context, AX_ENGINE_IO_T* pIO);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#ifndef _AX_SYS_API_H_
+#define _AX_SYS_API_H_
+
+/*
+ * host replay backend: the AX_SYS subset used by the samples. cmm memory is plain
+ * aligned host memory and the physical address is the virtual one.
+ */
+
+#include "ax_base_type.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+AX_S32 AX_SYS_Init(AX_VOID);
+AX_S32 AX_SYS_Deinit(AX_VOID);
+
+AX_S32 AX_SYS_MemAlloc(AX_U64* phyaddr, AX_VOID** pviraddr, AX_U32 size, AX_U32 align, const AX_S8* token);
+AX_S32 AX_SYS_MemAllocCached(AX_U64* phyaddr, AX_VOID** pviraddr, AX_U32 size, AX_U32 align, const AX_S8* token);
+AX_S32 AX_SYS_MemFree(AX_U64 phyaddr, AX_VOID* pviraddr);
+
+AX_S32 AX_SYS_MflushCache(AX_U64 phyaddr, AX_VOID* pviraddr, AX_U32 size);
+AX_S32 AX_SYS_MinvalidateCache(AX_U64 phyaddr, AX_VOID* pviraddr, AX_U32 size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,657 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * host replay backend: AX_SYS / AX_ENGINE on an ordinary linux machine. the model "file"
+ * is a text manifest describing the io tensors, outputs are replayed from recorded tensor
+ * files and every run takes the latency given in the manifest, so the cpu side of a sample
+ * (preprocess, post process, threading) runs and can be profiled as it would on the board.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ax_sys_api.h"
+#include "ax_engine_api.h"
+
+#include "middleware/capture.hpp"
+
+namespace host
+{
+    // error codes in the ax style: module 0x80 | engine / sys, then the reason
+    const AX_S32 ERR_NULL_PTR = (AX_S32)0x80060006;
+    const AX_S32 ERR_ILLEGAL_PARAM = (AX_S32)0x80060007;
+    const AX_S32 ERR_NOT_INIT = (AX_S32)0x80060010;
+    const AX_S32 ERR_NO_MEMORY = (AX_S32)0x8002000C;
+
+    const int NUM_CORES = 3;
+
+    typedef struct Tensor
+    {
+        std::string name;
+        std::vector<AX_S32> shape;
+        AX_ENGINE_DATA_TYPE_T dtype;
+        AX_ENGINE_TENSOR_LAYOUT_T layout;
+        AX_ENGINE_COLOR_SPACE_T color;
+        size_t size = 0; // nSize when it is not the packed shape (taken from a capture)
+        std::string replay_path;
+        std::vector<char> records; // recorded outputs, one image of the batch per record
+        std::vector<const char*> captured; // or images of the batches in a capture, in the mapping
+    } Tensor;
+
+    typedef struct Model
+    {
+        std::string name;
+        std::string root;
+        float latency_ms = 0.f;
+        float latency_per_item_ms = 0.f; // for every image of a batch after the first
+        int max_batch = 1;
+        bool dynamic_batch = false;
+        int npu_set = 0;
+        std::string capture_path;
+        std::unique_ptr<middleware::capture_reader> capture;
+        std::vector<Tensor> inputs;
+        std::vector<Tensor> outputs;
+
+        // storage behind the AX_ENGINE_IO_INFO_T handed out by GetIOInfo
+        std::vector<AX_ENGINE_IOMETA_T> input_meta;
+        std::vector<AX_ENGINE_IOMETA_T> output_meta;
+        std::vector<AX_ENGINE_IOMETA_EX_T> input_extra;
+        std::vector<AX_ENGINE_IOMETA_EX_T> output_extra;
+        AX_ENGINE_IO_INFO_T info;
+
+        std::atomic<uint64_t> frame{0};
+        std::vector<std::unique_ptr<int> > contexts;
+    } Model;
+
+    struct State
+    {
+        std::mutex lock;
+        bool sys_ready = false;
+        bool engine_ready = false;
+        AX_ENGINE_NPU_MODE_T npu_mode = AX_ENGINE_VIRTUAL_NPU_DISABLE;
+        std::map<void*, size_t> blocks; // live cmm allocations
+        size_t bytes = 0;
+        std::mutex cores[NUM_CORES];
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    static size_t dtype_size(AX_ENGINE_DATA_TYPE_T dtype)
+    {
+        switch (dtype)
+        {
+        case AX_ENGINE_DT_UINT8:
+        case AX_ENGINE_DT_SINT8:
+            return 1;
+        case AX_ENGINE_DT_UINT16:
+        case AX_ENGINE_DT_SINT16:
+            return 2;
+        case AX_ENGINE_DT_FLOAT64:
+            return 8;
+        default:
+            return 4;
+        }
+    }
+
+    static bool parse_dtype(const std::string& text, AX_ENGINE_DATA_TYPE_T& dtype)
+    {
+        static const std::map<std::string, AX_ENGINE_DATA_TYPE_T> names = {
+            {"uint8", AX_ENGINE_DT_UINT8},
+            {"sint8", AX_ENGINE_DT_SINT8},
+            {"int8", AX_ENGINE_DT_SINT8},
+            {"uint16", AX_ENGINE_DT_UINT16},
+            {"sint16", AX_ENGINE_DT_SINT16},
+            {"int16", AX_ENGINE_DT_SINT16},
+            {"float32", AX_ENGINE_DT_FLOAT32},
+            {"sint32", AX_ENGINE_DT_SINT32},
+            {"int32", AX_ENGINE_DT_SINT32},
+            {"uint32", AX_ENGINE_DT_UINT32},
+            {"float64", AX_ENGINE_DT_FLOAT64},
+        };
+        auto it = names.find(text);
+        if (it == names.end())
+            return false;
+        dtype = it->second;
+        return true;
+    }
+
+    static bool parse_color(const std::string& text, AX_ENGINE_COLOR_SPACE_T& color)
+    {
+        static const std::map<std::string, AX_ENGINE_COLOR_SPACE_T> names = {
+            {"featuremap", AX_ENGINE_CS_FEATUREMAP},
+            {"nv12", AX_ENGINE_CS_NV12},
+            {"nv21", AX_ENGINE_CS_NV21},
+            {"rgb", AX_ENGINE_CS_RGB},
+            {"bgr", AX_ENGINE_CS_BGR},
+            {"rgba", AX_ENGINE_CS_RGBA},
+            {"gray", AX_ENGINE_CS_GRAY},
+            {"yuv444", AX_ENGINE_CS_YUV444},
+        };
+        auto it = names.find(text);
+        if (it == names.end())
+            return false;
+        color = it->second;
+        return true;
+    }
+
+    // 1x640x640x3 or 1,640,640,3
+    static bool parse_shape(const std::string& text, std::vector<AX_S32>& shape)
+    {
+        shape.clear();
+        std::string token;
+        for (size_t i = 0; i <= text.size(); i++)
+        {
+            if (i == text.size() || text[i] == 'x' || text[i] == ',')
+            {
+                if (token.empty())
+                    return false;
+                int dim = atoi(token.c_str());
+                if (dim <= 0)
+                    return false;
+                shape.push_back(dim);
+                token.clear();
+            }
+            else
+            {
+                token += text[i];
+            }
+        }
+        return !shape.empty();
+    }
+
+    static size_t tensor_size(const Tensor& tensor)
+    {
+        if (tensor.size > 0)
+            return tensor.size;
+        size_t size = dtype_size(tensor.dtype);
+        for (auto dim : tensor.shape)
+        {
+            size *= (size_t)dim;
+        }
+        return size;
+    }
+
+    static bool read_records(const std::string& path, std::vector<char>& data)
+    {
+        std::ifstream fs(path, std::ios::in | std::ios::binary);
+        if (!fs.is_open())
+            return false;
+        data.assign(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    /*
+     * one directive per line, '#' starts a comment:
+     *   name <text>
+     *   root <dir>                              replay files are relative to it
+     *   latency_ms <per run> [<per extra image of a batch>]
+     *   max_batch <n> [dynamic]
+     *   npu_set <mask>                          cores the model uses, 0 for all
+     *   input <name> <dtype> <shape> [nhwc|nchw] [color]
+     *   output <name> <dtype> <shape> [<replay file>]
+     *   capture <file>                          outputs replayed by name from a tensor capture,
+     *                                           its io table stands in for missing input / output lines
+     */
+    static bool parse_manifest(const std::string& text, Model& model, std::string& error)
+    {
+        std::istringstream lines(text);
+        std::string line;
+        int line_number = 0;
+        while (std::getline(lines, line))
+        {
+            line_number++;
+            auto comment = line.find('#');
+            if (comment != std::string::npos)
+                line.erase(comment);
+            std::istringstream words(line);
+            std::string key;
+            if (!(words >> key))
+                continue;
+
+            bool ok = true;
+            if (key == "name")
+            {
+                ok = (bool)(words >> model.name);
+            }
+            else if (key == "root")
+            {
+                ok = (bool)(words >> model.root);
+            }
+            else if (key == "latency_ms")
+            {
+                ok = (bool)(words >> model.latency_ms);
+                words >> model.latency_per_item_ms;
+            }
+            else if (key == "max_batch")
+            {
+                std::string dynamic;
+                ok = (bool)(words >> model.max_batch) && model.max_batch > 0;
+                model.dynamic_batch = (words >> dynamic) && dynamic == "dynamic";
+            }
+            else if (key == "npu_set")
+            {
+                ok = (bool)(words >> model.npu_set);
+            }
+            else if (key == "capture")
+            {
+                ok = (bool)(words >> model.capture_path);
+            }
+            else if (key == "input" || key == "output")
+            {
+                Tensor tensor;
+                std::string dtype, shape, extra;
+                tensor.layout = AX_ENGINE_TENSOR_LAYOUT_UNKNOWN;
+                tensor.color = AX_ENGINE_CS_FEATUREMAP;
+                ok = (words >> tensor.name >> dtype >> shape) && parse_dtype(dtype, tensor.dtype) && parse_shape(shape, tensor.shape);
+                while (ok && (words >> extra))
+                {
+                    if (extra == "nhwc")
+                        tensor.layout = AX_ENGINE_TENSOR_LAYOUT_NHWC;
+                    else if (extra == "nchw")
+                        tensor.layout = AX_ENGINE_TENSOR_LAYOUT_NCHW;
+                    else if (key == "input")
+                        ok = parse_color(extra, tensor.color);
+                    else
+                        tensor.replay_path = extra;
+                }
+                if (ok)
+                    (key == "input" ? model.inputs : model.outputs).push_back(tensor);
+            }
+            else
+            {
+                ok = false;
+            }
+
+            if (!ok)
+            {
+                error = "line " + std::to_string(line_number) + ": " + line;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void from_capture(const AX_ENGINE_IOMETA_T* meta, AX_U32 count, std::vector<Tensor>& tensors)
+    {
+        for (AX_U32 i = 0; i < count; i++)
+        {
+            Tensor tensor;
+            tensor.name = meta[i].pName;
+            tensor.shape.assign(meta[i].pShape, meta[i].pShape + meta[i].nShapeSize);
+            tensor.dtype = meta[i].eDataType;
+            tensor.layout = meta[i].eLayout;
+            tensor.color = meta[i].pExtraMeta->eColorSpace;
+            tensor.size = meta[i].nSize;
+            tensors.push_back(tensor);
+        }
+    }
+
+    static bool load_capture(Model& model, const std::string& path)
+    {
+        model.capture.reset(new middleware::capture_reader());
+        middleware::capture_reader& capture = *model.capture;
+        if (!capture.open(path))
+            return false;
+        AX_ENGINE_IO_INFO_T* info = capture.io_info();
+        if (model.inputs.empty())
+            from_capture(info->pInputs, info->nInputSize, model.inputs);
+        if (model.outputs.empty())
+        {
+            from_capture(info->pOutputs, info->nOutputSize, model.outputs);
+            model.max_batch = (int)info->nMaxBatchSize;
+        }
+
+        for (auto& tensor : model.outputs)
+        {
+            int index = capture.find_output(tensor.name);
+            if (index < 0)
+            {
+                fprintf(stderr, "[host] %s is not in %s\n", tensor.name.c_str(), path.c_str());
+                continue;
+            }
+            if (capture.output_stride(index) != tensor_size(tensor) / model.max_batch)
+            {
+                fprintf(stderr, "[host] %s has %zu bytes per image in %s, the manifest says %zu\n", tensor.name.c_str(),
+                        capture.output_stride(index), path.c_str(), tensor_size(tensor) / model.max_batch);
+                return false;
+            }
+            for (size_t f = 0; f < capture.frames(); f++)
+            {
+                const char* data = (const char*)capture.output(f, index);
+                for (uint32_t b = 0; b < capture.frame(f).batch; b++)
+                {
+                    tensor.captured.push_back(data + b * capture.output_stride(index));
+                }
+            }
+        }
+        return true;
+    }
+
+    static void fill_meta(std::vector<Tensor>& tensors, std::vector<AX_ENGINE_IOMETA_T>& meta, std::vector<AX_ENGINE_IOMETA_EX_T>& extra)
+    {
+        meta.resize(tensors.size());
+        extra.resize(tensors.size());
+        for (size_t i = 0; i < tensors.size(); i++)
+        {
+            Tensor& tensor = tensors[i];
+            memset(&meta[i], 0, sizeof(meta[i]));
+            memset(&extra[i], 0, sizeof(extra[i]));
+            extra[i].eColorSpace = tensor.color;
+            meta[i].pName = (AX_CHAR*)tensor.name.c_str();
+            meta[i].pShape = tensor.shape.data();
+            meta[i].nShapeSize = (AX_U8)tensor.shape.size();
+            meta[i].eLayout = tensor.layout;
+            meta[i].eMemoryType = AX_ENGINE_MT_PHYSICAL;
+            meta[i].eDataType = tensor.dtype;
+            meta[i].pExtraMeta = &extra[i];
+            meta[i].nSize = (AX_U32)tensor_size(tensor);
+        }
+    }
+
+    static std::string join(const std::string& root, const std::string& path)
+    {
+        if (root.empty() || path.empty() || path[0] == '/')
+            return path;
+        return root.back() == '/' ? root + path : root + "/" + path;
+    }
+
+    static AX_S32 create(AX_ENGINE_HANDLE* handle, const AX_VOID* data, AX_U32 size, int npu_set)
+    {
+        if (!handle || !data)
+            return ERR_NULL_PTR;
+        {
+            std::lock_guard<std::mutex> guard(state().lock);
+            if (!state().engine_ready)
+                return ERR_NOT_INIT;
+        }
+
+        std::unique_ptr<Model> model(new Model());
+        std::string error;
+        if (!parse_manifest(std::string((const char*)data, size), *model, error))
+        {
+            fprintf(stderr, "[host] bad model manifest, %s\n", error.c_str());
+            return ERR_ILLEGAL_PARAM;
+        }
+        if (model->root.empty() && getenv("AX_HOST_REPLAY_ROOT"))
+            model->root = getenv("AX_HOST_REPLAY_ROOT");
+        if (npu_set != 0)
+            model->npu_set = npu_set;
+        if (!model->capture_path.empty() && !load_capture(*model, join(model->root, model->capture_path)))
+            return ERR_ILLEGAL_PARAM;
+        if (model->inputs.empty() || model->outputs.empty())
+        {
+            fprintf(stderr, "[host] bad model manifest, a model needs at least one input and one output\n");
+            return ERR_ILLEGAL_PARAM;
+        }
+
+        for (auto& tensor : model->outputs)
+        {
+            if (tensor.replay_path.empty())
+                continue;
+            std::string path = join(model->root, tensor.replay_path);
+            size_t record = tensor_size(tensor) / model->max_batch;
+            if (!read_records(path, tensor.records) || tensor.records.size() < record)
+            {
+                fprintf(stderr, "[host] no recorded %s in %s, it reads as zeros\n", tensor.name.c_str(), path.c_str());
+                tensor.records.clear();
+            }
+            else if (tensor.records.size() % record != 0)
+            {
+                fprintf(stderr, "[host] %s size is not a multiple of %zu bytes, the tail is ignored\n", path.c_str(), record);
+            }
+        }
+
+        fill_meta(model->inputs, model->input_meta, model->input_extra);
+        fill_meta(model->outputs, model->output_meta, model->output_extra);
+        memset(&model->info, 0, sizeof(model->info));
+        model->info.pInputs = model->input_meta.data();
+        model->info.nInputSize = (AX_U32)model->input_meta.size();
+        model->info.pOutputs = model->output_meta.data();
+        model->info.nOutputSize = (AX_U32)model->output_meta.size();
+        model->info.nMaxBatchSize = (AX_U32)model->max_batch;
+        model->info.bDynamicBatchSize = model->dynamic_batch ? AX_TRUE : AX_FALSE;
+        *handle = model.release();
+        return 0;
+    }
+
+    static AX_S32 check_buffers(const AX_ENGINE_IO_BUFFER_T* buffers, AX_U32 count, const std::vector<AX_ENGINE_IOMETA_T>& meta)
+    {
+        if (count != meta.size() || !buffers)
+            return ERR_ILLEGAL_PARAM;
+        for (AX_U32 i = 0; i < count; i++)
+        {
+            if (!buffers[i].pVirAddr)
+                return ERR_NULL_PTR;
+        }
+        return 0;
+    }
+
+    static AX_S32 run(Model* model, AX_ENGINE_IO_T* io)
+    {
+        if (!model || !io)
+            return ERR_NULL_PTR;
+        AX_S32 ret = check_buffers(io->pInputs, io->nInputSize, model->input_meta);
+        if (0 == ret)
+            ret = check_buffers(io->pOutputs, io->nOutputSize, model->output_meta);
+        if (0 != ret)
+            return ret;
+        int batch = model->dynamic_batch && io->nBatchSize > 0 ? (int)io->nBatchSize : model->max_batch;
+        if (batch > model->max_batch)
+            return ERR_ILLEGAL_PARAM;
+
+        // a model holds the cores of its npu set for the whole run, like the hardware queue
+        int npu_set = model->npu_set;
+        if (npu_set == 0)
+            npu_set = state().npu_mode == AX_ENGINE_VIRTUAL_NPU_DISABLE ? (1 << NUM_CORES) - 1 : 1;
+        std::vector<std::unique_lock<std::mutex> > held;
+        for (int c = 0; c < NUM_CORES; c++)
+        {
+            if (npu_set & (1 << c))
+                held.emplace_back(state().cores[c]);
+        }
+        auto start = std::chrono::steady_clock::now();
+
+        uint64_t frame = model->frame.fetch_add(batch);
+        for (size_t i = 0; i < model->outputs.size(); i++)
+        {
+            const Tensor& tensor = model->outputs[i];
+            size_t record = model->output_meta[i].nSize / model->max_batch;
+            char* dst = (char*)io->pOutputs[i].pVirAddr;
+            size_t num_records = record > 0 ? tensor.records.size() / record : 0;
+            for (int b = 0; b < batch; b++)
+            {
+                if (!tensor.captured.empty())
+                    memcpy(dst + b * record, tensor.captured[(frame + b) % tensor.captured.size()], record);
+                else if (num_records == 0)
+                    memset(dst + b * record, 0, record);
+                else
+                    memcpy(dst + b * record, tensor.records.data() + ((frame + b) % num_records) * record, record);
+            }
+        }
+
+        static const float scale = getenv("AX_HOST_LATENCY_SCALE") ? (float)atof(getenv("AX_HOST_LATENCY_SCALE")) : 1.f;
+        float latency_ms = (model->latency_ms + model->latency_per_item_ms * (batch - 1)) * scale;
+        if (latency_ms > 0)
+            std::this_thread::sleep_until(start + std::chrono::microseconds((long long)(latency_ms * 1000.f)));
+        return 0;
+    }
+} // namespace host
+
+extern "C" {
+
+AX_S32 AX_SYS_Init(AX_VOID)
+{
+    std::lock_guard<std::mutex> guard(host::state().lock);
+    host::state().sys_ready = true;
+    return 0;
+}
+
+AX_S32 AX_SYS_Deinit(AX_VOID)
+{
+    host::State& s = host::state();
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (!s.blocks.empty())
+        fprintf(stderr, "[host] %zu cmm blocks (%zu bytes) not freed\n", s.blocks.size(), s.bytes);
+    s.sys_ready = false;
+    return 0;
+}
+
+AX_S32 AX_SYS_MemAlloc(AX_U64* phyaddr, AX_VOID** pviraddr, AX_U32 size, AX_U32 align, const AX_S8*)
+{
+    if (!phyaddr || !pviraddr)
+        return host::ERR_NULL_PTR;
+    host::State& s = host::state();
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (!s.sys_ready)
+        return host::ERR_NOT_INIT;
+    size_t alignment = sizeof(void*);
+    while (alignment < align)
+        alignment <<= 1;
+    void* data = nullptr;
+    if (size == 0 || posix_memalign(&data, alignment, size) != 0)
+        return host::ERR_NO_MEMORY;
+    s.blocks[data] = size;
+    s.bytes += size;
+    *pviraddr = data;
+    *phyaddr = (AX_U64)(uintptr_t)data;
+    return 0;
+}
+
+AX_S32 AX_SYS_MemAllocCached(AX_U64* phyaddr, AX_VOID** pviraddr, AX_U32 size, AX_U32 align, const AX_S8* token)
+{
+    return AX_SYS_MemAlloc(phyaddr, pviraddr, size, align, token);
+}
+
+AX_S32 AX_SYS_MemFree(AX_U64, AX_VOID* pviraddr)
+{
+    host::State& s = host::state();
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto it = s.blocks.find(pviraddr);
+    if (it == s.blocks.end())
+        return host::ERR_ILLEGAL_PARAM;
+    s.bytes -= it->second;
+    s.blocks.erase(it);
+    free(pviraddr);
+    return 0;
+}
+
+AX_S32 AX_SYS_MflushCache(AX_U64, AX_VOID*, AX_U32)
+{
+    return 0;
+}
+
+AX_S32 AX_SYS_MinvalidateCache(AX_U64, AX_VOID*, AX_U32)
+{
+    return 0;
+}
+
+AX_S32 AX_ENGINE_Init(AX_ENGINE_NPU_ATTR_T* pNpuAttr)
+{
+    std::lock_guard<std::mutex> guard(host::state().lock);
+    host::state().npu_mode = pNpuAttr ? pNpuAttr->eHardMode : AX_ENGINE_VIRTUAL_NPU_DISABLE;
+    host::state().engine_ready = true;
+    return 0;
+}
+
+AX_S32 AX_ENGINE_Deinit(AX_VOID)
+{
+    std::lock_guard<std::mutex> guard(host::state().lock);
+    host::state().engine_ready = false;
+    return 0;
+}
+
+AX_S32 AX_ENGINE_NPUReset(AX_VOID)
+{
+    return 0;
+}
+
+const AX_CHAR* AX_ENGINE_GetVersion(AX_VOID)
+{
+    return "host-replay";
+}
+
+AX_S32 AX_ENGINE_CreateHandle(AX_ENGINE_HANDLE* pHandle, const AX_VOID* pData, AX_U32 nDataSize)
+{
+    return host::create(pHandle, pData, nDataSize, 0);
+}
+
+AX_S32 AX_ENGINE_CreateHandleV2(AX_ENGINE_HANDLE* pHandle, const AX_VOID* pData, AX_U32 nDataSize, AX_ENGINE_HANDLE_EXTRA_T* pExtraParam)
+{
+    return host::create(pHandle, pData, nDataSize, pExtraParam ? pExtraParam->nNpuSet : 0);
+}
+
+AX_S32 AX_ENGINE_DestroyHandle(AX_ENGINE_HANDLE nHandle)
+{
+    if (!nHandle)
+        return host::ERR_NULL_PTR;
+    delete (host::Model*)nHandle;
+    return 0;
+}
+
+AX_S32 AX_ENGINE_CreateContext(AX_ENGINE_HANDLE handle)
+{
+    return handle ? 0 : host::ERR_NULL_PTR;
+}
+
+AX_S32 AX_ENGINE_CreateContextV2(AX_ENGINE_HANDLE nHandle, AX_ENGINE_CONTEXT_T* pContext)
+{
+    if (!nHandle || !pContext)
+        return host::ERR_NULL_PTR;
+    host::Model* model = (host::Model*)nHandle;
+    std::lock_guard<std::mutex> guard(host::state().lock);
+    model->contexts.emplace_back(new int((int)model->contexts.size()));
+    *pContext = model->contexts.back().get();
+    return 0;
+}
+
+AX_S32 AX_ENGINE_GetIOInfo(AX_ENGINE_HANDLE nHandle, AX_ENGINE_IO_INFO_T** pIO)
+{
+    if (!nHandle || !pIO)
+        return host::ERR_NULL_PTR;
+    *pIO = &((host::Model*)nHandle)->info;
+    return 0;
+}
+
+AX_S32 AX_ENGINE_RunSync(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_T* pIO)
+{
+    return host::run((host::Model*)handle, pIO);
+}
+
+AX_S32 AX_ENGINE_RunSyncV2(AX_ENGINE_HANDLE handle, AX_ENGINE_CONTEXT_T context, AX_ENGINE_IO_T* pIO)
+{
+    if (!context)
+        return host::ERR_NULL_PTR;
+    return host::run((host::Model*)handle, pIO);
+}
+
+} // extern "C"
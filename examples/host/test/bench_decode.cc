@@ -0,0 +1,208 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * anchor-free decode: the shared logit-space path (decode_anchor_free_head) against the scan
+ * every logit, sigmoid, then threshold loop it replaced, per head type, on synthetic heads
+ * where about 1% of the cells hold an object. both must give the same proposals.
+ *
+ * usage: bench_decode [repeat]
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "base/detection.hpp"
+
+struct Raw
+{
+    int cell;
+    int label;
+    float prob;
+    float ltrb[4];
+};
+
+struct HeadType
+{
+    const char* name;
+    int cls_num;
+    int cells;
+    bool split;     // cls and dfl in separate tensors (yolo-world)
+    int extra;      // channels after the cls logits (obb angle)
+    float scale;    // yolo-world cls scale / bias
+    float bias;
+};
+
+/* the decoder before the shared path: argmax over all logits, sigmoid, then threshold */
+static void reference_decode(const detection::AnchorFreeHead<float>& head, int num_cells, float prob_threshold, std::vector<Raw>& out)
+{
+    for (int i = 0; i < num_cells; i++)
+    {
+        const float* cls = head.cls_ptr + (size_t)i * head.cls_step;
+        const float* dfl = head.dfl_ptr + (size_t)i * head.dfl_step;
+
+        int class_index = 0;
+        float class_score = -FLT_MAX;
+        for (int s = 0; s < head.cls_num; s++)
+        {
+            if (cls[s] > class_score)
+            {
+                class_index = s;
+                class_score = cls[s];
+            }
+        }
+
+        float box_prob = detection::sigmoid(class_score * head.cls_scale + head.cls_bias);
+        if (box_prob > prob_threshold)
+        {
+            Raw raw;
+            raw.cell = i;
+            raw.label = class_index;
+            raw.prob = box_prob;
+            for (int k = 0; k < 4; k++)
+            {
+                raw.ltrb[k] = math::dfl(dfl + k * head.reg_max, head.reg_max);
+            }
+            out.push_back(raw);
+        }
+    }
+}
+
+static void shared_decode(const detection::AnchorFreeHead<float>& head, int num_cells, float prob_threshold, std::vector<Raw>& out)
+{
+    detection::decode_anchor_free_head(head, num_cells, prob_threshold, [&](int cell, int class_index, float box_prob, const float* pred_ltrb) {
+        Raw raw;
+        raw.cell = cell;
+        raw.label = class_index;
+        raw.prob = box_prob;
+        for (int k = 0; k < 4; k++)
+        {
+            raw.ltrb[k] = pred_ltrb[k];
+        }
+        out.push_back(raw);
+    });
+}
+
+static bool same(const std::vector<Raw>& a, const std::vector<Raw>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].cell != b[i].cell || a[i].label != b[i].label || a[i].prob != b[i].prob || memcmp(a[i].ltrb, b[i].ltrb, sizeof(a[i].ltrb)) != 0)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = check::repeat(argc, argv, 200);
+    const float prob_threshold = 0.45f;
+
+    // 640x640 for the box heads (8400 cells), 1024x1024 for obb (21504 cells)
+    const HeadType types[] = {
+        {"yolov8 / v9 / 11", 80, 8400, false, 0, 1.f, 0.f},
+        {"yolov8 seg", 80, 8400, false, 0, 1.f, 0.f},
+        {"yolov8 pose", 1, 8400, false, 0, 1.f, 0.f},
+        {"yolo-world", 80, 8400, true, 0, 1.3f, 0.5f},
+        {"yolov8 obb", 15, 21504, false, 1, 1.f, 0.f},
+    };
+
+    std::mt19937 rng(7);
+    std::normal_distribution<float> background(-8.f, 1.5f);
+    std::normal_distribution<float> bins(0.f, 2.f);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    fprintf(stdout, "%-18s %6s %9s %12s %12s %8s\n", "head", "cls", "proposals", "scan all us", "shared us", "speedup");
+    for (const HeadType& type : types)
+    {
+        const int reg_max = 16;
+        int cls_step = type.split ? type.cls_num : 4 * reg_max + type.cls_num + type.extra;
+        int dfl_step = type.split ? 4 * reg_max : cls_step;
+        std::vector<float> cls_feat((size_t)type.cells * cls_step);
+        std::vector<float> dfl_feat(type.split ? (size_t)type.cells * dfl_step : 0);
+
+        for (auto& v : cls_feat) v = bins(rng);
+        for (auto& v : dfl_feat) v = bins(rng);
+        const int cls_offset = type.split ? 0 : 4 * reg_max;
+        for (int i = 0; i < type.cells; i++)
+        {
+            float* cls = cls_feat.data() + (size_t)i * cls_step + cls_offset;
+            for (int s = 0; s < type.cls_num; s++)
+            {
+                cls[s] = background(rng);
+            }
+            if (uniform(rng) < 0.01f)
+                cls[(int)(uniform(rng) * type.cls_num) % type.cls_num] = 2.f + bins(rng);
+        }
+
+        auto head = type.split
+                        ? detection::make_anchor_free_head(cls_feat.data(), cls_step, dfl_feat.data(), dfl_step, type.cls_num, reg_max)
+                        : detection::make_anchor_free_head(cls_feat.data() + cls_offset, cls_step, cls_feat.data(), dfl_step, type.cls_num, reg_max);
+        head.cls_scale = type.scale;
+        head.cls_bias = type.bias;
+
+        std::vector<Raw> expected, actual;
+        reference_decode(head, type.cells, prob_threshold, expected);
+        shared_decode(head, type.cells, prob_threshold, actual);
+        CHECK(!expected.empty());
+        CHECK(same(expected, actual));
+
+        double scan_all = check::best_of_us(repeat, [&]() {
+            expected.clear();
+            reference_decode(head, type.cells, prob_threshold, expected);
+        });
+        double shared = check::best_of_us(repeat, [&]() {
+            actual.clear();
+            shared_decode(head, type.cells, prob_threshold, actual);
+        });
+        fprintf(stdout, "%-18s %6d %9zu %12.1f %12.1f %7.2fx\n", type.name, type.cls_num, actual.size(), scan_all, shared, scan_all / shared);
+    }
+
+    // the public generator on top of the shared path, against the reference plus the same box transform
+    {
+        const int stride = 8, cols = 640, rows = 640, cls_num = 80;
+        const int feat_w = cols / stride;
+        std::vector<float> feat((size_t)feat_w * (rows / stride) * (64 + cls_num));
+        for (size_t i = 0; i < feat.size(); i++)
+        {
+            feat[i] = (i % (64 + cls_num)) < 64 ? bins(rng) : (uniform(rng) < 0.002f ? 2.f + bins(rng) : background(rng));
+        }
+
+        std::vector<detection::Object> objects, fixed;
+        detection::generate_proposals_yolov8_native(stride, feat.data(), prob_threshold, objects, cols, rows, cls_num);
+        detection::generate_proposals_yolov8_native<80>(stride, tensor::make_view(feat.data()), prob_threshold, fixed, cols, rows);
+
+        std::vector<Raw> expected;
+        auto head = detection::make_anchor_free_head(feat.data() + 64, 64 + cls_num, feat.data(), 64 + cls_num, cls_num);
+        reference_decode(head, (int)(feat.size() / (64 + cls_num)), prob_threshold, expected);
+
+        CHECK(objects.size() == expected.size() && fixed.size() == expected.size());
+        for (size_t i = 0; i < expected.size() && i < objects.size() && i < fixed.size(); i++)
+        {
+            cv::Rect_<float> rect = detection::ltrb_to_rect(expected[i].ltrb, expected[i].cell % feat_w, expected[i].cell / feat_w, stride, cols, rows);
+            CHECK(objects[i].label == expected[i].label && objects[i].prob == expected[i].prob);
+            CHECK(objects[i].rect.x == rect.x && objects[i].rect.y == rect.y && objects[i].rect.width == rect.width && objects[i].rect.height == rect.height);
+            CHECK(fixed[i].label == objects[i].label && fixed[i].prob == objects[i].prob && fixed[i].rect.x == objects[i].rect.x);
+        }
+    }
+
+    return check::result();
+}
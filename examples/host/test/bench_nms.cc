@@ -0,0 +1,137 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * nms: nms::nms_sorted against the greedy loop it replaced, which tested every box against
+ * every picked box through cv::Rect_ intersection without an early exit. 100 to 20k random
+ * boxes over 80 classes, class agnostic and class aware, plus the top_k cap.
+ *
+ * usage: bench_nms [repeat]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "base/nms.hpp"
+
+struct Box
+{
+    float x, y, width, height;
+    float prob;
+    int label;
+};
+
+/* intersection area as cv::Rect_<float> operator& computes it */
+static float intersection_area(const Box& a, const Box& b)
+{
+    float x0 = std::max(a.x, b.x);
+    float y0 = std::max(a.y, b.y);
+    float w = std::min(a.x + a.width, b.x + b.width) - x0;
+    float h = std::min(a.y + a.height, b.y + b.height) - y0;
+    if (w <= 0.f || h <= 0.f)
+        return 0.f;
+    return w * h;
+}
+
+/* the loop before nms.hpp, class_aware only compares boxes of the same label */
+static void reference_nms(const std::vector<Box>& boxes, std::vector<int>& picked, float nms_threshold, bool class_aware)
+{
+    picked.clear();
+    const int n = (int)boxes.size();
+    std::vector<float> areas(n);
+    for (int i = 0; i < n; i++)
+    {
+        areas[i] = boxes[i].width * boxes[i].height;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        int keep = 1;
+        for (int j = 0; j < (int)picked.size(); j++)
+        {
+            const Box& b = boxes[picked[j]];
+            if (class_aware && b.label != boxes[i].label)
+                continue;
+            float inter_area = intersection_area(boxes[i], b);
+            float union_area = areas[i] + areas[picked[j]] - inter_area;
+            if (inter_area / union_area > nms_threshold)
+                keep = 0;
+        }
+        if (keep)
+            picked.push_back(i);
+    }
+}
+
+static void to_soa(const std::vector<Box>& boxes, nms::Boxes& soa)
+{
+    soa.clear();
+    soa.reserve(boxes.size());
+    for (const Box& b : boxes)
+    {
+        soa.push_back(b.x, b.y, b.x + b.width, b.y + b.height, b.width * b.height, b.label);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = check::repeat(argc, argv, 20);
+    const float nms_threshold = 0.45f;
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> position(0.f, 640.f);
+    std::uniform_real_distribution<float> extent(8.f, 120.f);
+    std::uniform_real_distribution<float> score(0.f, 1.f);
+
+    fprintf(stdout, "%6s %-7s %6s %12s %12s %8s\n", "boxes", "mode", "picked", "greedy us", "nms us", "speedup");
+    for (int n : {100, 1000, 5000, 20000})
+    {
+        std::vector<Box> boxes(n);
+        for (Box& b : boxes)
+        {
+            b = Box{position(rng), position(rng), extent(rng), extent(rng), score(rng), (int)(rng() % 80)};
+        }
+        std::sort(boxes.begin(), boxes.end(), [](const Box& a, const Box& b) { return a.prob > b.prob; });
+
+        nms::Boxes soa;
+        to_soa(boxes, soa);
+
+        for (bool class_aware : {false, true})
+        {
+            std::vector<int> expected, actual;
+            reference_nms(boxes, expected, nms_threshold, class_aware);
+            nms::nms_sorted(soa, actual, nms_threshold, class_aware);
+            CHECK(expected == actual);
+
+            int count = n >= 5000 ? std::max(repeat / 10, 1) : repeat;
+            double greedy = check::best_of_us(count, [&]() { reference_nms(boxes, expected, nms_threshold, class_aware); });
+            double engine = check::best_of_us(count, [&]() { nms::nms_sorted(soa, actual, nms_threshold, class_aware); });
+            fprintf(stdout, "%6d %-7s %6zu %12.1f %12.1f %7.1fx\n", n, class_aware ? "class" : "agnostic", actual.size(), greedy, engine, greedy / engine);
+        }
+
+        // top_k keeps the result of nms over the best top_k boxes
+        std::vector<int> expected, actual;
+        std::vector<Box> top(boxes.begin(), boxes.begin() + std::min(n, 300));
+        reference_nms(top, expected, nms_threshold, false);
+        nms::nms_sorted(soa, actual, nms_threshold, false, 300);
+        CHECK(expected == actual);
+    }
+
+    return check::result();
+}
@@ -0,0 +1,166 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * proposal allocations: heap allocations per frame of the yolov8 seg / pose decode with
+ * std::vector<Object> proposals and with ProposalArena, counted by a replaced operator new.
+ * the arena decode must not allocate once the first frame has sized it, and both paths must
+ * give the same objects after nms.
+ *
+ * usage: bench_proposal_alloc [repeat]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "base/detection.hpp"
+
+static long allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+static const int COLS = 640;
+static const int ROWS = 640;
+static const int SRC_ROWS = 480;
+static const int SRC_COLS = 640;
+static const float PROB_THRESHOLD = 0.3f;
+static const float NMS_THRESHOLD = 0.45f;
+
+struct Frame
+{
+    int cls_num;
+    std::vector<float> feat[3];
+    std::vector<float> side[3];
+};
+
+static Frame make_frame(std::mt19937& rng, int cls_num, int side_dim)
+{
+    std::normal_distribution<float> values(-5.f, 2.5f);
+    Frame frame;
+    frame.cls_num = cls_num;
+    for (int l = 0; l < 3; l++)
+    {
+        int cells = (COLS >> (3 + l)) * (ROWS >> (3 + l));
+        frame.feat[l].resize((size_t)cells * (64 + cls_num));
+        frame.side[l].resize((size_t)cells * side_dim);
+        for (auto& v : frame.feat[l]) v = values(rng);
+        for (auto& v : frame.side[l]) v = values(rng);
+    }
+    return frame;
+}
+
+static bool same(const std::vector<detection::Object>& a, const std::vector<detection::Object>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].label != b[i].label || a[i].prob != b[i].prob || a[i].rect.x != b[i].rect.x || a[i].rect.y != b[i].rect.y
+            || a[i].rect.width != b[i].rect.width || a[i].rect.height != b[i].rect.height || a[i].mask_feat != b[i].mask_feat || a[i].kps_feat != b[i].kps_feat)
+            return false;
+    }
+    return true;
+}
+
+static void objects_path(const Frame& frame, bool seg, std::vector<detection::Object>& proposals, std::vector<detection::Object>& objects)
+{
+    proposals.clear();
+    for (int l = 0; l < 3; l++)
+    {
+        if (seg)
+            detection::generate_proposals_yolov8_seg_native(8 << l, frame.feat[l].data(), frame.side[l].data(), PROB_THRESHOLD, proposals, COLS, ROWS, frame.cls_num);
+        else
+            detection::generate_proposals_yolov8_pose_native(8 << l, frame.feat[l].data(), frame.side[l].data(), PROB_THRESHOLD, proposals, COLS, ROWS, 17, frame.cls_num);
+    }
+    detection::get_out_bbox_kps(proposals, objects, NMS_THRESHOLD, ROWS, COLS, SRC_ROWS, SRC_COLS);
+}
+
+static long arena_decode(const Frame& frame, bool seg, detection::ProposalArena& arena)
+{
+    long before = allocations;
+    arena.reset(seg ? detection::ProposalArena::FEAT_MASK : detection::ProposalArena::FEAT_KPS, seg ? 32 : 51);
+    for (int l = 0; l < 3; l++)
+    {
+        if (seg)
+            detection::generate_proposals_yolov8_seg_native(8 << l, tensor::make_view(frame.feat[l].data()), tensor::make_view(frame.side[l].data()), PROB_THRESHOLD, arena, COLS, ROWS, frame.cls_num);
+        else
+            detection::generate_proposals_yolov8_pose_native(8 << l, tensor::make_view(frame.feat[l].data()), tensor::make_view(frame.side[l].data()), PROB_THRESHOLD, arena, COLS, ROWS, frame.cls_num);
+    }
+    return allocations - before;
+}
+
+static void run(const char* name, const Frame& frame, bool seg, int repeat)
+{
+    std::vector<detection::Object> proposals, expected, objects;
+    detection::ProposalArena arena;
+
+    // first frame sizes every buffer
+    objects_path(frame, seg, proposals, expected);
+    arena_decode(frame, seg, arena);
+    detection::get_out_bbox_kps(arena, objects, NMS_THRESHOLD, ROWS, COLS, SRC_ROWS, SRC_COLS);
+    CHECK(!expected.empty() && same(expected, objects));
+
+    long before = allocations;
+    objects_path(frame, seg, proposals, expected);
+    long object_allocs = allocations - before;
+
+    before = allocations;
+    long decode_allocs = arena_decode(frame, seg, arena);
+    detection::get_out_bbox_kps(arena, objects, NMS_THRESHOLD, ROWS, COLS, SRC_ROWS, SRC_COLS);
+    long arena_allocs = allocations - before;
+    CHECK(decode_allocs == 0);
+    CHECK(arena_allocs < object_allocs / 10);
+    CHECK(same(expected, objects));
+
+    double object_us = check::best_of_us(repeat, [&]() { objects_path(frame, seg, proposals, expected); });
+    double arena_us = check::best_of_us(repeat, [&]() {
+        arena_decode(frame, seg, arena);
+        detection::get_out_bbox_kps(arena, objects, NMS_THRESHOLD, ROWS, COLS, SRC_ROWS, SRC_COLS);
+    });
+    fprintf(stdout, "%-5s %9d %8zu %14ld %13ld %13ld %10.1f %10.1f\n", name, arena.size(), objects.size(), object_allocs, decode_allocs, arena_allocs, object_us, arena_us);
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = check::repeat(argc, argv, 50);
+    std::mt19937 rng(1);
+
+    fprintf(stdout, "%-5s %9s %8s %14s %13s %13s %10s %10s\n", "head", "proposals", "objects", "object allocs", "arena decode", "arena + nms", "object us", "arena us");
+    run("seg", make_frame(rng, 80, 32), true, repeat);
+    run("pose", make_frame(rng, 1, 51), false, repeat);
+    return check::result();
+}
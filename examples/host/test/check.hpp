@@ -0,0 +1,78 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ * minimal checks for the host tests: CHECK records a failure and goes on, main returns
+ * check::result(). best_of_us times a callable, benchmarks print and never fail on speed.
+ */
+
+#define CHECK(cond)                                                                  \
+    do                                                                               \
+    {                                                                                \
+        if (!(cond))                                                                 \
+        {                                                                            \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            check::failures()++;                                                     \
+        }                                                                            \
+    } while (0)
+
+namespace check
+{
+    static inline int& failures()
+    {
+        static int count = 0;
+        return count;
+    }
+
+    static inline int result()
+    {
+        if (failures())
+        {
+            fprintf(stderr, "%d check(s) failed\n", failures());
+            return -1;
+        }
+        fprintf(stdout, "ok\n");
+        return 0;
+    }
+
+    // repeat count from argv[1], ctest passes a small one
+    static inline int repeat(int argc, char* argv[], int fallback)
+    {
+        int count = argc > 1 ? atoi(argv[1]) : fallback;
+        return count > 0 ? count : fallback;
+    }
+
+    template<typename Fn>
+    static inline double best_of_us(int repeat, Fn&& fn)
+    {
+        double best = 1e30;
+        for (int i = 0; i < repeat; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto end = std::chrono::steady_clock::now();
+            double us = std::chrono::duration<double, std::micro>(end - start).count();
+            best = us < best ? us : best;
+        }
+        return best;
+    }
+} // namespace check
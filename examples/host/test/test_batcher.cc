@@ -0,0 +1,304 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * batcher: batches closing full or at their deadline, flush(), fill failures replied with -1,
+ * release() running the open batch, and every submitted item getting exactly one reply with
+ * its own result, from one producer and from several. the replay backend runs a dynamic
+ * batch model.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+#include "middleware/batcher.hpp"
+
+struct Item
+{
+    int id;
+    bool bad; // fill fails
+};
+
+typedef middleware::batcher<Item, int> batcher_t;
+
+// written by the batcher thread under lock, CHECK runs on the main thread only
+static struct Replies
+{
+    std::mutex lock;
+    std::condition_variable arrived;
+    std::vector<int> count; // replies per item id
+    std::vector<int> ret;
+    std::vector<int> result;
+    int total = 0;
+} replies;
+
+static void reset_replies(int items)
+{
+    std::lock_guard<std::mutex> guard(replies.lock);
+    replies.count.assign(items, 0);
+    replies.ret.assign(items, 1);
+    replies.result.assign(items, -1);
+    replies.total = 0;
+}
+
+static void on_reply(Item& item, batcher_t::Reply& reply)
+{
+    std::lock_guard<std::mutex> guard(replies.lock);
+    replies.count[item.id]++;
+    replies.ret[item.id] = reply.ret;
+    replies.result[item.id] = reply.result;
+    replies.total++;
+    replies.arrived.notify_all();
+}
+
+static bool wait_replies(int total, int timeout_ms = 5000)
+{
+    std::unique_lock<std::mutex> guard(replies.lock);
+    return replies.arrived.wait_for(guard, std::chrono::milliseconds(timeout_ms), [total]() { return replies.total >= total; });
+}
+
+static bool replied_once(int first, int last)
+{
+    std::lock_guard<std::mutex> guard(replies.lock);
+    for (int i = first; i < last; i++)
+    {
+        if (replies.count[i] != 1)
+            return false;
+    }
+    return true;
+}
+
+// the item id goes to the first byte of its slot and back through scatter
+static bool fill(Item& item, uint8_t* input, int)
+{
+    input[0] = (uint8_t)item.id;
+    return !item.bad;
+}
+
+static int scatter(Item& item, AX_ENGINE_IO_INFO_T* info, AX_ENGINE_IO_T* io, int b)
+{
+    const uint8_t* input = middleware::get_input_buffer(info, io, 0, b);
+    return input[0] == (uint8_t)item.id ? item.id : -1;
+}
+
+// a batch is counted after its replies went out
+static middleware::BatcherStats wait_counted(batcher_t& batcher, size_t items)
+{
+    auto stats = batcher.stats();
+    for (int i = 0; i < 5000 && stats.items + stats.failed < items; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        stats = batcher.stats();
+    }
+    return stats;
+}
+
+static int init(batcher_t& batcher, AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* info, float deadline_ms, int max_batch = 0)
+{
+    return batcher.init(handle, info, middleware::make_batcher_options(deadline_ms, max_batch), fill, scatter);
+}
+
+// with a deadline that never comes, batches close only when full or on flush
+static void check_full_and_flush(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* info)
+{
+    batcher_t batcher;
+    CHECK(init(batcher, handle, info, 60000.f) == 0);
+    CHECK(batcher.batch_size() == 4);
+
+    reset_replies(14);
+    for (int i = 0; i < 12; i++)
+    {
+        batcher.submit(Item{i, false}, on_reply);
+    }
+    CHECK(wait_replies(12));
+    CHECK(replied_once(0, 12));
+    auto stats = wait_counted(batcher, 12);
+    CHECK(stats.batches == 3 && stats.full_batches == 3 && stats.items == 12 && stats.failed == 0 && stats.mean_batch == 4.f);
+
+    // two items wait in the open batch until flush
+    batcher.submit(Item{12, false}, on_reply);
+    batcher.submit(Item{13, false}, on_reply);
+    CHECK(!wait_replies(13, 50));
+    batcher.flush();
+    CHECK(wait_replies(14));
+    CHECK(replied_once(0, 14));
+    stats = wait_counted(batcher, 14);
+    CHECK(stats.batches == 4 && stats.full_batches == 3 && stats.items == 14);
+
+    // nothing open, nothing to run
+    batcher.flush();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(batcher.stats().batches == 4);
+
+    for (int i = 0; i < 14; i++)
+    {
+        CHECK(replies.ret[i] == 0 && replies.result[i] == i);
+    }
+}
+
+// a batch that does not fill closes deadline_ms after its first item
+static void check_deadline(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* info)
+{
+    batcher_t batcher;
+    CHECK(init(batcher, handle, info, 30.f) == 0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::future<batcher_t::Reply> first = batcher.submit(Item{0, false});
+    std::future<batcher_t::Reply> second = batcher.submit(Item{1, false});
+    CHECK(first.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    CHECK(second.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    double waited = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    CHECK(waited >= 30.0);
+    batcher_t::Reply reply = first.get();
+    CHECK(reply.ret == 0 && reply.result == 0);
+    reply = second.get();
+    CHECK(reply.ret == 0 && reply.result == 1);
+
+    auto stats = wait_counted(batcher, 2);
+    CHECK(stats.batches == 1 && stats.full_batches == 0 && stats.items == 2 && stats.mean_batch == 2.f);
+    CHECK(stats.latency_max >= 29.f);
+
+    // a smaller max_batch than the model closes full earlier
+    batcher_t small;
+    CHECK(init(small, handle, info, 60000.f, 2) == 0 && small.batch_size() == 2);
+    reset_replies(4);
+    for (int i = 0; i < 4; i++)
+    {
+        small.submit(Item{i, false}, on_reply);
+    }
+    CHECK(wait_replies(4) && replied_once(0, 4));
+    stats = wait_counted(small, 4);
+    CHECK(stats.batches == 2 && stats.full_batches == 2);
+}
+
+// an item whose fill failed is replied with -1, the others of its batch still run
+static void check_fill_failure(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* info)
+{
+    batcher_t batcher;
+    CHECK(init(batcher, handle, info, 60000.f) == 0);
+    reset_replies(8);
+    for (int i = 0; i < 8; i++)
+    {
+        batcher.submit(Item{i, i % 3 == 0}, on_reply);
+    }
+    CHECK(wait_replies(8) && replied_once(0, 8));
+    for (int i = 0; i < 8; i++)
+    {
+        if (i % 3 == 0)
+            CHECK(replies.ret[i] == -1 && replies.result[i] == 0);
+        else
+            CHECK(replies.ret[i] == 0 && replies.result[i] == i);
+    }
+    auto stats = wait_counted(batcher, 8);
+    CHECK(stats.batches == 2 && stats.items == 5 && stats.failed == 3 && stats.mean_batch == 4.f);
+}
+
+// release() runs the open batch instead of dropping it, then frees the io sets
+static void check_release(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* info)
+{
+    reset_replies(3);
+    {
+        batcher_t batcher;
+        CHECK(init(batcher, handle, info, 60000.f) == 0);
+        for (int i = 0; i < 3; i++)
+        {
+            batcher.submit(Item{i, false}, on_reply);
+        }
+        batcher.release();
+        CHECK(replies.total == 3 && replied_once(0, 3));
+        CHECK(batcher.stats().batches == 1);
+    }
+    CHECK(middleware::default_cmm_pool().stats().cmm_bytes == 0);
+
+    batcher_t batcher;
+    CHECK(init(batcher, handle, info, 1.f, 5) != 0); // larger than the model batch
+}
+
+// producers on several threads, pausing now and then
+static void check_producers(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* info)
+{
+    const int threads = 4, per_thread = 100;
+    batcher_t batcher;
+    CHECK(init(batcher, handle, info, 1.f) == 0);
+    reset_replies(threads * per_thread);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; t++)
+    {
+        producers.emplace_back([&batcher, t]() {
+            for (int i = 0; i < per_thread; i++)
+            {
+                int id = t * per_thread + i;
+                batcher.submit(Item{id, id % 17 == 0}, on_reply);
+                if (i % 10 == 0)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        });
+    }
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    CHECK(wait_replies(threads * per_thread) && replied_once(0, threads * per_thread));
+    int bad = 0;
+    for (int id = 0; id < threads * per_thread; id++)
+    {
+        bad += id % 17 == 0 ? 1 : 0;
+        CHECK(replies.ret[id] == (id % 17 == 0 ? -1 : 0));
+        CHECK(id % 17 == 0 || replies.result[id] == id);
+    }
+    auto stats = wait_counted(batcher, threads * per_thread);
+    CHECK((int)stats.items == threads * per_thread - bad && (int)stats.failed == bad);
+    CHECK(stats.batches * 4 >= (size_t)(threads * per_thread) && stats.full_batches <= stats.batches);
+}
+
+int main()
+{
+    setenv("AX_HOST_LATENCY_SCALE", "0", 1);
+    CHECK(AX_SYS_Init() == 0);
+    AX_ENGINE_NPU_ATTR_T attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.eHardMode = AX_ENGINE_VIRTUAL_NPU_DISABLE;
+    CHECK(AX_ENGINE_Init(&attr) == 0);
+
+    const std::string manifest = "name toy_batch\n"
+                                 "latency_ms 2 0.5\n"
+                                 "max_batch 4 dynamic\n"
+                                 "input images uint8 4x4x4x3 nhwc bgr\n"
+                                 "output out0 float32 4x4\n";
+    AX_ENGINE_HANDLE handle = nullptr;
+    AX_ENGINE_IO_INFO_T* info = nullptr;
+    CHECK(AX_ENGINE_CreateHandle(&handle, manifest.data(), (AX_U32)manifest.size()) == 0);
+    CHECK(AX_ENGINE_GetIOInfo(handle, &info) == 0);
+
+    check_full_and_flush(handle, info);
+    check_deadline(handle, info);
+    check_fill_failure(handle, info);
+    check_release(handle, info);
+    check_producers(handle, info);
+
+    CHECK(AX_ENGINE_DestroyHandle(handle) == 0);
+    CHECK(AX_ENGINE_Deinit() == 0);
+    CHECK(AX_SYS_Deinit() == 0);
+    return check::result();
+}
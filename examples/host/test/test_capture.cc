@@ -0,0 +1,260 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * capture: middleware::capture_writer / capture_reader round trip over frames of a dynamic
+ * batch model, a capture whose writer died before close(), corrupt indexes and data types
+ * the reader cannot view, and the replay backend driven by a capture alone.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "middleware/io.hpp"
+#include "middleware/capture.hpp"
+#include "utilities/file.hpp"
+
+static const int FRAMES = 7;
+static const int MAX_BATCH = 4;
+static const size_t FEAT_IMAGE = 8 * 8 * 16 * sizeof(float);
+static const size_t CLS_IMAGE = 4 * 4 * 10;
+
+static bool write_file(const std::string& path, const void* data, size_t size)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+/* 6 distinct records of every output, so consecutive images differ */
+static bool write_recordings()
+{
+    std::vector<float> feat(6 * FEAT_IMAGE / sizeof(float));
+    for (size_t i = 0; i < feat.size(); i++)
+    {
+        feat[i] = (float)i * .25f;
+    }
+    std::vector<int8_t> cls(6 * CLS_IMAGE);
+    for (size_t i = 0; i < cls.size(); i++)
+    {
+        cls[i] = (int8_t)(i * 7);
+    }
+    return write_file("capture_feat.bin", feat.data(), feat.size() * sizeof(float)) && write_file("capture_cls.bin", cls.data(), cls.size());
+}
+
+static AX_ENGINE_HANDLE create(const std::string& manifest)
+{
+    AX_ENGINE_HANDLE handle = nullptr;
+    CHECK(AX_ENGINE_CreateHandle(&handle, manifest.data(), (AX_U32)manifest.size()) == 0);
+    CHECK(handle && AX_ENGINE_CreateContext(handle) == 0);
+    return handle;
+}
+
+/* the capture with one field of the file changed, written to path */
+template<typename T>
+static bool patch(const std::string& path, uint64_t offset, T value)
+{
+    std::vector<char> data;
+    if (!utilities::read_file("capture.axcap", data) || offset + sizeof(T) > data.size())
+        return false;
+    memcpy(data.data() + offset, &value, sizeof(T));
+    return write_file(path, data.data(), data.size());
+}
+
+typedef struct Expected
+{
+    std::vector<int> batches;
+    std::vector<std::vector<char> > inputs, feats, clss;
+} Expected;
+
+static void check_round_trip(const Expected& expected)
+{
+    middleware::capture_reader reader;
+    CHECK(reader.open("capture.axcap"));
+    CHECK(reader.frames() == FRAMES);
+    if (reader.frames() != FRAMES)
+        return;
+
+    AX_ENGINE_IO_INFO_T* info = reader.io_info();
+    CHECK(info->nInputSize == 1 && info->nOutputSize == 2 && info->nMaxBatchSize == MAX_BATCH);
+    CHECK(std::string(info->pOutputs[1].pName) == "cls" && info->pOutputs[1].eDataType == AX_ENGINE_DT_SINT8);
+    CHECK(info->pOutputs[0].nShapeSize == 4 && info->pOutputs[0].pShape[3] == 16);
+    CHECK(info->pInputs[0].pExtraMeta->eColorSpace == AX_ENGINE_CS_BGR);
+    CHECK(reader.find_output("cls") == 1 && reader.find_output("none") == -1);
+
+    middleware::capture_reader::Frame frame;
+    for (int f = 0; f < FRAMES; f++)
+    {
+        CHECK((int)reader.frame(f).batch == expected.batches[f] && reader.frame(f).timestamp_us == (uint64_t)f * 1000);
+        CHECK(memcmp(reader.input(f, 0), expected.inputs[f].data(), expected.inputs[f].size()) == 0);
+        CHECK(memcmp(reader.output(f, 0), expected.feats[f].data(), expected.feats[f].size()) == 0);
+        CHECK(memcmp(reader.output(f, 1), expected.clss[f].data(), expected.clss[f].size()) == 0);
+        CHECK((uintptr_t)reader.output(f, 0) % middleware::CAPTURE_ALIGN == 0);
+        CHECK((uintptr_t)reader.output(f, 1) % middleware::CAPTURE_ALIGN == 0);
+
+        // zero copy: the bound io points into the mapping
+        reader.bind(f, frame);
+        CHECK(frame.io.pOutputs[1].pVirAddr == reader.output(f, 1) && (int)frame.io.nBatchSize == expected.batches[f]);
+        tensor::View view = reader.output_view(f, 1);
+        CHECK(view.dtype == tensor::DT_SINT8 && view.quant.scale == 0.05f && view.quant.zero_point == -3 && view.data == reader.output(f, 1));
+    }
+}
+
+static void check_damaged(const Expected& expected)
+{
+    std::vector<char> data;
+    CHECK(utilities::read_file("capture.axcap", data));
+    middleware::CaptureHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    // writer killed before close(): no index, the last frame cut short
+    {
+        std::vector<char> cut(data.begin(), data.begin() + header.index_offset - 100);
+        middleware::CaptureHeader* h = (middleware::CaptureHeader*)cut.data();
+        h->index_offset = 0;
+        h->num_frames = 0;
+        CHECK(write_file("capture_cut.axcap", cut.data(), cut.size()));
+        middleware::capture_reader reader;
+        CHECK(reader.open("capture_cut.axcap") && reader.frames() == FRAMES - 1);
+        if (reader.frames() == FRAMES - 1)
+            CHECK(memcmp(reader.output(FRAMES - 2, 0), expected.feats[FRAMES - 2].data(), expected.feats[FRAMES - 2].size()) == 0);
+    }
+
+    // an index entry past the end, off the alignment or on a frame whose tensors do not fit
+    uint64_t last = header.index_offset + (FRAMES - 1) * sizeof(uint64_t);
+    uint64_t last_frame;
+    memcpy(&last_frame, data.data() + last, sizeof(last_frame));
+    middleware::capture_reader reader;
+    CHECK(patch("capture_bad.axcap", last, (uint64_t)data.size() + middleware::CAPTURE_ALIGN));
+    CHECK(!reader.open("capture_bad.axcap"));
+    CHECK(patch("capture_bad.axcap", last, last_frame + 8));
+    CHECK(!reader.open("capture_bad.axcap"));
+    CHECK(patch("capture_bad.axcap", last_frame + offsetof(middleware::CaptureFrame, size), (uint64_t)data.size()));
+    CHECK(!reader.open("capture_bad.axcap"));
+    CHECK(patch("capture_bad.axcap", last_frame + offsetof(middleware::CaptureFrame, batch), (uint32_t)MAX_BATCH + 1));
+    CHECK(!reader.open("capture_bad.axcap"));
+
+    // an index that does not fit the file is ignored, the frames are walked as if it was not closed
+    CHECK(patch("capture_bad.axcap", offsetof(middleware::CaptureHeader, num_frames), (uint64_t)1 << 61));
+    CHECK(reader.open("capture_bad.axcap") && reader.frames() == FRAMES);
+
+    // not a capture at all
+    CHECK(write_file("capture_junk.bin", data.data() + 200, 4096));
+    CHECK(!reader.open("capture_junk.bin"));
+}
+
+int main()
+{
+    setenv("AX_HOST_LATENCY_SCALE", "0", 1);
+    CHECK(write_recordings());
+    CHECK(AX_SYS_Init() == 0);
+    AX_ENGINE_NPU_ATTR_T attr;
+    memset(&attr, 0, sizeof(attr));
+    CHECK(AX_ENGINE_Init(&attr) == 0);
+
+    AX_ENGINE_HANDLE handle = create("name toy\n"
+                                     "max_batch 4 dynamic\n"
+                                     "input images uint8 4x32x32x3 nhwc bgr\n"
+                                     "output feat float32 4x8x8x16 capture_feat.bin\n"
+                                     "output cls sint8 4x4x4x10 capture_cls.bin\n");
+    AX_ENGINE_IO_INFO_T* info = nullptr;
+    CHECK(AX_ENGINE_GetIOInfo(handle, &info) == 0);
+    AX_ENGINE_IO_T io;
+    CHECK(middleware::prepare_io(info, &io, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED)) == 0);
+
+    // batches 1 to 4, every frame keeps what the run wrote
+    Expected expected;
+    {
+        middleware::capture_writer writer;
+        CHECK(writer.open("capture.axcap", info, true) == 0);
+        writer.set_quant(1, 0.05f, -3);
+        for (int f = 0; f < FRAMES; f++)
+        {
+            io.nBatchSize = 1 + f % MAX_BATCH;
+            memset(io.pInputs[0].pVirAddr, f, io.pInputs[0].nSize);
+            CHECK(AX_ENGINE_RunSync(handle, &io) == 0);
+            CHECK(writer.append(&io, f * 1000) == 0);
+
+            const char* input = (const char*)io.pInputs[0].pVirAddr;
+            const char* feat = (const char*)io.pOutputs[0].pVirAddr;
+            const char* cls = (const char*)io.pOutputs[1].pVirAddr;
+            expected.batches.push_back(io.nBatchSize);
+            expected.inputs.emplace_back(input, input + info->pInputs[0].nSize / MAX_BATCH * io.nBatchSize);
+            expected.feats.emplace_back(feat, feat + FEAT_IMAGE * io.nBatchSize);
+            expected.clss.emplace_back(cls, cls + CLS_IMAGE * io.nBatchSize);
+        }
+        CHECK(writer.frames() == FRAMES);
+        CHECK(writer.close() == 0);
+    }
+    check_round_trip(expected);
+    check_damaged(expected);
+
+    // an output tensor::View cannot read is refused before the file is created
+    {
+        std::vector<AX_ENGINE_IOMETA_T> outputs(info->pOutputs, info->pOutputs + info->nOutputSize);
+        outputs[1].eDataType = AX_ENGINE_DT_SINT32;
+        AX_ENGINE_IO_INFO_T odd = *info;
+        odd.pOutputs = outputs.data();
+        middleware::capture_writer writer;
+        CHECK(writer.open("capture_sint32.axcap", &odd, false) != 0);
+        CHECK(!utilities::file_exist("capture_sint32.axcap"));
+    }
+
+    // the replay backend takes io info and outputs from the capture alone
+    {
+        AX_ENGINE_HANDLE replay = create("name toy_replay\n"
+                                         "capture capture.axcap\n");
+        AX_ENGINE_IO_INFO_T* replay_info = nullptr;
+        CHECK(AX_ENGINE_GetIOInfo(replay, &replay_info) == 0);
+        CHECK(replay_info->nOutputSize == 2 && replay_info->nMaxBatchSize == MAX_BATCH && replay_info->pOutputs[0].nSize == info->pOutputs[0].nSize);
+        AX_ENGINE_IO_T replay_io;
+        CHECK(middleware::prepare_io(replay_info, &replay_io, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED)) == 0);
+
+        // images in capture order, max_batch of them per run
+        std::vector<const char*> images;
+        for (int f = 0; f < FRAMES; f++)
+        {
+            for (int b = 0; b < expected.batches[f]; b++)
+            {
+                images.push_back(expected.feats[f].data() + b * FEAT_IMAGE);
+            }
+        }
+        for (size_t run = 0; run < images.size() + 3; run++)
+        {
+            CHECK(AX_ENGINE_RunSync(replay, &replay_io) == 0);
+            for (int b = 0; b < MAX_BATCH; b++)
+            {
+                const char* out = (const char*)replay_io.pOutputs[0].pVirAddr + b * FEAT_IMAGE;
+                CHECK(memcmp(out, images[(run * MAX_BATCH + b) % images.size()], FEAT_IMAGE) == 0);
+            }
+        }
+        middleware::free_io(&replay_io);
+        CHECK(AX_ENGINE_DestroyHandle(replay) == 0);
+    }
+
+    middleware::free_io(&io);
+    CHECK(AX_ENGINE_DestroyHandle(handle) == 0);
+    CHECK(AX_ENGINE_Deinit() == 0);
+    CHECK(AX_SYS_Deinit() == 0);
+    return check::result();
+}
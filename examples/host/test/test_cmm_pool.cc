@@ -0,0 +1,182 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * cmm_pool: middleware::cmm_size_class, reuse of idle blocks across sessions, the idle limit,
+ * reserve and release, the pool under concurrent use, preallocate_io for switched and
+ * concurrent models, and prepare_io failing before any memory can be allocated.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "check.hpp"
+#include "middleware/io.hpp"
+
+static void check_size_classes()
+{
+    using middleware::cmm_size_class;
+    CHECK(cmm_size_class(1) == 128 && cmm_size_class(4096) == 4096 && cmm_size_class(4097) == 5120);
+    CHECK(cmm_size_class(1228800) == 1310720); // 640x640x3
+    CHECK(cmm_size_class(950000) == cmm_size_class(1000000));
+    for (size_t size = 1; size < (64u << 20); size = size * 3 / 2 + 7)
+    {
+        size_t size_class = cmm_size_class(size);
+        CHECK(size_class >= size && size_class % 128 == 0 && cmm_size_class(size_class) == size_class);
+        CHECK(size <= 4096 || size_class - size <= size / 4 + 128);
+    }
+}
+
+static void check_pool()
+{
+    using middleware::cmm_size_class;
+    middleware::cmm_pool pool;
+    AX_U64 phy;
+    AX_VOID* vir;
+
+    // no idle limit: exact size, straight back to the cmm
+    CHECK(pool.alloc(&phy, &vir, 1000000, false, "s0") == 0 && (uintptr_t)vir % 128 == 0);
+    pool.free(phy, vir);
+    auto stats = pool.stats();
+    CHECK(stats.cmm_allocs == 1 && stats.cmm_frees == 1 && stats.cmm_bytes == 0 && stats.sessions["s0"].peak == 1000064);
+
+    // blocks the pool did not allocate go to AX_SYS_MemFree
+    CHECK(AX_SYS_MemAlloc(&phy, &vir, 100, 128, (const AX_S8*)"foreign") == 0);
+    pool.free(phy, vir);
+    CHECK(pool.stats().cmm_frees == 1);
+
+    // reuse across sessions of the same size class, cached and not cached apart
+    pool.set_idle_limit(16 << 20);
+    CHECK(pool.alloc(&phy, &vir, 1000000, false, "a") == 0);
+    pool.free(phy, vir);
+    AX_VOID* first = vir;
+    CHECK(pool.alloc(&phy, &vir, 950000, false, "b") == 0 && vir == first);
+    pool.free(phy, vir);
+    CHECK(pool.alloc(&phy, &vir, 950000, true, "b") == 0 && vir != first);
+    pool.free(phy, vir);
+    stats = pool.stats();
+    CHECK(stats.reused == 1 && stats.idle_bytes == 2 * cmm_size_class(1000000) && stats.sessions["b"].peak == cmm_size_class(950000));
+
+    // a lower idle limit frees the excess
+    pool.set_idle_limit(cmm_size_class(1000000));
+    CHECK(pool.stats().idle_bytes == cmm_size_class(1000000));
+
+    // reserve tops up to count idle blocks and raises the limit to keep them
+    CHECK(pool.reserve(3000000, false, 2, "r") == 0);
+    CHECK(pool.reserve(3000000, false, 2, "r") == 0);
+    CHECK(pool.stats().idle_bytes == cmm_size_class(1000000) + 2 * cmm_size_class(3000000));
+
+    // concurrent sessions, CHECK itself is not thread safe
+    pool.set_idle_limit(64 << 20);
+    auto before = pool.stats();
+    std::atomic<int> failed(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&pool, &failed, t]() {
+            for (int i = 0; i < 2000; i++)
+            {
+                AX_U64 block_phy;
+                AX_VOID* block_vir;
+                size_t size = 1000 + ((i * 7919 + t * 31) % 50) * 20000;
+                if (pool.alloc(&block_phy, &block_vir, size, i & 1, t & 1 ? "odd" : "even") != 0)
+                {
+                    failed++;
+                    continue;
+                }
+                memset(block_vir, t, size);
+                pool.free(block_phy, block_vir);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    stats = pool.stats();
+    CHECK(failed == 0 && stats.requests - before.requests == 8000);
+    CHECK(stats.requests - before.requests == stats.reused - before.reused + stats.cmm_allocs - before.cmm_allocs);
+    CHECK(stats.sessions["odd"].in_use == 0 && stats.sessions["even"].in_use == 0);
+
+    // release hands every idle block back
+    pool.release();
+    stats = pool.stats();
+    CHECK(stats.cmm_bytes == 0 && stats.idle_bytes == 0 && stats.cmm_allocs == stats.cmm_frees);
+}
+
+static void check_preallocate()
+{
+    auto& pool = middleware::default_cmm_pool();
+    AX_ENGINE_IOMETA_T inputs[1], outputs[2];
+    memset(inputs, 0, sizeof(inputs));
+    memset(outputs, 0, sizeof(outputs));
+    inputs[0].nSize = 1228800;
+    outputs[0].nSize = 3686400;
+    outputs[1].nSize = 3686400;
+    AX_ENGINE_IO_INFO_T first;
+    memset(&first, 0, sizeof(first));
+    first.pInputs = inputs;
+    first.nInputSize = 1;
+    first.pOutputs = outputs;
+    first.nOutputSize = 2;
+    AX_ENGINE_IO_INFO_T second = first;
+    second.nOutputSize = 1;
+    auto strategy = std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED);
+
+    // models switched in turn need the max per size class, concurrent ones the sum
+    CHECK(middleware::preallocate_io({&first, &second}, strategy, 2) == 0);
+    CHECK(pool.stats().cmm_allocs == 6);
+    CHECK(middleware::preallocate_io({&first, &second}, strategy, 2, true) == 0);
+    CHECK(pool.stats().cmm_allocs == 10);
+
+    AX_ENGINE_IO_T io;
+    CHECK(middleware::prepare_io(&first, &io, strategy, "first") == 0);
+    CHECK(pool.stats().cmm_allocs == 10 && pool.stats().reused == 3);
+    middleware::free_io(&io);
+    pool.release();
+    CHECK(pool.stats().cmm_bytes == 0);
+}
+
+int main()
+{
+    setenv("AX_HOST_LATENCY_SCALE", "0", 1);
+    check_size_classes();
+
+    // without AX_SYS_Init every allocation fails, prepare_io leaves io empty
+    AX_ENGINE_IOMETA_T meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.nSize = 4096;
+    AX_ENGINE_IO_INFO_T info;
+    memset(&info, 0, sizeof(info));
+    info.pInputs = &meta;
+    info.nInputSize = 1;
+    info.pOutputs = &meta;
+    info.nOutputSize = 1;
+    AX_ENGINE_IO_T io;
+    CHECK(middleware::prepare_io(&info, &io, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_DEFAULT)) != 0);
+    CHECK(io.pInputs == nullptr && io.pOutputs == nullptr && io.nInputSize == 0 && io.nOutputSize == 0);
+    middleware::free_io(&io);
+
+    CHECK(AX_SYS_Init() == 0);
+    check_pool();
+    check_preallocate();
+    CHECK(AX_SYS_Deinit() == 0);
+    return check::result();
+}
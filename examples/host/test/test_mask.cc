@@ -0,0 +1,273 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * mask: assemble_masks against the cv::Mat matmul + sigmoid > 0.5 it replaced, for rois clipped
+ * at the proto edges, overlapping and zero area ones, and more instances than one block.
+ * the packed and rle instance mask formats of base/mask.hpp: encode_rle, decode to packed
+ * and decode to cv::Mat round trip on widths that are not a multiple of 8, the packed
+ * upsample_mask gives the pixels of the cv::Mat one bit for bit, and blit paints exactly the
+ * set bits that land inside the image for offsets left of, above and past the image.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "check.hpp"
+#include "base/mask.hpp"
+
+static cv::Mat random_mask(std::mt19937& rng, int rows, int cols, int percent)
+{
+    cv::Mat mat(rows, cols, CV_8UC1);
+    for (int y = 0; y < rows; y++)
+    {
+        for (int x = 0; x < cols; x++)
+        {
+            mat.ptr<uint8_t>(y)[x] = (int)(rng() % 100) < percent ? 255 : 0;
+        }
+    }
+    return mat;
+}
+
+static mask::PackedMask pack(const cv::Mat& mat)
+{
+    mask::PackedMask packed;
+    packed.width = mat.cols;
+    packed.height = mat.rows;
+    packed.stride = (mat.cols + 7) / 8;
+    packed.bits.assign((size_t)packed.stride * packed.height, 0);
+    for (int y = 0; y < mat.rows; y++)
+    {
+        mask::pack_row(mat.ptr<uint8_t>(y), mat.cols, packed.bits.data() + (size_t)y * packed.stride);
+    }
+    return packed;
+}
+
+static bool same_pixels(const cv::Mat& a, const cv::Mat& b)
+{
+    if (a.rows != b.rows || a.cols != b.cols)
+        return false;
+    for (int y = 0; y < a.rows; y++)
+    {
+        if (memcmp(a.ptr<uint8_t>(y), b.ptr<uint8_t>(y), a.cols) != 0)
+            return false;
+    }
+    return true;
+}
+
+static void check_assemble(std::mt19937& rng)
+{
+    const int dim = 32, proto_h = 40, proto_w = 76;
+    const size_t plane = (size_t)proto_h * proto_w;
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+    std::vector<float> proto(dim * plane);
+    for (float& v : proto)
+    {
+        v = uniform(rng);
+    }
+
+    // edges, corners, the whole proto, overlaps, a tile boundary, zero width and zero height
+    std::vector<cv::Rect> rois = {
+        {0, 0, 10, 7},
+        {66, 33, 10, 7},
+        {0, 0, proto_w, proto_h},
+        {60, 0, 16, 40},
+        {0, 35, 76, 5},
+        {30, 10, 20, 20},
+        {35, 12, 20, 20},
+        {63, 5, 3, 3},
+        {12, 20, 0, 9},
+        {12, 20, 9, 0},
+        {64, 39, 12, 1},
+    };
+    for (int i = 0; i < 6; i++)
+    {
+        int x = (int)(rng() % proto_w), y = (int)(rng() % proto_h);
+        rois.push_back(cv::Rect(x, y, 1 + (int)(rng() % (proto_w - x)), 1 + (int)(rng() % (proto_h - y))));
+    }
+    const int n = (int)rois.size();
+    std::vector<float> coeffs((size_t)n * dim);
+    for (float& v : coeffs)
+    {
+        v = uniform(rng);
+    }
+
+    std::vector<cv::Mat> masks;
+    mask::assemble_masks(coeffs.data(), n, proto.data(), dim, proto_h, proto_w, rois, masks);
+    CHECK((int)masks.size() == n);
+
+    for (int i = 0; i < n; i++)
+    {
+        const cv::Rect& roi = rois[i];
+        if (roi.area() <= 0)
+        {
+            CHECK(masks[i].empty());
+            continue;
+        }
+        CHECK(masks[i].rows == roi.height && masks[i].cols == roi.width);
+
+        // the path get_out_bbox_mask used before: roi protos as a matrix, matmul, sigmoid > 0.5
+        cv::Mat protos(dim, roi.area(), CV_32FC1);
+        for (int k = 0; k < dim; k++)
+        {
+            float* row = protos.ptr<float>(k);
+            for (int y = 0; y < roi.height; y++)
+            {
+                memcpy(row + y * roi.width, proto.data() + k * plane + (size_t)(roi.y + y) * proto_w + roi.x, roi.width * sizeof(float));
+            }
+        }
+        cv::Mat proposal(1, dim, CV_32FC1, coeffs.data() + (size_t)i * dim);
+        cv::Mat logits = proposal * protos;
+        cv::Mat sigmoid;
+        cv::exp(-logits, sigmoid);
+        sigmoid = 1.0 / (1.0 + sigmoid);
+        cv::Mat expected = sigmoid > 0.5;
+
+        // a logit within rounding of 0 may land on either side, whatever the summation order
+        int mismatches = 0;
+        for (int y = 0; y < roi.height; y++)
+        {
+            for (int x = 0; x < roi.width; x++)
+            {
+                double exact = 0.;
+                for (int k = 0; k < dim; k++)
+                {
+                    exact += (double)coeffs[(size_t)i * dim + k] * proto[k * plane + (size_t)(roi.y + y) * proto_w + roi.x + x];
+                }
+                uint8_t actual = masks[i].ptr<uint8_t>(y)[x];
+                mismatches += std::fabs(exact) > 1e-4 && (actual != expected.ptr<uint8_t>(0)[y * roi.width + x] || actual != (exact > 0. ? 255 : 0));
+            }
+        }
+        CHECK(mismatches == 0);
+    }
+}
+
+static void check_round_trip(std::mt19937& rng)
+{
+    const int widths[] = {1, 3, 7, 9, 13, 31, 33, 157};
+    for (int width : widths)
+    {
+        for (int height : {1, 5, 64})
+        {
+            for (int percent : {0, 3, 50, 97, 100})
+            {
+                cv::Mat original = random_mask(rng, height, width, percent);
+                mask::PackedMask packed = pack(original);
+
+                mask::RleMask rle;
+                mask::encode_rle(packed, rle);
+                size_t total = 0;
+                for (uint32_t count : rle.counts)
+                {
+                    total += count;
+                }
+                CHECK(rle.width == width && rle.height == height && total == (size_t)width * height);
+
+                mask::PackedMask unpacked;
+                mask::decode(rle, unpacked);
+                CHECK(unpacked.width == width && unpacked.height == height && unpacked.bits == packed.bits);
+
+                cv::Mat decoded;
+                mask::decode(unpacked, decoded);
+                CHECK(same_pixels(decoded, original));
+            }
+        }
+    }
+}
+
+static void check_upsample(std::mt19937& rng)
+{
+    // proto resolution rois to box sizes, up, down, exact 2x down and degenerate
+    const cv::Size cases[][2] = {
+        {{1, 1}, {7, 5}},
+        {{9, 13}, {37, 51}},
+        {{40, 30}, {161, 119}},
+        {{40, 30}, {20, 15}},
+        {{33, 17}, {13, 9}},
+        {{16, 16}, {1, 1}},
+        {{5, 3}, {0, 4}},
+        {{0, 0}, {6, 6}},
+    };
+    for (const auto& c : cases)
+    {
+        cv::Mat src = c[0].area() > 0 ? random_mask(rng, c[0].height, c[0].width, 50) : cv::Mat();
+        cv::Mat scratch;
+        for (int interpolation : {(int)cv::INTER_LINEAR, (int)cv::INTER_NEAREST})
+        {
+            cv::Mat expected;
+            mask::upsample_mask(src, expected, c[1], interpolation);
+            mask::PackedMask packed;
+            mask::upsample_mask(src, packed, c[1], interpolation, scratch);
+            CHECK(packed.width == std::max(c[1].width, 0) && packed.height == std::max(c[1].height, 0));
+            if (expected.empty())
+            {
+                CHECK(packed.empty());
+                continue;
+            }
+            cv::Mat decoded;
+            mask::decode(packed, decoded);
+            CHECK(same_pixels(decoded, expected));
+        }
+    }
+}
+
+static void check_blit(std::mt19937& rng)
+{
+    const int rows = 23, cols = 29;
+    const std::vector<uint8_t> color = {10, 20, 30};
+    cv::Mat source = random_mask(rng, 11, 13, 60);
+    mask::PackedMask packed = pack(source);
+
+    // left, above, inside, past the right and bottom edges, and fully outside
+    const cv::Point offsets[] = {{-5, -3}, {-12, 4}, {4, -10}, {8, 6}, {22, 17}, {-13, 0}, {0, -11}, {29, 0}, {0, 23}, {-40, -40}};
+    for (const cv::Point& offset : offsets)
+    {
+        cv::Mat image(rows, cols, CV_8UC3);
+        memset(image.data, 0x55, (size_t)rows * cols * 3);
+        mask::blit(packed, image, offset, color);
+
+        bool exact = true;
+        for (int y = 0; y < rows; y++)
+        {
+            const uint8_t* row = image.ptr<uint8_t>(y);
+            for (int x = 0; x < cols; x++)
+            {
+                int mx = x - offset.x, my = y - offset.y;
+                bool set = mx >= 0 && my >= 0 && mx < source.cols && my < source.rows && source.ptr<uint8_t>(my)[mx];
+                for (int c = 0; c < 3; c++)
+                {
+                    exact = exact && row[x * 3 + c] == (set ? color[c] : 0x55);
+                }
+            }
+        }
+        CHECK(exact);
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(8);
+    check_assemble(rng);
+    check_round_trip(rng);
+    check_upsample(rng);
+    check_blit(rng);
+    return check::result();
+}
@@ -0,0 +1,198 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * base/math.hpp and the simd scans against double precision / plain loops. built once for
+ * the host isa (NEON or SSE) and once with AX_SAMPLES_NO_SIMD for the scalar paths.
+ *
+ * usage: test_math [repeat]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "base/math.hpp"
+
+#if defined(AX_SAMPLES_SIMD_NEON)
+static const char* ISA = "neon";
+#elif defined(AX_SAMPLES_SIMD_AVX)
+static const char* ISA = "avx";
+#elif defined(AX_SAMPLES_SIMD_SSE)
+static const char* ISA = "sse";
+#else
+static const char* ISA = "scalar";
+#endif
+
+static void check_accuracy(std::mt19937& rng)
+{
+    const size_t n = 1 << 18;
+    std::vector<float> x(n), y(n);
+
+    // exp, relative error over the whole non overflowing range, and lanes against the scalar function
+    double exp_error = 0;
+    size_t lane_mismatch = 0;
+    std::uniform_real_distribution<float> exp_range(-87.f, 88.f);
+    for (auto& v : x) v = exp_range(rng);
+    math::exp(x.data(), y.data(), (int)n);
+    for (size_t i = 0; i < n; i++)
+    {
+        double expected = std::exp((double)x[i]);
+        exp_error = std::max(exp_error, std::fabs(y[i] - expected) / expected);
+        lane_mismatch += y[i] != math::exp(x[i]);
+    }
+
+    // log, absolute error from 1e-35 to 1e30
+    double log_error = 0;
+    std::uniform_real_distribution<float> log_range(-80.f, 69.f);
+    for (auto& v : x) v = (float)std::exp((double)log_range(rng));
+    for (size_t i = 0; i < n; i++)
+    {
+        log_error = std::max(log_error, std::fabs(math::log(x[i]) - std::log((double)x[i])));
+    }
+#if defined(AX_SAMPLES_SIMD_NEON) || defined(AX_SAMPLES_SIMD_SSE)
+    for (size_t i = 0; i + 4 <= n; i += 4)
+    {
+        float lanes[4];
+#if defined(AX_SAMPLES_SIMD_NEON)
+        vst1q_f32(lanes, math::log_ps(vld1q_f32(&x[i])));
+#else
+        _mm_storeu_ps(lanes, math::log_ps(_mm_loadu_ps(&x[i])));
+#endif
+        for (int k = 0; k < 4; k++)
+        {
+            lane_mismatch += lanes[k] != math::log(x[i + k]);
+        }
+    }
+#endif
+    CHECK(math::log(0.f) != math::log(0.f));
+
+    // sigmoid
+    double sigmoid_error = 0;
+    std::uniform_real_distribution<float> sigmoid_range(-20.f, 20.f);
+    for (auto& v : x) v = sigmoid_range(rng);
+    math::sigmoid(x.data(), y.data(), (int)n);
+    for (size_t i = 0; i < n; i++)
+    {
+        sigmoid_error = std::max(sigmoid_error, std::fabs(y[i] - 1.0 / (1.0 + std::exp(-(double)x[i]))));
+    }
+
+    // softmax and dfl on 16 bins, softmax also on odd lengths for the tails
+    double softmax_error = 0, dfl_error = 0;
+    std::normal_distribution<float> logits(0.f, 4.f);
+    for (int t = 0; t < 20000; t++)
+    {
+        int length = t % 4 == 0 ? 16 : 1 + t % 23;
+        float src[23], dst[23];
+        for (int k = 0; k < length; k++) src[k] = logits(rng);
+        double m = *std::max_element(src, src + length), sum = 0, expectation = 0;
+        for (int k = 0; k < length; k++) sum += std::exp(src[k] - m);
+        math::softmax(src, dst, length);
+        for (int k = 0; k < length; k++)
+        {
+            double p = std::exp(src[k] - m) / sum;
+            softmax_error = std::max(softmax_error, std::fabs(dst[k] - p));
+            expectation += k * p;
+        }
+        dfl_error = std::max(dfl_error, std::fabs(math::dfl(src, length) - expectation));
+    }
+
+    fprintf(stdout, "[%s] exp rel %.3g, log abs %.3g, sigmoid %.3g, softmax %.3g, dfl %.3g, lane != scalar %zu\n",
+            ISA, exp_error, log_error, sigmoid_error, softmax_error, dfl_error, lane_mismatch);
+    CHECK(exp_error < 2e-7);
+    CHECK(log_error < 2e-6);
+    CHECK(sigmoid_error < 2e-7);
+    CHECK(softmax_error < 5e-7);
+    CHECK(dfl_error < 1e-5);
+    CHECK(lane_mismatch == 0);
+}
+
+template<typename T>
+static void check_scan(std::mt19937& rng, int low, int high)
+{
+    std::uniform_int_distribution<int> values(low, high);
+    T src[97];
+    for (int t = 0; t < 5000; t++)
+    {
+        int n = 1 + t % 97;
+        for (int i = 0; i < n; i++) src[i] = (T)values(rng);
+        T threshold = (T)values(rng);
+
+        bool expected = false;
+        for (int i = 0; i < n; i++) expected = expected || src[i] > threshold;
+        CHECK(simd::any_greater(src, n, threshold) == expected);
+
+        T value;
+        int index = simd::argmax(src, n, value);
+        CHECK(index == (int)(std::max_element(src, src + n) - src) && value == src[index]);
+    }
+}
+
+static void benchmark(std::mt19937& rng, int repeat)
+{
+    // the dfl of one 8400 cell head, and the softmax loop with std::exp it replaced
+    std::normal_distribution<float> logits(0.f, 4.f);
+    std::vector<float> bins(8400 * 64);
+    for (auto& v : bins) v = logits(rng);
+    volatile float sink = 0.f;
+
+    double math_us = check::best_of_us(repeat, [&]() {
+        float sum = 0.f;
+        for (size_t i = 0; i < bins.size(); i += 16) sum += math::dfl(&bins[i], 16);
+        sink = sum;
+    });
+    double libm_us = check::best_of_us(repeat, [&]() {
+        float sum = 0.f;
+        for (size_t i = 0; i < bins.size(); i += 16)
+        {
+            const float* p = &bins[i];
+            float m = *std::max_element(p, p + 16), den = 0.f, acc = 0.f, e[16];
+            for (int k = 0; k < 16; k++)
+            {
+                e[k] = std::exp(p[k] - m);
+                den += e[k];
+            }
+            for (int k = 0; k < 16; k++) acc += k * e[k] / den;
+            sum += acc;
+        }
+        sink = sum;
+    });
+    fprintf(stdout, "[%s] dfl x %zu: math %.1f us, std::exp %.1f us, %.2fx\n", ISA, bins.size() / 16, math_us, libm_us, libm_us / math_us);
+
+    std::vector<float> dst(bins.size());
+    double exp_us = check::best_of_us(repeat, [&]() { math::exp(bins.data(), dst.data(), (int)bins.size()); });
+    double std_exp_us = check::best_of_us(repeat, [&]() {
+        for (size_t i = 0; i < bins.size(); i++) dst[i] = std::exp(bins[i]);
+    });
+    fprintf(stdout, "[%s] exp x %zu: math %.1f us, std::exp %.1f us, %.2fx\n", ISA, bins.size(), exp_us, std_exp_us, std_exp_us / exp_us);
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = check::repeat(argc, argv, 20);
+    std::mt19937 rng(1);
+
+    check_accuracy(rng);
+    check_scan<float>(rng, -1000, 1000);
+    check_scan<int8_t>(rng, -128, 127);
+    check_scan<uint8_t>(rng, 0, 255);
+    check_scan<uint16_t>(rng, 0, 65535);
+    benchmark(rng, repeat);
+    return check::result();
+}
@@ -0,0 +1,230 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * nv12: nv12::bgr_to_nv12 and nv12_to_bgr against per pixel bt.601 references, nv12 and nv21,
+ * padded strides. crop_resize against the reference plane resize, its border color and the
+ * odd size checks. a 1080p frame is timed both ways, against cv::cvtColor when OpenCV is there.
+ *
+ * usage: test_nv12 [repeat]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(AX_HOST_TEST_OPENCV)
+#include <opencv2/opencv.hpp>
+#endif
+
+#include "check.hpp"
+#include "base/nv12.hpp"
+
+/* one pixel at a time, chroma from the rounded mean of each 2x2 block */
+static void reference_bgr_to_nv12(const uint8_t* bgr, int bgr_stride, const nv12::Frame& dst)
+{
+    for (int y = 0; y < dst.height; y++)
+    {
+        for (int x = 0; x < dst.width; x++)
+        {
+            const uint8_t* p = bgr + (size_t)y * bgr_stride + x * 3;
+            dst.y[(size_t)y * dst.stride + x] = nv12::detail::luma(p[2], p[1], p[0]);
+        }
+    }
+    for (int y = 0; y < dst.height; y += 2)
+    {
+        for (int x = 0; x < dst.width; x += 2)
+        {
+            int sum[3] = {0, 0, 0};
+            for (int k = 0; k < 4; k++)
+            {
+                const uint8_t* p = bgr + (size_t)(y + k / 2) * bgr_stride + (x + k % 2) * 3;
+                for (int c = 0; c < 3; c++)
+                {
+                    sum[c] += p[c];
+                }
+            }
+            int b = (sum[0] + 2) >> 2, g = (sum[1] + 2) >> 2, r = (sum[2] + 2) >> 2;
+            uint8_t* uv = dst.uv + (size_t)(y / 2) * dst.stride + x;
+            uv[dst.nv21 ? 1 : 0] = nv12::detail::chroma_u(r, g, b);
+            uv[dst.nv21 ? 0 : 1] = nv12::detail::chroma_v(r, g, b);
+        }
+    }
+}
+
+static void reference_nv12_to_bgr(const nv12::Frame& src, uint8_t* bgr, int bgr_stride)
+{
+    for (int y = 0; y < src.height; y++)
+    {
+        for (int x = 0; x < src.width; x++)
+        {
+            const uint8_t* uv = src.uv + (size_t)(y / 2) * src.stride + (x & ~1);
+            int c = 298 * (src.y[(size_t)y * src.stride + x] - 16);
+            int d = uv[src.nv21 ? 1 : 0] - 128;
+            int e = uv[src.nv21 ? 0 : 1] - 128;
+            uint8_t* p = bgr + (size_t)y * bgr_stride + x * 3;
+            p[0] = nv12::detail::clamp_u8((c + 516 * d + 128) >> 8);
+            p[1] = nv12::detail::clamp_u8((c - 100 * d - 208 * e + 128) >> 8);
+            p[2] = nv12::detail::clamp_u8((c + 409 * e + 128) >> 8);
+        }
+    }
+}
+
+static void fill(std::vector<uint8_t>& data, std::mt19937& rng)
+{
+    for (uint8_t& v : data)
+    {
+        v = (uint8_t)rng();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = check::repeat(argc, argv, 20);
+    std::mt19937 rng(1);
+
+    // widths around the 16 pixel vector step, strides with padding
+    const int sizes[][2] = {{2, 2}, {14, 6}, {16, 4}, {34, 10}, {640, 360}};
+    for (const int* size : sizes)
+    {
+        const int width = size[0], height = size[1];
+        const int bgr_stride = width * 3 + 7;
+        const int stride = width + 10;
+        std::vector<uint8_t> bgr((size_t)bgr_stride * height);
+        fill(bgr, rng);
+        for (bool nv21 : {false, true})
+        {
+            std::vector<uint8_t> expected(nv12::frame_size(stride, height), 9), actual(expected.size(), 9);
+            reference_bgr_to_nv12(bgr.data(), bgr_stride, nv12::make_frame(expected.data(), width, height, stride, nv21));
+            nv12::Frame frame = nv12::make_frame(actual.data(), width, height, stride, nv21);
+            CHECK(nv12::bgr_to_nv12(bgr.data(), bgr_stride, frame) == 0);
+            CHECK(expected == actual);
+
+            std::vector<uint8_t> back((size_t)bgr_stride * height, 9), reference(back.size(), 9);
+            fill(actual, rng);
+            reference_nv12_to_bgr(frame, reference.data(), bgr_stride);
+            nv12::nv12_to_bgr(frame, back.data(), bgr_stride);
+            CHECK(back == reference);
+        }
+    }
+
+    // mid gray goes through unchanged
+    {
+        std::vector<uint8_t> gray(4 * 2 * 3, 128), frame_data(nv12::frame_size(4, 2)), back(gray.size());
+        nv12::Frame frame = nv12::make_frame(frame_data.data(), 4, 2);
+        nv12::bgr_to_nv12(gray.data(), 4 * 3, frame);
+        nv12::nv12_to_bgr(frame, back.data(), 4 * 3);
+        CHECK(frame.uv[0] == 128 && frame.uv[1] == 128);
+        CHECK(back == gray);
+    }
+
+    const int width = 1920, height = 1080, stride = 2048;
+    std::vector<uint8_t> bgr((size_t)width * 3 * height), frame_data(nv12::frame_size(stride, height));
+    fill(bgr, rng);
+    nv12::Frame frame = nv12::make_frame(frame_data.data(), width, height, stride);
+    nv12::bgr_to_nv12(bgr.data(), width * 3, frame);
+
+    // crop_resize is the plane resize of y and uv into the letterbox roi
+    {
+        const int dst_w = 640, dst_h = 640;
+        std::vector<uint8_t> dst_data(nv12::frame_size(dst_w, dst_h));
+        nv12::Frame dst = nv12::make_frame(dst_data.data(), dst_w, dst_h);
+        letterbox::LetterboxTransform transform;
+        CHECK(nv12::crop_resize(frame, dst, nv12::make_aspect_ratio(nv12::ASPECT_RATIO_AUTO, 0xFFFFFF), &transform) == 0);
+        CHECK(transform.pad_x == 0 && transform.pad_y == 140 && transform.resize_w == 640 && transform.resize_h == 360);
+
+        std::vector<uint8_t> y(dst_w * dst_h), uv(dst_w * dst_h / 2);
+        uint8_t border_y, border_uv[2];
+        nv12::color_to_yuv(0xFFFFFF, false, border_y, border_uv);
+        resize::detail::bilinear_plane_reference<1>(frame.y, width, height, stride, y.data(), dst_w, dst_h, dst_w,
+                                                    resize::make_layout(640, 360, 0, 0, 0, 140, 640, 360), false, &border_y);
+        resize::detail::bilinear_plane_reference<2>(frame.uv, width / 2, height / 2, stride, uv.data(), dst_w / 2, dst_h / 2, dst_w,
+                                                    resize::make_layout(320, 180, 0, 0, 0, 70, 320, 180), false, border_uv);
+        CHECK(std::equal(y.begin(), y.end(), dst.y));
+        CHECK(std::equal(uv.begin(), uv.end(), dst.uv));
+        CHECK(dst.y[0] == border_y && dst.uv[0] == border_uv[0] && dst.uv[1] == border_uv[1]);
+
+        // nv12 into nv21 swaps the chroma bytes
+        std::vector<uint8_t> swapped_data(dst_data.size());
+        nv12::Frame swapped = nv12::make_frame(swapped_data.data(), dst_w, dst_h, 0, true);
+        CHECK(nv12::crop_resize(frame, swapped, nv12::make_aspect_ratio(nv12::ASPECT_RATIO_AUTO, 0xFFFFFF)) == 0);
+        bool same = true;
+        for (int i = 0; i < dst_w * dst_h / 2; i += 2)
+        {
+            same = same && swapped.uv[i] == dst.uv[i + 1] && swapped.uv[i + 1] == dst.uv[i];
+        }
+        CHECK(same);
+
+        // everything off the 2x2 chroma grid is refused
+        CHECK(nv12::crop_resize(frame, nv12::Rect{1, 0, 10, 10}, dst, nv12::make_aspect_ratio()) != 0);
+        CHECK(nv12::crop_resize(frame, nv12::Rect{0, 0, 1920, 1082}, dst, nv12::make_aspect_ratio()) != 0);
+        nv12::AspectRatio manual = nv12::make_aspect_ratio(nv12::ASPECT_RATIO_MANUAL);
+        manual.rect = nv12::Rect{10, 20, 100, 51};
+        CHECK(nv12::crop_resize(frame, dst, manual) != 0);
+        manual.rect = nv12::Rect{10, 20, 100, 50};
+        CHECK(nv12::crop_resize(frame, dst, manual, &transform) == 0);
+        CHECK(transform.pad_x == 10 && transform.pad_y == 20 && transform.resize_w == 100);
+        CHECK(nv12::crop_resize(frame, nv12::make_frame(dst_data.data(), 639, 640), nv12::make_aspect_ratio()) != 0);
+    }
+
+    std::vector<uint8_t> back((size_t)width * 3 * height);
+    double to_nv12 = check::best_of_us(repeat, [&]() { nv12::bgr_to_nv12(bgr.data(), width * 3, frame); });
+    double to_bgr = check::best_of_us(repeat, [&]() { nv12::nv12_to_bgr(frame, back.data(), width * 3); });
+    fprintf(stdout, "%-26s %10s %10s\n", "1920x1080", "nv12 us", "cv us");
+
+#if defined(AX_HOST_TEST_OPENCV)
+    {
+        // cvtColor has no bgr -> nv12, i420 plus the uv interleave is what the samples did
+        cv::Mat mat(height, width, CV_8UC3, bgr.data());
+        cv::Mat i420, out;
+        std::vector<uint8_t> packed(nv12::frame_size(width, height));
+        double cv_nv12 = check::best_of_us(repeat, [&]() {
+            cv::cvtColor(mat, i420, cv::COLOR_BGR2YUV_I420);
+            const uint8_t* u = i420.data + width * height;
+            const uint8_t* v = u + width * height / 4;
+            memcpy(packed.data(), i420.data, (size_t)width * height);
+            uint8_t* uv = packed.data() + width * height;
+            for (int i = 0; i < width * height / 4; i++)
+            {
+                uv[2 * i] = u[i];
+                uv[2 * i + 1] = v[i];
+            }
+        });
+        nv12::Frame tight = nv12::make_frame(packed.data(), width, height);
+        nv12::bgr_to_nv12(bgr.data(), width * 3, tight);
+        cv::Mat yuv(height * 3 / 2, width, CV_8UC1, packed.data());
+        double cv_bgr = check::best_of_us(repeat, [&]() { cv::cvtColor(yuv, out, cv::COLOR_YUV2BGR_NV12); });
+        nv12::nv12_to_bgr(tight, back.data(), width * 3);
+
+        int difference = 0;
+        for (size_t i = 0; i < back.size(); i++)
+        {
+            difference = std::max(difference, std::abs((int)back[i] - (int)out.data[i]));
+        }
+        fprintf(stdout, "%-26s %10.1f %10.1f\n", "bgr_to_nv12", to_nv12, cv_nv12);
+        fprintf(stdout, "%-26s %10.1f %10.1f\n", "nv12_to_bgr", to_bgr, cv_bgr);
+        fprintf(stdout, "max difference to cv::cvtColor %d\n", difference);
+    }
+#else
+    fprintf(stdout, "%-26s %10.1f %10s\n", "bgr_to_nv12", to_nv12, "-");
+    fprintf(stdout, "%-26s %10.1f %10s\n", "nv12_to_bgr", to_bgr, "-");
+#endif
+
+    return check::result();
+}
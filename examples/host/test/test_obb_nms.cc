@@ -0,0 +1,185 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * rotated nms: obb::nms_rotated_sorted_bboxes against the implementation it replaced, which
+ * rebuilt the covariances as cv::Point3f on every call and computed probiou of every box
+ * against every earlier one. that probiou is kept here as the reference.
+ *
+ * - probiou of RotatedBoxes matches the reference formula
+ * - picks equal a kept-only greedy loop on the reference probiou
+ * - every box the old loop kept is still kept, it compared against suppressed boxes too
+ *
+ * usage: test_obb_nms [repeat]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "base/detection.hpp"
+
+using detection::Object;
+
+static void reference_covariance(const std::vector<Object>& objects, std::vector<cv::Point3f>& covariance)
+{
+    covariance.clear();
+    for (const Object& obj : objects)
+    {
+        float a = obj.rect.width * obj.rect.width * 0.0833333333f;
+        float b = obj.rect.height * obj.rect.height * 0.0833333333f;
+        float c_sin = std::sin(obj.angle);
+        float c_cos = std::cos(obj.angle);
+        covariance.push_back(cv::Point3f(a * c_cos * c_cos + b * c_sin * c_sin, a * c_sin * c_sin + b * c_cos * c_cos, a * c_cos * c_sin - b * c_sin * c_cos));
+    }
+}
+
+static float reference_probiou(const Object& obj1, const Object& obj2, const cv::Point3f& covar1, const cv::Point3f& covar2)
+{
+    using detection::obb::clamp_;
+    float v_x1_x2 = covar1.x + covar2.x;
+    float v_y1_y2 = covar1.y + covar2.y;
+    float x1_x2 = obj1.rect.x - obj2.rect.x;
+    float y1_y2 = obj1.rect.y - obj2.rect.y;
+    float dem1 = clamp_(covar1.x * covar1.y - covar1.z * covar1.z);
+    float dem2 = clamp_(covar2.x * covar2.y - covar2.z * covar2.z);
+    float dem_num = v_x1_x2 * v_y1_y2 - (covar1.z + covar2.z) * (covar1.z + covar2.z);
+
+    float t1 = (v_x1_x2 * y1_y2 * y1_y2 + v_y1_y2 * x1_x2 * x1_x2) / (dem_num + 1e-7) * 0.25f;
+    float t2 = ((covar1.z + covar2.z) * (-x1_x2) * y1_y2) / (dem_num + 1e-7) * 0.5f;
+    float t3 = math::log(0.25f * dem_num / (std::sqrt(dem1 * dem2) + 1e-7) + 1e-7) * 0.5f;
+
+    float bd = t1 + t2 + t3;
+    return math::exp(-clamp_(bd, 1e-7, 100.f));
+}
+
+/* the replaced function: max probiou over all earlier boxes, suppressed or not */
+static void old_nms(const std::vector<Object>& objects, std::vector<int>& picked, float nms_threshold)
+{
+    picked.clear();
+    std::vector<cv::Point3f> covariance;
+    reference_covariance(objects, covariance);
+    float threshold = (1.f - nms_threshold) * (1.f - nms_threshold);
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        float max_iou = 0.f;
+        for (size_t j = 0; j < i; j++)
+        {
+            max_iou = std::max(max_iou, reference_probiou(objects[i], objects[j], covariance[i], covariance[j]));
+        }
+        if (max_iou < threshold)
+            picked.push_back((int)i);
+    }
+}
+
+/* greedy over kept boxes with the reference probiou */
+static void kept_only_nms(const std::vector<Object>& objects, std::vector<int>& picked, float nms_threshold)
+{
+    picked.clear();
+    std::vector<cv::Point3f> covariance;
+    reference_covariance(objects, covariance);
+    float threshold = (1.f - nms_threshold) * (1.f - nms_threshold);
+    for (int i = 0; i < (int)objects.size(); i++)
+    {
+        bool keep = true;
+        for (int j : picked)
+        {
+            if (reference_probiou(objects[i], objects[j], covariance[i], covariance[j]) >= threshold)
+            {
+                keep = false;
+                break;
+            }
+        }
+        if (keep)
+            picked.push_back(i);
+    }
+}
+
+static std::vector<Object> random_obbs(std::mt19937& rng, int n)
+{
+    std::uniform_real_distribution<float> position(0.f, 1024.f), extent(5.f, 120.f), angle(0.f, 3.14159f), unit(0.f, 1.f);
+    std::vector<Object> objects(n);
+    for (Object& obj : objects)
+    {
+        obj.rect = cv::Rect_<float>(position(rng), position(rng), extent(rng), extent(rng));
+        obj.angle = angle(rng);
+        obj.prob = unit(rng);
+        obj.label = 0;
+    }
+    // half of the boxes are jittered copies, so that suppression happens
+    for (int i = 0; i < n / 2; i++)
+    {
+        objects[i + n / 2] = objects[i];
+        objects[i + n / 2].rect.x += extent(rng) * 0.1f;
+        objects[i + n / 2].angle += 0.1f * unit(rng);
+        objects[i + n / 2].prob = unit(rng);
+    }
+    std::sort(objects.begin(), objects.end(), [](const Object& a, const Object& b) { return a.prob > b.prob; });
+    return objects;
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = check::repeat(argc, argv, 10);
+    std::mt19937 rng(3);
+
+    // pairwise probiou
+    {
+        std::vector<Object> objects = random_obbs(rng, 400);
+        std::vector<cv::Point3f> covariance;
+        reference_covariance(objects, covariance);
+        detection::obb::RotatedBoxes boxes;
+        for (const Object& obj : objects) boxes.push_back(obj);
+
+        float max_diff = 0.f;
+        for (int i = 0; i < (int)objects.size(); i++)
+        {
+            for (int j = 0; j < (int)objects.size(); j++)
+            {
+                float expected = reference_probiou(objects[i], objects[j], covariance[i], covariance[j]);
+                max_diff = std::max(max_diff, std::fabs(expected - detection::obb::probiou(boxes, i, boxes, j)));
+            }
+        }
+        CHECK(max_diff < 1e-4f);
+        fprintf(stdout, "probiou max abs diff %g over %zu pairs\n", max_diff, objects.size() * objects.size());
+    }
+
+    fprintf(stdout, "%6s %5s %6s %6s %12s %12s %8s\n", "boxes", "thr", "old", "kept", "old us", "new us", "speedup");
+    for (int n : {50, 300, 1000, 5000})
+    {
+        for (float nms_threshold : {0.3f, 0.45f, 0.7f})
+        {
+            std::vector<Object> objects = random_obbs(rng, n);
+            std::vector<int> old_picked, reference, picked;
+            old_nms(objects, old_picked, nms_threshold);
+            kept_only_nms(objects, reference, nms_threshold);
+            detection::obb::nms_rotated_sorted_bboxes(objects, picked, nms_threshold);
+
+            CHECK(picked == reference);
+            CHECK(std::includes(picked.begin(), picked.end(), old_picked.begin(), old_picked.end()));
+
+            int count = n >= 1000 ? std::max(repeat / 5, 1) : repeat;
+            double old_us = check::best_of_us(count, [&]() { old_nms(objects, old_picked, nms_threshold); });
+            double new_us = check::best_of_us(count, [&]() { detection::obb::nms_rotated_sorted_bboxes(objects, picked, nms_threshold); });
+            fprintf(stdout, "%6d %5.2f %6zu %6zu %12.1f %12.1f %7.1fx\n", n, nms_threshold, old_picked.size(), picked.size(), old_us, new_us, old_us / new_us);
+        }
+    }
+
+    return check::result();
+}
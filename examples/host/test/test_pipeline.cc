@@ -0,0 +1,213 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * pipeline: frames reach postprocess in order with their own io set, the io set ring bounds
+ * the frames in flight, an npu error stops the run and drops the frames behind it without a
+ * deadlock, and the PipelineStats counts. the replay backend runs the model.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "check.hpp"
+#include "middleware/pipeline.hpp"
+
+struct Job
+{
+    int frame;
+};
+
+// preprocess and the npu run on their own threads, postprocess on the caller of run()
+static struct Stream
+{
+    int frames = 0;                    // preprocess returns false after this many
+    int fail_at = -1;                  // frame whose npu run fails
+    int npu_us = 0;                    // extra time of a run
+    int post_us = 0;                   // time of a postprocess
+    std::atomic<int> next{0};          // frames preprocessed
+    std::atomic<int> in_flight{0};     // preprocessed, not yet post processed or dropped
+    std::atomic<int> max_in_flight{0};
+    int posted = 0;
+    bool in_order = true;
+    bool own_io = true; // the output of every frame carries its own input
+} stream;
+
+static const int FAULT = 0x80060009;
+
+static void reset_stream(int frames, int fail_at = -1, int npu_us = 0, int post_us = 0)
+{
+    stream.frames = frames;
+    stream.fail_at = fail_at;
+    stream.npu_us = npu_us;
+    stream.post_us = post_us;
+    stream.next = 0;
+    stream.in_flight = 0;
+    stream.max_in_flight = 0;
+    stream.posted = 0;
+    stream.in_order = true;
+    stream.own_io = true;
+}
+
+static bool preprocess(Job& job, AX_ENGINE_IO_T* io)
+{
+    if (stream.next.load() >= stream.frames)
+        return false;
+    job.frame = stream.next++;
+    memcpy(io->pInputs[0].pVirAddr, &job.frame, sizeof(job.frame));
+    int in_flight = ++stream.in_flight;
+    int seen = stream.max_in_flight.load();
+    while (in_flight > seen && !stream.max_in_flight.compare_exchange_weak(seen, in_flight))
+    {
+    }
+    return true;
+}
+
+// the replay run, then the frame id copied from the input to the output
+static int npu(AX_ENGINE_HANDLE handle, Job& job, AX_ENGINE_IO_T* io)
+{
+    if (stream.npu_us > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(stream.npu_us));
+    if (job.frame == stream.fail_at)
+        return FAULT;
+    int ret = AX_ENGINE_RunSync(handle, io);
+    memcpy(io->pOutputs[0].pVirAddr, io->pInputs[0].pVirAddr, sizeof(int));
+    return ret;
+}
+
+static void postprocess(Job& job, AX_ENGINE_IO_T* io)
+{
+    if (stream.post_us > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(stream.post_us));
+    int frame;
+    memcpy(&frame, io->pOutputs[0].pVirAddr, sizeof(frame));
+    stream.own_io = stream.own_io && frame == job.frame;
+    stream.in_order = stream.in_order && job.frame == stream.posted;
+    stream.posted++;
+    stream.in_flight--;
+}
+
+static int run(middleware::pipeline<Job>& pipeline, AX_ENGINE_HANDLE handle)
+{
+    return pipeline.run(preprocess, postprocess, [handle](Job& job, AX_ENGINE_IO_T* io) { return npu(handle, job, io); });
+}
+
+static void check_order(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* info, int num_sets)
+{
+    middleware::pipeline<Job> pipeline;
+    CHECK(pipeline.init(handle, info, num_sets, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED)) == 0);
+    CHECK(pipeline.num_sets() == num_sets);
+
+    // a slow postprocess lets preprocess fill every io set, never more
+    reset_stream(60, -1, 0, 1000);
+    CHECK(run(pipeline, handle) == 0);
+    CHECK(stream.posted == 60 && stream.in_order && stream.own_io);
+    CHECK(stream.max_in_flight == num_sets && stream.in_flight == 0);
+
+    const middleware::PipelineStats& stats = pipeline.stats();
+    CHECK(stats.frames == 60 && stats.failed == 0);
+    CHECK(stats.busy_ms[middleware::STAGE_POST] >= 60.f && stats.wall_ms >= stats.busy_ms[middleware::STAGE_POST]);
+    CHECK(stats.fps > 0.f && stats.steady_fps > 0.f);
+    CHECK(stats.latency_p50 <= stats.latency_p90 && stats.latency_p90 <= stats.latency_p99 && stats.latency_p99 <= stats.latency_max);
+    CHECK(stats.latency_p50 >= 1.f);
+
+    // a slow npu, the same pipeline again
+    reset_stream(40, -1, 500, 0);
+    CHECK(run(pipeline, handle) == 0);
+    CHECK(stream.posted == 40 && stream.in_order && stream.own_io && stream.max_in_flight <= num_sets);
+    CHECK(pipeline.stats().frames == 40 && pipeline.stats().busy_ms[middleware::STAGE_NPU] >= 20.f);
+}
+
+// the failed run and the frames behind it are dropped, the run returns the error
+static void check_npu_error(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* info)
+{
+    middleware::pipeline<Job> pipeline;
+    CHECK(pipeline.init(handle, info, 3, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED)) == 0);
+
+    for (int fail_at : {0, 1, 7, 29})
+    {
+        reset_stream(30, fail_at, 200, 300);
+        CHECK(run(pipeline, handle) == FAULT);
+        const middleware::PipelineStats& stats = pipeline.stats();
+        CHECK(stream.posted == fail_at && stream.in_order && stream.own_io);
+        CHECK((int)stats.frames == fail_at && stats.failed >= 1);
+        CHECK((int)(stats.frames + stats.failed) == stream.next.load());
+        CHECK(stream.next.load() <= fail_at + 1 + pipeline.num_sets());
+    }
+
+    // the pipeline runs again after an error
+    reset_stream(10);
+    CHECK(run(pipeline, handle) == 0 && stream.posted == 10 && stream.in_order);
+    CHECK(pipeline.stats().frames == 10 && pipeline.stats().failed == 0);
+}
+
+// the default npu stage is AX_ENGINE_RunSync, an empty stream and an empty pipeline
+static void check_defaults(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_INFO_T* info)
+{
+    middleware::pipeline<Job> pipeline;
+    reset_stream(5);
+    CHECK(pipeline.run(preprocess, postprocess) == -1);
+    CHECK(stream.next.load() == 0);
+
+    CHECK(pipeline.init(handle, info, 2, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED)) == 0);
+    int posted = 0;
+    auto count = [&posted](Job&, AX_ENGINE_IO_T*) { posted++; };
+    CHECK(pipeline.run(preprocess, count) == 0);
+    CHECK(posted == 5 && pipeline.stats().frames == 5);
+
+    reset_stream(0);
+    CHECK(pipeline.run(preprocess, postprocess) == 0);
+    CHECK(stream.posted == 0 && pipeline.stats().frames == 0 && pipeline.stats().failed == 0);
+
+    pipeline.release();
+    CHECK(pipeline.num_sets() == 0);
+    CHECK(middleware::default_cmm_pool().stats().cmm_bytes == 0);
+}
+
+int main()
+{
+    setenv("AX_HOST_LATENCY_SCALE", "0", 1);
+    CHECK(AX_SYS_Init() == 0);
+    AX_ENGINE_NPU_ATTR_T attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.eHardMode = AX_ENGINE_VIRTUAL_NPU_DISABLE;
+    CHECK(AX_ENGINE_Init(&attr) == 0);
+
+    const std::string manifest = "name toy\n"
+                                 "latency_ms 1\n"
+                                 "input images uint8 1x4x4x3 nhwc bgr\n"
+                                 "output out0 float32 1x4\n";
+    AX_ENGINE_HANDLE handle = nullptr;
+    AX_ENGINE_IO_INFO_T* info = nullptr;
+    CHECK(AX_ENGINE_CreateHandle(&handle, manifest.data(), (AX_U32)manifest.size()) == 0);
+    CHECK(AX_ENGINE_GetIOInfo(handle, &info) == 0);
+
+    check_order(handle, info, 1);
+    check_order(handle, info, 3);
+    check_order(handle, info, 5);
+    check_npu_error(handle, info);
+    check_defaults(handle, info);
+
+    CHECK(AX_ENGINE_DestroyHandle(handle) == 0);
+    CHECK(AX_ENGINE_Deinit() == 0);
+    CHECK(AX_SYS_Deinit() == 0);
+    return check::result();
+}
@@ -0,0 +1,192 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * quantized decode: int8 / uint8 / uint16 outputs decoded through get_output_view and the
+ * integer threshold must give the same proposals as the float path on the dequantized copy.
+ * the quantized tensors are recorded and replayed through the host backend.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "base/detection.hpp"
+#include "middleware/io.hpp"
+
+static const int COLS = 640;
+static const int ROWS = 640;
+static const int CLS_NUM = 80;
+static const int STRIDES[] = {8, 16, 32};
+
+template<typename T>
+static std::vector<T> random_tensor(std::mt19937& rng, size_t n, int low, int high)
+{
+    std::uniform_int_distribution<int> values(low, high);
+    std::vector<T> data(n);
+    for (auto& v : data) v = (T)values(rng);
+    return data;
+}
+
+template<typename T>
+static std::vector<float> dequantized(const T* data, size_t n, const tensor::QuantParam& quant)
+{
+    std::vector<float> out(n);
+    tensor::dequantize(data, out.data(), (int)n, quant);
+    return out;
+}
+
+static bool same(const std::vector<detection::Object>& a, const std::vector<detection::Object>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].label != b[i].label || a[i].prob != b[i].prob || a[i].rect.x != b[i].rect.x || a[i].rect.y != b[i].rect.y
+            || a[i].rect.width != b[i].rect.width || a[i].rect.height != b[i].rect.height || a[i].mask_feat != b[i].mask_feat || a[i].kps_feat != b[i].kps_feat)
+            return false;
+    }
+    return true;
+}
+
+static bool write_file(const std::string& path, const void* data, size_t size)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+/* 3 level yolov8 detection head recorded as T, replayed and decoded from the cmm output */
+template<typename T>
+static void check_replayed(const char* dtype, int low, int high, const tensor::QuantParam& quant, std::mt19937& rng)
+{
+    std::string manifest = std::string("name quantized_") + dtype + "\ninput images uint8 1x640x640x3 nhwc bgr\n";
+    std::vector<std::vector<T> > recorded;
+    for (int stride : STRIDES)
+    {
+        int size = COLS / stride;
+        std::string path = std::string("quantized_") + dtype + "_" + std::to_string(stride) + ".bin";
+        recorded.push_back(random_tensor<T>(rng, (size_t)size * size * (64 + CLS_NUM), low, high));
+        CHECK(write_file(path, recorded.back().data(), recorded.back().size() * sizeof(T)));
+        manifest += "output out" + std::to_string(stride) + " " + dtype + " 1x" + std::to_string(size) + "x" + std::to_string(size) + "x" + std::to_string(64 + CLS_NUM) + " nhwc " + path + "\n";
+    }
+
+    AX_ENGINE_HANDLE handle = nullptr;
+    CHECK(AX_ENGINE_CreateHandle(&handle, manifest.data(), (AX_U32)manifest.size()) == 0);
+    if (!handle)
+        return;
+    AX_ENGINE_IO_INFO_T* info = nullptr;
+    AX_ENGINE_IO_T io;
+    CHECK(AX_ENGINE_GetIOInfo(handle, &info) == 0);
+    CHECK(middleware::prepare_io(info, &io, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED)) == 0);
+    CHECK(AX_ENGINE_RunSync(handle, &io) == 0);
+
+    for (float threshold : {0.01f, 0.25f, 0.45f, 0.9f, 0.999f})
+    {
+        for (int level = 0; level < 3; level++)
+        {
+            auto view = middleware::get_output_view(info, &io, level, quant.scale, quant.zero_point);
+            CHECK(view.data == io.pOutputs[level].pVirAddr && view.quant.scale == quant.scale && view.quant.zero_point == quant.zero_point);
+            auto feat = dequantized((const T*)view.data, recorded[level].size(), quant);
+
+            std::vector<detection::Object> expected, runtime, fixed;
+            detection::generate_proposals_yolov8_native(STRIDES[level], feat.data(), threshold, expected, COLS, ROWS, CLS_NUM);
+            detection::generate_proposals_yolov8_native(STRIDES[level], view, threshold, runtime, COLS, ROWS, CLS_NUM);
+            detection::make_yolov8_native_decoder(middleware::get_output_shape(info, level))(STRIDES[level], view, threshold, fixed, COLS, ROWS);
+            CHECK(same(expected, runtime));
+            CHECK(same(expected, fixed));
+        }
+    }
+
+    middleware::free_io(&io);
+    CHECK(AX_ENGINE_DestroyHandle(handle) == 0);
+}
+
+/* seg and pose heads, the side tensors are dequantized per survivor */
+static void check_side_tensors(std::mt19937& rng)
+{
+    const int stride = 16, cells = (COLS / stride) * (ROWS / stride);
+    const tensor::QuantParam quant = {0.05f, 40};
+    const tensor::QuantParam side_quant = {0.02f, -3};
+
+    auto seg_feat = random_tensor<int8_t>(rng, (size_t)cells * (64 + CLS_NUM), -128, 110);
+    auto seg_mask = random_tensor<int8_t>(rng, (size_t)cells * 32, -128, 127);
+    auto pose_feat = random_tensor<int8_t>(rng, (size_t)cells * (64 + 1), -128, 110);
+    auto pose_kps = random_tensor<int8_t>(rng, (size_t)cells * 51, -128, 127);
+
+    auto seg_feat_f = dequantized(seg_feat.data(), seg_feat.size(), quant);
+    auto seg_mask_f = dequantized(seg_mask.data(), seg_mask.size(), side_quant);
+    auto pose_feat_f = dequantized(pose_feat.data(), pose_feat.size(), quant);
+    auto pose_kps_f = dequantized(pose_kps.data(), pose_kps.size(), side_quant);
+
+    for (float threshold : {0.25f, 0.45f})
+    {
+        std::vector<detection::Object> expected, actual;
+        detection::generate_proposals_yolov8_seg_native(stride, seg_feat_f.data(), seg_mask_f.data(), threshold, expected, COLS, ROWS, CLS_NUM);
+        detection::generate_proposals_yolov8_seg_native(stride, tensor::make_view(seg_feat.data(), quant.scale, quant.zero_point),
+                                                        tensor::make_view(seg_mask.data(), side_quant.scale, side_quant.zero_point), threshold, actual, COLS, ROWS, CLS_NUM);
+        CHECK(!expected.empty() && same(expected, actual));
+
+        expected.clear();
+        actual.clear();
+        detection::generate_proposals_yolov8_pose_native(stride, pose_feat_f.data(), pose_kps_f.data(), threshold, expected, COLS, ROWS);
+        detection::generate_proposals_yolov8_pose_native(stride, tensor::make_view(pose_feat.data(), quant.scale, quant.zero_point),
+                                                         tensor::make_view(pose_kps.data(), side_quant.scale, side_quant.zero_point), threshold, actual, COLS, ROWS);
+        CHECK(!expected.empty() && same(expected, actual));
+    }
+}
+
+/* an output type the decoders cannot read gives a null view instead of a float reinterpretation */
+static void check_unsupported()
+{
+    const std::string manifest = "name int32_out\ninput images uint8 1x4x4x3 nhwc bgr\noutput out0 int32 1x4\n";
+    AX_ENGINE_HANDLE handle = nullptr;
+    CHECK(AX_ENGINE_CreateHandle(&handle, manifest.data(), (AX_U32)manifest.size()) == 0);
+    if (!handle)
+        return;
+    AX_ENGINE_IO_INFO_T* info = nullptr;
+    AX_ENGINE_IO_T io;
+    CHECK(AX_ENGINE_GetIOInfo(handle, &info) == 0);
+    CHECK(middleware::prepare_io(info, &io, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED)) == 0);
+    CHECK(middleware::get_output_view(info, &io, 0).data == nullptr);
+    middleware::free_io(&io);
+    CHECK(AX_ENGINE_DestroyHandle(handle) == 0);
+}
+
+int main()
+{
+    setenv("AX_HOST_LATENCY_SCALE", "0", 1);
+    CHECK(AX_SYS_Init() == 0);
+    AX_ENGINE_NPU_ATTR_T attr;
+    memset(&attr, 0, sizeof(attr));
+    CHECK(AX_ENGINE_Init(&attr) == 0);
+
+    std::mt19937 rng(1);
+    check_replayed<int8_t>("sint8", -128, 110, {0.05f, 40}, rng);
+    check_replayed<uint8_t>("uint8", 0, 240, {0.06f, 170}, rng);
+    check_replayed<uint16_t>("uint16", 0, 60000, {0.0002f, 50000}, rng);
+    check_side_tensors(rng);
+    check_unsupported();
+
+    CHECK(AX_ENGINE_Deinit() == 0);
+    CHECK(AX_SYS_Deinit() == 0);
+    return check::result();
+}
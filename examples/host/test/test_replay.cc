@@ -0,0 +1,145 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * replay backend: record cycling, dynamic batch, cmm alignment, batch overflow, npu sets
+ * and the cmm bookkeeping. the manifests are built here, the recording is written to the
+ * working directory.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "middleware/io.hpp"
+
+static const int RECORDS = 5;
+
+static bool write_recording(const char* path)
+{
+    // record r of out0 is { r, r + .5, 0, 0 }
+    std::vector<float> data(RECORDS * 4, 0.f);
+    for (int r = 0; r < RECORDS; r++)
+    {
+        data[r * 4] = (float)r;
+        data[r * 4 + 1] = r + .5f;
+    }
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(data.data(), sizeof(float), data.size(), file) == data.size();
+    return fclose(file) == 0 && ok;
+}
+
+static AX_S32 create(const std::string& manifest, AX_ENGINE_HANDLE* handle, int npu_set = 0)
+{
+    if (npu_set == 0)
+        return AX_ENGINE_CreateHandle(handle, manifest.data(), (AX_U32)manifest.size());
+    AX_ENGINE_HANDLE_EXTRA_T extra;
+    memset(&extra, 0, sizeof(extra));
+    extra.nNpuSet = npu_set;
+    return AX_ENGINE_CreateHandleV2(handle, manifest.data(), (AX_U32)manifest.size(), &extra);
+}
+
+static void check_cycling(const std::string& manifest, int batch)
+{
+    AX_ENGINE_HANDLE handle = nullptr;
+    CHECK(create(manifest, &handle) == 0);
+    if (!handle)
+        return;
+    AX_ENGINE_IO_INFO_T* info = nullptr;
+    CHECK(AX_ENGINE_GetIOInfo(handle, &info) == 0);
+
+    AX_ENGINE_IO_T io;
+    CHECK(middleware::prepare_io(info, &io, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED)) == 0);
+    CHECK(((uintptr_t)io.pInputs[0].pVirAddr % AX_CMM_ALIGN_SIZE) == 0);
+    CHECK(((uintptr_t)io.pOutputs[0].pVirAddr % AX_CMM_ALIGN_SIZE) == 0);
+
+    io.nBatchSize = info->bDynamicBatchSize ? batch : 0;
+    int images = info->bDynamicBatchSize ? batch : (int)info->nMaxBatchSize;
+    for (int run = 0; run < 7; run++)
+    {
+        CHECK(AX_ENGINE_RunSync(handle, &io) == 0);
+        const float* out = (const float*)io.pOutputs[0].pVirAddr;
+        for (int b = 0; b < images; b++)
+        {
+            int record = (run * images + b) % RECORDS;
+            CHECK(out[b * 4] == record && out[b * 4 + 1] == record + .5f);
+        }
+    }
+
+    // more images than the model was compiled for
+    io.nBatchSize = info->nMaxBatchSize + 1;
+    if (info->bDynamicBatchSize)
+        CHECK(AX_ENGINE_RunSync(handle, &io) != 0);
+
+    middleware::free_io(&io);
+    CHECK(AX_ENGINE_DestroyHandle(handle) == 0);
+}
+
+int main()
+{
+    setenv("AX_HOST_LATENCY_SCALE", "0", 1);
+    CHECK(write_recording("replay_out0.bin"));
+
+    const std::string single = "name toy\n"
+                               "latency_ms 4\n"
+                               "input images uint8 1x4x4x3 nhwc bgr\n"
+                               "output out0 float32 1x4 replay_out0.bin\n";
+    const std::string batch = "name toy_batch\n"
+                              "max_batch 4 dynamic\n"
+                              "input images uint8 4x4x4x3 nhwc rgb\n"
+                              "output out0 float32 4x4 replay_out0.bin\n";
+
+    AX_ENGINE_HANDLE handle = nullptr;
+    CHECK(AX_SYS_Init() == 0);
+    CHECK(create(single, &handle) != 0); // engine not initialized
+
+    AX_ENGINE_NPU_ATTR_T attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.eHardMode = AX_ENGINE_VIRTUAL_NPU_DISABLE;
+    CHECK(AX_ENGINE_Init(&attr) == 0);
+
+    check_cycling(single, 1);
+    check_cycling(batch, 3);
+    check_cycling(batch, 1);
+
+    // a 1 core build on core 2, its io info is the same
+    AX_ENGINE_IO_INFO_T* info = nullptr;
+    CHECK(create(single, &handle, 2) == 0);
+    CHECK(AX_ENGINE_GetIOInfo(handle, &info) == 0 && info->nOutputSize == 1 && info->pOutputs[0].nSize == 16);
+    CHECK(AX_ENGINE_DestroyHandle(handle) == 0);
+
+    // malformed manifests
+    CHECK(create("input x uint9 1x2\noutput y float32 1\n", &handle) != 0);
+    CHECK(create("name no_outputs\ninput x uint8 1x2\n", &handle) != 0);
+    CHECK(create("name b\nmax_batch 0\ninput x uint8 1x2\noutput y float32 1\n", &handle) != 0);
+
+    // cmm bookkeeping
+    AX_U64 phy = 0;
+    AX_VOID* vir = nullptr;
+    CHECK(AX_SYS_MemAlloc(&phy, &vir, 1000, 256, (const AX_S8*)"test") == 0);
+    CHECK(((uintptr_t)vir % 256) == 0 && phy == (AX_U64)(uintptr_t)vir);
+    CHECK(AX_SYS_MemFree(phy, vir) == 0);
+    CHECK(AX_SYS_MemFree(phy, vir) != 0); // double free
+
+    CHECK(AX_ENGINE_Deinit() == 0);
+    CHECK(AX_SYS_Deinit() == 0);
+    return check::result();
+}
@@ -0,0 +1,255 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * resize: resize::bilinear_letterbox against the per pixel bilinear_letterbox_reference, bit
+ * exact for letterbox, stretch and center crop layouts with and without the rb swap. the
+ * 8 bit fixed point result stays within 1 of the exact bilinear value, and of cv::resize when
+ * OpenCV is there, which the fused path is also timed against. with OpenCV the common.hpp entry
+ * points must stay bit exact with cv::resize unless fused is asked for.
+ *
+ * usage: test_resize [repeat]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#if defined(AX_HOST_TEST_OPENCV)
+#include <opencv2/opencv.hpp>
+#include "base/common.hpp"
+#endif
+
+#include "check.hpp"
+#include "base/resize.hpp"
+
+enum Kind
+{
+    LETTERBOX,
+    STRETCH,
+    CENTER_CROP,
+};
+
+struct Case
+{
+    int src_w, src_h;
+    int dst_w, dst_h;
+    Kind kind;
+};
+
+/* the layouts common.hpp builds for get_input_data_letterbox, _no_letterbox and _centercrop */
+static resize::Layout make_layout(const Case& c)
+{
+    if (c.kind == LETTERBOX)
+    {
+        float scale = std::min((float)c.dst_w / c.src_w, (float)c.dst_h / c.src_h);
+        int resize_w = (int)(scale * c.src_w);
+        int resize_h = (int)(scale * c.src_h);
+        return resize::make_layout(resize_w, resize_h, 0, 0, (c.dst_w - resize_w) / 2, (c.dst_h - resize_h) / 2, resize_w, resize_h);
+    }
+    if (c.kind == STRETCH)
+    {
+        return resize::make_layout(c.dst_w, c.dst_h, 0, 0, 0, 0, c.dst_w, c.dst_h);
+    }
+    int w0, h0;
+    if (c.src_h < c.src_w)
+    {
+        h0 = 256;
+        w0 = (int)(c.src_w * (256.0 / c.src_h));
+    }
+    else
+    {
+        w0 = 256;
+        h0 = (int)(c.src_h * (256.0 / c.src_w));
+    }
+    return resize::make_layout(w0, h0, w0 / 2 - c.dst_w / 2, h0 / 2 - c.dst_h / 2, 0, 0, c.dst_w, c.dst_h);
+}
+
+/* exact bilinear in double with the coordinate convention of cv::resize INTER_LINEAR */
+static void exact_bilinear(const uint8_t* src, int src_w, int src_h, int src_stride, uint8_t* dst, int dst_w, int dst_h, int dst_stride)
+{
+    const double scale_x = (double)src_w / dst_w;
+    const double scale_y = (double)src_h / dst_h;
+    for (int y = 0; y < dst_h; y++)
+    {
+        double fy = (y + 0.5) * scale_y - 0.5;
+        int y0 = (int)std::floor(fy);
+        double ay = fy - y0;
+        if (y0 < 0)
+        {
+            y0 = 0;
+            ay = 0.;
+        }
+        if (y0 >= src_h - 1)
+        {
+            y0 = src_h - 1;
+            ay = 0.;
+        }
+        int y1 = std::min(y0 + 1, src_h - 1);
+        for (int x = 0; x < dst_w; x++)
+        {
+            double fx = (x + 0.5) * scale_x - 0.5;
+            int x0 = (int)std::floor(fx);
+            double ax = fx - x0;
+            if (x0 < 0)
+            {
+                x0 = 0;
+                ax = 0.;
+            }
+            if (x0 >= src_w - 1)
+            {
+                x0 = src_w - 1;
+                ax = 0.;
+            }
+            int x1 = std::min(x0 + 1, src_w - 1);
+            for (int c = 0; c < 3; c++)
+            {
+                const uint8_t* r0 = src + y0 * src_stride + c;
+                const uint8_t* r1 = src + y1 * src_stride + c;
+                double top = r0[x0 * 3] * (1. - ax) + r0[x1 * 3] * ax;
+                double bottom = r1[x0 * 3] * (1. - ax) + r1[x1 * 3] * ax;
+                dst[y * dst_stride + x * 3 + c] = (uint8_t)std::lround(top * (1. - ay) + bottom * ay);
+            }
+        }
+    }
+}
+
+static int max_difference(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+{
+    int difference = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        difference = std::max(difference, std::abs((int)a[i] - (int)b[i]));
+    }
+    return difference;
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = check::repeat(argc, argv, 20);
+    std::mt19937 rng(3);
+
+    // odd strides on both sides, the padding bytes of dst must stay untouched
+    const Case cases[] = {
+        {1920, 1080, 640, 640, LETTERBOX},
+        {1280, 720, 320, 320, LETTERBOX},
+        {333, 500, 640, 640, LETTERBOX},
+        {64, 48, 640, 640, LETTERBOX},
+        {7, 5, 13, 11, LETTERBOX},
+        {2, 3, 5, 4, LETTERBOX},
+        {640, 480, 224, 224, STRETCH},
+        {1, 1, 8, 8, STRETCH},
+        {500, 375, 224, 224, CENTER_CROP},
+    };
+    for (const Case& c : cases)
+    {
+        const int src_stride = c.src_w * 3 + c.src_w % 3;
+        const int dst_stride = c.dst_w * 3 + 5;
+        std::vector<uint8_t> src((size_t)src_stride * c.src_h);
+        for (uint8_t& v : src)
+        {
+            v = (uint8_t)rng();
+        }
+        resize::Layout layout = make_layout(c);
+        for (bool swap : {false, true})
+        {
+            std::vector<uint8_t> expected((size_t)dst_stride * c.dst_h, 7), actual(expected.size(), 7);
+            resize::bilinear_letterbox_reference(src.data(), c.src_w, c.src_h, src_stride, expected.data(), c.dst_w, c.dst_h, dst_stride, layout, swap, 114);
+            resize::bilinear_letterbox(src.data(), c.src_w, c.src_h, src_stride, actual.data(), c.dst_w, c.dst_h, dst_stride, layout, swap, 114);
+            CHECK(expected == actual);
+        }
+    }
+
+    // fixed point against exact bilinear, random sizes up and down
+    int worst = 0;
+    for (int i = 0; i < 50; i++)
+    {
+        int src_w = 2 + (int)(rng() % 700), src_h = 2 + (int)(rng() % 700);
+        int dst_w = 1 + (int)(rng() % 640), dst_h = 1 + (int)(rng() % 640);
+        std::vector<uint8_t> src((size_t)src_w * 3 * src_h);
+        for (uint8_t& v : src)
+        {
+            v = (uint8_t)rng();
+        }
+        std::vector<uint8_t> exact((size_t)dst_w * 3 * dst_h), actual(exact.size());
+        exact_bilinear(src.data(), src_w, src_h, src_w * 3, exact.data(), dst_w, dst_h, dst_w * 3);
+        resize::bilinear_letterbox(src.data(), src_w, src_h, src_w * 3, actual.data(), dst_w, dst_h, dst_w * 3,
+                                   resize::make_layout(dst_w, dst_h, 0, 0, 0, 0, dst_w, dst_h));
+        worst = std::max(worst, max_difference(exact, actual));
+    }
+    CHECK(worst <= 1);
+    fprintf(stdout, "max difference to exact bilinear %d\n", worst);
+
+    // the letterbox of a 1080p frame, as the samples feed a 640x640 model
+    const Case frame = cases[0];
+    std::vector<uint8_t> src((size_t)frame.src_w * 3 * frame.src_h);
+    for (uint8_t& v : src)
+    {
+        v = (uint8_t)rng();
+    }
+    std::vector<uint8_t> dst((size_t)frame.dst_w * 3 * frame.dst_h);
+    resize::Layout layout = make_layout(frame);
+    double reference = check::best_of_us(std::max(repeat / 5, 1), [&]() {
+        resize::bilinear_letterbox_reference(src.data(), frame.src_w, frame.src_h, frame.src_w * 3, dst.data(), frame.dst_w, frame.dst_h, frame.dst_w * 3, layout, true, 114);
+    });
+    double fused = check::best_of_us(repeat, [&]() {
+        resize::bilinear_letterbox(src.data(), frame.src_w, frame.src_h, frame.src_w * 3, dst.data(), frame.dst_w, frame.dst_h, frame.dst_w * 3, layout, true, 114);
+    });
+    fprintf(stdout, "%-22s %10s %10s\n", "1920x1080 -> 640x640", "us", "speedup");
+    fprintf(stdout, "%-22s %10.1f %10s\n", "reference", reference, "");
+    fprintf(stdout, "%-22s %10.1f %9.1fx\n", "bilinear_letterbox", fused, reference / fused);
+
+#if defined(AX_HOST_TEST_OPENCV)
+    {
+        // what common.hpp did before: cv::resize into the roi, border fill, cv::cvtColor
+        cv::Mat mat(frame.src_h, frame.src_w, CV_8UC3, src.data());
+        cv::Mat out(frame.dst_h, frame.dst_w, CV_8UC3, cv::Scalar(114, 114, 114));
+        cv::Mat roi = out(cv::Rect(layout.roi_x, layout.roi_y, layout.roi_w, layout.roi_h));
+        double opencv = check::best_of_us(repeat, [&]() {
+            out.setTo(cv::Scalar(114, 114, 114));
+            cv::resize(mat, roi, cv::Size(layout.roi_w, layout.roi_h));
+            cv::cvtColor(out, out, cv::COLOR_BGR2RGB);
+        });
+        fprintf(stdout, "%-22s %10.1f %9.1fx\n", "cv::resize", opencv, opencv / fused);
+
+        // the inputs the model sees move by at most one step against cv::resize
+        resize::bilinear_letterbox(src.data(), frame.src_w, frame.src_h, frame.src_w * 3, dst.data(), frame.dst_w, frame.dst_h, frame.dst_w * 3, layout, false, 114);
+        cv::resize(mat, roi, cv::Size(layout.roi_w, layout.roi_h));
+        std::vector<uint8_t> expected(out.data, out.data + dst.size());
+        int difference = max_difference(expected, dst);
+        CHECK(difference <= 1);
+        fprintf(stdout, "max difference to cv::resize %d\n", difference);
+
+        // common.hpp: cv::resize by default, the fused kernel only when asked for
+        std::vector<uint8_t> image(dst.size());
+        letterbox::LetterboxTransform transform = letterbox::make(mat.rows, mat.cols, frame.dst_h, frame.dst_w);
+        cv::Mat letterboxed(frame.dst_h, frame.dst_w, CV_8UC3, cv::Scalar(0, 0, 0));
+        cv::Mat inner = letterboxed(cv::Rect(transform.pad_x, transform.pad_y, transform.resize_w, transform.resize_h));
+        cv::resize(mat, inner, cv::Size(transform.resize_w, transform.resize_h));
+        cv::cvtColor(letterboxed, letterboxed, cv::COLOR_BGR2RGB);
+        expected.assign(letterboxed.data, letterboxed.data + dst.size());
+        common::get_input_data_letterbox(mat, image, frame.dst_h, frame.dst_w, true);
+        CHECK(image == expected);
+        common::get_input_data_letterbox(mat, image, frame.dst_h, frame.dst_w, true, true);
+        CHECK(max_difference(expected, image) <= 1);
+    }
+#endif
+
+    return check::result();
+}
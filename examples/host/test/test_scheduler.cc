@@ -0,0 +1,279 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ * 
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ * 
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ * 
+ * https://opensource.org/licenses/BSD-3-Clause
+ * 
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * scheduler: every request gets exactly one postprocess, a strict core hint with steal off,
+ * stealing by idle replicas with steal on, the failed count for preprocess and npu errors,
+ * release() draining the queued requests and init failing on a bad model. the replay backend
+ * runs the model, a sleeping preprocess keeps the queues non empty.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+#include "middleware/scheduler.hpp"
+
+enum
+{
+    FAULT_NONE = 0,
+    FAULT_PREPROCESS = 1, // preprocess returns false, postprocess sees -1
+    FAULT_NPU = 2,        // the input buffer is taken away, AX_ENGINE_RunSyncV2 fails
+};
+
+struct Job
+{
+    int id;
+    int fault;
+    void* input; // the input buffer a FAULT_NPU job took away
+};
+
+// written by the workers under lock, CHECK runs on the main thread only
+static struct Outcome
+{
+    std::mutex lock;
+    std::vector<int> replies; // postprocess calls per job id
+    std::vector<int> ret;
+    std::set<const AX_ENGINE_IO_INFO_T*> instances; // io info of the instances that ran a job
+    int preprocess_us = 0;
+} outcome;
+
+static const std::string manifest = "name toy\n"
+                                    "latency_ms 1\n"
+                                    "input images uint8 1x4x4x3 nhwc bgr\n"
+                                    "output out0 float32 1x4\n";
+
+static bool preprocess(Job& job, AX_ENGINE_IO_INFO_T*, AX_ENGINE_IO_T* io)
+{
+    if (outcome.preprocess_us > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(outcome.preprocess_us));
+    if (job.fault == FAULT_PREPROCESS)
+        return false;
+    if (job.fault == FAULT_NPU)
+    {
+        job.input = io->pInputs[0].pVirAddr;
+        io->pInputs[0].pVirAddr = nullptr;
+    }
+    return true;
+}
+
+static void postprocess(Job& job, AX_ENGINE_IO_INFO_T* info, AX_ENGINE_IO_T* io, int ret)
+{
+    if (job.input)
+        io->pInputs[0].pVirAddr = job.input;
+    std::lock_guard<std::mutex> guard(outcome.lock);
+    outcome.replies[job.id]++;
+    outcome.ret[job.id] = ret;
+    if (0 == ret)
+        outcome.instances.insert(info);
+}
+
+static middleware::SchedulerOptions options(int mode, bool steal, int contexts, int preprocess_us)
+{
+    middleware::SchedulerOptions options = middleware::make_scheduler_options(mode, 3, contexts);
+    options.steal = steal;
+    outcome.preprocess_us = preprocess_us;
+    return options;
+}
+
+static void submit(middleware::scheduler<Job>& scheduler, int first, int count, int hint, int fault_every = 0)
+{
+    for (int i = first; i < first + count; i++)
+    {
+        int fault = FAULT_NONE;
+        if (fault_every > 0 && i % fault_every == 0)
+            fault = (i / fault_every) % 2 ? FAULT_NPU : FAULT_PREPROCESS;
+        scheduler.submit(Job{i, fault, nullptr}, hint);
+    }
+}
+
+static void reset_outcome(int jobs)
+{
+    outcome.replies.assign(jobs, 0);
+    outcome.ret.assign(jobs, 1);
+    outcome.instances.clear();
+}
+
+static bool replied_once(int jobs)
+{
+    for (int i = 0; i < jobs; i++)
+    {
+        if (outcome.replies[i] != 1)
+            return false;
+    }
+    return true;
+}
+
+static size_t stolen(const middleware::SchedulerStats& stats)
+{
+    size_t count = 0;
+    for (auto& instance : stats.instances)
+    {
+        count += instance.stolen;
+    }
+    return count;
+}
+
+// one instance on the whole npu, two contexts, four threads submitting
+static void check_full()
+{
+    const int jobs = 200;
+    reset_outcome(jobs);
+    middleware::scheduler<Job> scheduler;
+    CHECK(scheduler.init(manifest.data(), manifest.size(), options(middleware::SCHEDULE_FULL, true, 2, 0), preprocess, postprocess) == 0);
+    CHECK(scheduler.num_instances() == 1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back(submit, std::ref(scheduler), t * jobs / 4, jobs / 4, -1, 0);
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    scheduler.wait();
+    middleware::SchedulerStats stats = scheduler.stats();
+    CHECK(replied_once(jobs));
+    CHECK(stats.requests == jobs && stats.failed == 0 && stats.instances.size() == 1);
+    CHECK(stats.instances[0].requests == jobs && stolen(stats) == 0);
+
+    // a second run after reset_stats counts from zero
+    reset_outcome(jobs);
+    scheduler.reset_stats();
+    submit(scheduler, 0, jobs, -1);
+    scheduler.wait();
+    CHECK(replied_once(jobs) && scheduler.stats().requests == jobs);
+}
+
+// steal off: every request runs on the hinted replica, a hint past the last wraps
+static void check_strict_hint()
+{
+    const int jobs = 40;
+    reset_outcome(jobs);
+    middleware::scheduler<Job> scheduler;
+    CHECK(scheduler.init(manifest.data(), manifest.size(), options(middleware::SCHEDULE_REPLICAS, false, 1, 500), preprocess, postprocess) == 0);
+    CHECK(scheduler.num_instances() == 3);
+    submit(scheduler, 0, jobs / 2, 1);
+    submit(scheduler, jobs / 2, jobs / 2, 4);
+    scheduler.wait();
+    middleware::SchedulerStats stats = scheduler.stats();
+    CHECK(replied_once(jobs) && outcome.instances.size() == 1);
+    CHECK(stats.requests == jobs && stolen(stats) == 0);
+    CHECK(stats.instances[0].requests == 0 && stats.instances[1].requests == jobs && stats.instances[2].requests == 0);
+}
+
+// steal on: everything is hinted to replica 0, the idle replicas take from its queue
+static void check_steal()
+{
+    const int jobs = 40;
+    reset_outcome(jobs);
+    middleware::scheduler<Job> scheduler;
+    CHECK(scheduler.init(manifest.data(), manifest.size(), options(middleware::SCHEDULE_REPLICAS, true, 1, 2000), preprocess, postprocess) == 0);
+    submit(scheduler, 0, jobs, 0);
+    scheduler.wait();
+    middleware::SchedulerStats stats = scheduler.stats();
+    CHECK(replied_once(jobs) && stats.requests == jobs);
+    CHECK(stolen(stats) > 0 && outcome.instances.size() > 1);
+    CHECK(stats.instances[0].stolen == 0);
+    CHECK(stats.instances[1].requests + stats.instances[2].requests == stolen(stats));
+}
+
+// failed requests are replied to with their error and counted apart
+static void check_failures()
+{
+    const int jobs = 120, fault_every = 5;
+    reset_outcome(jobs);
+    middleware::scheduler<Job> scheduler;
+    CHECK(scheduler.init(manifest.data(), manifest.size(), options(middleware::SCHEDULE_REPLICAS, true, 2, 0), preprocess, postprocess) == 0);
+    submit(scheduler, 0, jobs, -1, fault_every);
+    scheduler.wait();
+    middleware::SchedulerStats stats = scheduler.stats();
+    CHECK(replied_once(jobs));
+    CHECK(stats.failed == jobs / fault_every && stats.requests == jobs - jobs / fault_every);
+    size_t run = 0;
+    for (auto& instance : stats.instances)
+    {
+        run += instance.requests;
+    }
+    CHECK(run == stats.requests);
+    for (int i = 0; i < jobs; i++)
+    {
+        if (i % fault_every != 0)
+            CHECK(outcome.ret[i] == 0);
+        else if ((i / fault_every) % 2)
+            CHECK(outcome.ret[i] != 0 && outcome.ret[i] != -1);
+        else
+            CHECK(outcome.ret[i] == -1);
+    }
+}
+
+// release() without wait() runs the queued requests before it stops the workers
+static void check_release()
+{
+    const int jobs = 30;
+    reset_outcome(jobs);
+    {
+        middleware::scheduler<Job> scheduler;
+        CHECK(scheduler.init(manifest.data(), manifest.size(), options(middleware::SCHEDULE_REPLICAS, false, 1, 1000), preprocess, postprocess) == 0);
+        submit(scheduler, 0, jobs, 2);
+        scheduler.release();
+        CHECK(replied_once(jobs));
+        CHECK(scheduler.num_instances() == 0);
+
+        // the destructor after an explicit release, and a release of nothing
+        scheduler.release();
+    }
+    for (int i = 0; i < jobs; i++)
+    {
+        CHECK(outcome.ret[i] == 0);
+    }
+
+    // the scheduler frees its io sets
+    CHECK(middleware::default_cmm_pool().stats().cmm_bytes == 0);
+}
+
+static void check_bad_model()
+{
+    middleware::scheduler<Job> scheduler;
+    const std::string bad = "name bad\ninput x uint8 1x2\n";
+    CHECK(scheduler.init(bad.data(), bad.size(), options(middleware::SCHEDULE_REPLICAS, true, 1, 0), preprocess, postprocess) != 0);
+    CHECK(scheduler.num_instances() == 0);
+}
+
+int main()
+{
+    setenv("AX_HOST_LATENCY_SCALE", "0", 1);
+    CHECK(AX_SYS_Init() == 0);
+
+    CHECK(middleware::init_npu(middleware::SCHEDULE_FULL) == 0);
+    check_full();
+
+    CHECK(middleware::init_npu(middleware::SCHEDULE_REPLICAS) == 0);
+    check_strict_hint();
+    check_steal();
+    check_failures();
+    check_release();
+    check_bad_model();
+
+    CHECK(AX_ENGINE_Deinit() == 0);
+    CHECK(AX_SYS_Deinit() == 0);
+    return check::result();
+}
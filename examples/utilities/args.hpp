@@ -54,4 +54,29 @@ namespace utilities
 
         return true;
     }
+
+    template <typename T>
+    bool parse_string(const std::string& argument_string, std::vector<T>& arguments, const std::string& delimiter = ",")
+    {
+        arguments.clear();
+        for (auto& item : split_string(argument_string, delimiter))
+        {
+            if (item.empty())
+            {
+                return false;
+            }
+
+            if (std::is_integral<T>::value)
+            {
+                arguments.push_back(std::stoi(item));
+            }
+
+            if (std::is_floating_point<T>::value)
+            {
+                arguments.push_back(std::stof(item));
+            }
+        }
+
+        return true;
+    }
 }
@@ -21,9 +21,15 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdio>
 #include <string>
 #include <vector>
 #include <fstream>
+#include <algorithm>
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
 
 namespace utilities
 {
@@ -90,4 +96,66 @@ namespace utilities
 
         return true;
     }
+
+    bool dir_exist(const std::string& path)
+    {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    bool create_dir(const std::string& path)
+    {
+        return mkdir(path.c_str(), 0755) == 0 || dir_exist(path);
+    }
+
+    // regular files in dir matching a glob pattern such as "*.jpg", several patterns can be
+    // separated by ';'. names are sorted and relative to dir.
+    bool file_list(const std::string& dir, const std::string& pattern, std::vector<std::string>& files)
+    {
+        DIR* handle = opendir(dir.c_str());
+        if (!handle)
+        {
+            fprintf(stderr, "[ERR] cannot open dir %s \n", dir.c_str());
+            return false;
+        }
+
+        std::vector<std::string> patterns;
+        std::string::size_type begin = 0;
+        while (begin <= pattern.size())
+        {
+            auto end = pattern.find(';', begin);
+            if (end == std::string::npos)
+            {
+                end = pattern.size();
+            }
+            if (end > begin)
+            {
+                patterns.push_back(pattern.substr(begin, end - begin));
+            }
+            begin = end + 1;
+        }
+
+        auto first = files.size();
+        while (struct dirent* entry = readdir(handle))
+        {
+            std::string name = entry->d_name;
+            struct stat st;
+            if (stat((dir + "/" + name).c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            {
+                continue;
+            }
+            for (auto& p : patterns)
+            {
+                if (fnmatch(p.c_str(), name.c_str(), 0) == 0)
+                {
+                    files.push_back(name);
+                    break;
+                }
+            }
+        }
+        closedir(handle);
+
+        std::sort(files.begin() + first, files.end());
+        return true;
+    }
 } // namespace utilities